@@ -28,6 +28,8 @@
 #include "hphp/runtime/base/macros.h"
 #include "hphp/runtime/base/shared-array.h"
 #include "hphp/runtime/base/comparisons.h"
+#include "hphp/runtime/base/struct-array.h"
+#include "hphp/runtime/base/slice-array.h"
 #include "hphp/runtime/vm/name-value-table-wrapper.h"
 
 namespace HPHP {
@@ -67,215 +69,424 @@ static size_t VsizeNop(const ArrayData* ad) {
   return ad->getSize();
 }
 
-// order: kPackedKind, kMixedKind, kSharedKind, kNvtwKind
+// order: kPackedKind, kMixedKind, kSharedKind, kNvtwKind, kStructKind,
+//        kIntVecKind, kDblVecKind, kSliceKind
 extern const ArrayFunctions g_array_funcs = {
   // release
   { &HphpArray::ReleasePacked, &HphpArray::Release,
     &SharedArray::Release,
-    &NameValueTableWrapper::Release },
+    &NameValueTableWrapper::Release,
+    &StructArray::Release,
+    &HphpArray::ReleaseTypedVec,
+    &HphpArray::ReleaseTypedVec,
+    &SliceArray::Release },
   // nvGetInt
   { &HphpArray::NvGetIntPacked, &HphpArray::NvGetInt,
     &SharedArray::NvGetInt,
-    &NameValueTableWrapper::NvGetInt },
+    &NameValueTableWrapper::NvGetInt,
+    &StructArray::NvGetInt,
+    &HphpArray::NvGetIntTypedVec,
+    &HphpArray::NvGetIntTypedVec,
+    &SliceArray::NvGetInt },
   // nvGetStr
   { &HphpArray::NvGetStrPacked, &HphpArray::NvGetStr,
     &SharedArray::NvGetStr,
-    &NameValueTableWrapper::NvGetStr },
+    &NameValueTableWrapper::NvGetStr,
+    &StructArray::NvGetStr,
+    &HphpArray::NvGetStrTypedVec,
+    &HphpArray::NvGetStrTypedVec,
+    &SliceArray::NvGetStr },
   // nvGetKey
   { &HphpArray::NvGetKeyPacked, &HphpArray::NvGetKey,
     &SharedArray::NvGetKey,
-    &NameValueTableWrapper::NvGetKey },
+    &NameValueTableWrapper::NvGetKey,
+    &StructArray::NvGetKey,
+    &HphpArray::NvGetKeyTypedVec,
+    &HphpArray::NvGetKeyTypedVec,
+    &SliceArray::NvGetKey },
   // setInt
   { &HphpArray::SetIntPacked, &HphpArray::SetInt,
     &SharedArray::SetInt,
-    &NameValueTableWrapper::SetInt },
+    &NameValueTableWrapper::SetInt,
+    &StructArray::SetInt,
+    &HphpArray::SetIntTypedVec,
+    &HphpArray::SetIntTypedVec,
+    &SliceArray::SetInt },
   // setStr
   { &HphpArray::SetStrPacked, &HphpArray::SetStr,
     &SharedArray::SetStr,
-    &NameValueTableWrapper::SetStr },
+    &NameValueTableWrapper::SetStr,
+    &StructArray::SetStr,
+    &HphpArray::SetStrTypedVec,
+    &HphpArray::SetStrTypedVec,
+    &SliceArray::SetStr },
   // vsize
   { &VsizeNop, &VsizeNop,
     &VsizeNop,
-    &NameValueTableWrapper::Vsize },
+    &NameValueTableWrapper::Vsize,
+    &VsizeNop,
+    &VsizeNop,
+    &VsizeNop,
+    &VsizeNop },
   // getValueRef
   { &HphpArray::GetValueRef, &HphpArray::GetValueRef,
     &SharedArray::GetValueRef,
-    &NameValueTableWrapper::GetValueRef },
+    &NameValueTableWrapper::GetValueRef,
+    &StructArray::GetValueRef,
+    &HphpArray::GetValueRefTypedVec,
+    &HphpArray::GetValueRefTypedVec,
+    &SliceArray::GetValueRef },
   // noCopyOnWrite
   { false, false,
     false,
-    true }, // NameValueTableWrapper doesn't support COW.
+    true, // NameValueTableWrapper doesn't support COW.
+    false,
+    false,
+    false,
+    false },
   // isVectorData
   { &HphpArray::IsVectorDataPacked, &HphpArray::IsVectorData,
     &SharedArray::IsVectorData,
-    &NameValueTableWrapper::IsVectorData },
+    &NameValueTableWrapper::IsVectorData,
+    &StructArray::IsVectorData,
+    &HphpArray::IsVectorDataPacked,
+    &HphpArray::IsVectorDataPacked,
+    &SliceArray::IsVectorData },
   // existsInt
   { &HphpArray::ExistsIntPacked, &HphpArray::ExistsInt,
     &SharedArray::ExistsInt,
-    &NameValueTableWrapper::ExistsInt },
+    &NameValueTableWrapper::ExistsInt,
+    &StructArray::ExistsInt,
+    &HphpArray::ExistsIntTypedVec,
+    &HphpArray::ExistsIntTypedVec,
+    &SliceArray::ExistsInt },
   // existsStr
   { &HphpArray::ExistsStrPacked, &HphpArray::ExistsStr,
     &SharedArray::ExistsStr,
-    &NameValueTableWrapper::ExistsStr },
+    &NameValueTableWrapper::ExistsStr,
+    &StructArray::ExistsStr,
+    &HphpArray::ExistsStrTypedVec,
+    &HphpArray::ExistsStrTypedVec,
+    &SliceArray::ExistsStr },
   // lvalInt
   { &HphpArray::LvalIntPacked, &HphpArray::LvalInt,
     &SharedArray::LvalInt,
-    &NameValueTableWrapper::LvalInt },
+    &NameValueTableWrapper::LvalInt,
+    &StructArray::LvalInt,
+    &HphpArray::LvalIntTypedVec,
+    &HphpArray::LvalIntTypedVec,
+    &SliceArray::LvalInt },
   // lvalStr
   { &HphpArray::LvalStrPacked, &HphpArray::LvalStr,
     &SharedArray::LvalStr,
-    &NameValueTableWrapper::LvalStr },
+    &NameValueTableWrapper::LvalStr,
+    &StructArray::LvalStr,
+    &HphpArray::LvalStrTypedVec,
+    &HphpArray::LvalStrTypedVec,
+    &SliceArray::LvalStr },
   // lvalNew
   { &HphpArray::LvalNewPacked, &HphpArray::LvalNew,
     &SharedArray::LvalNew,
-    &NameValueTableWrapper::LvalNew },
+    &NameValueTableWrapper::LvalNew,
+    &StructArray::LvalNew,
+    &HphpArray::LvalNewTypedVec,
+    &HphpArray::LvalNewTypedVec,
+    &SliceArray::LvalNew },
   // setRefInt
   { &HphpArray::SetRefIntPacked, &HphpArray::SetRefInt,
     &SharedArray::SetRefInt,
-    &NameValueTableWrapper::SetRefInt },
+    &NameValueTableWrapper::SetRefInt,
+    &StructArray::SetRefInt,
+    &HphpArray::SetRefIntTypedVec,
+    &HphpArray::SetRefIntTypedVec,
+    &SliceArray::SetRefInt },
   // setRefStr
   { &HphpArray::SetRefStrPacked, &HphpArray::SetRefStr,
     &SharedArray::SetRefStr,
-    &NameValueTableWrapper::SetRefStr },
+    &NameValueTableWrapper::SetRefStr,
+    &StructArray::SetRefStr,
+    &HphpArray::SetRefStrTypedVec,
+    &HphpArray::SetRefStrTypedVec,
+    &SliceArray::SetRefStr },
   // addInt
   { &HphpArray::AddIntPacked, &HphpArray::AddInt,
     &SharedArray::SetInt, // reuse set
-    &NameValueTableWrapper::SetInt }, // reuse set
+    &NameValueTableWrapper::SetInt, // reuse set
+    &StructArray::SetInt, // reuse set
+    &HphpArray::AddIntTypedVec,
+    &HphpArray::AddIntTypedVec,
+    &SliceArray::SetInt }, // reuse set
   // addStr
   { &HphpArray::SetStrPacked, // reuse set
     &HphpArray::AddStr,
     &SharedArray::SetStr, // reuse set
-    &NameValueTableWrapper::SetStr }, // reuse set
+    &NameValueTableWrapper::SetStr, // reuse set
+    &StructArray::SetStr, // reuse set
+    &HphpArray::SetStrTypedVec, // reuse set
+    &HphpArray::SetStrTypedVec, // reuse set
+    &SliceArray::SetStr }, // reuse set
   // removeInt
   { &HphpArray::RemoveIntPacked, &HphpArray::RemoveInt,
     &SharedArray::RemoveInt,
-    &NameValueTableWrapper::RemoveInt },
+    &NameValueTableWrapper::RemoveInt,
+    &StructArray::RemoveInt,
+    &HphpArray::RemoveIntTypedVec,
+    &HphpArray::RemoveIntTypedVec,
+    &SliceArray::RemoveInt },
   // removeStr
   { &HphpArray::RemoveStrPacked, &HphpArray::RemoveStr,
     &SharedArray::RemoveStr,
-    &NameValueTableWrapper::RemoveStr },
+    &NameValueTableWrapper::RemoveStr,
+    &StructArray::RemoveStr,
+    &HphpArray::RemoveStrTypedVec,
+    &HphpArray::RemoveStrTypedVec,
+    &SliceArray::RemoveStr },
   // iterBegin
   { &HphpArray::IterBegin, &HphpArray::IterBegin,
     &SharedArray::IterBegin,
-    &NameValueTableWrapper::IterBegin },
+    &NameValueTableWrapper::IterBegin,
+    &StructArray::IterBegin,
+    &HphpArray::IterBeginTypedVec,
+    &HphpArray::IterBeginTypedVec,
+    &SliceArray::IterBegin },
   // iterEnd
   { &HphpArray::IterEnd, &HphpArray::IterEnd,
     &SharedArray::IterEnd,
-    &NameValueTableWrapper::IterEnd },
+    &NameValueTableWrapper::IterEnd,
+    &StructArray::IterEnd,
+    &HphpArray::IterEndTypedVec,
+    &HphpArray::IterEndTypedVec,
+    &SliceArray::IterEnd },
   // iterAdvance
   { &HphpArray::IterAdvance, &HphpArray::IterAdvance,
     &SharedArray::IterAdvance,
-    &NameValueTableWrapper::IterAdvance },
+    &NameValueTableWrapper::IterAdvance,
+    &StructArray::IterAdvance,
+    &HphpArray::IterAdvanceTypedVec,
+    &HphpArray::IterAdvanceTypedVec,
+    &SliceArray::IterAdvance },
   // iterRewind
   { &HphpArray::IterRewind, &HphpArray::IterRewind,
     &SharedArray::IterRewind,
-    &NameValueTableWrapper::IterRewind },
+    &NameValueTableWrapper::IterRewind,
+    &StructArray::IterRewind,
+    &HphpArray::IterRewindTypedVec,
+    &HphpArray::IterRewindTypedVec,
+    &SliceArray::IterRewind },
   // validFullPos
   { &HphpArray::ValidFullPos, &HphpArray::ValidFullPos,
     &SharedArray::ValidFullPos,
-    &NameValueTableWrapper::ValidFullPos },
+    &NameValueTableWrapper::ValidFullPos,
+    &StructArray::ValidFullPos,
+    &HphpArray::ValidFullPosTypedVec,
+    &HphpArray::ValidFullPosTypedVec,
+    &SliceArray::ValidFullPos },
   // advanceFullPos
   { &HphpArray::AdvanceFullPos, &HphpArray::AdvanceFullPos,
     &SharedArray::AdvanceFullPos,
-    &NameValueTableWrapper::AdvanceFullPos },
+    &NameValueTableWrapper::AdvanceFullPos,
+    &StructArray::AdvanceFullPos,
+    &HphpArray::AdvanceFullPosTypedVec,
+    &HphpArray::AdvanceFullPosTypedVec,
+    &SliceArray::AdvanceFullPos },
   // escalateForSort
   { &HphpArray::EscalateForSort, &HphpArray::EscalateForSort,
     &SharedArray::EscalateForSort,
-    &NameValueTableWrapper::EscalateForSort },
+    &NameValueTableWrapper::EscalateForSort,
+    &StructArray::EscalateForSort,
+    &HphpArray::EscalateForSortTypedVec,
+    &HphpArray::EscalateForSortTypedVec,
+    &SliceArray::EscalateForSort },
   // ksort
   { &HphpArray::Ksort, &HphpArray::Ksort,
     &ArrayData::Ksort,
-    &NameValueTableWrapper::Ksort },
+    &NameValueTableWrapper::Ksort,
+    &ArrayData::Ksort,
+    &HphpArray::KsortTypedVec,
+    &HphpArray::KsortTypedVec,
+    &ArrayData::Ksort },
   // sort
   { &HphpArray::Sort, &HphpArray::Sort,
     &ArrayData::Sort,
-    &NameValueTableWrapper::Sort },
+    &NameValueTableWrapper::Sort,
+    &ArrayData::Sort,
+    &HphpArray::SortTypedVec,
+    &HphpArray::SortTypedVec,
+    &ArrayData::Sort },
   // asort
   { &HphpArray::Asort, &HphpArray::Asort,
     &ArrayData::Asort,
-    &NameValueTableWrapper::Asort },
+    &NameValueTableWrapper::Asort,
+    &ArrayData::Asort,
+    &HphpArray::AsortTypedVec,
+    &HphpArray::AsortTypedVec,
+    &ArrayData::Asort },
   // uksort
   { &HphpArray::Uksort, &HphpArray::Uksort,
     &ArrayData::Uksort,
-    &NameValueTableWrapper::Uksort },
+    &NameValueTableWrapper::Uksort,
+    &ArrayData::Uksort,
+    &HphpArray::UksortTypedVec,
+    &HphpArray::UksortTypedVec,
+    &ArrayData::Uksort },
   // usort
   { &HphpArray::Usort, &HphpArray::Usort,
     &ArrayData::Usort,
-    &NameValueTableWrapper::Usort },
+    &NameValueTableWrapper::Usort,
+    &ArrayData::Usort,
+    &HphpArray::UsortTypedVec,
+    &HphpArray::UsortTypedVec,
+    &ArrayData::Usort },
   // uasort
   { &HphpArray::Uasort, &HphpArray::Uasort,
     &ArrayData::Uasort,
-    &NameValueTableWrapper::Uasort },
+    &NameValueTableWrapper::Uasort,
+    &ArrayData::Uasort,
+    &HphpArray::UasortTypedVec,
+    &HphpArray::UasortTypedVec,
+    &ArrayData::Uasort },
   // copy
   { &HphpArray::CopyPacked, &HphpArray::Copy,
     &SharedArray::Copy,
-    &NameValueTableWrapper::Copy },
+    &NameValueTableWrapper::Copy,
+    &StructArray::Copy,
+    &HphpArray::CopyTypedVec,
+    &HphpArray::CopyTypedVec,
+    &SliceArray::Copy },
   // copyWithStrongIterators
   { &HphpArray::CopyWithStrongIterators, &HphpArray::CopyWithStrongIterators,
     &SharedArray::CopyWithStrongIterators,
-    &NameValueTableWrapper::CopyWithStrongIterators },
+    &NameValueTableWrapper::CopyWithStrongIterators,
+    &StructArray::Copy,
+    &HphpArray::CopyWithStrongIteratorsTypedVec,
+    &HphpArray::CopyWithStrongIteratorsTypedVec,
+    &SliceArray::Copy },
   // nonSmartCopy
   { &HphpArray::NonSmartCopy, &HphpArray::NonSmartCopy,
     &ArrayData::NonSmartCopy,
-    &ArrayData::NonSmartCopy },
+    &ArrayData::NonSmartCopy,
+    &StructArray::NonSmartCopy,
+    &HphpArray::NonSmartCopyTypedVec,
+    &HphpArray::NonSmartCopyTypedVec,
+    &SliceArray::NonSmartCopy },
   // append
   { &HphpArray::AppendPacked, &HphpArray::Append,
     &SharedArray::Append,
-    &NameValueTableWrapper::Append },
+    &NameValueTableWrapper::Append,
+    &StructArray::Append,
+    &HphpArray::AppendTypedVec,
+    &HphpArray::AppendTypedVec,
+    &SliceArray::Append },
   // appendRef
   { &HphpArray::AppendRefPacked, &HphpArray::AppendRef,
     &SharedArray::AppendRef,
-    &NameValueTableWrapper::AppendRef },
+    &NameValueTableWrapper::AppendRef,
+    &StructArray::AppendRef,
+    &HphpArray::AppendRefTypedVec,
+    &HphpArray::AppendRefTypedVec,
+    &SliceArray::AppendRef },
   // appendWithRef
   { &HphpArray::AppendWithRefPacked, &HphpArray::AppendWithRef,
     &SharedArray::AppendRef,
-    &NameValueTableWrapper::AppendRef },
+    &NameValueTableWrapper::AppendRef,
+    &StructArray::AppendWithRef,
+    &HphpArray::AppendWithRefTypedVec,
+    &HphpArray::AppendWithRefTypedVec,
+    &SliceArray::AppendWithRef },
   // plus
-  { &HphpArray::Plus, &HphpArray::Plus,
+  { &HphpArray::PlusPacked, &HphpArray::Plus,
     &SharedArray::Plus,
-    &NameValueTableWrapper::Plus },
+    &NameValueTableWrapper::Plus,
+    &StructArray::Plus,
+    &HphpArray::PlusTypedVec,
+    &HphpArray::PlusTypedVec,
+    &SliceArray::Plus },
   // merge
-  { &HphpArray::Merge, &HphpArray::Merge,
+  { &HphpArray::MergePacked, &HphpArray::Merge,
     &SharedArray::Merge,
-    &NameValueTableWrapper::Merge },
+    &NameValueTableWrapper::Merge,
+    &StructArray::Merge,
+    &HphpArray::MergeTypedVec,
+    &HphpArray::MergeTypedVec,
+    &SliceArray::Merge },
   // pop
   { &HphpArray::PopPacked, &HphpArray::Pop,
     &SharedArray::Pop,
-    &NameValueTableWrapper::Pop },
+    &NameValueTableWrapper::Pop,
+    &ArrayData::Pop,
+    &HphpArray::PopTypedVec,
+    &HphpArray::PopTypedVec,
+    &ArrayData::Pop },
   // dequeue
   { &HphpArray::DequeuePacked, &HphpArray::Dequeue,
     &SharedArray::Dequeue,
-    &NameValueTableWrapper::Dequeue },
+    &NameValueTableWrapper::Dequeue,
+    &ArrayData::Dequeue,
+    &HphpArray::DequeueTypedVec,
+    &HphpArray::DequeueTypedVec,
+    &ArrayData::Dequeue },
   // prepend
   { &HphpArray::PrependPacked, &HphpArray::Prepend,
     &SharedArray::Prepend,
-    &NameValueTableWrapper::Prepend },
+    &NameValueTableWrapper::Prepend,
+    &StructArray::Prepend,
+    &HphpArray::PrependTypedVec,
+    &HphpArray::PrependTypedVec,
+    &SliceArray::Prepend },
   // renumber
   { &HphpArray::RenumberPacked, &HphpArray::Renumber,
     &SharedArray::Renumber,
-    &NameValueTableWrapper::Renumber },
+    &NameValueTableWrapper::Renumber,
+    &ArrayData::Renumber,
+    &HphpArray::RenumberTypedVec,
+    &HphpArray::RenumberTypedVec,
+    &ArrayData::Renumber },
   // onSetEvalScalar
   { &HphpArray::OnSetEvalScalarPacked, &HphpArray::OnSetEvalScalar,
     &SharedArray::OnSetEvalScalar,
-    &NameValueTableWrapper::OnSetEvalScalar },
+    &NameValueTableWrapper::OnSetEvalScalar,
+    &ArrayData::OnSetEvalScalar,
+    &HphpArray::OnSetEvalScalarTypedVec,
+    &HphpArray::OnSetEvalScalarTypedVec,
+    &SliceArray::OnSetEvalScalar },
   // escalate
   { &ArrayData::Escalate, &ArrayData::Escalate,
     &SharedArray::Escalate,
-    &ArrayData::Escalate },
+    &ArrayData::Escalate,
+    &StructArray::Escalate,
+    &ArrayData::Escalate,
+    &ArrayData::Escalate,
+    &SliceArray::Escalate },
   // getSharedVariant
   { &ArrayData::GetSharedVariant, &ArrayData::GetSharedVariant,
     &SharedArray::GetSharedVariant,
+    &ArrayData::GetSharedVariant,
+    &ArrayData::GetSharedVariant,
+    &ArrayData::GetSharedVariant,
+    &ArrayData::GetSharedVariant,
     &ArrayData::GetSharedVariant },
   // zSetInt
   { &ArrayData::ZSetInt, &ArrayData::ZSetInt,
+    &ArrayData::ZSetInt,
+    &ArrayData::ZSetInt,
+    &ArrayData::ZSetInt,
+    &ArrayData::ZSetInt,
     &ArrayData::ZSetInt,
     &ArrayData::ZSetInt },
   // zSetStr
   { &ArrayData::ZSetStr, &ArrayData::ZSetStr,
+    &ArrayData::ZSetStr,
+    &ArrayData::ZSetStr,
+    &ArrayData::ZSetStr,
+    &ArrayData::ZSetStr,
     &ArrayData::ZSetStr,
     &ArrayData::ZSetStr },
   // zAppend
   { &ArrayData::ZAppend, &ArrayData::ZAppend,
+    &ArrayData::ZAppend,
+    &ArrayData::ZAppend,
+    &ArrayData::ZAppend,
+    &ArrayData::ZAppend,
     &ArrayData::ZAppend,
     &ArrayData::ZAppend },
 };
@@ -691,6 +902,10 @@ const char* ArrayData::kindToString(ArrayKind kind) {
     "MixedKind",
     "SharedKind",
     "NvtwKind",
+    "StructKind",
+    "IntVecKind",
+    "DblVecKind",
+    "SliceKind",
   };
   return names[kind];
 }
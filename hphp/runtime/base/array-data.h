@@ -18,6 +18,7 @@
 #define incl_HPHP_ARRAY_DATA_H_
 
 #include "hphp/runtime/base/countable.h"
+#include "hphp/runtime/base/cycle-collector.h"
 #include "hphp/runtime/base/types.h"
 #include "hphp/runtime/base/macros.h"
 #include <climits>
@@ -47,6 +48,10 @@ class ArrayData {
     kMixedKind,   // HphpArray arbitrary int or string keys, maybe holes
     kSharedKind,  // SharedArray
     kNvtwKind,    // NameValueTableWrapper
+    kStructKind,  // StructArray
+    kIntVecKind,  // HphpArray packed layout, every value a KindOfInt64
+    kDblVecKind,  // HphpArray packed layout, every value a KindOfDouble
+    kSliceKind,   // SliceArray
     kNumKinds // insert new values before kNumKinds.
   };
 
@@ -62,6 +67,7 @@ class ArrayData {
   explicit ArrayData(ArrayKind kind)
     : m_kind(kind)
     , m_allocMode(AllocationMode::smart)
+    , m_cycleRoot(false)
     , m_size(-1)
     , m_pos(0)
     , m_count(0)
@@ -71,6 +77,7 @@ class ArrayData {
   explicit ArrayData(ArrayKind kind, AllocationMode m)
     : m_kind(kind)
     , m_allocMode(m)
+    , m_cycleRoot(false)
     , m_size(-1)
     , m_pos(0)
     , m_count(0)
@@ -80,6 +87,7 @@ class ArrayData {
   ArrayData(ArrayKind kind, AllocationMode m, uint size)
     : m_kind(kind)
     , m_allocMode(m)
+    , m_cycleRoot(false)
     , m_size(size)
     , m_pos(size ? 0 : ArrayData::invalid_index)
     , m_count(0)
@@ -90,6 +98,7 @@ class ArrayData {
             AllocationMode m = AllocationMode::smart)
     : m_kind(src->m_kind)
     , m_allocMode(m)
+    , m_cycleRoot(false)
     , m_pos(src->m_pos)
     , m_count(0)
     , m_strongIterators(nullptr)
@@ -109,7 +118,41 @@ class ArrayData {
   ~ArrayData() { destroy(); }
 
 public:
-  IMPLEMENT_COUNTABLE_METHODS
+  void setStatic() const {
+    assert(is_refcount_realistic(m_count));
+    m_count = RefCountStaticValue;
+  }
+  bool isStatic() const {
+    assert(is_refcount_realistic(m_count));
+    return m_count == RefCountStaticValue;
+  }
+  RefCount getCount() const {
+    assert(is_refcount_realistic(m_count));
+    return m_count;
+  }
+  bool isRefCounted() const {
+    assert(is_refcount_realistic(m_count));
+    return m_count != RefCountStaticValue;
+  }
+  void incRefCount() const {
+    assert(!MemoryManager::sweeping());
+    assert(is_refcount_realistic(m_count));
+    if (isRefCounted()) { ++m_count; }
+  }
+  // Like objects, arrays the CycleCollector can walk are candidate
+  // cycle roots when they lose a reference but survive.
+  RefCount decRefCount() const {
+    assert(!MemoryManager::sweeping());
+    assert(m_count > 0);
+    assert(is_refcount_realistic(m_count));
+    if (!isRefCounted()) return m_count;
+    auto const count = --m_count;
+    if (UNLIKELY(CycleCollector::enabled()) && count && !m_cycleRoot &&
+        (isHphpArray() || isStructArray())) {
+      CycleCollector::addRoot(const_cast<ArrayData*>(this));
+    }
+    return count;
+  }
   void setRefCount(RefCount n) { m_count = n; }
 
   /**
@@ -199,6 +242,11 @@ public:
   bool isNameValueTableWrapper() const {
     return m_kind == kNvtwKind;
   }
+  bool isStructArray() const { return m_kind == kStructKind; }
+  bool isSliceArray() const { return m_kind == kSliceKind; }
+  bool isTypedVec() const {
+    return m_kind == kIntVecKind || m_kind == kDblVecKind;
+  }
 
   /*
    * Returns whether or not this array contains "vector-like" data.
@@ -536,6 +584,8 @@ public:
   static bool IsValidKey(const StringData* k) { return k; }
 
 protected:
+  friend struct CycleCollector;
+
   // The following fields are blocked into unions with qwords so we
   // can combine the stores when initializing arrays.  (gcc won't do
   // this on its own.)
@@ -543,7 +593,8 @@ protected:
     struct {
       ArrayKind m_kind;
       AllocationMode m_allocMode;
-      UNUSED uint16_t m_forSubClasses; // unused space that subclasses may use
+      mutable bool m_cycleRoot; // in the CycleCollector's root buffer
+      UNUSED uint8_t m_forSubClasses; // unused space that subclasses may use
       uint32_t m_size;
     };
     uint64_t m_kindModeAndSize;
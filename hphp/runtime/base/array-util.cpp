@@ -15,15 +15,32 @@
 */
 
 #include "hphp/runtime/base/array-util.h"
+#include "hphp/runtime/base/array-init.h"
 #include "hphp/runtime/base/array-iterator.h"
 #include "hphp/runtime/base/string-util.h"
 #include "hphp/runtime/base/builtin-functions.h"
 #include "hphp/runtime/base/runtime-error.h"
+#include "hphp/runtime/base/runtime-option.h"
+#include "hphp/runtime/base/slice-array.h"
 #include "hphp/runtime/ext/ext_math.h"
 #include "hphp/runtime/ext/ext_json.h"
 #include "hphp/runtime/ext/ext_string.h"
 
 namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Whether array_slice and friends should try a SliceArray for a run of
+ * `length' elements of input.  Keys of packed arrays and their views are
+ * their positions, so such a run renumbered is a run of keys 0..n-1.
+ */
+static bool wantSliceView(CArrRef input, int64_t length) {
+  auto const threshold = RuntimeOption::EvalSliceArrayThreshold;
+  return threshold && length > 0 && length >= threshold &&
+    !input.isNull() &&
+    (input->isPacked() || input->isTypedVec() || input->isSliceArray());
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // compositions
 
@@ -57,6 +74,24 @@ Variant ArrayUtil::Chunk(CArrRef input, int size,
   }
 
   Array ret = Array::Create();
+  int num_in = input.size();
+  if (!preserve_keys && wantSliceView(input, std::min(size, num_in))) {
+    // Each chunk is a run of positions and can share the input's elements.
+    for (int start = 0; start < num_in; start += size) {
+      int len = std::min(size, num_in - start);
+      if (auto view = SliceArray::Make(input.get(), start, len)) {
+        ret.append(Array(view));
+        continue;
+      }
+      PackedArrayInit chunk(len);
+      for (int pos = start; pos < start + len; ++pos) {
+        chunk.appendWithRef(input->getValueRef(pos));
+      }
+      ret.append(chunk.toArray());
+    }
+    return ret;
+  }
+
   Array chunk;
   int current = 0;
   for (ArrayIter iter(input); iter; ++iter) {
@@ -92,6 +127,25 @@ Variant ArrayUtil::Slice(CArrRef input, int offset, int64_t length,
     length = num_in - offset;
   }
 
+  if (!input.isNull() &&
+      (input->isPacked() || input->isTypedVec() || input->isSliceArray()) &&
+      (!preserve_keys || offset == 0)) {
+    // The keys of a packed array (typed or not) are its positions, so
+    // the slice is a contiguous run of elements and can stay packed.
+    int64_t stop = std::min<int64_t>(int64_t(offset) + length, num_in);
+    if (stop <= offset) return Array::Create();
+    if (wantSliceView(input, stop - offset)) {
+      if (auto view = SliceArray::Make(input.get(), offset, stop - offset)) {
+        return Array(view);
+      }
+    }
+    PackedArrayInit ai(stop - offset);
+    for (int64_t pos = offset; pos < stop; ++pos) {
+      ai.appendWithRef(input->getValueRef(pos));
+    }
+    return ai.toArray();
+  }
+
   Array out_hash = Array::Create();
   int pos = 0;
   ArrayIter iter(input);
@@ -125,6 +179,17 @@ Variant ArrayUtil::Splice(CArrRef input, int offset, int64_t length /* = 0 */,
     length = num_in - offset;
   }
 
+  // The removed run comes back renumbered, so it can share the input's
+  // elements when they are a run of positions.
+  bool removedView = false;
+  int64_t removedLen = std::min<int64_t>(length, num_in - offset);
+  if (removed && wantSliceView(input, removedLen)) {
+    if (auto view = SliceArray::Make(input.get(), offset, removedLen)) {
+      *removed = Array(view);
+      removedView = true;
+    }
+  }
+
   Array out_hash = Array::Create();
   int pos = 0;
   ArrayIter iter(input);
@@ -139,7 +204,7 @@ Variant ArrayUtil::Splice(CArrRef input, int offset, int64_t length /* = 0 */,
   }
 
   for (; pos < offset + length && iter; ++pos, ++iter) {
-    if (removed) {
+    if (removed && !removedView) {
       Variant key(iter.first());
       CVarRef v = iter.secondRef();
       if (key.isNumeric()) {
@@ -487,6 +552,14 @@ Variant ArrayUtil::Reverse(CArrRef input, bool preserve_keys /* = false */) {
     return input;
   }
 
+  if (input->isPacked() && !preserve_keys) {
+    PackedArrayInit ai(input.size());
+    for (ssize_t pos = input.size() - 1; pos >= 0; --pos) {
+      ai.appendWithRef(input->getValueRef(pos));
+    }
+    return ai.toArray();
+  }
+
   Array ret = Array::Create();
   for (ssize_t pos = input->iter_end(); pos != ArrayData::invalid_index;
        pos = input->iter_rewind(pos)) {
@@ -711,6 +784,19 @@ Variant ArrayUtil::Map(CArrRef inputs, PFUNC_MAP map_function,
 
   if (inputs.size() == 1) {
     Array arr = inputs.begin().secondRef().toArray();
+    if (!arr.empty() && arr->isPacked()) {
+      PackedArrayInit ai(arr.size());
+      for (ssize_t k = 0, n = arr.size(); k < n; ++k) {
+        Array params;
+        params.append(arr->getValueRef(k));
+        if (map_function) {
+          ai.append(map_function(params, data));
+        } else {
+          ai.append(params);
+        }
+      }
+      return ai.toArray();
+    }
     if (!arr.empty()) {
       for (ssize_t k = arr->iter_begin(); k != ArrayData::invalid_index;
            k = arr->iter_advance(k)) {
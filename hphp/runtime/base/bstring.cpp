@@ -15,6 +15,7 @@
 */
 
 #include "hphp/runtime/base/bstring.h"
+#include "hphp/util/string-simd.h"
 #include "hphp/util/util.h"
 
 namespace HPHP {
@@ -43,13 +44,7 @@ int bstrcasecmp(const char* left, size_t leftSize,
 }
 
 char* bstrcasechr(const char* haystack, char needle, size_t haystackSize) {
-  const char* haystackEnd = haystack + haystackSize;
-  for (; haystack != haystackEnd; ++haystack) {
-    if (chrcaseeq(*haystack, needle)) {
-      return (char*)haystack;
-    }
-  }
-  return nullptr;
+  return (char*)simd_memcasechr(haystack, haystackSize, needle);
 }
 
 HOT_FUNC
@@ -58,9 +53,16 @@ char* bstrcasestr(const char* haystack, size_t haystackSize,
   if (needleSize > haystackSize) {
     return nullptr;
   }
+  if (needleSize == 0) {
+    return (char*)haystack;
+  }
+  // Jump between the places where the needle's first character occurs.
   const char* haystackLast = haystack + (haystackSize - needleSize);
   for (;;) {
-    if (bstrcaseeq(haystack, needle, needleSize)) {
+    haystack = simd_memcasechr(haystack, haystackLast - haystack + 1,
+                               needle[0]);
+    if (!haystack) return nullptr;
+    if (bstrcaseeq(haystack + 1, needle + 1, needleSize - 1)) {
       return (char*)haystack;
     }
     if (haystack == haystackLast) return nullptr;
@@ -25,6 +25,7 @@
 #include "hphp/runtime/base/execution-context.h"
 #include "hphp/runtime/base/strings.h"
 #include "hphp/runtime/base/file-repository.h"
+#include "hphp/runtime/base/cycle-collector.h"
 #include "hphp/runtime/debugger/debugger.h"
 #include "hphp/runtime/ext/ext_process.h"
 #include "hphp/runtime/ext/ext_class.h"
@@ -592,6 +593,9 @@ ssize_t check_request_surprise(ThreadInfo *info) {
     pendingException = generate_memory_exceeded_exception();
   }
   if (do_signaled) f_pcntl_signal_dispatch();
+  if (flags & RequestInjectionData::CycleCollectFlag) {
+    CycleCollector::onCollectFlag();
+  }
 
   if (pendingException) {
     pendingException->throwException();
@@ -15,11 +15,18 @@
 */
 
 #include "hphp/runtime/base/concurrent-shared-store.h"
+#include "folly/ScopeGuard.h"
 #include "hphp/runtime/base/variable-serializer.h"
+#include "hphp/runtime/base/sweepable.h"
 #include "hphp/runtime/ext/ext_apc.h"
+#include "hphp/runtime/vm/treadmill.h"
+#include "hphp/util/cycles.h"
 #include "hphp/util/logger.h"
 #include "hphp/util/timer.h"
 #include <mutex>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 using std::set;
 
@@ -49,6 +56,42 @@ static void stats_on_delete(StringData* key, const StoreValue* sval, bool exp) {
     }
   }
 }
+static void stats_on_evict(StringData* key, const StoreValue* sval) {
+  SharedStoreStats::addEviction(sval->bytes);
+  if (RuntimeOption::EnableAPCSizeStats) {
+    SharedStoreStats::evictDirect(key->size(), sval->size);
+    if (RuntimeOption::EnableAPCSizeGroup ||
+        RuntimeOption::EnableAPCSizeDetail) {
+      SharedStoreStats::onDelete(key, sval->var, false, sval->expiry == 0);
+    }
+  }
+}
+
+// Stats.APCHotKeys: one access in APCHotKeysSampleRate per thread is
+// recorded.  Sampled accesses time how long the bucket lock took, and
+// count as contended when it took longer than kContendedCycles.
+static const uint64_t kContendedCycles = 10000;
+static __thread uint32_t tl_hotKeyTick;
+
+// Returns zero if this access isn't sampled.
+static uint64_t hot_key_sample_start() {
+  if (!RuntimeOption::EnableAPCHotKeys ||
+      ++tl_hotKeyTick < uint32_t(RuntimeOption::APCHotKeysSampleRate)) {
+    return 0;
+  }
+  tl_hotKeyTick = 0;
+  return cpuCycles();
+}
+static bool hot_key_contended(uint64_t sampleStart) {
+  return sampleStart && cpuCycles() - sampleStart > kContendedCycles;
+}
+static void stats_on_hot_key(StringData* key, uint64_t sampleStart,
+                             int64_t bytesFetched, bool contended) {
+  if (sampleStart) {
+    SharedStoreStats::onHotKeySample(key, bytesFetched, contended);
+  }
+}
+
 static bool check_key_prefix(const std::vector<std::string>& list,
                              const char *key, size_t keyLen) {
   for (unsigned int i = 0; i < list.size(); ++i) {
@@ -123,6 +166,7 @@ bool ConcurrentTableSharedStore::clear() {
   if (apcExtension::ConcurrentTableLockFree) {
     return false;
   }
+  if (m_shm) m_shm->clear();
   WriteLock l(m_lock);
   for (Map::iterator iter = m_vars.begin(); iter != m_vars.end();
        ++iter) {
@@ -132,12 +176,24 @@ bool ConcurrentTableSharedStore::clear() {
     free((void *)iter->first);
   }
   m_vars.clear();
+  for (auto& slot : m_hot) {
+    if (auto const e = slot.exchange(nullptr, std::memory_order_acq_rel)) {
+      retireHot(e);
+    }
+  }
+  ClockNode node;
+  while (m_clock.try_pop(node)) free((void *)node.key);
+  m_bytes = 0;
   return true;
 }
 
 bool ConcurrentTableSharedStore::erase(const String& key,
                                        bool expired /* = false */) {
   bool success = eraseImpl(key, expired);
+  if (m_shm && !expired && !key.isNull() &&
+      m_shm->erase(key.data(), key.size())) {
+    success = true;
+  }
 
   if (RuntimeOption::EnableStats && RuntimeOption::EnableAPCStats) {
     ServerStats::Log(success ? "apc.erased" : "apc.erase", 1);
@@ -161,14 +217,16 @@ bool ConcurrentTableSharedStore::eraseImpl(const String& key, bool expired) {
     if (expired && !acc->second.expired()) {
       return false;
     }
+    unpublishHot(key.get()->hash());
     if (acc->second.inMem()) {
       stats_on_delete(key.get(), &acc->second, expired);
       acc->second.var->decRef();
+      uncharge(&acc->second);
     } else {
       assert(acc->second.inFile());
-      assert(acc->second.expiry == 0);
+      assert(acc->second.expiry == 0 || acc->second.restored);
     }
-    if (expired && acc->second.inFile()) {
+    if (expired && acc->second.inFile() && !acc->second.restored) {
       // a primed key expired, do not erase the table entry
       acc->second.var = nullptr;
       acc->second.size = 0;
@@ -238,6 +296,81 @@ void ConcurrentTableSharedStore::addToExpirationQueue(const char* key,
   m_expQueue.push(p);
 }
 
+void ConcurrentTableSharedStore::charge(const String& key,
+                                        const StoreValue* sval) {
+  auto const bytes = key.size() + sval->var->getSpaceUsage();
+  auto const old = sval->bytes;
+  sval->bytes = bytes;
+  m_bytes.fetch_add(bytes - old, std::memory_order_relaxed);
+  if (!sval->clockGen) {
+    sval->clockGen = m_clockGen.fetch_add(1, std::memory_order_relaxed) + 1;
+    m_clock.push(ClockNode{strdup(key.data()), sval->clockGen});
+  }
+}
+
+void ConcurrentTableSharedStore::uncharge(const StoreValue* sval) {
+  m_bytes.fetch_sub(sval->bytes, std::memory_order_relaxed);
+  sval->bytes = 0;
+  sval->clockGen = 0;
+}
+
+// Should be called outside Map accessors
+void ConcurrentTableSharedStore::evict() {
+  auto const limit = apcExtension::MaxMemory;
+  auto const overBudget = [&] {
+    return m_bytes.load(std::memory_order_relaxed) > limit;
+  };
+
+  // With no memory pressure nothing pops the clock, so drop a couple of
+  // erased keys per store once they start to pile up.
+  if (!overBudget()) {
+    if (m_clock.unsafe_size() <= 2 * m_vars.size() + 1024) return;
+    for (int i = 0; i < 2; ++i) {
+      ClockNode node;
+      if (!m_clock.try_pop(node)) return;
+      Map::const_accessor acc;
+      if (m_vars.find(acc, node.key) && acc->second.clockGen == node.gen) {
+        m_clock.push(node);
+      } else {
+        free((void *)node.key);
+      }
+    }
+    return;
+  }
+
+  // Every entry is passed over at most once before it is evicted, so
+  // two trips round the clock are enough to get under budget.
+  ssize_t steps = 2 * m_clock.unsafe_size() + 1;
+  while (steps-- > 0 && overBudget()) {
+    ClockNode node;
+    if (!m_clock.try_pop(node)) return;
+    auto const key = node.key;
+    Map::accessor acc;
+    if (!m_vars.find(acc, key) || acc->second.clockGen != node.gen) {
+      free((void *)key);
+      continue;
+    }
+    StoreValue *sval = &acc->second;
+    assert(sval->bytes);
+    auto const len = strlen(key);
+    auto const h = hash_string(key, len);
+    if (sval->referenced.load(std::memory_order_relaxed) ||
+        takeHotFetched(key, len, h)) {
+      sval->referenced.store(false, std::memory_order_relaxed);
+      m_clock.push(node);
+      continue;
+    }
+    assert(sval->inMem());
+    unpublishHot(h);
+    String skey(key, CopyString);
+    stats_on_evict(skey.get(), sval);
+    sval->var->decRef();
+    uncharge(sval);
+    eraseAcc(acc);
+    free((void *)key);
+  }
+}
+
 bool ConcurrentTableSharedStore::handlePromoteObj(const String& key,
                                                   SharedVariant* svar,
                                                   CVarRef value) {
@@ -256,10 +389,12 @@ bool ConcurrentTableSharedStore::handlePromoteObj(const String& key,
     // sv may not be same as svar here because some other thread may have
     // updated it already, check before updating
     if (sv == svar && !sv->isUnserializedObj()) {
+      unpublishHot(key.get()->hash());
       int64_t ttl = sval->expiry ? sval->expiry - time(nullptr) : 0;
       stats_on_update(key.get(), sval, converted, ttl);
       sval->var = converted;
       sv->decRef();
+      if (sval->bytes) charge(key, sval);
       return true;
     }
     converted->decRef();
@@ -294,17 +429,196 @@ SharedVariant* ConcurrentTableSharedStore::unserialize(const String& key,
   }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// hot fetches
+
+struct ConcurrentTableSharedStore::HotEntry {
+  HotEntry(SharedVariant* var, int64_t expiry, strhash_t hash,
+           const char* key, uint32_t len)
+    : var(var), expiry(expiry), hash(hash), len(len), fetched(false) {
+    var->incRef();
+    memcpy(this + 1, key, len);
+  }
+
+  const char* key() const { return reinterpret_cast<const char*>(this + 1); }
+  bool matches(const char* k, uint32_t l, strhash_t h) const {
+    return hash == h && len == l && memcmp(key(), k, l) == 0;
+  }
+
+  SharedVariant* const var;
+  const int64_t expiry;
+  const strhash_t hash;
+  const uint32_t len;
+  // Stands in for StoreValue::referenced, which hot fetches don't see.
+  mutable std::atomic<bool> fetched;
+  // followed by the key bytes (not NUL-terminated)
+};
+
+namespace {
+
+/*
+ * The SharedVariants whose strings and arrays this request is borrowing.
+ * Each one is held once, however often it is fetched, and let go when
+ * the request is swept, by which point nothing can still be reading the
+ * values made from it.  Once the table is 3/4 full further values are
+ * copied the usual way instead.
+ */
+struct HotPins : Sweepable {
+  static constexpr size_t kSize = 256;
+
+  HotPins() : m_count(0) { memset(m_vars, 0, sizeof m_vars); }
+
+  bool pin(SharedVariant* var) {
+    for (size_t i = hash_int64(intptr_t(var)) & (kSize - 1); ;
+         i = (i + 1) & (kSize - 1)) {
+      if (m_vars[i] == var) return true;
+      if (!m_vars[i]) {
+        if (m_count >= kSize * 3 / 4) return false;
+        var->incRef();
+        m_vars[i] = var;
+        ++m_count;
+        return true;
+      }
+    }
+  }
+
+  virtual void sweep();
+
+private:
+  SharedVariant* m_vars[kSize];
+  size_t m_count;
+};
+
+__thread HotPins* tl_hotPins;
+__thread uint32_t tl_hotCollisions;
+
+void HotPins::sweep() {
+  for (auto var : m_vars) {
+    if (var) var->decRef();
+  }
+  tl_hotPins = nullptr;
+  delete this;
+}
+
+/*
+ * Whether toLocal() may borrow from var for the rest of this request.
+ * Only strings and arrays point back into the SharedVariant.
+ */
+bool pin_for_request(SharedVariant* var) {
+  if (!var->is(KindOfString) && !var->is(KindOfArray)) return false;
+  if (!tl_hotPins) tl_hotPins = new HotPins;
+  return tl_hotPins->pin(var);
+}
+
+}
+
+/*
+ * Only called from request threads, so the entry read from the slot
+ * can't be freed before we are done with it.
+ */
+bool ConcurrentTableSharedStore::getHot(const String& key, Variant& value) {
+  if (!Treadmill::inRequest()) return false;
+  StringData* sd = key.get();
+  auto const h = sd->hash();
+  auto const e = m_hot[hotSlot(h)].load(std::memory_order_acquire);
+  if (!e || !e->matches(sd->data(), sd->size(), h)) return false;
+  // Leave expired keys to the slow path, which erases them.
+  if (e->expiry && time(nullptr) >= e->expiry) return false;
+
+  value = e->var->toLocal(pin_for_request(e->var));
+  stats_on_get(sd, e->var);
+  if (auto const sample = hot_key_sample_start()) {
+    stats_on_hot_key(sd, sample, e->var->getSpaceUsage(), false);
+  }
+  if (apcExtension::MaxMemory &&
+      !e->fetched.load(std::memory_order_relaxed)) {
+    e->fetched.store(true, std::memory_order_relaxed);
+  }
+  log_apc(std_apc_hit);
+  return true;
+}
+
+// Should be called holding a Map::const_accessor on key
+void ConcurrentTableSharedStore::publishHot(const String& key,
+                                            const StoreValue* sval) {
+  if (!Treadmill::inRequest()) return;
+  StringData* sd = key.get();
+  auto const h = sd->hash();
+  auto& slot = m_hot[hotSlot(h)];
+  auto old = slot.load(std::memory_order_acquire);
+  if (old) {
+    if (old->matches(sd->data(), sd->size(), h)) return;
+    // Two busy keys sharing a slot would otherwise take turns replacing
+    // each other on every fetch.
+    if (++tl_hotCollisions % 16 != 0) return;
+  }
+  auto const e = new (malloc(sizeof(HotEntry) + sd->size()))
+    HotEntry(sval->var, sval->expiry, h, sd->data(), sd->size());
+  if (!slot.compare_exchange_strong(old, e, std::memory_order_acq_rel)) {
+    e->var->decRef();
+    free(e);
+    return;
+  }
+  if (old) retireHot(old);
+}
+
+// Should be called holding the Map::accessor of the key hashing to h
+void ConcurrentTableSharedStore::unpublishHot(strhash_t h) {
+  auto& slot = m_hot[hotSlot(h)];
+  if (!slot.load(std::memory_order_relaxed)) return;
+  if (auto const old = slot.exchange(nullptr, std::memory_order_acq_rel)) {
+    retireHot(old);
+  }
+}
+
+/*
+ * Test and clear the fetched bit of key's hot entry, if it has one.
+ * Outside a request there is no telling whether the entry is still
+ * there to look at, so the answer is just no.
+ */
+bool ConcurrentTableSharedStore::takeHotFetched(const char* key, size_t len,
+                                                strhash_t h) {
+  if (!Treadmill::inRequest()) return false;
+  auto const e = m_hot[hotSlot(h)].load(std::memory_order_acquire);
+  return e && e->matches(key, len, h) &&
+    e->fetched.load(std::memory_order_relaxed) &&
+    e->fetched.exchange(false, std::memory_order_relaxed);
+}
+
+void ConcurrentTableSharedStore::retireHot(HotEntry* e) {
+  struct HotEntryReaper : Treadmill::WorkItem {
+    explicit HotEntryReaper(HotEntry* e) : m_entry(e) {}
+    virtual void operator()() {
+      m_entry->var->decRef();
+      free(m_entry);
+    }
+    HotEntry* m_entry;
+  };
+  Treadmill::WorkItem::enqueue(new HotEntryReaper(e));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 bool ConcurrentTableSharedStore::get(const String& key, Variant &value) {
+  if (m_shm && shmGet(key, value)) return true;
+  if (apcExtension::HotCache && getHot(key, value)) return true;
   const StoreValue *sval;
   SharedVariant *svar = nullptr;
   ConditionalReadLock l(m_lock, !apcExtension::ConcurrentTableLockFree ||
                                 m_lockingFlag);
   bool expired = false;
   bool promoteObj = false;
+  auto const sample = hot_key_sample_start();
+  bool contended = false;
+  int64_t bytesFetched = -1;
+  SharedVariant* sizeVar = nullptr;
   {
     Map::const_accessor acc;
-    if (!m_vars.find(acc, tagStringData(key.get()))) {
+    bool const found = m_vars.find(acc, tagStringData(key.get()));
+    contended = hot_key_contended(sample);
+    if (!found) {
       log_apc(std_apc_miss);
+      stats_on_hot_key(key.get(), sample, -1, contended);
       return false;
     } else {
       sval = &acc->second;
@@ -319,6 +633,7 @@ bool ConcurrentTableSharedStore::get(const String& key, Variant &value) {
           if (!sval->inMem()) {
             svar = unserialize(key, sval);
             if (!svar) return false;
+            if (apcExtension::MaxMemory && sval->restored) charge(key, sval);
           } else {
             svar = sval->var;
           }
@@ -332,10 +647,33 @@ bool ConcurrentTableSharedStore::get(const String& key, Variant &value) {
           promoteObj = true;
         }
         value = svar->toLocal();
+        if (apcExtension::HotCache && !svar->is(KindOfObject)) {
+          publishHot(key, sval);
+        }
         stats_on_get(key.get(), svar);
+        if (sample) {
+          // Walking a big value for its size would hold up writers of
+          // this key, so do it once the accessor is gone unless the size
+          // stats already know it.
+          if (sval->size) {
+            bytesFetched = sval->size;
+          } else {
+            svar->incRef();
+            sizeVar = svar;
+          }
+        }
+        if (apcExtension::MaxMemory &&
+            !sval->referenced.load(std::memory_order_relaxed)) {
+          sval->referenced.store(true, std::memory_order_relaxed);
+        }
       }
     }
   }
+  if (sizeVar) {
+    bytesFetched = sizeVar->getSpaceUsage();
+    sizeVar->decRef();
+  }
+  stats_on_hot_key(key.get(), sample, bytesFetched, contended);
   if (expired) {
     log_apc(std_apc_miss);
     eraseImpl(key, true);
@@ -366,29 +704,58 @@ int64_t ConcurrentTableSharedStore::inc(const String& key, int64_t step,
                                         bool &found) {
   found = false;
   int64_t ret = 0;
+  if (m_shm) {
+    found = shmUpdateInt(key, [&] (int64_t cur, int64_t& val) -> bool {
+      ret = val = cur + step;
+      return true;
+    });
+    if (found) {
+      log_apc(std_apc_hit);
+      return ret;
+    }
+  }
   ConditionalReadLock l(m_lock, !apcExtension::ConcurrentTableLockFree ||
                                 m_lockingFlag);
   StoreValue *sval;
+  auto const sample = hot_key_sample_start();
+  bool contended = false;
   {
     Map::accessor acc;
-    if (m_vars.find(acc, tagStringData(key.get()))) {
+    bool const found = m_vars.find(acc, tagStringData(key.get()));
+    contended = hot_key_contended(sample);
+    if (found) {
       sval = &acc->second;
       if (!sval->expired()) {
+        unpublishHot(key.get()->hash());
         ret = get_int64_value(sval) + step;
         SharedVariant *svar = construct(Variant(ret));
         sval->var->decRef();
         sval->var = svar;
+        if (sval->bytes) charge(key, sval);
         found = true;
         log_apc(std_apc_hit);
       }
     }
   }
+  stats_on_hot_key(key.get(), sample, -1, contended);
   return ret;
 }
 
 bool ConcurrentTableSharedStore::cas(const String& key, int64_t old,
                                      int64_t val) {
   bool success = false;
+  if (m_shm) {
+    bool present = false;
+    if (shmUpdateInt(key, [&] (int64_t cur, int64_t& newVal) -> bool {
+          present = true;
+          newVal = val;
+          return cur == old;
+        })) {
+      log_apc(std_apc_cas);
+      return true;
+    }
+    if (present) return false;
+  }
   ConditionalReadLock l(m_lock, !apcExtension::ConcurrentTableLockFree ||
                                 m_lockingFlag);
   StoreValue *sval;
@@ -397,9 +764,11 @@ bool ConcurrentTableSharedStore::cas(const String& key, int64_t old,
     if (m_vars.find(acc, tagStringData(key.get()))) {
       sval = &acc->second;
       if (!sval->expired() && get_int64_value(sval) == old) {
+        unpublishHot(key.get()->hash());
         SharedVariant *var = construct(Variant(val));
         sval->var->decRef();
         sval->var = var;
+        if (sval->bytes) charge(key, sval);
         success = true;
         log_apc(std_apc_cas);
       }
@@ -409,6 +778,10 @@ bool ConcurrentTableSharedStore::cas(const String& key, int64_t old,
 }
 
 bool ConcurrentTableSharedStore::exists(const String& key) {
+  if (m_shm && m_shm->exists(key.data(), key.size())) {
+    log_apc(std_apc_hit);
+    return true;
+  }
   const StoreValue *sval;
   ConditionalReadLock l(m_lock, !apcExtension::ConcurrentTableLockFree ||
                                 m_lockingFlag);
@@ -453,6 +826,7 @@ static int64_t adjust_ttl(int64_t ttl, bool overwritePrime) {
 bool ConcurrentTableSharedStore::store(const String& key, CVarRef value,
                                        int64_t ttl,
                                        bool overwrite /* = true */) {
+  if (m_shm) return shmStore(key, value, ttl, overwrite);
   StoreValue *sval;
   SharedVariant* svar = construct(value);
   ConditionalReadLock l(m_lock, !apcExtension::ConcurrentTableLockFree ||
@@ -461,14 +835,18 @@ bool ConcurrentTableSharedStore::store(const String& key, CVarRef value,
   bool present;
   time_t expiry = 0;
   bool overwritePrime = false;
+  auto const sample = hot_key_sample_start();
+  bool contended = false;
   {
     Map::accessor acc;
     present = !m_vars.insert(acc, kcp);
+    contended = hot_key_contended(sample);
     sval = &acc->second;
     bool update = false;
     if (present) {
       free((void *)kcp);
       if (overwrite || sval->expired()) {
+        unpublishHot(key.get()->hash());
         // if ApcTTLLimit is set, then only primed keys can have expiry == 0
         overwritePrime = (sval->expiry == 0);
         if (sval->inMem()) {
@@ -483,6 +861,8 @@ bool ConcurrentTableSharedStore::store(const String& key, CVarRef value,
         }
       } else {
         svar->decRef();
+        acc.release();
+        stats_on_hot_key(key.get(), sample, -1, contended);
         return false;
       }
     }
@@ -495,13 +875,18 @@ bool ConcurrentTableSharedStore::store(const String& key, CVarRef value,
     if (!update) {
       stats_on_add(key.get(), sval, adjustedTtl, false, false);
     }
+    if (apcExtension::MaxMemory) charge(key, sval);
   }
+  stats_on_hot_key(key.get(), sample, -1, contended);
   if (expiry) {
     addToExpirationQueue(key.data(), expiry);
   }
   if (apcExtension::ExpireOnSets) {
     purgeExpired();
   }
+  if (apcExtension::MaxMemory) {
+    evict();
+  }
   if (present) {
     log_apc(std_apc_update);
   } else {
@@ -604,6 +989,211 @@ void ConcurrentTableSharedStore::primeDone() {
   }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// snapshots
+
+namespace {
+
+/*
+ * A snapshot file is a header followed by `count' entries.  Each entry
+ * is a SnapshotEntry, the key, the value in serialize() format, both
+ * NUL-terminated, and padding to the next 8 bytes.  Values are in the
+ * form StoreValue::sAddr expects, so they are used straight from the
+ * mapped file.
+ */
+const char kSnapshotMagic[8] = { 'H', 'H', 'A', 'P', 'C', 'S', 'N', 'P' };
+const uint32_t kSnapshotVersion = 1;
+
+struct SnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t count;
+};
+
+struct SnapshotEntry {
+  int64_t expiry;
+  uint32_t keyLen;
+  uint32_t valLen;
+};
+
+size_t snapshot_padding(size_t len) {
+  return -len & 7;
+}
+
+}
+
+bool ConcurrentTableSharedStore::serializeForSnapshot(const char* key,
+                                                      std::string& out,
+                                                      int64_t& expiry) {
+  ConditionalReadLock l(m_lock, !apcExtension::ConcurrentTableLockFree ||
+                                m_lockingFlag);
+  SharedVariant* svar;
+  {
+    Map::const_accessor acc;
+    if (!m_vars.find(acc, key)) return false;
+    const StoreValue* sval = &acc->second;
+    if (sval->expired()) return false;
+    expiry = sval->expiry;
+    if (!sval->inMem()) {
+      // Primed values in file storage are in apc_serialize() format, and
+      // will be primed again anyway.
+      if (!sval->restored || !sval->inFile()) return false;
+      out.assign(sval->sAddr, sval->getSerializedSize());
+      return true;
+    }
+    svar = sval->var;
+    if (!IS_REFCOUNTED_TYPE(svar->getType())) return svar->serializeTo(out);
+    // Don't hold up writers to the bucket while serializing.
+    svar->incRef();
+  }
+  bool ret = svar->serializeTo(out);
+  svar->decRef();
+  return ret;
+}
+
+bool ConcurrentTableSharedStore::snapshot(const std::string& path) {
+  if (apcExtension::ConcurrentTableLockFree) {
+    return false;
+  }
+  // The periodic snapshot may still be running at shutdown.
+  static std::mutex s_snapshotLock;
+  std::lock_guard<std::mutex> g(s_snapshotLock);
+  Timer timer(Timer::WallTime, "writing apc snapshot");
+  // Walking m_vars needs the write lock, which stops all APC traffic, so
+  // take nothing but a copy of the keys under it: one allocation for
+  // all of them rather than one per key.
+  std::string keyBuf;
+  std::vector<size_t> keys;
+  {
+    WriteLock l(m_lock);
+    keys.reserve(m_vars.size());
+    keyBuf.reserve(m_vars.size() * 32);
+    for (Map::iterator iter = m_vars.begin(); iter != m_vars.end(); ++iter) {
+      keys.push_back(keyBuf.size());
+      keyBuf.append(iter->first, strlen(iter->first) + 1);
+    }
+  }
+
+  std::string tmp = path + ".tmp";
+  FILE* f = fopen(tmp.c_str(), "w");
+  if (!f) {
+    Logger::Error("Unable to open %s to write apc snapshot", tmp.c_str());
+    return false;
+  }
+
+  SnapshotHeader header;
+  memcpy(header.magic, kSnapshotMagic, sizeof header.magic);
+  header.version = kSnapshotVersion;
+  header.reserved = 0;
+  header.count = 0;
+  bool ok = fwrite(&header, sizeof header, 1, f) == 1;
+
+  static const char zeros[8] = {};
+  std::string value;
+  for (auto offset : keys) {
+    if (!ok) break;
+    auto const key = keyBuf.data() + offset;
+    value.clear();
+    SnapshotEntry entry;
+    if (!serializeForSnapshot(key, value, entry.expiry)) continue;
+    entry.keyLen = strlen(key);
+    entry.valLen = value.size();
+    auto const len = entry.keyLen + entry.valLen + 2;
+    ok = fwrite(&entry, sizeof entry, 1, f) == 1 &&
+         fwrite(key, entry.keyLen + 1, 1, f) == 1 &&
+         fwrite(value.c_str(), entry.valLen + 1, 1, f) == 1 &&
+         fwrite(zeros, snapshot_padding(len), 1, f) <= 1;
+    ++header.count;
+  }
+
+  ok = ok && fseek(f, 0, SEEK_SET) == 0 &&
+       fwrite(&header, sizeof header, 1, f) == 1 &&
+       fflush(f) == 0 && fsync(fileno(f)) == 0;
+  ok = fclose(f) == 0 && ok;
+  if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+    Logger::Error("Failed to write apc snapshot %s", path.c_str());
+    unlink(tmp.c_str());
+    return false;
+  }
+  Logger::Info("apc snapshot: %" PRIu64 " of %zu keys written to %s",
+               header.count, keys.size(), path.c_str());
+  return true;
+}
+
+int64_t ConcurrentTableSharedStore::restore(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return -1;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(SnapshotHeader)) {
+    close(fd);
+    Logger::Error("apc snapshot %s is truncated", path.c_str());
+    return -1;
+  }
+  // The mapping is never undone: restored entries point into it for as
+  // long as they live.
+  size_t size = st.st_size;
+  auto const base = (const char*)mmap(nullptr, size, PROT_READ, MAP_PRIVATE,
+                                      fd, 0);
+  close(fd);
+  if (base == (const char*)MAP_FAILED) {
+    Logger::Error("Failed to mmap apc snapshot %s", path.c_str());
+    return -1;
+  }
+
+  SnapshotHeader header;
+  memcpy(&header, base, sizeof header);
+  if (memcmp(header.magic, kSnapshotMagic, sizeof header.magic) != 0 ||
+      header.version != kSnapshotVersion) {
+    Logger::Error("%s is not an apc snapshot", path.c_str());
+    munmap((void*)base, size);
+    return -1;
+  }
+
+  ConditionalReadLock l(m_lock, !apcExtension::ConcurrentTableLockFree ||
+                                m_lockingFlag);
+  time_t now = time(nullptr);
+  int64_t added = 0;
+  const char* p = base + sizeof header;
+  const char* end = base + size;
+  for (uint64_t i = 0; i < header.count; ++i) {
+    SnapshotEntry entry;
+    if (end - p < (ssize_t)sizeof entry) break;
+    memcpy(&entry, p, sizeof entry);
+    p += sizeof entry;
+    auto const len = size_t(entry.keyLen) + entry.valLen + 2;
+    if (size_t(end - p) < len || entry.valLen > INT32_MAX) break;
+    const char* key = p;
+    const char* val = p + entry.keyLen + 1;
+    if (key[entry.keyLen] != '\0' || val[entry.valLen] != '\0' ||
+        strlen(key) != entry.keyLen) {
+      break;
+    }
+    p += std::min(len + snapshot_padding(len), size_t(end - p));
+
+    if (entry.expiry && entry.expiry <= now) continue;
+    {
+      Map::accessor acc;
+      const char *copy = strdup(key);
+      if (!m_vars.insert(acc, copy)) {
+        free((void *)copy);
+        continue;
+      }
+      acc->second.sAddr = const_cast<char*>(val);
+      acc->second.sSize = entry.valLen;
+      acc->second.expiry = entry.expiry;
+      acc->second.restored = true;
+    }
+    if (entry.expiry) addToExpirationQueue(key, entry.expiry);
+    ++added;
+  }
+  if (p != end) {
+    Logger::Error("apc snapshot %s is corrupt after %" PRId64 " keys",
+                  path.c_str(), added);
+  }
+  return added;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // debugging support
 
@@ -656,5 +1246,85 @@ void ConcurrentTableSharedStore::dump(std::ostream & out, bool keyOnly,
   }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// shared memory
+
+void ConcurrentTableSharedStore::attachSharedMemory(const std::string& name,
+                                                    int64_t size,
+                                                    int64_t maxKeys) {
+  m_shm.reset(new SharedMemoryTable(name, size, maxKeys));
+  Logger::Info("APC attached to shared memory %s, %d keys in it",
+               name.c_str(), (int)m_shm->size());
+}
+
+/*
+ * Values in the segment are read by other processes and by later runs,
+ * so they must be in plain serialize() format: APCSerialize writes
+ * static strings as pointers into this process.
+ */
+bool ConcurrentTableSharedStore::shmGet(const String& key, Variant& value) {
+  std::string data;
+  if (!m_shm->get(key.data(), key.size(), data)) return false;
+  value = unserialize_from_buffer(data.data(), data.size());
+  log_apc(std_apc_hit);
+  return true;
+}
+
+bool ConcurrentTableSharedStore::shmStore(const String& key, CVarRef value,
+                                          int64_t ttl, bool overwrite) {
+  if (!overwrite) {
+    // apc_add() mustn't shadow a primed key, which only m_vars has.
+    ConditionalReadLock l(m_lock, !apcExtension::ConcurrentTableLockFree ||
+                                  m_lockingFlag);
+    Map::const_accessor acc;
+    if (m_vars.find(acc, tagStringData(key.get())) &&
+        !acc->second.expired()) {
+      return false;
+    }
+  }
+  String data = f_serialize(value);
+  int64_t adjustedTtl = adjust_ttl(ttl, false);
+  if (check_noTTL(key.data(), key.size())) {
+    adjustedTtl = 0;
+  }
+  int64_t expiry = adjustedTtl ? time(nullptr) + adjustedTtl : 0;
+  if (!m_shm->store(key.data(), key.size(), data.data(), data.size(),
+                    expiry, overwrite)) {
+    return false;
+  }
+  log_apc(std_apc_update);
+  return true;
+}
+
+/*
+ * Unserializing can run user code (__wakeup, Serializable), which may
+ * well use APC, so it mustn't happen under the segment's lock.  Instead
+ * the value is read, f decides on the new one, and it is written back
+ * only if nobody changed the value in the meantime.
+ */
+bool ConcurrentTableSharedStore::shmUpdateInt(
+    const String& key, const std::function<bool(int64_t, int64_t&)>& f) {
+  for (;;) {
+    std::string old;
+    if (!m_shm->get(key.data(), key.size(), old)) return false;
+    int64_t val;
+    if (!f(unserialize_from_buffer(old.data(), old.size()).toInt64(), val)) {
+      return false;
+    }
+    String data = f_serialize(val);
+    bool raced = false;
+    auto const swap = [&] (std::string& cur) -> bool {
+      if (cur != old) {
+        raced = true;
+        return false;
+      }
+      cur.assign(data.data(), data.size());
+      return true;
+    };
+    if (m_shm->update(key.data(), key.size(), swap)) return true;
+    if (!raced) return false;
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
@@ -20,14 +20,17 @@
 #define TBB_PREVIEW_CONCURRENT_PRIORITY_QUEUE 1
 
 #include "hphp/util/smalllocks.h"
+#include "hphp/util/shared-memory-table.h"
 #include "hphp/runtime/base/complex-types.h"
 #include "hphp/runtime/base/shared-variant.h"
 #include "hphp/runtime/base/runtime-option.h"
 #include "hphp/runtime/base/type-conversions.h"
 #include "hphp/runtime/base/builtin-functions.h"
 #include "hphp/runtime/server/server-stats.h"
+#include <memory>
 #include <tbb/concurrent_hash_map.h>
 #include <tbb/concurrent_priority_queue.h>
+#include <tbb/concurrent_queue.h>
 #include "hphp/runtime/base/shared-store-stats.h"
 
 namespace HPHP {
@@ -35,10 +38,14 @@ namespace HPHP {
 //////////////////////////////////////////////////////////////////////
 
 struct StoreValue {
-  StoreValue() : var(nullptr), sAddr(nullptr), expiry(0), size(0), sSize(0) {}
+  StoreValue() : var(nullptr), sAddr(nullptr), expiry(0), size(0), sSize(0),
+                 bytes(0), clockGen(0), referenced(false), restored(false) {}
   StoreValue(const StoreValue& v) : var(v.var), sAddr(v.sAddr),
                                     expiry(v.expiry), size(v.size),
-                                    sSize(v.sSize) {}
+                                    sSize(v.sSize), bytes(v.bytes),
+                                    clockGen(v.clockGen),
+                                    referenced(v.referenced.load()),
+                                    restored(v.restored) {}
   void set(SharedVariant *v, int64_t ttl);
   bool expired() const;
 
@@ -51,6 +58,17 @@ struct StoreValue {
   mutable int32_t size;
   int32_t sSize; // For file storage, negative means serailized object
   mutable SmallLock lock;
+  // Bytes charged against apcExtension::MaxMemory; zero if the entry
+  // isn't on the eviction clock (it was primed, or there is no limit).
+  mutable int32_t bytes;
+  // Generation of this entry's node on the eviction clock, zero if it has
+  // none.  A node whose generation doesn't match is stale.
+  mutable uint64_t clockGen;
+  // Clock reference bit: set by fetches, cleared by the eviction hand.
+  mutable std::atomic<bool> referenced;
+  // sAddr points into a snapshot loaded at startup, not the prime file
+  // storage.  Unlike a primed key, the entry can expire and be evicted.
+  bool restored;
 
   bool inMem() const {
     return var != nullptr;
@@ -87,13 +105,18 @@ struct ConcurrentTableSharedStore {
     : m_id(id)
     , m_lockingFlag(false)
     , m_purgeCounter(0)
-  {}
+    , m_clockGen(0)
+    , m_bytes(0) {
+    for (auto& slot : m_hot) slot.store(nullptr, std::memory_order_relaxed);
+  }
 
   ConcurrentTableSharedStore(const ConcurrentTableSharedStore&) = delete;
   ConcurrentTableSharedStore&
     operator=(const ConcurrentTableSharedStore&) = delete;
 
-  int size() const { return m_vars.size(); }
+  int size() const {
+    return m_vars.size() + (m_shm ? m_shm->size() : 0);
+  }
   bool get(const String& key, Variant &value);
   bool store(const String& key, CVarRef val, int64_t ttl,
                      bool overwrite = true);
@@ -108,6 +131,34 @@ struct ConcurrentTableSharedStore {
   bool constructPrime(CVarRef v, KeyValuePair& item);
   void primeDone();
 
+  /*
+   * Warm restarts.  snapshot() writes the store's values to path, or as
+   * many as SharedVariant::serializeTo can write, replacing the file
+   * atomically.  It takes the write lock only while it copies the keys,
+   * so fetches and stores carry on while it runs.
+   *
+   * restore() maps such a file and adds its unexpired keys without
+   * unserializing anything: like primed keys in file storage, each
+   * value is unserialized on its first fetch.  Keys already present are
+   * left alone.  Returns the number of keys added, or -1 if the file is
+   * missing or malformed.  The file must not change while the process
+   * runs, so snapshot() never writes over it in place.
+   */
+  bool snapshot(const std::string& path);
+  int64_t restore(const std::string& path);
+
+  /*
+   * Server.APC.TableType = sharedmemory.  Keys stored at run time go to
+   * a SharedMemoryTable, as serialize()d strings, where every process
+   * attached to the same segment sees them; fetches unserialize a
+   * private copy.  Primed keys stay in m_vars, each process having
+   * loaded its own: fetches look in the segment first, erase() and
+   * clear() empty both.  The hot cache, MaxMemory, size stats and
+   * snapshots only cover m_vars.
+   */
+  void attachSharedMemory(const std::string& name, int64_t size,
+                          int64_t maxKeys);
+
   // debug support
   void dump(std::ostream & out, bool keyOnly, int waitSeconds);
 
@@ -179,6 +230,69 @@ private:
 
   void addToExpirationQueue(const char* key, int64_t etime);
 
+  bool serializeForSnapshot(const char* key, std::string& out,
+                            int64_t& expiry);
+
+  /*
+   * Bounding memory.  With apcExtension::MaxMemory set, every value
+   * stored at run time is charged its key and getSpaceUsage() bytes, and
+   * its key goes on m_clock, a queue standing in for the ring of a CLOCK
+   * cache.  When the store is over budget, evict() pops keys off the
+   * front: an entry fetched since the hand last passed gets its bit
+   * cleared and goes to the back, and one that wasn't is erased.  New
+   * entries start with the bit clear, so values that are stored and
+   * never read go before ones that are.
+   *
+   * There is no lock besides the per-bucket accessors, so concurrent
+   * evictions each take their own keys and the budget is approximate.
+   * An entry has at most one node on the queue: charge() only pushes one
+   * for an entry whose clockGen is zero, and stamps both with a fresh
+   * generation, which uncharge() resets.  Nodes left behind by erased or
+   * uncharged entries no longer match their key's clockGen, and the hand
+   * drops them.
+   * Primed entries aren't charged or evicted.
+   */
+  struct ClockNode {
+    const char* key;
+    uint64_t gen;
+  };
+  void charge(const String& key, const StoreValue* sval);
+  void uncharge(const StoreValue* sval);
+  void evict();
+
+  /*
+   * Lock-free fetches (apcExtension::HotCache).  A fetch from a request
+   * thread that goes through m_vars publishes the entry in m_hot, a
+   * direct-mapped table of immutable HotEntry copies, and later fetches
+   * of that key read it with one atomic load: no bucket lock, and no
+   * write to anything shared.  The value borrows the SharedVariant
+   * instead of taking a reference on it per fetch; the request pins it
+   * once, until it ends.
+   *
+   * Anything that changes or removes a key first clears its slot while
+   * holding the key's Map::accessor, so m_hot never gets ahead of
+   * m_vars.  Publishing happens under a const_accessor for the same
+   * reason.  Clearing doesn't look at the entry (a non-request thread
+   * couldn't safely), so a write may also knock out an unrelated key
+   * sharing the slot; it is republished on its next fetch.  Entries
+   * that are replaced or cleared are freed through the Treadmill, once
+   * every request that might still be reading one has finished.
+   */
+  struct HotEntry;
+  static constexpr size_t kHotSize = 4096;
+  static size_t hotSlot(strhash_t h) { return h & (kHotSize - 1); }
+  bool getHot(const String& key, Variant& value);
+  void publishHot(const String& key, const StoreValue* sval);
+  void unpublishHot(strhash_t h);
+  bool takeHotFetched(const char* key, size_t len, strhash_t h);
+  static void retireHot(HotEntry* e);
+
+  bool shmGet(const String& key, Variant& value);
+  bool shmStore(const String& key, CVarRef value, int64_t ttl,
+                bool overwrite);
+  bool shmUpdateInt(const String& key,
+                    const std::function<bool(int64_t, int64_t&)>& f);
+
   bool handleUpdate(const String& key, SharedVariant* svar);
   bool handlePromoteObj(const String& key, SharedVariant* svar, CVarRef valye);
   SharedVariant* unserialize(const String& key, const StoreValue* sval);
@@ -195,6 +309,14 @@ private:
                                  ExpirationCompare> m_expQueue;
   ExpMap m_expMap;
   std::atomic<uint64_t> m_purgeCounter;
+
+  tbb::concurrent_queue<ClockNode> m_clock;
+  std::atomic<uint64_t> m_clockGen;
+  std::atomic<int64_t> m_bytes;
+
+  std::atomic<HotEntry*> m_hot[kHotSize];
+
+  std::unique_ptr<SharedMemoryTable> m_shm;
 };
 
 //////////////////////////////////////////////////////////////////////
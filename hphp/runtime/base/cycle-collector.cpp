@@ -0,0 +1,409 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+
+#include "hphp/runtime/base/cycle-collector.h"
+
+#include <unordered_map>
+#include <vector>
+
+#include "hphp/runtime/base/complex-types.h"
+#include "hphp/runtime/base/hphp-array.h"
+#include "hphp/runtime/base/memory-manager.h"
+#include "hphp/runtime/base/runtime-option.h"
+#include "hphp/runtime/base/tv-helpers.h"
+#include "hphp/runtime/server/server-stats.h"
+#include "hphp/util/timer.h"
+#include "hphp/util/trace.h"
+
+namespace HPHP {
+
+TRACE_SET_MOD(gc);
+
+//////////////////////////////////////////////////////////////////////
+
+__thread bool CycleCollector::s_enabled = false;
+
+namespace {
+
+struct RootSet {
+  // Each buffered node with the type needed to walk it.
+  std::unordered_map<void*,DataType> roots;
+};
+
+IMPLEMENT_THREAD_LOCAL(RootSet, s_rootSet);
+
+enum class Color : uint8_t { Black, Gray, White };
+
+struct Node {
+  DataType type;
+  Color color;
+  int32_t rc;
+};
+
+/*
+ * Only heap values we know how to walk and clear take part in a
+ * collection.  Anything else is invisible to the collector: its
+ * children keep their real counts, so they can only look more
+ * alive than they are.
+ */
+bool collectable(DataType type, void* p) {
+  switch (type) {
+    case KindOfObject:
+    case KindOfRef:
+      return true;
+    case KindOfArray: {
+      auto const arr = static_cast<ArrayData*>(p);
+      if (arr->isHphpArray()) {
+        // A zombie left behind by Grow has handed its elements over.
+        return arr->isRefCounted() &&
+          !static_cast<HphpArray*>(arr)->isZombie();
+      }
+      return arr->isStructArray() && arr->isRefCounted();
+    }
+    default:
+      return false;
+  }
+}
+
+}
+
+//////////////////////////////////////////////////////////////////////
+
+struct CycleCollector::Collector {
+  template<class F>
+  void forEachChild(void* p, DataType type, F f) {
+    switch (type) {
+      case KindOfObject: {
+        auto const obj = static_cast<ObjectData*>(p);
+        auto const props = obj->propVec();
+        auto const nProps = obj->getVMClass()->numDeclProperties();
+        for (Slot i = 0; i < nProps; ++i) {
+          f(props[i].m_type, props[i].m_data.pobj);
+        }
+        if (auto const dyn = obj->o_properties.get()) {
+          f(KindOfArray, dyn);
+        }
+        break;
+      }
+      case KindOfArray: {
+        auto const arr = static_cast<ArrayData*>(p);
+        for (ssize_t pos = arr->iter_begin();
+             pos != ArrayData::invalid_index;
+             pos = arr->iter_advance(pos)) {
+          auto const tv = arr->nvGetValueRef(pos);
+          f(tv->m_type, tv->m_data.pobj);
+        }
+        break;
+      }
+      case KindOfRef: {
+        auto const tv = static_cast<RefData*>(p)->tv();
+        f(tv->m_type, tv->m_data.pobj);
+        break;
+      }
+      default:
+        not_reached();
+    }
+  }
+
+  Node& node(void* p, DataType type) {
+    auto it = m_nodes.find(p);
+    if (it != m_nodes.end()) return it->second;
+    Node n { type, Color::Black, 0 };
+    switch (type) {
+      case KindOfObject: {
+        auto const obj = static_cast<ObjectData*>(p);
+        n.rc = obj->getCount();
+        // Freeing an object whose __destruct hasn't run would skip
+        // it, so such objects are treated as externally referenced.
+        if (!obj->noDestruct() && obj->getVMClass()->getDtor()) ++n.rc;
+        break;
+      }
+      case KindOfArray:
+        n.rc = static_cast<ArrayData*>(p)->getCount();
+        break;
+      case KindOfRef:
+        n.rc = static_cast<RefData*>(p)->zRefcount();
+        break;
+      default:
+        not_reached();
+    }
+    return m_nodes.emplace(p, n).first->second;
+  }
+
+  void markGray(void* root, DataType type) {
+    auto& n = node(root, type);
+    if (n.color == Color::Gray) return;
+    n.color = Color::Gray;
+    m_stack.emplace_back(root, type);
+    while (!m_stack.empty()) {
+      auto const cur = m_stack.back();
+      m_stack.pop_back();
+      forEachChild(cur.first, cur.second, [&] (DataType t, void* c) {
+        if (!collectable(t, c)) return;
+        auto& cn = node(c, t);
+        --cn.rc;
+        if (cn.color != Color::Gray) {
+          cn.color = Color::Gray;
+          m_stack.emplace_back(c, t);
+        }
+      });
+    }
+  }
+
+  void scanBlack(void* p) {
+    m_nodes[p].color = Color::Black;
+    m_blackStack.push_back(p);
+    while (!m_blackStack.empty()) {
+      auto const cur = m_blackStack.back();
+      m_blackStack.pop_back();
+      forEachChild(cur, m_nodes[cur].type, [&] (DataType t, void* c) {
+        if (!collectable(t, c)) return;
+        auto& cn = m_nodes[c];
+        ++cn.rc;
+        if (cn.color != Color::Black) {
+          cn.color = Color::Black;
+          m_blackStack.push_back(c);
+        }
+      });
+    }
+  }
+
+  void scan(void* root, DataType type) {
+    m_stack.emplace_back(root, type);
+    while (!m_stack.empty()) {
+      auto const cur = m_stack.back();
+      m_stack.pop_back();
+      auto& n = m_nodes[cur.first];
+      if (n.color != Color::Gray) continue;
+      if (n.rc > 0) {
+        scanBlack(cur.first);
+        continue;
+      }
+      n.color = Color::White;
+      forEachChild(cur.first, cur.second, [&] (DataType t, void* c) {
+        if (collectable(t, c)) m_stack.emplace_back(c, t);
+      });
+    }
+  }
+
+  static void clearTv(TypedValue* tv, bool uninit) {
+    auto const old = *tv;
+    if (uninit) {
+      tvWriteUninit(tv);
+    } else {
+      tvWriteNull(tv);
+    }
+    tvRefcountedDecRef(old);
+  }
+
+  /*
+   * Every reference to a white node comes from another white node, so
+   * the white nodes can be freed by pinning them, cutting all their
+   * outgoing edges, and then dropping the pins.
+   */
+  int64_t collectWhite() {
+    std::vector<std::pair<void*,DataType>> garbage;
+    for (auto& kv : m_nodes) {
+      if (kv.second.color == Color::White) {
+        garbage.emplace_back(kv.first, kv.second.type);
+      }
+    }
+    m_nodes.clear();
+
+    for (auto& g : garbage) {
+      switch (g.second) {
+        case KindOfObject:
+          static_cast<ObjectData*>(g.first)->incRefCount(); break;
+        case KindOfArray:
+          static_cast<ArrayData*>(g.first)->incRefCount(); break;
+        case KindOfRef:
+          static_cast<RefData*>(g.first)->incRefCount(); break;
+        default: not_reached();
+      }
+    }
+    for (auto& g : garbage) {
+      switch (g.second) {
+        case KindOfObject: {
+          auto const obj = static_cast<ObjectData*>(g.first);
+          auto const props = obj->propVec();
+          auto const nProps = obj->getVMClass()->numDeclProperties();
+          for (Slot i = 0; i < nProps; ++i) clearTv(&props[i], true);
+          obj->o_properties.reset();
+          break;
+        }
+        case KindOfArray: {
+          auto const arr = static_cast<ArrayData*>(g.first);
+          for (ssize_t pos = arr->iter_begin();
+               pos != ArrayData::invalid_index;
+               pos = arr->iter_advance(pos)) {
+            clearTv(arr->nvGetValueRef(pos), false);
+          }
+          break;
+        }
+        case KindOfRef:
+          clearTv(static_cast<RefData*>(g.first)->tv(), false);
+          break;
+        default:
+          not_reached();
+      }
+    }
+    for (auto& g : garbage) {
+      switch (g.second) {
+        case KindOfObject:
+          decRefObj(static_cast<ObjectData*>(g.first)); break;
+        case KindOfArray:
+          decRefArr(static_cast<ArrayData*>(g.first)); break;
+        case KindOfRef:
+          decRefRef(static_cast<RefData*>(g.first)); break;
+        default: not_reached();
+      }
+    }
+    return garbage.size();
+  }
+
+private:
+  std::unordered_map<void*,Node> m_nodes;
+  std::vector<std::pair<void*,DataType>> m_stack;
+  std::vector<void*> m_blackStack;
+};
+
+//////////////////////////////////////////////////////////////////////
+
+void CycleCollector::requestInit() {
+  s_enabled = RuntimeOption::EvalEnableCycleCollector;
+  MM().setCollectThreshold(s_enabled ?
+                           RuntimeOption::EvalCycleCollectorThreshold : 0);
+}
+
+void CycleCollector::requestExit() {
+  // Objects still in the buffer are about to be swept along with the
+  // rest of the request heap.
+  s_enabled = false;
+  s_rootSet->roots.clear();
+  MM().setCollectThreshold(0);
+}
+
+void CycleCollector::setEnabled(bool enabled) {
+  s_enabled = enabled;
+  if (!enabled) clearRoots();
+  MM().setCollectThreshold(enabled ?
+                           RuntimeOption::EvalCycleCollectorThreshold : 0);
+}
+
+void CycleCollector::clearRoots() {
+  auto& roots = s_rootSet->roots;
+  for (auto& r : roots) {
+    switch (r.second) {
+      case KindOfObject:
+        static_cast<ObjectData*>(r.first)->
+          clearAttribute(ObjectData::IsCycleRoot);
+        break;
+      case KindOfArray:
+        static_cast<ArrayData*>(r.first)->m_cycleRoot = false; break;
+      case KindOfRef:
+        static_cast<RefData*>(r.first)->m_cycleRoot = false; break;
+      default:
+        not_reached();
+    }
+  }
+  roots.clear();
+}
+
+static void bufferRoot(void* p, DataType type) {
+  auto& roots = s_rootSet->roots;
+  roots.emplace(p, type);
+  if (roots.size() == RuntimeOption::EvalCycleCollectorMaxRoots) {
+    ThreadInfo::s_threadInfo.getNoCheck()->
+      m_reqInjectionData.setCycleCollectFlag();
+  }
+}
+
+void CycleCollector::addRoot(ObjectData* obj) {
+  if (obj->getAttribute(ObjectData::IsCycleRoot)) return;
+  obj->setAttribute(ObjectData::IsCycleRoot);
+  bufferRoot(obj, KindOfObject);
+}
+
+void CycleCollector::addRoot(ArrayData* arr) {
+  if (arr->m_cycleRoot) return;
+  arr->m_cycleRoot = true;
+  bufferRoot(arr, KindOfArray);
+}
+
+void CycleCollector::addRoot(RefData* ref) {
+  if (ref->m_cycleRoot) return;
+  ref->m_cycleRoot = true;
+  bufferRoot(ref, KindOfRef);
+}
+
+void CycleCollector::forgetRoot(ObjectData* obj) {
+  s_rootSet->roots.erase(obj);
+}
+
+void CycleCollector::forgetRoot(ArrayData* arr) {
+  s_rootSet->roots.erase(arr);
+}
+
+void CycleCollector::forgetRoot(RefData* ref) {
+  s_rootSet->roots.erase(ref);
+}
+
+int64_t CycleCollector::collect() {
+  if (!s_enabled) return 0;
+  auto& roots = s_rootSet->roots;
+  if (roots.empty()) return 0;
+
+  auto const start = Timer::GetCurrentTimeMicros();
+  // Collected nodes leave the root set as they're freed, so work from
+  // a copy.  An array may have changed kind (or become a zombie) since
+  // it was buffered; those aren't walked.
+  std::vector<std::pair<void*,DataType>> candidates;
+  candidates.reserve(roots.size());
+  for (auto& r : roots) {
+    if (collectable(r.second, r.first)) candidates.push_back(r);
+  }
+  Collector c;
+  for (auto& r : candidates) c.markGray(r.first, r.second);
+  for (auto& r : candidates) c.scan(r.first, r.second);
+  auto const freed = c.collectWhite();
+  // Whatever survived was live as of this pass; it comes back when it
+  // next loses a reference.
+  clearRoots();
+  auto const elapsed = Timer::GetCurrentTimeMicros() - start;
+
+  FTRACE(1, "collect: {} roots, {} freed, {} us\n",
+         candidates.size(), freed, elapsed);
+  ServerStats::Log("gc.runs", 1);
+  ServerStats::Log("gc.roots", candidates.size());
+  ServerStats::Log("gc.freed", freed);
+  ServerStats::Log("gc.time_us", elapsed);
+  return freed;
+}
+
+void CycleCollector::onCollectFlag() {
+  if (!s_enabled) return;
+  collect();
+  // Don't come back until the heap has grown well past what survived.
+  auto const usage = MM().getStatsNoRefresh().usage;
+  MM().setCollectThreshold(
+    std::max<int64_t>(RuntimeOption::EvalCycleCollectorThreshold, usage * 2)
+  );
+}
+
+//////////////////////////////////////////////////////////////////////
+
+}
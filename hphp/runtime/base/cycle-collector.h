@@ -0,0 +1,117 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+
+#ifndef incl_HPHP_CYCLE_COLLECTOR_H_
+#define incl_HPHP_CYCLE_COLLECTOR_H_
+
+#include <cstdint>
+
+namespace HPHP {
+
+class ArrayData;
+class ObjectData;
+struct RefData;
+
+//////////////////////////////////////////////////////////////////////
+
+/*
+ * Request-local cycle collector.
+ *
+ * Refcounting can't reclaim object graphs that point back at
+ * themselves, so by default those live until the end of the request.
+ * When the collector is enabled (Eval.EnableCycleCollector, or
+ * gc_enable() from PHP if Eval.CycleCollectorUserControl allows it),
+ * every object, HphpArray, StructArray and RefData whose refcount is
+ * decremented without reaching zero is buffered as a possible cycle
+ * root, as in Bacon & Rajan: only such a node can be the last external
+ * handle on a garbage cycle.  collect() runs a synchronous
+ * trial-deletion pass over the nodes reachable from the buffered
+ * roots, then empties the buffer:
+ *
+ *   - mark: walk the subgraph, subtracting the internal edges from a
+ *     side-table copy of each node's refcount;
+ *   - scan: nodes left with a non-zero count are referenced from
+ *     outside the subgraph, so they and everything they reach are
+ *     live; the rest is garbage;
+ *   - collect: pin the garbage nodes, clear their outgoing edges, and
+ *     drop the pins so the ordinary release paths free them.
+ *
+ * Nothing the collector can't see inside (collections, extension
+ * objects' native state, shared or static arrays) is ever wrongly
+ * freed: invisible edges only make the collector more conservative.
+ * Objects whose __destruct hasn't run yet are treated as live.
+ *
+ * A collection is not incremental: all three phases run to completion
+ * inside one call, with the request stopped, because trial deletion
+ * is only sound while no refcount in the subgraph changes under it.
+ * The pause grows with the number of buffered roots plus everything
+ * they reach, not with the amount of garbage; CycleCollectorMaxRoots
+ * bounds the first term and gc.time_us in the server stats records
+ * the pauses actually taken.
+ *
+ * Collections happen when gc_collect_cycles() is called, or at the
+ * next surprise check once the request heap has grown past
+ * Eval.CycleCollectorThreshold bytes or the buffer holds
+ * Eval.CycleCollectorMaxRoots roots.  While either option that can
+ * turn the collector on is set, the JIT calls out for DecRefs of values
+ * that might be objects, arrays or refs instead of decrementing inline,
+ * so translated code buffers roots too (DecRefs that branch on reaching
+ * zero still don't).
+ */
+struct CycleCollector {
+  static void requestInit();
+  static void requestExit();
+
+  static bool enabled() { return s_enabled; }
+  static void setEnabled(bool enabled);
+
+  /*
+   * Track or untrack a node as a possible cycle root.  Nodes are
+   * flagged while they're in the root buffer, so adding one twice is
+   * cheap and forgetRoot() is only called, as the node is freed, for
+   * nodes that were added.
+   */
+  static void addRoot(ObjectData* obj);
+  static void addRoot(ArrayData* arr);
+  static void addRoot(RefData* ref);
+  static void forgetRoot(ObjectData* obj);
+  static void forgetRoot(ArrayData* arr);
+  static void forgetRoot(RefData* ref);
+
+  /*
+   * Run a collection now, if the collector is enabled.  Returns the
+   * number of objects, arrays and refs freed.
+   */
+  static int64_t collect();
+
+  /*
+   * Run the collection requested at a surprise check because the heap
+   * crossed the threshold or the root buffer filled up.
+   */
+  static void onCollectFlag();
+
+private:
+  struct Collector;
+  static void clearRoots();
+  static __thread bool s_enabled;
+};
+
+//////////////////////////////////////////////////////////////////////
+
+}
+
+#endif
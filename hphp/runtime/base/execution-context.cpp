@@ -188,6 +188,13 @@ void BaseExecutionContext::setRequestMemoryMaxBytes(int64_t max) {
 // write()
 
 void BaseExecutionContext::write(const String& s) {
+  if (m_out) {
+    // Pass the StringData along so the buffer can take a reference to
+    // a large string rather than copy it.
+    m_out->append(s);
+    if (m_implicitFlush) flush();
+    return;
+  }
   write(s.data(), s.size());
 }
 
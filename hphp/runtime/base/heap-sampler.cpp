@@ -0,0 +1,225 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+#include "hphp/runtime/base/heap-sampler.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+#include "folly/Format.h"
+#include "folly/Conv.h"
+
+#include "hphp/runtime/base/execution-context.h"
+#include "hphp/runtime/base/profile-dump.h"
+#include "hphp/runtime/base/runtime-option.h"
+#include "hphp/runtime/vm/jit/translator.h"
+#include "hphp/util/alloc.h"
+#include "hphp/util/util.h"
+
+namespace HPHP {
+
+TRACE_SET_MOD(heap);
+
+IMPLEMENT_THREAD_LOCAL(HeapSampler, HeapSampler::s_sampler);
+
+//////////////////////////////////////////////////////////////////////
+
+namespace {
+
+const int kMaxNativeFrames = 64;
+
+// Process-wide profile, keyed on stack trace.  There are at most
+// Eval.HeapSampleMaxSites traces; the bytes of sites evicted to stay
+// under that only show up in the totals.
+typedef std::map<std::vector<uint64_t>,SiteAllocations> SiteMap;
+std::mutex s_profileLock;
+SiteMap s_inUse;
+SiteMap s_allocated;
+SiteAllocations s_evictedInUse {0, 0};
+SiteAllocations s_evictedAllocated {0, 0};
+
+bool onNativeStack(const void* p) {
+  return uintptr_t(p) - Util::s_stackLimit < Util::s_stackSize;
+}
+
+/*
+ * Drop the sites with the fewest sampled bytes until a quarter of the
+ * cap is free, so a steady trickle of new traces only pays for this
+ * once in a while.  Called with s_profileLock held.
+ */
+void evictSmallSites(size_t maxSites) {
+  auto const keep = maxSites - maxSites / 4;
+  if (s_allocated.size() <= keep) return;
+  std::vector<SiteMap::iterator> sites;
+  sites.reserve(s_allocated.size());
+  for (auto it = s_allocated.begin(); it != s_allocated.end(); ++it) {
+    sites.push_back(it);
+  }
+  auto const drop = sites.size() - keep;
+  std::nth_element(
+    sites.begin(), sites.begin() + drop, sites.end(),
+    [] (SiteMap::iterator a, SiteMap::iterator b) {
+      return a->second.m_bytes < b->second.m_bytes;
+    }
+  );
+  for (size_t i = 0; i < drop; ++i) {
+    auto const it = s_inUse.find(sites[i]->first);
+    if (it != s_inUse.end()) {
+      s_evictedInUse += it->second;
+      s_inUse.erase(it);
+    }
+    s_evictedAllocated += sites[i]->second;
+    s_allocated.erase(sites[i]);
+  }
+}
+
+}
+
+//////////////////////////////////////////////////////////////////////
+
+bool HeapSampler::enabled() {
+  return RuntimeOption::EvalHeapSampleBytes != 0;
+}
+
+int64_t HeapSampler::nextInterval() {
+  std::exponential_distribution<double> dist(
+    1.0 / RuntimeOption::EvalHeapSampleBytes
+  );
+  return int64_t(dist(m_rng)) + 1;
+}
+
+uint64_t HeapSampler::liveFilter() const {
+  uint64_t filter = 0;
+  for (auto const& kv : m_live) filter |= filterBit(kv.first);
+  return filter;
+}
+
+/*
+ * The native part of the trace comes from walking the frame pointer
+ * chain up to the first frame that isn't on the thread's C++ stack,
+ * which is the ActRec of the PHP function that called into us from
+ * the TC.  We can't sync the VM registers here (allocations from the
+ * TC generally have no fixup), so when they're dirty that ActRec is
+ * where the PHP part starts, attributed to the start of the function.
+ */
+void HeapSampler::captureStack(std::vector<uint64_t>& trace) {
+  DECLARE_FRAME_POINTER(framePtr);
+  ActRec* tcFrame = nullptr;
+  if (Util::s_stackSize) {
+    auto rbp = framePtr;
+    for (int i = 0; i < kMaxNativeFrames; ++i) {
+      auto const next = reinterpret_cast<ActRec*>(rbp->m_savedRbp);
+      if (!next) break;
+      if (!onNativeStack(next)) {
+        tcFrame = next;
+        break;
+      }
+      trace.push_back(rbp->m_savedRip);
+      if (next <= rbp) break;
+      rbp = next;
+    }
+  }
+
+  if (g_context.isNull()) return;
+  ActRec* fp;
+  Offset off;
+  if (Transl::tl_regState == Transl::VMRegState::CLEAN) {
+    fp = g_vmContext->getFP();
+    if (!fp) return;
+    off = g_vmContext->getPC() - fp->m_func->unit()->entry();
+  } else {
+    if (!tcFrame) return;
+    fp = tcFrame;
+    off = fp->m_func->base();
+  }
+  for (;;) {
+    trace.push_back(kSrcKeyTag | SrcKey(fp->m_func, off).toAtomicInt());
+    fp = g_vmContext->getPrevVMState(fp, &off);
+    if (!fp) break;
+  }
+}
+
+void HeapSampler::recordAlloc(void* ptr, size_t bytes) {
+  TRACE(2, "sampling allocation at %p of %lu bytes\n", ptr, bytes);
+  m_samples.push_back(Sample { {}, bytes, false });
+  captureStack(m_samples.back().trace);
+  m_live[ptr] = m_samples.size() - 1;
+}
+
+bool HeapSampler::recordFree(void* ptr) {
+  auto const it = m_live.find(ptr);
+  if (it == m_live.end()) return false;
+  m_samples[it->second].freed = true;
+  m_live.erase(it);
+  return true;
+}
+
+void HeapSampler::requestEnd() {
+  if (m_samples.empty()) return;
+  TRACE(1, "request ended with %lu samples, %lu in use\n",
+        m_samples.size(), m_live.size());
+  {
+    std::lock_guard<std::mutex> lock(s_profileLock);
+    for (auto const& s : m_samples) {
+      s_allocated[s.trace] += s.bytes;
+      if (!s.freed) s_inUse[s.trace] += s.bytes;
+    }
+    auto const maxSites = std::max(RuntimeOption::EvalHeapSampleMaxSites, 1u);
+    if (s_allocated.size() > maxSites) evictSmallSites(maxSites);
+  }
+  m_samples.clear();
+  m_live.clear();
+}
+
+std::string HeapSampler::toPProfFormat() {
+  std::lock_guard<std::mutex> lock(s_profileLock);
+  auto inUse = s_evictedInUse;
+  auto allocated = s_evictedAllocated;
+  for (auto const& kv : s_inUse) inUse += kv.second;
+  for (auto const& kv : s_allocated) allocated += kv.second;
+
+  // heap_v2 tells pprof these are Poisson samples at the given rate,
+  // so that it can unsample them.
+  std::string res;
+  folly::toAppend(
+    folly::format(
+      "heap profile: {}: {} [{}: {}] @ heap_v2/{}\n",
+      inUse.m_count, inUse.m_bytes, allocated.m_count, allocated.m_bytes,
+      RuntimeOption::EvalHeapSampleBytes
+    ).str(), &res
+  );
+  for (auto const& kv : s_allocated) {
+    auto const it = s_inUse.find(kv.first);
+    auto const cur = it == s_inUse.end() ? SiteAllocations {0, 0}
+                                         : it->second;
+    folly::toAppend(
+      folly::format(
+        "{}: {} [{}: {}] @",
+        cur.m_count, cur.m_bytes, kv.second.m_count, kv.second.m_bytes
+      ).str(), &res
+    );
+    for (auto addr : kv.first) {
+      folly::toAppend(folly::format(" {:#x}", addr), &res);
+    }
+    folly::toAppend("\n", &res);
+  }
+  pprof_append_mapped_libraries(res);
+  return res;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+}
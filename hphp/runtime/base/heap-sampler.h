@@ -0,0 +1,103 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef incl_HPHP_HEAP_SAMPLER_H_
+#define incl_HPHP_HEAP_SAMPLER_H_
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "hphp/util/thread-local.h"
+
+namespace HPHP {
+
+//////////////////////////////////////////////////////////////////////
+
+/*
+ * Sampling allocation profiler for the smart heap.
+ *
+ * With Eval.HeapSampleBytes set to N, the MemoryManager samples
+ * smartMallocSize and objMalloc allocations as a Poisson process over
+ * allocated bytes with a mean interval of N, so an s-byte allocation
+ * is picked with probability 1 - exp(-s/N) and pprof can scale the
+ * samples back up.  Each sample records the native return addresses
+ * up to the first VM frame, followed by the PHP frames from there
+ * outward.
+ *
+ * Samples are folded into a process-wide profile at the end of every
+ * request; those that weren't freed by then count as in use.  The
+ * HHProf server returns the profile in pprof's heap_v2 format from
+ * /pprof/heap.  PHP frames appear as SrcKeys tagged with kSrcKeyTag,
+ * which /pprof/symbol knows how to resolve.
+ */
+struct HeapSampler {
+  static DECLARE_THREAD_LOCAL(HeapSampler, s_sampler);
+
+  static const uint64_t kSrcKeyTag = 1ull << 63;
+
+  HeapSampler() : m_rng(std::random_device()()) {}
+
+  static bool enabled();
+
+  /*
+   * Bytes to allocate before taking the next sample.
+   */
+  int64_t nextInterval();
+
+  /*
+   * Filter over sampled pointers that are still live, used by the
+   * MemoryManager to skip recordFree() on nearly every free.  It may
+   * have false positives, never false negatives.
+   */
+  static uint64_t filterBit(const void* ptr) {
+    return 1ull << ((uintptr_t(ptr) * 0x9e3779b97f4a7c15ull) >> 58);
+  }
+  uint64_t liveFilter() const;
+
+  void recordAlloc(void* ptr, size_t bytes);
+  // Returns whether ptr was a sampled allocation.
+  bool recordFree(void* ptr);
+
+  /*
+   * Merge this request's samples into the process-wide profile.
+   */
+  void requestEnd();
+
+  static std::string toPProfFormat();
+
+private:
+  struct Sample {
+    std::vector<uint64_t> trace;
+    size_t bytes;
+    bool freed;
+  };
+
+  static void captureStack(std::vector<uint64_t>& trace);
+
+  std::mt19937_64 m_rng;
+  std::vector<Sample> m_samples;
+  // Sampled pointers not yet freed, to their index in m_samples.
+  std::unordered_map<void*,size_t> m_live;
+};
+
+//////////////////////////////////////////////////////////////////////
+
+}
+
+#endif
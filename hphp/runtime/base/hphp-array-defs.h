@@ -27,17 +27,42 @@ namespace HPHP {
 inline void HphpArray::initHash(size_t tableSize) {
   assert(HphpArray::Empty == -1);
   memset(m_hash, 0xffU, tableSize * sizeof(*m_hash));
+  memset(hashTags(), EmptyTag, computeTagBytes(m_tableMask));
   m_hLoad = 0;
 }
 
+inline uint8_t HphpArray::hashTag(size_t h0) {
+  // Slot selection uses the low bits, so mix all of them into the tag.
+  return (uint32_t(h0 & STRHASH_MASK) * 0x9e3779b1U) >> 25;
+}
+
+inline uint8_t* HphpArray::hashTags() const {
+  return reinterpret_cast<uint8_t*>(m_hash + computeTableSize(m_tableMask));
+}
+
+inline void HphpArray::setHashTag(const int32_t* ei, uint8_t tag) const {
+  auto const tableSize = computeTableSize(m_tableMask);
+  auto const tags = hashTags();
+  auto const slot = size_t(ei - m_hash);
+  assert(slot < tableSize);
+  tags[slot] = tag;
+  for (auto i = slot; i < TagGroupSize; i += tableSize) {
+    tags[tableSize + i] = tag;
+  }
+}
+
+// Stamps the returned slot's tag too, since every caller fills the slot.
 ALWAYS_INLINE
 int32_t* HphpArray::findForNewInsert(size_t h0) const {
   assert(!isPacked());
   size_t mask = m_tableMask;
   auto table = m_hash;
-  auto ei = &table[h0 & mask];
-  return !validPos(*ei) ? ei :
-         findForNewInsertLoop(table, h0, mask);
+  auto tags = hashTags();
+  auto ei = (tags[h0 & mask] & EmptyTag) ? &table[h0 & mask] :
+            findForNewInsertLoop(tags, table, h0, mask);
+  assert(!validPos(*ei));
+  setHashTag(ei, hashTag(h0));
+  return ei;
 }
 
 inline bool HphpArray::isTombstone(ssize_t pos) const {
@@ -117,6 +142,20 @@ inline const HphpArray* HphpArray::asPacked(const ArrayData* ad) {
   return a;
 }
 
+inline HphpArray* HphpArray::asTypedVec(ArrayData* ad) {
+  assert(ad->isTypedVec());
+  auto a = static_cast<HphpArray*>(ad);
+  assert(a->checkInvariants());
+  return a;
+}
+
+inline const HphpArray* HphpArray::asTypedVec(const ArrayData* ad) {
+  assert(ad->isTypedVec());
+  auto a = static_cast<const HphpArray*>(ad);
+  assert(a->checkInvariants());
+  return a;
+}
+
 inline HphpArray* HphpArray::asMixed(ArrayData* ad) {
   assert(ad->kind() == kMixedKind);
   auto a = static_cast<HphpArray*>(ad);
@@ -148,6 +187,17 @@ HphpArray::GetCellIntPacked(const ArrayData* ad, int64_t ki) {
   return *v.asTypedValue();
 }
 
+inline TypedValue
+HphpArray::GetCellIntTypedVec(const ArrayData* ad, int64_t ki) {
+  auto a = asTypedVec(ad);
+  if (LIKELY(size_t(ki) < a->m_size)) {
+    // Ints and doubles are never boxed or refcounted.
+    return a->data()[ki].data;
+  }
+  Variant v = getNotFound(ki);
+  return *v.asTypedValue();
+}
+
 inline uint64_t
 HphpArray::IssetIntPacked(const ArrayData* ad, int64_t ki) {
   auto a = asPacked(ad);
@@ -175,9 +225,14 @@ inline size_t HphpArray::computeMaxElms(uint32_t tableMask) {
 
 inline size_t HphpArray::computeDataSize(uint32_t tableMask) {
   return computeTableSize(tableMask) * sizeof(int32_t) +
+    computeTagBytes(tableMask) +
     computeMaxElms(tableMask) * sizeof(Elm);
 }
 
+inline size_t HphpArray::computeTagBytes(uint32_t tableMask) {
+  return computeTableSize(tableMask) + TagGroupSize;
+}
+
 inline void ArrayData::moveStrongIterators(ArrayData* dest, ArrayData* src) {
   for (FullPosRange r(src->strongIterators()); !r.empty(); r.popFront()) {
     r.front()->setContainer(dest);
@@ -20,7 +20,15 @@
 #include "hphp/runtime/base/sort-helpers.h"
 #include "hphp/runtime/base/complex-types.h"
 #include "hphp/runtime/base/execution-context.h"
+#include "hphp/runtime/base/memory-manager.h"
+#include "hphp/runtime/base/runtime-option.h"
 #include "hphp/runtime/vm/jit/translator-inline.h"
+#include "hphp/util/async-func.h"
+#include "hphp/util/process.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
 
 // inline methods of HphpArray
 #include "hphp/runtime/base/hphp-array-defs.h"
@@ -63,10 +71,7 @@ template <typename AccessorT>
 HphpArray::SortFlavor
 HphpArray::preSort(const AccessorT& acc, bool checkTypes) {
   assert(m_size > 0);
-  if (isPacked()) {
-    // todo t2607563: this is pessimistic.
-    packedToMixed();
-  }
+  // Packed arrays have no tombstones, so only the type scan applies.
   if (!checkTypes && m_size == m_used) {
     // No need to loop over the elements, we're done
     return GenericSort;
@@ -118,10 +123,16 @@ done:
 /**
  * postSort() runs after the sort has been performed. For HphpArray, postSort()
  * handles rebuilding the hash. Also, if resetKeys is true, postSort() will
- * renumber the keys 0 thru n-1.
+ * renumber the keys 0 thru n-1. Packed arrays are only sorted in place when
+ * the keys are renumbered, and their keys are implicit, so there is nothing
+ * to rebuild.
  */
 void HphpArray::postSort(bool resetKeys) {
   assert(m_size > 0);
+  if (isPacked()) {
+    assert(resetKeys);
+    return;
+  }
   size_t tableSize = computeTableSize(m_tableMask);
   initHash(tableSize);
   if (resetKeys) {
@@ -130,6 +141,7 @@ void HphpArray::postSort(bool resetKeys) {
       if (e.hasStrKey()) decRefStr(e.key);
       e.setIntKey(pos);
       m_hash[pos] = pos;
+      setHashTag(&m_hash[pos], hashTag(pos));
     }
     m_nextKI = m_size;
   } else {
@@ -147,14 +159,260 @@ ArrayData* HphpArray::EscalateForSort(ArrayData* ad) {
   return asHphpArray(ad)->copyImpl();
 }
 
+namespace {
+
+typedef HphpArray::Elm Elm;
+
+/*
+ * Sorting helpers for the builtin comparators.  When preSort() finds that
+ * every element is an int, SORT_REGULAR and SORT_NUMERIC order them by
+ * value; when every element is a string, SORT_STRING orders them bytewise
+ * (string_strcmp).  Both orderings can be produced by radix passes without
+ * calling the comparator.  PHP's sort is not stable, so the relative order
+ * of equal elements is unspecified here just as it is for Sort::sort.
+ */
+const size_t kRadixStrCutoff = 32;
+const size_t kRadixStrMaxDepth = 64;
+
+bool useRadixSort(size_t n) {
+  return RuntimeOption::EvalRadixSortThreshold &&
+         n >= RuntimeOption::EvalRadixSortThreshold;
+}
+
+size_t parallelSortThreads(size_t n) {
+  if (RuntimeOption::ServerExecutionMode() ||
+      !RuntimeOption::EvalParallelSortThreshold ||
+      n < RuntimeOption::EvalParallelSortThreshold) {
+    return 1;
+  }
+  size_t cpus = Process::GetCPUCount();
+  return std::max<size_t>(1, std::min<size_t>(cpus, 8));
+}
+
+/*
+ * LSD radix sort of int elements, one byte per pass.  Flipping the sign bit
+ * makes the unsigned order of the keys match the signed order of the ints,
+ * and complementing the keys gives a descending sort.  Passes over bytes
+ * that are the same in every key are skipped.
+ */
+template <typename AccessorT, bool ascending>
+void radixSortInts(Elm* elms, size_t n) {
+  AccessorT acc;
+  auto radixKey = [&] (const Elm& e) {
+    uint64_t k = uint64_t(acc.getInt(e)) ^ (uint64_t(1) << 63);
+    return ascending ? k : ~k;
+  };
+  size_t counts[8][256];
+  memset(counts, 0, sizeof counts);
+  for (size_t i = 0; i < n; ++i) {
+    uint64_t k = radixKey(elms[i]);
+    for (int b = 0; b < 8; ++b) {
+      ++counts[b][(k >> (b * 8)) & 0xff];
+    }
+  }
+  uint64_t k0 = radixKey(elms[0]);
+  Elm* buf = (Elm*)smart_malloc(n * sizeof(Elm));
+  Elm* src = elms;
+  Elm* dst = buf;
+  for (int b = 0; b < 8; ++b) {
+    int shift = b * 8;
+    size_t* count = counts[b];
+    if (count[(k0 >> shift) & 0xff] == n) continue;
+    size_t offset = 0;
+    for (int d = 0; d < 256; ++d) {
+      size_t c = count[d];
+      count[d] = offset;
+      offset += c;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      size_t d = (radixKey(src[i]) >> shift) & 0xff;
+      memcpy(&dst[count[d]++], &src[i], sizeof(Elm));
+    }
+    std::swap(src, dst);
+  }
+  if (src != elms) memcpy(elms, src, n * sizeof(Elm));
+  smart_free(buf);
+}
+
+/*
+ * MSD radix sort of string elements in ascending SORT_STRING order.  Bucket
+ * 0 holds strings that end at the current depth, so a string sorts before
+ * any longer string it prefixes.  Small buckets and long common prefixes
+ * fall back to the comparison sort.
+ */
+template <typename AccessorT>
+void radixSortStrs(Elm* elms, Elm* buf, size_t n, size_t depth) {
+  AccessorT acc;
+  auto bucket = [&] (const Elm& e) -> size_t {
+    StringData* s = acc.getStr(e);
+    return depth < size_t(s->size()) ?
+      size_t((unsigned char)s->data()[depth]) + 1 : 0;
+  };
+  size_t bounds[258];
+  for (;;) {
+    if (n < kRadixStrCutoff || depth >= kRadixStrMaxDepth) {
+      StrElmCompare<AccessorT, SORT_STRING, true> comp;
+      HPHP::Sort::sort(elms, elms + n, comp);
+      return;
+    }
+    memset(bounds, 0, sizeof bounds);
+    for (size_t i = 0; i < n; ++i) {
+      ++bounds[bucket(elms[i]) + 1];
+    }
+    size_t b0 = bucket(elms[0]);
+    if (bounds[b0 + 1] != n) break;
+    // Every string shares this byte (or has ended, in which case they are
+    // all equal); move on to the next byte without scattering.
+    if (b0 == 0) return;
+    ++depth;
+  }
+  for (int d = 1; d < 258; ++d) {
+    bounds[d] += bounds[d - 1];
+  }
+  size_t next[257];
+  memcpy(next, bounds, sizeof next);
+  for (size_t i = 0; i < n; ++i) {
+    memcpy(&buf[next[bucket(elms[i])]++], &elms[i], sizeof(Elm));
+  }
+  memcpy(elms, buf, n * sizeof(Elm));
+  for (int d = 1; d < 257; ++d) {
+    size_t len = bounds[d + 1] - bounds[d];
+    if (len > 1) {
+      radixSortStrs<AccessorT>(elms + bounds[d], buf, len, depth + 1);
+    }
+  }
+}
+
+/*
+ * Multi-threaded sort for the CLI: the range is split into one run per
+ * thread, each run is sorted with Sort::sort, and then runs are merged
+ * pairwise until one is left.  Worker threads only call the comparator and
+ * copy elements, so it is only used with comparators that neither allocate
+ * nor touch per-request state.
+ */
+template <typename CompT>
+struct SortJob {
+  Elm* first;
+  Elm* mid;
+  Elm* last;
+  Elm* out;
+  CompT comp;
+
+  void sort() { HPHP::Sort::sort(first, last, comp); }
+  void merge() { std::merge(first, mid, mid, last, out, comp); }
+};
+
+template <typename CompT>
+void runSortJobs(std::vector<SortJob<CompT>>& jobs,
+                 void (SortJob<CompT>::*fn)()) {
+  std::vector<std::unique_ptr<AsyncFunc<SortJob<CompT>>>> threads;
+  for (size_t i = 1; i < jobs.size(); ++i) {
+    threads.emplace_back(new AsyncFunc<SortJob<CompT>>(&jobs[i], fn));
+    threads.back()->setNoInit();
+    threads.back()->start();
+  }
+  (jobs[0].*fn)();
+  for (auto& t : threads) {
+    t->waitForEnd();
+  }
+}
+
+template <typename CompT>
+void parallelSort(Elm* elms, size_t n, CompT comp, size_t nthreads) {
+  std::vector<size_t> runs;
+  for (size_t i = 0; i <= nthreads; ++i) {
+    runs.push_back(n * i / nthreads);
+  }
+  std::vector<SortJob<CompT>> jobs;
+  for (size_t i = 0; i < nthreads; ++i) {
+    jobs.push_back({elms + runs[i], nullptr, elms + runs[i + 1], nullptr,
+                    comp});
+  }
+  runSortJobs(jobs, &SortJob<CompT>::sort);
+
+  Elm* buf = (Elm*)smart_malloc(n * sizeof(Elm));
+  Elm* src = elms;
+  Elm* dst = buf;
+  while (runs.size() > 2) {
+    std::vector<size_t> merged;
+    jobs.clear();
+    size_t i = 0;
+    for (; i + 2 < runs.size(); i += 2) {
+      jobs.push_back({src + runs[i], src + runs[i + 1], src + runs[i + 2],
+                      dst + runs[i], comp});
+      merged.push_back(runs[i]);
+    }
+    if (i + 1 < runs.size()) {
+      // An odd run out is carried over to the next round as is.
+      memcpy(dst + runs[i], src + runs[i],
+             (runs[i + 1] - runs[i]) * sizeof(Elm));
+      merged.push_back(runs[i]);
+    }
+    merged.push_back(n);
+    runSortJobs(jobs, &SortJob<CompT>::merge);
+    runs.swap(merged);
+    std::swap(src, dst);
+  }
+  if (src != elms) memcpy(elms, src, n * sizeof(Elm));
+  smart_free(buf);
+}
+
+template <typename CompT>
+void sortElms(Elm* elms, size_t n, CompT comp) {
+  HPHP::Sort::sort(elms, elms + n, comp);
+}
+
+template <typename AccessorT, int sort_flags, bool ascending>
+void sortElms(Elm* elms, size_t n,
+              IntElmCompare<AccessorT, sort_flags, ascending> comp) {
+  if ((sort_flags == SORT_REGULAR || sort_flags == SORT_NUMERIC) &&
+      useRadixSort(n)) {
+    radixSortInts<AccessorT, ascending>(elms, n);
+    return;
+  }
+  // strcoll() depends on the request's locale.
+  size_t nthreads = sort_flags == SORT_LOCALE_STRING ?
+    1 : parallelSortThreads(n);
+  if (nthreads > 1) {
+    parallelSort(elms, n, comp, nthreads);
+    return;
+  }
+  HPHP::Sort::sort(elms, elms + n, comp);
+}
+
+template <typename AccessorT, int sort_flags, bool ascending>
+void sortElms(Elm* elms, size_t n,
+              StrElmCompare<AccessorT, sort_flags, ascending> comp) {
+  if (sort_flags == SORT_STRING && useRadixSort(n)) {
+    Elm* buf = (Elm*)smart_malloc(n * sizeof(Elm));
+    radixSortStrs<AccessorT>(elms, buf, n, 0);
+    smart_free(buf);
+    if (!ascending) std::reverse(elms, elms + n);
+    return;
+  }
+  // SORT_REGULAR and SORT_NUMERIC go through StringData methods that cache
+  // numeric-ness in the string, and strcoll() depends on the locale.
+  size_t nthreads =
+    sort_flags == SORT_STRING || sort_flags == SORT_STRING_CASE ||
+    sort_flags == SORT_NATURAL || sort_flags == SORT_NATURAL_CASE ?
+    parallelSortThreads(n) : 1;
+  if (nthreads > 1) {
+    parallelSort(elms, n, comp, nthreads);
+    return;
+  }
+  HPHP::Sort::sort(elms, elms + n, comp);
+}
+
+}
+
 #define SORT_CASE(flag, cmp_type, acc_type) \
   case flag: { \
     if (ascending) { \
       cmp_type##Compare<acc_type, flag, true> comp; \
-      HPHP::Sort::sort(a->data(), a->data() + a->m_size, comp); \
+      sortElms(a->data(), a->m_size, comp); \
     } else { \
       cmp_type##Compare<acc_type, flag, false> comp; \
-      HPHP::Sort::sort(a->data(), a->data() + a->m_size, comp); \
+      sortElms(a->data(), a->m_size, comp); \
     } \
     break; \
   }
@@ -186,6 +444,9 @@ ArrayData* HphpArray::EscalateForSort(ArrayData* ad) {
       } \
       return; \
     } \
+    if (!resetKeys && a->isPacked()) { \
+      a->packedToMixed(); \
+    } \
     SortFlavor flav = a->preSort<acc_type>(acc_type(), true); \
     a->m_pos = ssize_t(0); \
     try { \
@@ -226,6 +487,9 @@ void HphpArray::Asort(ArrayData* ad, int sort_flags, bool ascending) {
       }                                                         \
       return;                                                   \
     }                                                           \
+    if (!resetKeys && a->isPacked()) {                          \
+      a->packedToMixed();                                       \
+    }                                                           \
     a->preSort<acc_type>(acc_type(), false);                    \
     a->m_pos = ssize_t(0);                                      \
     try {                                                       \
@@ -0,0 +1,351 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include "hphp/runtime/base/hphp-array.h"
+#include "hphp/runtime/base/array-iterator.h"
+#include "hphp/runtime/base/complex-types.h"
+#include "hphp/runtime/base/runtime-option.h"
+
+// inline methods of HphpArray
+#include "hphp/runtime/base/hphp-array-defs.h"
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Typed vectors are packed HphpArrays whose values are all KindOfInt64
+ * (kIntVecKind) or all KindOfDouble (kDblVecKind).  The element layout
+ * is exactly the packed one, so changing kinds in either direction is a
+ * single store to m_kind.  Every mutator below demotes to kPackedKind,
+ * reuses the packed implementation, and re-tags the result when the
+ * operation could not have broken homogeneity.
+ */
+
+bool HphpArray::fitsTypedVec(ArrayKind kind, CVarRef v) {
+  auto const t = v.getType();
+  return kind == kIntVecKind ? t == KindOfInt64 : t == KindOfDouble;
+}
+
+ArrayData* HphpArray::retagTypedVec(ArrayData* ad, ArrayKind kind) {
+  assert(kind == kIntVecKind || kind == kDblVecKind);
+  if (ad->isPacked()) {
+    auto a = static_cast<HphpArray*>(ad);
+    a->m_kind = kind;
+    assert(a->checkInvariants());
+  }
+  return ad;
+}
+
+// The packed array a write should land in: the array itself, demoted in
+// place, when nobody else can see it; otherwise a plain packed copy, so
+// the shared (or static) original keeps its kind.
+HphpArray* HphpArray::demoteTypedVec(ArrayData* ad, bool copy) {
+  auto a = asTypedVec(ad);
+  if (copy || a->getCount() > 1) return a->copyPacked();
+  assert(!a->isStatic());
+  a->m_kind = kPackedKind;
+  return a;
+}
+
+// Called by AppendPacked once an empty array has taken its first value.
+HphpArray* HphpArray::maybePromoteTypedVec() {
+  assert(isPacked() && m_size == 1);
+  if (!RuntimeOption::EvalEnableTypedVecs) return this;
+  switch (data()[0].data.m_type) {
+  case KindOfInt64:  m_kind = kIntVecKind; break;
+  case KindOfDouble: m_kind = kDblVecKind; break;
+  default: break;
+  }
+  return this;
+}
+
+//=============================================================================
+// Reads; the packed layout answers these directly.
+
+void HphpArray::ReleaseTypedVec(ArrayData* ad) {
+  ReleasePacked(demoteTypedVec(ad, false));
+}
+
+TypedValue* HphpArray::NvGetIntTypedVec(const ArrayData* ad, int64_t ki) {
+  auto a = asTypedVec(ad);
+  return LIKELY(size_t(ki) < a->m_size) ? &a->data()[ki].data : nullptr;
+}
+
+TypedValue*
+HphpArray::NvGetStrTypedVec(const ArrayData* ad, const StringData* k) {
+  assert(asTypedVec(ad));
+  return nullptr;
+}
+
+void HphpArray::NvGetKeyTypedVec(const ArrayData* ad, TypedValue* out,
+                                 ssize_t pos) {
+  DEBUG_ONLY auto a = asTypedVec(ad);
+  assert(size_t(pos) < a->m_size);
+  out->m_data.num = pos;
+  out->m_type = KindOfInt64;
+}
+
+CVarRef HphpArray::GetValueRefTypedVec(const ArrayData* ad, ssize_t pos) {
+  auto a = asTypedVec(ad);
+  assert(size_t(pos) < a->m_size);
+  return tvAsCVarRef(&a->data()[pos].data);
+}
+
+bool HphpArray::ExistsIntTypedVec(const ArrayData* ad, int64_t k) {
+  return size_t(k) < asTypedVec(ad)->m_size;
+}
+
+bool HphpArray::ExistsStrTypedVec(const ArrayData* ad, const StringData* k) {
+  assert(asTypedVec(ad));
+  return false;
+}
+
+ssize_t HphpArray::IterBeginTypedVec(const ArrayData* ad) {
+  return asTypedVec(ad)->m_size ? 0 : invalid_index;
+}
+
+ssize_t HphpArray::IterEndTypedVec(const ArrayData* ad) {
+  return ssize_t(asTypedVec(ad)->m_size) - 1;
+  static_assert(invalid_index == -1, "");
+}
+
+ssize_t HphpArray::IterAdvanceTypedVec(const ArrayData* ad, ssize_t pos) {
+  return size_t(pos + 1) < asTypedVec(ad)->m_size ? pos + 1 : invalid_index;
+}
+
+ssize_t HphpArray::IterRewindTypedVec(const ArrayData* ad, ssize_t pos) {
+  assert(asTypedVec(ad));
+  return pos == invalid_index ? invalid_index : pos - 1;
+}
+
+bool HphpArray::ValidFullPosTypedVec(const ArrayData* ad, const FullPos& fp) {
+  assert(fp.getContainer() == asTypedVec(ad));
+  if (fp.getResetFlag()) return false;
+  return fp.m_pos != invalid_index;
+}
+
+//=============================================================================
+// Copies keep the kind; the values are already known to fit.
+
+ArrayData* HphpArray::CopyTypedVec(const ArrayData* ad) {
+  auto a = asTypedVec(ad);
+  auto copied = a->copyPacked();
+  copied->m_kind = a->m_kind;
+  return copied;
+}
+
+ArrayData* HphpArray::CopyWithStrongIteratorsTypedVec(const ArrayData* ad) {
+  auto copied = CopyTypedVec(ad);
+  moveStrongIterators(copied, const_cast<ArrayData*>(ad));
+  return copied;
+}
+
+ArrayData* HphpArray::EscalateForSortTypedVec(ArrayData* ad) {
+  return CopyTypedVec(ad);
+}
+
+//=============================================================================
+// Writes that keep the array homogeneous when the value fits.
+
+ArrayData* HphpArray::SetIntTypedVec(ArrayData* ad, int64_t k, CVarRef v,
+                                     bool copy) {
+  auto const kind = ad->kind();
+  auto ret = SetIntPacked(demoteTypedVec(ad, copy), k, v, false);
+  return fitsTypedVec(kind, v) ? retagTypedVec(ret, kind) : ret;
+}
+
+ArrayData* HphpArray::AddIntTypedVec(ArrayData* ad, int64_t k, CVarRef v,
+                                     bool copy) {
+  auto const kind = ad->kind();
+  auto ret = AddIntPacked(demoteTypedVec(ad, copy), k, v, false);
+  return fitsTypedVec(kind, v) ? retagTypedVec(ret, kind) : ret;
+}
+
+ArrayData* HphpArray::AppendTypedVec(ArrayData* ad, CVarRef v, bool copy) {
+  auto const kind = ad->kind();
+  auto ret = AppendPacked(demoteTypedVec(ad, copy), v, false);
+  return fitsTypedVec(kind, v) ? retagTypedVec(ret, kind) : ret;
+}
+
+ArrayData* HphpArray::PrependTypedVec(ArrayData* ad, CVarRef v, bool copy) {
+  auto const kind = ad->kind();
+  auto ret = PrependPacked(demoteTypedVec(ad, copy), v, false);
+  return fitsTypedVec(kind, v) ? retagTypedVec(ret, kind) : ret;
+}
+
+ArrayData* HphpArray::PlusTypedVec(ArrayData* ad, const ArrayData* elems) {
+  auto const kind = ad->kind();
+  auto const same = elems->kind() == kind;
+  auto a = demoteTypedVec(ad, false);
+  auto ret = PlusPacked(a, elems);
+  // PlusPacked always copies, so put back whatever demoteTypedVec made.
+  if (a != ad) ReleasePacked(a); else retagTypedVec(a, kind);
+  return same ? retagTypedVec(ret, kind) : ret;
+}
+
+ArrayData* HphpArray::MergeTypedVec(ArrayData* ad, const ArrayData* elems) {
+  auto const kind = ad->kind();
+  auto const same = elems->kind() == kind;
+  auto a = demoteTypedVec(ad, false);
+  auto ret = MergePacked(a, elems);
+  // MergePacked always copies, so put back whatever demoteTypedVec made.
+  if (a != ad) ReleasePacked(a); else retagTypedVec(a, kind);
+  return same ? retagTypedVec(ret, kind) : ret;
+}
+
+//=============================================================================
+// Writes that only ever remove or reorder values.
+
+ArrayData* HphpArray::RemoveIntTypedVec(ArrayData* ad, int64_t k, bool copy) {
+  auto const kind = ad->kind();
+  return retagTypedVec(RemoveIntPacked(demoteTypedVec(ad, copy), k, false),
+                       kind);
+}
+
+ArrayData* HphpArray::RemoveStrTypedVec(ArrayData* ad, const StringData* k,
+                                        bool copy) {
+  auto const kind = ad->kind();
+  return retagTypedVec(RemoveStrPacked(demoteTypedVec(ad, copy), k, false),
+                       kind);
+}
+
+ArrayData* HphpArray::PopTypedVec(ArrayData* ad, Variant& value) {
+  auto const kind = ad->kind();
+  return retagTypedVec(PopPacked(demoteTypedVec(ad, false), value), kind);
+}
+
+ArrayData* HphpArray::DequeueTypedVec(ArrayData* ad, Variant& value) {
+  auto const kind = ad->kind();
+  return retagTypedVec(DequeuePacked(demoteTypedVec(ad, false), value), kind);
+}
+
+void HphpArray::RenumberTypedVec(ArrayData* ad) {
+  assert(asTypedVec(ad)); // already numbered 0..size-1
+}
+
+// The sorts run on the copy EscalateForSortTypedVec made, which nothing
+// else holds, so the demotion is always in place.
+void HphpArray::KsortTypedVec(ArrayData* ad, int sort_flags, bool ascending) {
+  auto const kind = ad->kind();
+  assert(ad->getCount() <= 1);
+  Ksort(demoteTypedVec(ad, false), sort_flags, ascending);
+  retagTypedVec(ad, kind);
+}
+
+void HphpArray::SortTypedVec(ArrayData* ad, int sort_flags, bool ascending) {
+  auto const kind = ad->kind();
+  assert(ad->getCount() <= 1);
+  Sort(demoteTypedVec(ad, false), sort_flags, ascending);
+  retagTypedVec(ad, kind);
+}
+
+void HphpArray::AsortTypedVec(ArrayData* ad, int sort_flags, bool ascending) {
+  auto const kind = ad->kind();
+  assert(ad->getCount() <= 1);
+  Asort(demoteTypedVec(ad, false), sort_flags, ascending);
+  retagTypedVec(ad, kind);
+}
+
+void HphpArray::UksortTypedVec(ArrayData* ad, CVarRef cmp_function) {
+  auto const kind = ad->kind();
+  assert(ad->getCount() <= 1);
+  Uksort(demoteTypedVec(ad, false), cmp_function);
+  retagTypedVec(ad, kind);
+}
+
+void HphpArray::UsortTypedVec(ArrayData* ad, CVarRef cmp_function) {
+  auto const kind = ad->kind();
+  assert(ad->getCount() <= 1);
+  Usort(demoteTypedVec(ad, false), cmp_function);
+  retagTypedVec(ad, kind);
+}
+
+void HphpArray::UasortTypedVec(ArrayData* ad, CVarRef cmp_function) {
+  auto const kind = ad->kind();
+  assert(ad->getCount() <= 1);
+  Uasort(demoteTypedVec(ad, false), cmp_function);
+  retagTypedVec(ad, kind);
+}
+
+//=============================================================================
+// Everything else hands out references or stores arbitrary values, so
+// the array stops being typed.
+
+ArrayData* HphpArray::SetStrTypedVec(ArrayData* ad, StringData* k, CVarRef v,
+                                     bool copy) {
+  return SetStrPacked(demoteTypedVec(ad, copy), k, v, false);
+}
+
+ArrayData* HphpArray::LvalIntTypedVec(ArrayData* ad, int64_t k,
+                                      Variant*& ret, bool copy) {
+  return LvalIntPacked(demoteTypedVec(ad, copy), k, ret, false);
+}
+
+ArrayData* HphpArray::LvalStrTypedVec(ArrayData* ad, StringData* k,
+                                      Variant*& ret, bool copy) {
+  return LvalStrPacked(demoteTypedVec(ad, copy), k, ret, false);
+}
+
+ArrayData* HphpArray::LvalNewTypedVec(ArrayData* ad, Variant*& ret,
+                                      bool copy) {
+  return LvalNewPacked(demoteTypedVec(ad, copy), ret, false);
+}
+
+ArrayData* HphpArray::SetRefIntTypedVec(ArrayData* ad, int64_t k, CVarRef v,
+                                        bool copy) {
+  return SetRefIntPacked(demoteTypedVec(ad, copy), k, v, false);
+}
+
+ArrayData* HphpArray::SetRefStrTypedVec(ArrayData* ad, StringData* k,
+                                        CVarRef v, bool copy) {
+  return SetRefStrPacked(demoteTypedVec(ad, copy), k, v, false);
+}
+
+ArrayData* HphpArray::AppendRefTypedVec(ArrayData* ad, CVarRef v, bool copy) {
+  return AppendRefPacked(demoteTypedVec(ad, copy), v, false);
+}
+
+ArrayData* HphpArray::AppendWithRefTypedVec(ArrayData* ad, CVarRef v,
+                                            bool copy) {
+  return AppendWithRefPacked(demoteTypedVec(ad, copy), v, false);
+}
+
+//=============================================================================
+// Neither of these writes a value, so the kind stays.
+
+bool HphpArray::AdvanceFullPosTypedVec(ArrayData* ad, FullPos& fp) {
+  auto a = asTypedVec(ad);
+  if (fp.getResetFlag()) {
+    fp.setResetFlag(false);
+    fp.m_pos = invalid_index;
+  } else if (fp.m_pos == invalid_index) {
+    return false;
+  }
+  fp.m_pos = a->nextElm(a->data(), fp.m_pos);
+  if (fp.m_pos == invalid_index) {
+    return false;
+  }
+  // As in AdvanceFullPos, the internal cursor goes one past fp.
+  a->m_pos = a->nextElm(a->data(), fp.m_pos);
+  return true;
+}
+
+void HphpArray::OnSetEvalScalarTypedVec(ArrayData* ad) {
+  assert(asTypedVec(ad)); // ints and doubles are already scalars
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
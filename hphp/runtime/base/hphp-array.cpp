@@ -34,6 +34,10 @@
 #include "hphp/runtime/vm/member-operations.h"
 #include "hphp/runtime/base/stats.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 // inline methods of HphpArray
 #include "hphp/runtime/base/hphp-array-defs.h"
 
@@ -143,8 +147,9 @@ ALWAYS_INLINE
 uint32_t computeAllocBytes(uint32_t cap, uint32_t mask) {
   auto const tabSize    = mask + 1;
   auto const tabBytes   = tabSize * sizeof(int32_t);
+  auto const tagBytes   = HphpArray::computeTagBytes(mask);
   auto const dataBytes  = cap * sizeof(HphpArray::Elm);
-  return sizeof(HphpArray) + tabBytes + dataBytes;
+  return sizeof(HphpArray) + tabBytes + tagBytes + dataBytes;
 }
 
 ALWAYS_INLINE
@@ -237,7 +242,7 @@ HphpArray* HphpArray::MakePacked(uint32_t size, const TypedValue* values) {
 // for internal use by nonSmartCopy() and copyPacked()
 ALWAYS_INLINE
 HphpArray* HphpArray::CopyPacked(const HphpArray& other, AllocationMode mode) {
-  assert(other.isPacked());
+  assert(other.isPacked() || other.isTypedVec());
 
   auto const cap  = other.m_cap;
   auto const mask = other.m_tableMask;
@@ -296,8 +301,10 @@ HphpArray* HphpArray::CopyMixed(const HphpArray& other, AllocationMode mode) {
   auto const data      = reinterpret_cast<Elm*>(ad + 1);
   auto const hash      = reinterpret_cast<int32_t*>(data + cap);
 
+  // The tags sit right after the hash slots; copy both at once.
   ad->m_hash = static_cast<int32_t*>(
-    memcpy(hash, other.m_hash, (mask + 1) * sizeof *hash)
+    memcpy(hash, other.m_hash,
+           (mask + 1) * sizeof *hash + computeTagBytes(mask))
   );
 
   // Copy the elements and bump up refcounts as needed.
@@ -344,6 +351,12 @@ NEVER_INLINE ArrayData* HphpArray::NonSmartCopy(const ArrayData* in) {
     : CopyMixed(*a, AllocationMode::nonSmart);
 }
 
+// Non-smart copies back static and shared arrays, which must never be
+// demoted in place later, so they come out as plain packed arrays.
+NEVER_INLINE ArrayData* HphpArray::NonSmartCopyTypedVec(const ArrayData* in) {
+  return CopyPacked(*asTypedVec(in), AllocationMode::nonSmart);
+}
+
 NEVER_INLINE HphpArray* HphpArray::copyPacked() const {
   assert(checkInvariants());
   return CopyPacked(*this, AllocationMode::smart);
@@ -403,6 +416,7 @@ HphpArray* HphpArray::copyMixedAndResizeIfNeededSlow() const {
 HOT_FUNC_VM NEVER_INLINE
 void HphpArray::ReleasePacked(ArrayData* in) {
   auto const ad = asPacked(in);
+  if (UNLIKELY(ad->m_cycleRoot)) CycleCollector::forgetRoot(ad);
 
   if (!ad->isZombie()) {
     auto const data = ad->data();
@@ -427,6 +441,7 @@ void HphpArray::ReleasePacked(ArrayData* in) {
 HOT_FUNC_VM NEVER_INLINE
 void HphpArray::Release(ArrayData* in) {
   auto const ad = asMixed(in);
+  if (UNLIKELY(ad->m_cycleRoot)) CycleCollector::forgetRoot(ad);
 
   if (!ad->isZombie()) {
     auto const data = ad->data();
@@ -478,6 +493,10 @@ HphpArray* HphpArray::packedToMixed() {
     *hash = Empty;
     ++hash;
   }
+  memset(hashTags(), EmptyTag, computeTagBytes(tableMask));
+  for (i = 0; i < size; ++i) {
+    setHashTag(&m_hash[i], hashTag(i));
+  }
 
   assert(checkInvariants());
   return this;
@@ -494,7 +513,7 @@ HphpArray* HphpArray::packedToMixed() {
  *
  * All arrays (zombie or not):
  *
- *   m_tableMask is 2^k - 1 (required for quadratic probe)
+ *   m_tableMask is 2^k - 1 (required for group probing)
  *   m_tableMask == nextPower2(m_cap) - 1;
  *   m_cap == computeMaxElms(m_tableMask);
  *
@@ -513,6 +532,7 @@ HphpArray* HphpArray::packedToMixed() {
  *   m_nextKI >= highest actual int key
  *   Elm.data.m_type maybe KindOfInvalid (tombstone)
  *   hash[] maybe Tombstone
+ *   hashTags()[i] is EmptyTag/TombstoneTag/hashTag(key) to match hash[i]
  *   m_hLoad >= m_size, == number of non-Empty hash entries
  *
  * kPackedKind:
@@ -557,6 +577,13 @@ bool HphpArray::checkInvariants() const {
   case kPackedKind:
     assert(m_size == m_used);
     break;
+  case kIntVecKind:
+  case kDblVecKind:
+    assert(m_size == m_used);
+    assert(m_used == 0 ||
+           data()[m_used - 1].data.m_type ==
+             (m_kind == kIntVecKind ? KindOfInt64 : KindOfDouble));
+    break;
   case kMixedKind: {
     assert(m_hash);
     assert(m_hLoad >= m_size);
@@ -699,34 +726,69 @@ static bool hitIntKey(const HphpArray::Elm& e, int64_t ki) {
   return e.ikey == ki && e.hasIntKey();
 }
 
-// Quadratic probe is:
-//
-//   h(k, i) = (k + c1*i + c2*(i^2)) % tableSize
-//
-// Use 1/2 for c1 and c2.  In combination with a table size that is a power of
-// 2, this guarantees a probe sequence of length tableSize that probes all
-// table elements exactly once.
+// Probing is linear, a group of TagGroupSize slots at a time: the tags
+// of a whole group are compared against the key's tag at once (with
+// SSE2 when available), and only slots whose tag matches have their
+// element loaded.  A group containing an Empty slot ends the search;
+// there always is one, because the load factor is kept below 1.
+
+namespace {
+
+// Bit i is set iff tags[i] == tag, for i < TagGroupSize.
+ALWAYS_INLINE uint32_t matchTags(const uint8_t* tags, uint8_t tag) {
+#ifdef __SSE2__
+  auto const group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tags));
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(tag)));
+#else
+  uint32_t bits = 0;
+  for (uint32_t i = 0; i < HphpArray::TagGroupSize; ++i) {
+    bits |= uint32_t(tags[i] == tag) << i;
+  }
+  return bits;
+#endif
+}
+
+// Bit i is set iff slot i is Empty or a Tombstone.
+ALWAYS_INLINE uint32_t matchFree(const uint8_t* tags) {
+  static_assert((HphpArray::EmptyTag & HphpArray::TombstoneTag & 0x80) != 0,
+                "free tags are the ones with the top bit set");
+#ifdef __SSE2__
+  auto const group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tags));
+  return _mm_movemask_epi8(group);
+#else
+  uint32_t bits = 0;
+  for (uint32_t i = 0; i < HphpArray::TagGroupSize; ++i) {
+    bits |= uint32_t(tags[i] >> 7) << i;
+  }
+  return bits;
+#endif
+}
+
+ALWAYS_INLINE size_t firstBit(uint32_t bits) {
+  assert(bits != 0);
+  return __builtin_ctz(bits);
+}
+
+}
 
 template <class Hit> ALWAYS_INLINE
 ssize_t HphpArray::findImpl(size_t h0, Hit hit) const {
-  // tableMask, probeIndex, and pos are explicitly 64-bit, because performance
+  // tableMask, probe, and pos are explicitly 64-bit, because performance
   // regressed when they were 32-bit types via auto.  Test carefully.
   size_t tableMask = m_tableMask;
-  size_t probeIndex = h0 & tableMask;
   auto* elms = data();
   auto* hashtable = m_hash;
-  ssize_t pos = hashtable[probeIndex];
-  if ((validPos(pos) && hit(elms[pos])) || pos == Empty) {
-    return pos;
-  }
-  for (size_t i = 1;; ++i) {
-    assert(i <= tableMask);
-    probeIndex = (probeIndex + i) & tableMask;
-    assert(probeIndex == ((h0 + (i + i*i) / 2) & tableMask));
-    pos = hashtable[probeIndex];
-    if ((validPos(pos) && hit(elms[pos])) || pos == Empty) {
-      return pos;
+  auto* tags = hashTags();
+  auto const tag = hashTag(h0);
+  for (size_t probe = h0 & tableMask;;
+       probe = (probe + TagGroupSize) & tableMask) {
+    auto const group = tags + probe;
+    for (auto bits = matchTags(group, tag); bits; bits &= bits - 1) {
+      ssize_t pos = hashtable[(probe + firstBit(bits)) & tableMask];
+      assert(validPos(pos));
+      if (hit(elms[pos])) return pos;
     }
+    if (matchTags(group, EmptyTag)) return Empty;
   }
 }
 
@@ -759,36 +821,31 @@ int32_t* warnUnbalanced(size_t n, int32_t* ei) {
 
 template <class Hit> ALWAYS_INLINE
 int32_t* HphpArray::findForInsertImpl(size_t h0, Hit hit) const {
-  // tableMask, probeIndex, and pos are explicitly 64-bit, because performance
+  // tableMask, probe, and pos are explicitly 64-bit, because performance
   // regressed when they were 32-bit types via auto.  Test carefully.
   assert(m_hLoad <= computeMaxElms(m_tableMask));
   size_t tableMask = m_tableMask;
   auto* elms = data();
   auto* hashtable = m_hash;
+  auto* tags = hashTags();
+  auto const tag = hashTag(h0);
   int32_t* ret = nullptr;
-  size_t probeIndex = h0 & tableMask;
-  auto* ei = &hashtable[probeIndex];
-  ssize_t pos = *ei;
-  if ((validPos(pos) && hit(elms[pos])) || pos == Empty) {
-    return ei;
-  }
-  if (!validPos(pos)) ret = ei;
-  for (size_t i = 1;; ++i) {
-    assert(i <= tableMask);
-    probeIndex = (probeIndex + i) & tableMask;
-    assert(probeIndex == ((h0 + (i + i*i) / 2) & tableMask));
-    ei = &hashtable[probeIndex];
-    pos = *ei;
-    if (validPos(pos)) {
-      if (hit(elms[pos])) {
-        return ei;
-      }
-    } else {
-      if (!ret) ret = ei;
-      if (pos == Empty) {
-        return LIKELY(i <= 100) ? ret : warnUnbalanced(i, ret);
+  for (size_t probe = h0 & tableMask, n = 0;;
+       probe = (probe + TagGroupSize) & tableMask, n += TagGroupSize) {
+    auto const group = tags + probe;
+    for (auto bits = matchTags(group, tag); bits; bits &= bits - 1) {
+      auto* ei = &hashtable[(probe + firstBit(bits)) & tableMask];
+      assert(validPos(*ei));
+      if (hit(elms[*ei])) return ei;
+    }
+    if (!ret) {
+      if (auto const free = matchFree(group)) {
+        ret = &hashtable[(probe + firstBit(free)) & tableMask];
       }
     }
+    if (matchTags(group, EmptyTag)) {
+      return LIKELY(n <= 100) ? ret : warnUnbalanced(n, ret);
+    }
   }
 }
 
@@ -817,6 +874,7 @@ HphpArray::InsertPos HphpArray::insert(int64_t k) {
     return InsertPos(true, data()[*ei].data);
   }
   if (k >= m_nextKI && m_nextKI >= 0) m_nextKI = k + 1;
+  setHashTag(ei, hashTag(k));
   auto& e = allocElm(ei);
   e.setIntKey(k);
   return InsertPos(false, e.data);
@@ -829,6 +887,7 @@ HphpArray::InsertPos HphpArray::insert(StringData* k) {
   if (validPos(*ei)) {
     return InsertPos(true, data()[*ei].data);
   }
+  setHashTag(ei, hashTag(h));
   auto& e = allocElm(ei);
   e.setStrKey(k, h);
   return InsertPos(false, e.data);
@@ -840,24 +899,25 @@ ssize_t HphpArray::findForRemoveImpl(size_t h0, Hit hit, Remove remove) const {
   size_t mask = m_tableMask;
   auto* elms = data();
   auto* hashtable = m_hash;
-  for (size_t i = 1, probe = h0;; ++i) {
-    auto* ei = &hashtable[probe & mask];
-    ssize_t pos = *ei;
-    if (validPos(pos)) {
+  auto* tags = hashTags();
+  auto const tag = hashTag(h0);
+  for (size_t probe = h0 & mask;; probe = (probe + TagGroupSize) & mask) {
+    auto const group = tags + probe;
+    for (auto bits = matchTags(group, tag); bits; bits &= bits - 1) {
+      auto* ei = &hashtable[(probe + firstBit(bits)) & mask];
+      ssize_t pos = *ei;
+      assert(validPos(pos));
       if (hit(elms[pos])) {
         remove(elms[pos]);
         *ei = Tombstone;
+        setHashTag(ei, TombstoneTag);
         return pos;
       }
-    } else {
-      if (pos == Empty) {
-        // not found, terminate search
-        return pos;
-      }
     }
-    probe += i;
-    assert(probe == (h0 + (i + i*i) / 2));
-    assert(i <= mask);
+    if (matchTags(group, EmptyTag)) {
+      // not found, terminate search
+      return Empty;
+    }
   }
 }
 
@@ -900,15 +960,12 @@ HphpArray::findForRemove(const StringData* s, strhash_t prehash) {
 }
 
 NEVER_INLINE int32_t*
-HphpArray::findForNewInsertLoop(int32_t* table, size_t h0, size_t mask) {
-  /* Quadratic probe. */
-  for (size_t i = 1, probe = h0;; ++i) {
-    assert(i <= mask);
-    probe += i;
-    assert(probe == h0 + ((i + i * i) / 2));
-    auto ei = &table[probe & mask];
-    ssize_t pos = *ei;
-    if (!validPos(pos)) return ei;
+HphpArray::findForNewInsertLoop(const uint8_t* tags, int32_t* table,
+                                size_t h0, size_t mask) {
+  for (size_t probe = h0 & mask;; probe = (probe + TagGroupSize) & mask) {
+    if (auto const free = matchFree(tags + probe)) {
+      return &table[(probe + firstBit(free)) & mask];
+    }
   }
 }
 
@@ -1087,6 +1144,7 @@ HphpArray* HphpArray::Grow(HphpArray* old) {
   assert(HphpArray::Empty == -1);
   memcpy(ad->data(), old->data(), oldUsed * sizeof(Elm));
   memset(ad->m_hash, 0xffU, (mask + 1) * sizeof *ad->m_hash);
+  memset(ad->hashTags(), EmptyTag, computeTagBytes(mask));
 
   // TODO(#2942020): findForNewInsert will reload m_hash and
   // m_tableMask each time through the loop.  A naive attempt to keep
@@ -1136,6 +1194,7 @@ HphpArray* HphpArray::GrowPacked(HphpArray* old) {
   auto const oldStrongIters     = old->m_strongIterators;
 
   ad->m_kindModeAndSize = oldKindModeAndSize;
+  ad->m_cycleRoot       = false; // the zombie keeps its place, if any
   ad->m_posAndCount     = oldPosUnsigned;
   ad->m_strongIterators = oldStrongIters; // could be nullptr
   ad->m_capAndUsed      = uint64_t{oldUsed} << 32 | cap;
@@ -1736,7 +1795,9 @@ ArrayData* HphpArray::AppendPacked(ArrayData* ad, CVarRef v, bool copy) {
   a = copy ? a->copyPackedAndResizeIfNeeded()
            : a->resizePackedIfNeeded();
   auto& tv = a->allocNextElm(a->m_size);
-  return a->initVal(tv, v);
+  a->initVal(tv, v);
+  if (UNLIKELY(a->m_size == 1)) return a->maybePromoteTypedVec();
+  return a;
 }
 
 ArrayData* HphpArray::Append(ArrayData* ad, CVarRef v, bool copy) {
@@ -1859,6 +1920,7 @@ HphpArray* HphpArray::CopyReserve(const HphpArray* src,
 
   assert(Empty == -1);
   memset(hash, 0xffu, (mask + 1) * sizeof *hash);
+  memset(ad->hashTags(), EmptyTag, computeTagBytes(mask));
 
   auto dstElm = data;
   auto srcElm = src->data();
@@ -1930,6 +1992,33 @@ HphpArray* HphpArray::CopyReserve(const HphpArray* src,
   return ad;
 }
 
+/*
+ * Copy a packed array to a new packed array with room for at least
+ * `expectedSize' elements, so the caller can append without regrowing.
+ */
+NEVER_INLINE
+HphpArray* HphpArray::CopyReservePacked(const HphpArray* src,
+                                        size_t expectedSize) {
+  assert(src->isPacked());
+  auto const ad      = MakeReserve(std::max<size_t>(expectedSize,
+                                                    src->m_size));
+  auto const oldSize = src->m_size;
+
+  auto const srcElms = src->data();
+  auto const dstElms = ad->data();
+  for (uint32_t i = 0; i < oldSize; ++i) {
+    tvDupFlattenVars(&srcElms[i].data, &dstElms[i].data, src);
+  }
+  ad->m_size = ad->m_used = oldSize;
+  ad->m_pos  = src->m_pos;
+
+  assert(ad->isPacked());
+  assert(ad->m_count == 1);
+  assert(ad->m_cap >= expectedSize);
+  assert(ad->checkInvariants());
+  return ad;
+}
+
 ArrayData* HphpArray::Plus(ArrayData* ad, const ArrayData* elems) {
   auto const ret = CopyReserve(asHphpArray(ad), ad->size() + elems->size());
 
@@ -1971,6 +2060,91 @@ ArrayData* HphpArray::Merge(ArrayData* ad, const ArrayData* elems) {
   return ret;
 }
 
+/*
+ * Plus on a packed base.  Int keys below the current size are already
+ * present and are skipped, and the key equal to the size is an append,
+ * so the result only escalates to mixed when `elems' has a string key
+ * or leaves a gap.
+ */
+ArrayData* HphpArray::PlusPacked(ArrayData* ad, const ArrayData* elems) {
+  auto ret = CopyReservePacked(asPacked(ad), ad->size() + elems->size());
+
+  if (elems->isPacked()) {
+    auto const src = asPacked(elems);
+    auto const srcElms = src->data();
+    for (uint32_t i = ret->m_size, limit = src->m_size; i < limit; ++i) {
+      auto& tv = ret->allocNextElm(i);
+      ret->initWithRef(tv, tvAsCVarRef(&srcElms[i].data));
+    }
+    return ret;
+  }
+
+  for (ArrayIter it(elems); !it.end(); it.next()) {
+    Variant key = it.first();
+    CVarRef value = it.secondRef();
+    auto tv = key.asTypedValue();
+    if (ret->isPacked()) {
+      if (tv->m_type == KindOfInt64) {
+        auto const k = tv->m_data.num;
+        if (size_t(k) < ret->m_size) continue;
+        if (size_t(k) == ret->m_size) {
+          auto& elm = ret->allocNextElm(k);
+          ret->initWithRef(elm, value);
+          continue;
+        }
+      }
+      ret->packedToMixed();
+    }
+    auto p = tv->m_type == KindOfInt64
+      ? ret->insert(tv->m_data.num)
+      : ret->insert(tv->m_data.pstr);
+    if (!p.found) {
+      ret->initWithRef(p.tv, value);
+    }
+  }
+
+  return ret;
+}
+
+/*
+ * Merge on a packed base.  Every int key of `elems' is renumbered onto
+ * the end, so the result stays packed until the first string key.
+ */
+ArrayData* HphpArray::MergePacked(ArrayData* ad, const ArrayData* elems) {
+  auto ret = CopyReservePacked(asPacked(ad), ad->size() + elems->size());
+
+  if (elems->isPacked()) {
+    auto const src = asPacked(elems);
+    auto const srcElms = src->data();
+    for (uint32_t i = 0, limit = src->m_size; i < limit; ++i) {
+      auto& tv = ret->allocNextElm(ret->m_size);
+      ret->initWithRef(tv, tvAsCVarRef(&srcElms[i].data));
+    }
+    return ret;
+  }
+
+  for (ArrayIter it(elems); !it.end(); it.next()) {
+    Variant key = it.first();
+    CVarRef value = it.secondRef();
+    if (key.asTypedValue()->m_type == KindOfInt64) {
+      if (ret->isPacked()) {
+        auto& tv = ret->allocNextElm(ret->m_size);
+        ret->initWithRef(tv, value);
+      } else {
+        ret->nextInsertWithRef(value);
+      }
+    } else {
+      if (ret->isPacked()) ret->packedToMixed();
+      Variant* p;
+      StringData* sd = key.getStringData();
+      ret->addLvalImpl(sd, p);
+      p->setWithRef(value);
+    }
+  }
+
+  return ret;
+}
+
 ArrayData* HphpArray::PopPacked(ArrayData* ad, Variant& value) {
   auto a = asPacked(ad);
   if (a->getCount() > 1) a = a->copyPacked();
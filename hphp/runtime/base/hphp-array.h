@@ -192,7 +192,9 @@ public:
   static ArrayData* AppendWithRef(ArrayData*, CVarRef v, bool copy);
   static ArrayData* AppendWithRefPacked(ArrayData*, CVarRef v, bool copy);
   static ArrayData* Plus(ArrayData*, const ArrayData* elems);
+  static ArrayData* PlusPacked(ArrayData*, const ArrayData* elems);
   static ArrayData* Merge(ArrayData*, const ArrayData* elems);
+  static ArrayData* MergePacked(ArrayData*, const ArrayData* elems);
   static ArrayData* Pop(ArrayData*, Variant& value);
   static ArrayData* PopPacked(ArrayData*, Variant& value);
   static ArrayData* Dequeue(ArrayData*, Variant& value);
@@ -247,6 +249,70 @@ public:
   static TypedValue GetCellIntPacked(const ArrayData* ad, int64_t ki);
   static uint64_t IssetIntPacked(const ArrayData* ad, int64_t ki);
 
+  /*
+   * Typed vectors (kIntVecKind, kDblVecKind) use the packed layout but
+   * promise every value is an int (resp. double) cell.  Reads and
+   * type-preserving writes stay in place; anything else demotes the
+   * array to kPackedKind, which only rewrites m_kind, and then runs the
+   * packed implementation.  See hphp-array-typed.cpp.
+   */
+  static void ReleaseTypedVec(ArrayData*);
+  static TypedValue* NvGetIntTypedVec(const ArrayData*, int64_t ki);
+  static TypedValue* NvGetStrTypedVec(const ArrayData*, const StringData* k);
+  static void NvGetKeyTypedVec(const ArrayData*, TypedValue* out,
+                               ssize_t pos);
+  static ArrayData* SetIntTypedVec(ArrayData*, int64_t k, CVarRef v,
+                                   bool copy);
+  static ArrayData* SetStrTypedVec(ArrayData*, StringData* k, CVarRef v,
+                                   bool copy);
+  static CVarRef GetValueRefTypedVec(const ArrayData*, ssize_t pos);
+  static bool ExistsIntTypedVec(const ArrayData*, int64_t k);
+  static bool ExistsStrTypedVec(const ArrayData*, const StringData* k);
+  static ArrayData* LvalIntTypedVec(ArrayData*, int64_t k, Variant*& ret,
+                                    bool copy);
+  static ArrayData* LvalStrTypedVec(ArrayData*, StringData* k, Variant*& ret,
+                                    bool copy);
+  static ArrayData* LvalNewTypedVec(ArrayData*, Variant*& ret, bool copy);
+  static ArrayData* SetRefIntTypedVec(ArrayData*, int64_t k, CVarRef v,
+                                      bool copy);
+  static ArrayData* SetRefStrTypedVec(ArrayData*, StringData* k, CVarRef v,
+                                      bool copy);
+  static ArrayData* AddIntTypedVec(ArrayData*, int64_t k, CVarRef v,
+                                   bool copy);
+  static ArrayData* RemoveIntTypedVec(ArrayData*, int64_t k, bool copy);
+  static ArrayData* RemoveStrTypedVec(ArrayData*, const StringData* k,
+                                      bool copy);
+  static ssize_t IterBeginTypedVec(const ArrayData*);
+  static ssize_t IterEndTypedVec(const ArrayData*);
+  static ssize_t IterAdvanceTypedVec(const ArrayData*, ssize_t pos);
+  static ssize_t IterRewindTypedVec(const ArrayData*, ssize_t pos);
+  static bool ValidFullPosTypedVec(const ArrayData*, const FullPos& fp);
+  static bool AdvanceFullPosTypedVec(ArrayData*, FullPos& fp);
+  static ArrayData* EscalateForSortTypedVec(ArrayData*);
+  static void KsortTypedVec(ArrayData*, int sort_flags, bool ascending);
+  static void SortTypedVec(ArrayData*, int sort_flags, bool ascending);
+  static void AsortTypedVec(ArrayData*, int sort_flags, bool ascending);
+  static void UksortTypedVec(ArrayData*, CVarRef cmp_function);
+  static void UsortTypedVec(ArrayData*, CVarRef cmp_function);
+  static void UasortTypedVec(ArrayData*, CVarRef cmp_function);
+  static ArrayData* CopyTypedVec(const ArrayData*);
+  static ArrayData* CopyWithStrongIteratorsTypedVec(const ArrayData*);
+  static ArrayData* NonSmartCopyTypedVec(const ArrayData*);
+  static ArrayData* AppendTypedVec(ArrayData*, CVarRef v, bool copy);
+  static ArrayData* AppendRefTypedVec(ArrayData*, CVarRef v, bool copy);
+  static ArrayData* AppendWithRefTypedVec(ArrayData*, CVarRef v, bool copy);
+  static ArrayData* PlusTypedVec(ArrayData*, const ArrayData* elems);
+  static ArrayData* MergeTypedVec(ArrayData*, const ArrayData* elems);
+  static ArrayData* PopTypedVec(ArrayData*, Variant& value);
+  static ArrayData* DequeueTypedVec(ArrayData*, Variant& value);
+  static ArrayData* PrependTypedVec(ArrayData*, CVarRef v, bool copy);
+  static void RenumberTypedVec(ArrayData*);
+  static void OnSetEvalScalarTypedVec(ArrayData*);
+
+  // Called from the TC once the base is known to be a typed vector; the
+  // result is an int (resp. double) or, on a miss, null.
+  static TypedValue GetCellIntTypedVec(const ArrayData* ad, int64_t ki);
+
   /*
    * Sorting routines.
    */
@@ -272,6 +338,13 @@ public:
   static const int32_t Empty      = -1; // == ArrayData::invalid_index
   static const int32_t Tombstone  = -2;
 
+  // Every hash slot also has a one-byte tag (see hashTags()).  Live
+  // slots hold a 7-bit fingerprint of the key's hash; free slots have
+  // the top bit set.  Probes compare TagGroupSize tags at a time.
+  static const uint32_t TagGroupSize = 16;
+  static const uint8_t EmptyTag      = 0x80;
+  static const uint8_t TombstoneTag  = 0xfe;
+
   // Use a minimum of an 4-element hash table.  Valid range: [2..32]
   static const uint32_t MinLgTableSize = 2;
   static const uint32_t SmallHashSize = 1 << MinLgTableSize;
@@ -293,9 +366,11 @@ public:
   static size_t computeTableSize(uint32_t tableMask);
   static size_t computeMaxElms(uint32_t tableMask);
   static size_t computeDataSize(uint32_t tableMask);
+  static size_t computeTagBytes(uint32_t tableMask);
 
 private:
   friend class ArrayInit;
+  friend class SliceArray;
   friend struct MemoryProfile;
   struct EmptyArrayInitializer;
   enum class ClonePacked {};
@@ -313,6 +388,14 @@ private:
   static const HphpArray* asMixed(const ArrayData* ad);
   static HphpArray* asHphpArray(ArrayData* ad);
   static const HphpArray* asHphpArray(const ArrayData* ad);
+  static HphpArray* asTypedVec(ArrayData* ad);
+  static const HphpArray* asTypedVec(const ArrayData* ad);
+
+  // Typed vector helpers; see hphp-array-typed.cpp.
+  static bool fitsTypedVec(ArrayKind kind, CVarRef v);
+  static ArrayData* retagTypedVec(ArrayData* ad, ArrayKind kind);
+  static HphpArray* demoteTypedVec(ArrayData* ad, bool copy);
+  HphpArray* maybePromoteTypedVec();
 
   static void getElmKey(const Elm& e, TypedValue* out);
 
@@ -320,6 +403,8 @@ private:
   static HphpArray* CopyPacked(const HphpArray& other, AllocationMode);
   static HphpArray* CopyMixed(const HphpArray& other, AllocationMode);
   static HphpArray* CopyReserve(const HphpArray* src, size_t expectedSize);
+  static HphpArray* CopyReservePacked(const HphpArray* src,
+                                      size_t expectedSize);
 
   HphpArray() = delete;
   HphpArray(const HphpArray&) = delete;
@@ -384,8 +469,15 @@ private:
    * put the array into a bad state; use with caution.
    */
   int32_t* findForNewInsert(size_t h0) const;
-  static int32_t* findForNewInsertLoop(int32_t* table, size_t h0,
-                                       size_t mask);
+  static int32_t* findForNewInsertLoop(const uint8_t* tags, int32_t* table,
+                                       size_t h0, size_t mask);
+
+  // The tag array lives right after m_hash: one byte per slot, then a
+  // copy of the first TagGroupSize tags (repeated for tables smaller
+  // than that) so a group load starting at any slot never wraps.
+  static uint8_t hashTag(size_t h0);
+  uint8_t* hashTags() const;
+  void setHashTag(const int32_t* ei, uint8_t tag) const;
 
   bool nextInsert(CVarRef data);
   ArrayData* nextInsertRef(CVarRef data);
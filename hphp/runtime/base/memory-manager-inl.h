@@ -171,6 +171,12 @@ inline bool MemoryManager::sweeping() {
   return !TlsWrapper::isNull() && MM().m_sweeping;
 }
 
+inline bool MemoryManager::arenaMode() const { return m_arena; }
+
+inline void MemoryManager::setCollectThreshold(int64_t bytes) {
+  m_collectThreshold = bytes;
+}
+
 inline void* MemoryManager::smartMallocSize(uint32_t bytes) {
   assert(bytes > 0);
   assert(bytes <= kMaxSmartSize);
@@ -181,6 +187,7 @@ inline void* MemoryManager::smartMallocSize(uint32_t bytes) {
 
   unsigned i = (bytes - 1) >> kLgSizeQuantum;
   assert(i < kNumSizes);
+  if (UNLIKELY(m_profiling)) profileAlloc(i);
   void* p = m_sizeUntrackedFree[i].maybePop();
   if (UNLIKELY(p == nullptr)) {
     p = slabAlloc(debugAddExtra(MemoryManager::smartSizeClass(bytes)));
@@ -188,7 +195,9 @@ inline void* MemoryManager::smartMallocSize(uint32_t bytes) {
   assert(reinterpret_cast<uintptr_t>(p) % 16 == 0);
 
   FTRACE(1, "smartMallocSize: {} -> {}\n", bytes, p);
-  return debugPostAllocate(p, bytes, bytes);
+  auto const ret = debugPostAllocate(p, bytes, bytes);
+  if (UNLIKELY((m_sampleCountdown -= bytes) < 0)) sampleAlloc(ret, bytes);
+  return ret;
 }
 
 inline void MemoryManager::smartFreeSize(void* ptr, uint32_t bytes) {
@@ -198,8 +207,18 @@ inline void MemoryManager::smartFreeSize(void* ptr, uint32_t bytes) {
 
   unsigned i = (bytes - 1) >> kLgSizeQuantum;
   assert(i < kNumSizes);
-  m_sizeUntrackedFree[i].push(debugPreFree(ptr, bytes, bytes));
   m_stats.usage -= bytes;
+  if (UNLIKELY(m_profiling)) profileFree(i);
+  if (UNLIKELY(m_sampleFilter & HeapSampler::filterBit(ptr))) {
+    sampleFree(ptr);
+  }
+  if (UNLIKELY(m_arena)) {
+    // The block stays dead until resetAllocator() drops its slab.
+    debugPreFree(ptr, bytes, bytes);
+    FTRACE(1, "smartFreeSize: {} ({} bytes, arena)\n", ptr, bytes);
+    return;
+  }
+  m_sizeUntrackedFree[i].push(debugPreFree(ptr, bytes, bytes));
 
   FTRACE(1, "smartFreeSize: {} ({} bytes)\n", ptr, bytes);
 }
@@ -226,6 +245,9 @@ std::pair<void*,size_t> MemoryManager::smartMallocSizeBig(size_t bytes) {
 ALWAYS_INLINE
 void MemoryManager::smartFreeSizeBig(void* vp, size_t bytes) {
   m_stats.usage -= bytes;
+  if (UNLIKELY(m_sampleFilter & HeapSampler::filterBit(vp))) {
+    sampleFree(vp);
+  }
   FTRACE(1, "smartFreeBig: {} ({} bytes)\n", vp, bytes);
   return smartFreeBig(static_cast<SweepNode*>(debugPreFree(vp, bytes, 0)) - 1);
 }
@@ -235,7 +257,9 @@ void MemoryManager::smartFreeSizeBig(void* vp, size_t bytes) {
 ALWAYS_INLINE
 void* MemoryManager::objMalloc(size_t size) {
   if (LIKELY(size <= kMaxSmartSize)) return smartMallocSize(size);
-  return smartMallocSizeBig(size).first;
+  auto const ret = smartMallocSizeBig(size).first;
+  if (UNLIKELY((m_sampleCountdown -= size) < 0)) sampleAlloc(ret, size);
+  return ret;
 }
 
 ALWAYS_INLINE
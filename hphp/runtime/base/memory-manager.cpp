@@ -24,14 +24,19 @@
 #define __STDC_LIMIT_MACROS
 
 #include <algorithm>
+#include <atomic>
 #include <cstdint>
 
+#include <sys/mman.h>
+
 #include "hphp/runtime/base/sweepable.h"
 #include "hphp/runtime/base/memory-profile.h"
 #include "hphp/runtime/base/builtin-functions.h"
 #include "hphp/runtime/base/runtime-option.h"
 #include "hphp/runtime/server/http-server.h"
 #include "hphp/util/alloc.h"
+#include "hphp/util/lock.h"
+#include "hphp/util/maphuge.h"
 #include "hphp/util/process.h"
 #include "hphp/util/trace.h"
 #include "folly/ScopeGuard.h"
@@ -167,7 +172,14 @@ void MemoryManager::OnThreadExit(MemoryManager* mm) {
 MemoryManager::MemoryManager()
     : m_front(nullptr)
     , m_limit(nullptr)
-    , m_sweeping(false) {
+    , m_sweeping(false)
+    , m_arena(false)
+    , m_profiling(false)
+    , m_node(0)
+    , m_allocmFlags(0)
+    , m_collectThreshold(0)
+    , m_sampleCountdown(std::numeric_limits<int64_t>::max())
+    , m_sampleFilter(0) {
 #ifdef USE_JEMALLOC
   threadStats(m_allocated, m_deallocated, m_cactive, m_cactiveLimit);
 #endif
@@ -176,6 +188,14 @@ MemoryManager::MemoryManager()
   // make the circular-lists empty.
   m_sweep.next = m_sweep.prev = &m_sweep;
   m_strings.next = m_strings.prev = &m_strings;
+  memset(&m_heapStats, 0, sizeof m_heapStats);
+}
+
+MemoryManager::~MemoryManager() {
+  // Normally only the slab kept by an arena-mode resetAllocator() and
+  // the retained slabs are left at this point.
+  for (auto slab : m_slabs) freeSlab(slab);
+  for (auto slab : m_retainedSlabs) freeSlab(slab);
 }
 
 void MemoryManager::resetStats() {
@@ -193,6 +213,27 @@ void MemoryManager::resetStats() {
 #endif
 }
 
+void MemoryManager::resetRuntimeOptions() {
+  // Safe to flip at any time: blocks freed in arena mode are simply
+  // never reused, and the free lists stay valid in either mode.
+  m_arena = RuntimeOption::EvalSmartHeapArena;
+  m_profiling = RuntimeOption::EvalProfileSmartHeap;
+
+  // Threads are bound to their node before they serve requests, and
+  // stay there.
+  m_node = Util::s_numaNode;
+  assert(m_node >= 0 && m_node < kMaxNumaNodes);
+  m_allocmFlags = 0;
+#ifdef USE_JEMALLOC
+  auto const arena = Util::numa_node_arena(m_node);
+  if (arena >= 0) m_allocmFlags = ALLOCM_ARENA(arena);
+#endif
+
+  m_sampleCountdown = HeapSampler::enabled() ?
+    HeapSampler::s_sampler->nextInterval() :
+    std::numeric_limits<int64_t>::max();
+}
+
 NEVER_INLINE
 void MemoryManager::refreshStatsHelper() {
   refreshStats();
@@ -203,6 +244,14 @@ void MemoryManager::refreshStatsHelperExceeded() const {
   info->m_reqInjectionData.setMemExceededFlag();
 }
 
+void MemoryManager::checkCollectThreshold() {
+  if (m_collectThreshold && m_stats.usage > m_collectThreshold) {
+    m_collectThreshold = 0;
+    ThreadInfo::s_threadInfo.getNoCheck()->
+      m_reqInjectionData.setCycleCollectFlag();
+  }
+}
+
 #ifdef USE_JEMALLOC
 void MemoryManager::refreshStatsHelperStop() {
   HttpServer::Server->stop();
@@ -221,10 +270,25 @@ void MemoryManager::sweep() {
 
 void MemoryManager::resetAllocator() {
   StringData::sweepAll();
-
-  // free smart-malloc slabs
+  if (m_profiling) profileFinish();
+  if (!HeapSampler::s_sampler.isNull()) HeapSampler::s_sampler->requestEnd();
+  m_sampleFilter = 0;
+
+  // free smart-malloc slabs.  In arena mode we hang on to the first
+  // one and rewind into it, so the next request on this thread
+  // starts out with a warm slab instead of a fresh malloc.  Up to
+  // Eval.SmartHeapRetainBytes of the rest stay with this thread, and
+  // anything beyond that goes back to the node pool.
+  char* keep = m_arena && !m_slabs.empty() ? m_slabs.front() : nullptr;
+  auto const maxRetained =
+    RuntimeOption::EvalSmartHeapRetainBytes / SLAB_SIZE;
   for (auto slab : m_slabs) {
-    free(slab);
+    if (slab == keep) continue;
+    if (m_retainedSlabs.size() < maxRetained) {
+      m_retainedSlabs.push_back(slab);
+    } else {
+      releaseSlab(slab);
+    }
   }
   m_slabs.clear();
 
@@ -238,7 +302,13 @@ void MemoryManager::resetAllocator() {
   // zero out freelists
   for (auto& i : m_sizeUntrackedFree) i.head = nullptr;
   for (auto& i : m_sizeTrackedFree)   i.head = nullptr;
-  m_front = m_limit = 0;
+  if (keep) {
+    m_slabs.push_back(keep);
+    m_front = keep;
+    m_limit = keep + SLAB_SIZE;
+  } else {
+    m_front = m_limit = 0;
+  }
 }
 
 /*
@@ -278,7 +348,8 @@ void MemoryManager::resetAllocator() {
  *
  * When small blocks are freed (case b and c), they're placed the
  * appropriate size-segregated freelist.  Large blocks are immediately
- * passed back to libc via free.
+ * passed back to libc via free.  (In arena mode small frees skip the
+ * freelist entirely; see MemoryManager::arenaMode.)
  *
  * There are currently two kinds of freelist entries: entries where
  * there is already a valid SmallNode on the list (case b), and
@@ -301,6 +372,7 @@ inline void* MemoryManager::smartMalloc(size_t nbytes) {
 
   auto const idx = (nbytes - 1) >> kLgSizeQuantum;
   assert(idx < kNumSizes && idx >= 0);
+  if (UNLIKELY(m_profiling)) profileAlloc(idx);
   void* vp = m_sizeTrackedFree[idx].maybePop();
   if (UNLIKELY(vp == nullptr)) {
     return smartMallocSlab(nbytes);
@@ -319,8 +391,9 @@ inline void MemoryManager::smartFree(void* ptr) {
     auto const idx = (padbytes - 1) >> kLgSizeQuantum;
     assert(idx < kNumSizes && idx >= 0);
     FTRACE(1, "smartFree: {}\n", ptr);
-    m_sizeTrackedFree[idx].push(ptr);
     m_stats.usage -= padbytes;
+    if (UNLIKELY(m_profiling)) profileFree(idx);
+    if (LIKELY(!m_arena)) m_sizeTrackedFree[idx].push(ptr);
     return;
   }
   smartFreeBig(n);
@@ -369,13 +442,14 @@ NEVER_INLINE char* MemoryManager::newSlab(size_t nbytes) {
   if (UNLIKELY(m_stats.usage > m_stats.maxBytes)) {
     refreshStatsHelper();
   }
-  char* slab = (char*) Util::safe_malloc(SLAB_SIZE);
+  checkCollectThreshold();
+  char* slab = takeSlab();
   assert(uintptr_t(slab) % 16 == 0);
-  JEMALLOC_STATS_ADJUST(&m_stats, SLAB_SIZE);
   m_stats.alloc += SLAB_SIZE;
   if (m_stats.alloc > m_stats.peakAlloc) {
     m_stats.peakAlloc = m_stats.alloc;
   }
+  if (UNLIKELY(m_profiling)) profileSlab();
   m_slabs.push_back(slab);
   m_front = slab + nbytes;
   m_limit = slab + SLAB_SIZE;
@@ -385,6 +459,174 @@ NEVER_INLINE char* MemoryManager::newSlab(size_t nbytes) {
   return slab;
 }
 
+/*
+ * Per-node slab pools, used only when threads are spread over more
+ * than one numa node; with a single node the thread-retained slabs
+ * already cover reuse, and a shared pool would only add contention.
+ * Every slab in s_slabPools[n] came from node n's arena.
+ *
+ * A pool is a fixed array of slots that threads claim and fill with
+ * atomic exchanges, so taking or returning a slab never blocks.  The
+ * low bit of a slot marks a slab mapped from hugetlbfs, which has to be
+ * munmapped rather than freed.
+ */
+namespace {
+constexpr uint32_t kMaxPooledSlabs = 64;
+constexpr uintptr_t kHugetlbBit = 1;
+
+struct SlabPool {
+  std::atomic<uintptr_t> slots[kMaxPooledSlabs];
+  std::atomic<int64_t> fresh;
+  std::atomic<int64_t> hugetlb;
+  std::atomic<int64_t> thp;
+  std::atomic<int64_t> reused;
+  std::atomic<int64_t> released;
+  std::atomic<int64_t> pooled;
+} __attribute__((aligned(64)));
+SlabPool s_slabPools[MemoryManager::kMaxNumaNodes];
+
+bool useSlabPools() {
+  return Util::num_numa_nodes() > 1;
+}
+
+void bump(std::atomic<int64_t>& counter, int64_t n = 1) {
+  counter.fetch_add(n, std::memory_order_relaxed);
+}
+}
+
+char* MemoryManager::takeSlab() {
+  if (!m_retainedSlabs.empty()) {
+    auto const slab = m_retainedSlabs.back();
+    m_retainedSlabs.pop_back();
+    return slab;
+  }
+  auto& pool = s_slabPools[m_node];
+  if (useSlabPools() && pool.pooled.load(std::memory_order_relaxed) > 0) {
+    for (auto& slot : pool.slots) {
+      if (!slot.load(std::memory_order_relaxed)) continue;
+      auto const bits = slot.exchange(0, std::memory_order_acquire);
+      if (!bits) continue;
+      bump(pool.pooled, -1);
+      bump(pool.reused);
+      auto const slab = reinterpret_cast<char*>(bits & ~kHugetlbBit);
+      if (bits & kHugetlbBit) m_hugetlbSlabs.insert(slab);
+      return slab;
+    }
+  }
+  bump(pool.fresh);
+  if (RuntimeOption::EvalSmartHeapHugePages) return newHugeSlab();
+  JEMALLOC_STATS_ADJUST(&m_stats, SLAB_SIZE);
+  return static_cast<char*>(nodeMalloc(SLAB_SIZE, false));
+}
+
+/*
+ * Back a slab with a 2MB huge page: from the hugetlbfs pool if it has
+ * one to spare, otherwise a 2MB-aligned block that transparent huge
+ * pages can back.
+ */
+char* MemoryManager::newHugeSlab() {
+  static_assert(SLAB_SIZE == 2 << 20, "slabs must be one huge page");
+  auto& pool = s_slabPools[m_node];
+#ifdef MAP_HUGETLB
+  void* mem = mmap(nullptr, SLAB_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (mem != MAP_FAILED) {
+    auto const slab = static_cast<char*>(mem);
+    m_hugetlbSlabs.insert(slab);
+    bump(pool.hugetlb);
+    return slab;
+  }
+#endif
+  void* block;
+#ifdef USE_JEMALLOC
+  if (allocm(&block, nullptr, SLAB_SIZE,
+             m_allocmFlags | ALLOCM_ALIGN(SLAB_SIZE)) != ALLOCM_SUCCESS) {
+    throw OutOfMemoryException(SLAB_SIZE);
+  }
+#else
+  if (posix_memalign(&block, SLAB_SIZE, SLAB_SIZE)) {
+    throw OutOfMemoryException(SLAB_SIZE);
+  }
+#endif
+  JEMALLOC_STATS_ADJUST(&m_stats, SLAB_SIZE);
+  hintHuge(block, SLAB_SIZE);
+  bump(pool.thp);
+  return static_cast<char*>(block);
+}
+
+void MemoryManager::freeSlab(char* slab) {
+  if (!m_hugetlbSlabs.empty() && m_hugetlbSlabs.erase(slab)) {
+    munmap(slab, SLAB_SIZE);
+    return;
+  }
+  free(slab);
+}
+
+void MemoryManager::releaseSlab(char* slab) {
+  auto& pool = s_slabPools[m_node];
+  if (useSlabPools()) {
+    auto const cap = std::min(RuntimeOption::EvalSmartHeapSlabsPerNode,
+                              kMaxPooledSlabs);
+    if (pool.pooled.load(std::memory_order_relaxed) < cap) {
+      auto bits = reinterpret_cast<uintptr_t>(slab);
+      if (!m_hugetlbSlabs.empty() && m_hugetlbSlabs.erase(slab)) {
+        bits |= kHugetlbBit;
+      }
+      for (uint32_t i = 0; i < cap; ++i) {
+        uintptr_t empty = 0;
+        if (pool.slots[i].compare_exchange_strong(empty, bits,
+                                                  std::memory_order_release)) {
+          bump(pool.pooled);
+          return;
+        }
+      }
+      if (bits & kHugetlbBit) m_hugetlbSlabs.insert(slab);
+    }
+  }
+  bump(pool.released);
+  freeSlab(slab);
+}
+
+void MemoryManager::flushRetainedSlabs() {
+  FTRACE(1, "flushRetainedSlabs: {} slabs\n", m_retainedSlabs.size());
+  for (auto slab : m_retainedSlabs) freeSlab(slab);
+  m_retainedSlabs.clear();
+}
+
+std::array<MemoryManager::NodeSlabStats,MemoryManager::kMaxNumaNodes>
+MemoryManager::getNodeSlabStats() {
+  std::array<NodeSlabStats,kMaxNumaNodes> ret;
+  for (int i = 0; i < kMaxNumaNodes; ++i) {
+    auto const& pool = s_slabPools[i];
+    auto& ns = ret[i];
+    ns.fresh = pool.fresh.load(std::memory_order_relaxed);
+    ns.hugetlb = pool.hugetlb.load(std::memory_order_relaxed);
+    ns.thp = pool.thp.load(std::memory_order_relaxed);
+    ns.reused = pool.reused.load(std::memory_order_relaxed);
+    ns.released = pool.released.load(std::memory_order_relaxed);
+    ns.pooled = pool.pooled.load(std::memory_order_relaxed);
+  }
+  return ret;
+}
+
+/*
+ * malloc from this thread's node arena, if it has one.  Blocks are
+ * still released with plain free().
+ */
+void* MemoryManager::nodeMalloc(size_t nbytes, bool zero) {
+#ifdef USE_JEMALLOC
+  if (m_allocmFlags) {
+    void* p;
+    if (allocm(&p, nullptr, nbytes,
+               m_allocmFlags | (zero ? ALLOCM_ZERO : 0)) != ALLOCM_SUCCESS) {
+      throw OutOfMemoryException(nbytes);
+    }
+    return p;
+  }
+#endif
+  return zero ? Util::safe_calloc(nbytes, 1) : Util::safe_malloc(nbytes);
+}
+
 // allocate nbytes from the current slab, aligned to 16-bytes
 void* MemoryManager::slabAlloc(size_t nbytes) {
   const size_t kAlignMask = 15;
@@ -410,6 +652,7 @@ inline void* MemoryManager::smartEnlist(SweepNode* n) {
   if (UNLIKELY(m_stats.usage > m_stats.maxBytes)) {
     refreshStatsHelper();
   }
+  if (UNLIKELY(m_collectThreshold != 0)) checkCollectThreshold();
   // link after m_sweep
   SweepNode* next = m_sweep.next;
   n->next = next;
@@ -423,7 +666,7 @@ NEVER_INLINE
 void* MemoryManager::smartMallocBig(size_t nbytes) {
   assert(nbytes > 0);
   auto const n = static_cast<SweepNode*>(
-    Util::safe_malloc(nbytes + sizeof(SweepNode) - sizeof(SmallNode))
+    nodeMalloc(nbytes + sizeof(SweepNode) - sizeof(SmallNode), false)
   );
   return smartEnlist(n);
 }
@@ -434,7 +677,8 @@ void* MemoryManager::smartMallocSizeBigHelper(void*& ptr,
                                               size_t& szOut,
                                               size_t bytes) {
   m_stats.usage += bytes;
-  allocm(&ptr, &szOut, debugAddExtra(bytes + sizeof(SweepNode)), 0);
+  allocm(&ptr, &szOut, debugAddExtra(bytes + sizeof(SweepNode)),
+         m_allocmFlags);
   szOut = debugRemoveExtra(szOut - sizeof(SweepNode));
   return debugPostAllocate(
     smartEnlist(static_cast<SweepNode*>(ptr)),
@@ -448,7 +692,7 @@ NEVER_INLINE
 void* MemoryManager::smartCallocBig(size_t totalbytes) {
   assert(totalbytes > 0);
   auto const n = static_cast<SweepNode*>(
-    Util::safe_calloc(totalbytes + sizeof(SweepNode), 1)
+    nodeMalloc(totalbytes + sizeof(SweepNode), true)
   );
   return smartEnlist(n);
 }
@@ -462,6 +706,99 @@ void MemoryManager::smartFreeBig(SweepNode* n) {
   free(n);
 }
 
+//////////////////////////////////////////////////////////////////////
+// Heap sampling; see HeapSampler.
+
+NEVER_INLINE
+void MemoryManager::sampleAlloc(void* ptr, size_t bytes) {
+  auto& sampler = *HeapSampler::s_sampler;
+  m_sampleCountdown = sampler.nextInterval();
+  sampler.recordAlloc(ptr, bytes);
+  m_sampleFilter |= HeapSampler::filterBit(ptr);
+}
+
+NEVER_INLINE
+void MemoryManager::sampleFree(void* ptr) {
+  auto& sampler = *HeapSampler::s_sampler;
+  if (sampler.recordFree(ptr)) m_sampleFilter = sampler.liveFilter();
+}
+
+//////////////////////////////////////////////////////////////////////
+// Smart heap profile.
+
+static SimpleMutex s_heapStatsLock;
+static MemoryManager::SmartHeapStats s_heapStats;
+
+NEVER_INLINE
+void MemoryManager::profileAlloc(unsigned idx) {
+  auto& sz = m_heapStats.sizes[idx];
+  ++sz.allocs;
+  sz.liveBytes += (idx + 1) << kLgSizeQuantum;
+  if (sz.liveBytes > sz.peakBytes) sz.peakBytes = sz.liveBytes;
+}
+
+NEVER_INLINE
+void MemoryManager::profileFree(unsigned idx) {
+  auto& sz = m_heapStats.sizes[idx];
+  ++sz.frees;
+  sz.liveBytes -= (idx + 1) << kLgSizeQuantum;
+}
+
+// Called when we give up on the current slab for a new one.
+void MemoryManager::profileSlab() {
+  m_heapStats.slabWastedBytes += m_limit - m_front;
+}
+
+/*
+ * Fold this request's counters into the process-wide totals, and
+ * start over for the next request.  Must run before the slabs and
+ * free lists are released.
+ */
+void MemoryManager::profileFinish() {
+  auto& hs = m_heapStats;
+  hs.requests = 1;
+  hs.slabs = m_slabs.size();
+  hs.slabBytes = hs.slabs * SLAB_SIZE;
+  hs.slabWastedBytes += m_limit - m_front;
+  for (unsigned i = 0; i < kNumSizes; ++i) {
+    int64_t n = 0;
+    for (auto p = m_sizeUntrackedFree[i].head; p; p = p->next) ++n;
+    for (auto p = m_sizeTrackedFree[i].head; p; p = p->next) ++n;
+    hs.sizes[i].freeListBytes = n * ((i + 1) << kLgSizeQuantum);
+  }
+
+  {
+    SimpleLock lock(s_heapStatsLock);
+    s_heapStats.requests += hs.requests;
+    s_heapStats.slabs += hs.slabs;
+    s_heapStats.slabBytes += hs.slabBytes;
+    s_heapStats.slabWastedBytes += hs.slabWastedBytes;
+    for (unsigned i = 0; i < kNumSizes; ++i) {
+      auto& from = hs.sizes[i];
+      auto& to = s_heapStats.sizes[i];
+      to.allocs += from.allocs;
+      to.frees += from.frees;
+      to.liveBytes += from.liveBytes;
+      to.freeListBytes += from.freeListBytes;
+      to.peakBytes = std::max(to.peakBytes, from.peakBytes);
+    }
+  }
+
+  memset(&hs, 0, sizeof hs);
+}
+
+MemoryManager::SmartHeapStats MemoryManager::getSmartHeapStats() {
+  SimpleLock lock(s_heapStatsLock);
+  return s_heapStats;
+}
+
+void MemoryManager::resetSmartHeapStats() {
+  SimpleLock lock(s_heapStatsLock);
+  memset(&s_heapStats, 0, sizeof s_heapStats);
+}
+
+//////////////////////////////////////////////////////////////////////
+
 // smart_malloc api entry points, with support for malloc/free corner cases.
 
 HOT_FUNC
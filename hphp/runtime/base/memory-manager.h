@@ -18,6 +18,7 @@
 #define incl_HPHP_MEMORY_MANAGER_H_
 
 #include <array>
+#include <unordered_set>
 #include <vector>
 
 #include "folly/Memory.h"
@@ -26,6 +27,7 @@
 #include "hphp/util/trace.h"
 #include "hphp/util/thread-local.h"
 #include "hphp/runtime/base/memory-usage-stats.h"
+#include "hphp/runtime/base/heap-sampler.h"
 
 namespace HPHP {
 
@@ -175,6 +177,80 @@ struct MemoryManager {
    */
   static uint32_t smartSizeClass(uint32_t requested);
 
+  /*
+   * Small size classes are multiples of the size quantum, up to
+   * kMaxSmartSize.  Size class i holds blocks of (i + 1) quanta.
+   */
+  static constexpr unsigned kLgSizeQuantum = 4; // 16 bytes
+  static constexpr unsigned kNumSizes = kMaxSmartSize >> kLgSizeQuantum;
+
+  /*
+   * Smart heap profile.
+   *
+   * When Eval.ProfileSmartHeap is set, each thread's MemoryManager
+   * counts small allocations per size class and tracks how well its
+   * slabs were used.  At the end of every request (in
+   * resetAllocator) the counters are folded into a process-wide
+   * total, which the admin server dumps with /mm-stats.
+   *
+   * Byte counts are at size-class granularity.  The "AtEnd" fields
+   * are sums over requests of the value seen just before the heap
+   * was thrown away, and peakBytes is the largest per-request high
+   * water mark.
+   */
+  struct SizeClassStats {
+    uint64_t allocs;
+    uint64_t frees;
+    int64_t liveBytes;        // still allocated at request end
+    int64_t peakBytes;
+    int64_t freeListBytes;    // sitting on free lists at request end
+  };
+  struct SmartHeapStats {
+    uint64_t requests;
+    uint64_t slabs;           // slabs in use at request end
+    int64_t slabBytes;
+    int64_t slabWastedBytes;  // slab space never carved into blocks
+    std::array<SizeClassStats,kNumSizes> sizes;
+  };
+  static SmartHeapStats getSmartHeapStats();
+  static void resetSmartHeapStats();
+
+  /*
+   * Numa-local slabs.
+   *
+   * Slabs and big blocks come from the jemalloc arena of the numa
+   * node the thread is bound to, when Eval.EnableNumaLocal has set up
+   * per-node arenas.  When there is more than one node, slabs
+   * released at the end of a request go back to a lock-free per-node
+   * pool (up to Eval.SmartHeapSlabsPerNode of them, at most 64) rather
+   * than to jemalloc, so the next request on the same node starts with
+   * slabs that are already faulted in and local.
+   *
+   * With Eval.SmartHeapHugePages each new slab is backed by a 2MB huge
+   * page, from hugetlbfs when it has pages left and transparent huge
+   * pages otherwise.
+   */
+  static constexpr int kMaxNumaNodes = 32;
+  struct NodeSlabStats {
+    int64_t fresh;            // slabs newly allocated
+    int64_t hugetlb;          //   of which were mapped from hugetlbfs
+    int64_t thp;              //   of which were 2MB-aligned for THP
+    int64_t reused;           // slabs handed out from the pool
+    int64_t released;         // slabs given back to jemalloc
+    int64_t pooled;           // slabs in the pool right now
+  };
+  static std::array<NodeSlabStats,kMaxNumaNodes> getNodeSlabStats();
+
+  /*
+   * In front of the node pool, each thread can hold on to up to
+   * Eval.SmartHeapRetainBytes of its own slabs between requests; these
+   * are still TLB- and cache-warm for the thread, and are reused
+   * before anything else.  The JobQueue drop-cache path calls
+   * flushRetainedSlabs() once a worker has been idle for its
+   * drop-cache timeout, handing them back to jemalloc.
+   */
+  void flushRetainedSlabs();
+
   /*
    * Allocate/deallocate a smart-allocated memory block in a given
    * small size class.  You must be able to tell the deallocation
@@ -249,6 +325,34 @@ struct MemoryManager {
    */
   void resetStats();
 
+  /*
+   * Re-read the RuntimeOptions that control the allocator's behavior.
+   * Called at the start of each session.
+   */
+  void resetRuntimeOptions();
+
+  /*
+   * Returns true if the request heap is in arena mode.
+   *
+   * In arena mode, frees of small blocks (smartFreeSize, and the
+   * small case of smart_free) only update the usage stats: the
+   * memory is not pushed on a free list and is never reused during
+   * the request.  All small allocations are bump-allocated from the
+   * current slab, and resetAllocator() reclaims the whole heap by
+   * releasing the slabs and rewinding into the first one.
+   *
+   * Big allocations are unaffected.
+   */
+  bool arenaMode() const;
+
+  /*
+   * Once the request's smart heap usage grows past this many bytes,
+   * ask for a cycle collection at the next surprise check (see
+   * CycleCollector).  The threshold is cleared when it fires; zero
+   * means never.
+   */
+  void setCollectThreshold(int64_t bytes);
+
   /*
    * How much memory this thread has allocated or deallocated.
    */
@@ -294,19 +398,23 @@ private:
     Node* head;
   };
 
-  static constexpr unsigned kLgSizeQuantum = 4; // 16 bytes
-  static constexpr unsigned kNumSizes = kMaxSmartSize >> kLgSizeQuantum;
   static constexpr size_t kSmartSizeMask = (1 << kLgSizeQuantum) - 1;
   static void* TlsInitSetup;
 
 private:
   MemoryManager();
+  ~MemoryManager();
   MemoryManager(const MemoryManager&) = delete;
   MemoryManager& operator=(const MemoryManager&) = delete;
 
 private:
   void* slabAlloc(size_t nbytes);
   char* newSlab(size_t nbytes);
+  char* takeSlab();
+  char* newHugeSlab();
+  void releaseSlab(char* slab);
+  void freeSlab(char* slab);
+  void* nodeMalloc(size_t nbytes, bool zero);
   void* smartEnlist(SweepNode*);
   void* smartMallocSlab(size_t padbytes);
   void* smartMallocBig(size_t nbytes);
@@ -321,6 +429,13 @@ private:
   void refreshStats();
   template<bool live> void refreshStatsImpl(MemoryUsageStats& stats);
   void refreshStatsHelperExceeded() const;
+  void checkCollectThreshold();
+  void profileAlloc(unsigned idx);
+  void profileFree(unsigned idx);
+  void profileSlab();
+  void profileFinish();
+  void sampleAlloc(void* ptr, size_t bytes);
+  void sampleFree(void* ptr);
 #ifdef USE_JEMALLOC
   void refreshStatsHelperStop();
   void* smartMallocSizeBigHelper(void*&, size_t&, size_t);
@@ -342,6 +457,8 @@ private:
   SweepNode m_strings; // in-place node is head of circular list
   MemoryUsageStats m_stats;
   std::vector<char*> m_slabs;
+  std::vector<char*> m_retainedSlabs;
+  std::unordered_set<char*> m_hugetlbSlabs; // ours, mapped from hugetlbfs
 
 #ifdef USE_JEMALLOC
   uint64_t* m_allocated;
@@ -356,6 +473,14 @@ private:
 
 private:
   bool m_sweeping;
+  bool m_arena;
+  bool m_profiling;
+  int m_node;
+  int m_allocmFlags;   // 0, or ALLOCM_ARENA of m_node's arena
+  int64_t m_collectThreshold;
+  int64_t m_sampleCountdown;  // bytes until the next HeapSampler sample
+  uint64_t m_sampleFilter;    // HeapSampler::liveFilter()
+  SmartHeapStats m_heapStats;
 };
 
 //////////////////////////////////////////////////////////////////////
@@ -124,13 +124,14 @@ size_t MemoryProfile::getSizeOfTV(TypedValue *tv) {
 // static
 size_t MemoryProfile::getSizeOfArray(ArrayData *arr) {
   size_t size = getSizeOfPtr(arr);
-  if (arr->isHphpArray()) {
+  if (arr->isHphpArray() || arr->isTypedVec()) {
     // calculate extra size
     HphpArray *ha = static_cast<HphpArray *>(arr);
     size_t tableSize = HphpArray::computeTableSize(ha->m_tableMask);
     size_t maxElms = HphpArray::computeMaxElms(ha->m_tableMask);
     if (maxElms > HphpArray::SmallSize) {
-      size_t hashSize = tableSize * sizeof(int32_t);
+      size_t hashSize = tableSize * sizeof(int32_t) +
+                        HphpArray::computeTagBytes(ha->m_tableMask);
       size_t dataSize = maxElms * sizeof(HphpArray::Elm);
       size += dataSize + hashSize;
     }
@@ -56,6 +56,7 @@ const StaticString
 // constructor/destructor
 
 ObjectData::~ObjectData() {
+  if (UNLIKELY(getAttribute(IsCycleRoot))) CycleCollector::forgetRoot(this);
   int& pmax = *os_max_id;
   if (o_id && o_id == pmax) {
     --pmax;
@@ -22,6 +22,7 @@
 #include "hphp/runtime/base/types.h"
 #include "hphp/runtime/base/macros.h"
 #include "hphp/runtime/base/memory-manager.h"
+#include "hphp/runtime/base/cycle-collector.h"
 #include "hphp/runtime/vm/class.h"
 #include "hphp/system/systemlib.h"
 #include <boost/mpl/eval_if.hpp>
@@ -57,6 +58,7 @@ class ObjectData {
     HasCallStatic = 0x0100, // defines __callStatic
     CallToImpl    = 0x0200, // call o_to{Boolean,Int64,Double}Impl
     HasClone      = 0x0400, // has custom clone logic
+    IsCycleRoot   = 0x0800, // in the CycleCollector's root buffer
     // The top 3 bits of o_attributes are reserved to indicate the
     // type of collection
     CollectionTypeAttrMask = (7 << 13),
@@ -103,7 +105,29 @@ class ObjectData {
  public:
   void setStatic() const { assert(false); }
   bool isStatic() const { return false; }
-  IMPLEMENT_COUNTABLENF_METHODS_NO_STATIC
+
+  RefCount getCount() const {
+    assert(is_refcount_realistic(m_count));
+    return m_count;
+  }
+  bool isRefCounted() const { return true; }
+  void incRefCount() const {
+    assert(!MemoryManager::sweeping());
+    assert(is_refcount_realistic(m_count));
+    ++m_count;
+  }
+  // An object that loses a reference but survives may be the last
+  // thing holding a garbage cycle, so it's a candidate root for the
+  // CycleCollector.
+  RefCount decRefCount() const {
+    assert(m_count > 0);
+    assert(is_refcount_realistic(m_count));
+    auto const count = --m_count;
+    if (UNLIKELY(CycleCollector::enabled()) && count) {
+      CycleCollector::addRoot(const_cast<ObjectData*>(this));
+    }
+    return count;
+  }
 
   virtual ~ObjectData();
 
@@ -416,6 +440,7 @@ class ObjectData {
   }
 
   friend struct MemoryProfile;
+  friend struct CycleCollector;
 
   //============================================================================
   // ObjectData fields
@@ -15,11 +15,14 @@
 */
 
 #include "hphp/runtime/base/pprof-server.h"
+#include "hphp/runtime/base/heap-sampler.h"
+#include "hphp/util/abi-cxx.h"
 #include "hphp/util/current-executable.h"
 #include "hphp/util/logger.h"
 
 #include "folly/Format.h"
 #include "folly/Conv.h"
+#include "folly/ScopeGuard.h"
 
 #include <mutex>
 #include <condition_variable>
@@ -47,7 +50,11 @@ void HeapProfileRequestHandler::handleRequest(Transport *transport) {
     transport->sendString(current_executable_path(), 200);
   } else if (!strcmp(url, "pprof/heap")) {
     // the next thing pprof does is hit this endpoint and get a profile
-    // dump
+    // dump. when heap sampling is on, that's the sampled profile.
+    if (HeapSampler::enabled()) {
+      transport->sendString(HeapSampler::toPProfFormat(), 200);
+      return;
+    }
     ProfileDump dump = ProfileController::waitForProfile();
     transport->sendString(dump.toPProfFormat(), 200);
   } else if (!strcmp(url, "pprof/symbol")) {
@@ -77,10 +84,22 @@ void HeapProfileRequestHandler::handleRequest(Transport *transport) {
         // for each address we get from pprof, it expects a line formatted
         // like the following
         // <address>\t<symbol name>
-        SrcKey sk = SrcKey::fromAtomicInt(
-          static_cast<uint64_t>(std::stoll(addr.data(), 0, 16))
-        );
-        folly::toAppend(addr, "\t", sk.getSymbol(), "\n", &res);
+        auto const raw =
+          static_cast<uint64_t>(std::stoull(addr.data(), 0, 16));
+        // the heap sampler mixes real return addresses with tagged
+        // srckeys; everything else only has plain srckeys
+        std::string symbol;
+        if (raw & HeapSampler::kSrcKeyTag) {
+          symbol = SrcKey::fromAtomicInt(raw & ~HeapSampler::kSrcKeyTag)
+            .getSymbol();
+        } else if (HeapSampler::enabled()) {
+          auto name = getNativeFunctionName(reinterpret_cast<void*>(raw));
+          SCOPE_EXIT { free(name); };
+          symbol = name;
+        } else {
+          symbol = SrcKey::fromAtomicInt(raw).getSymbol();
+        }
+        folly::toAppend(addr, "\t", symbol, "\n", &res);
       }
       transport->sendString(res, 200);
 
@@ -88,6 +88,11 @@ std::string ProfileDump::toPProfFormat() const {
   // we are going to manually resolve symbols ourselves later, and the
   // addresses we are dumping as part of the stack trace aren't even real
   // addresses anyway
+  pprof_append_mapped_libraries(res);
+  return res;
+}
+
+void pprof_append_mapped_libraries(std::string &res) {
   size_t buflen = 64;
   folly::toAppend("\nMAPPED_LIBRARIES:\n", &res);
   char buf[buflen];
@@ -98,7 +103,6 @@ std::string ProfileDump::toPProfFormat() const {
     folly::toAppend(folly::StringPiece(buf, bytesRead), &res);
   }
   fclose(f);
-  return res;
 }
 
 // ProfileController state
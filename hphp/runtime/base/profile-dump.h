@@ -110,6 +110,9 @@ private:
   int m_numDumps;
 };
 
+// Append the MAPPED_LIBRARIES section that ends a pprof profile.
+void pprof_append_mapped_libraries(std::string &res);
+
 // Static controller for requesting and fetching profile dumps. The pprof
 // server will place requests for dumps, and the VM threads will give
 // their dumps to the controller if they satisfy the currently-active
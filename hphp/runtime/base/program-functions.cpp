@@ -66,6 +66,7 @@
 #include <libxml/parser.h>
 
 #include "hphp/runtime/base/file-repository.h"
+#include "hphp/runtime/base/cycle-collector.h"
 
 #include "hphp/runtime/vm/runtime.h"
 #include "hphp/runtime/vm/repo.h"
@@ -668,7 +669,7 @@ static int start_server(const std::string &username) {
   // initialize the process
   HttpServer::Server = HttpServerPtr(new HttpServer());
 
-  if (memory_profiling) {
+  if (memory_profiling || RuntimeOption::EvalHeapSampleBytes) {
     Logger::Info("Starting up profiling server");
     HeapProfileServer::Server = std::make_shared<HeapProfileServer>();
   }
@@ -1475,7 +1476,9 @@ static bool hphp_warmup(ExecutionContext *context,
 void hphp_session_init() {
   init_thread_locals();
   ThreadInfo::s_threadInfo->onSessionInit();
+  MM().resetRuntimeOptions();
   MM().resetStats();
+  CycleCollector::requestInit();
 
 #ifdef ENABLE_SIMPLE_COUNTER
   SimpleCounter::Enabled = true;
@@ -1578,6 +1581,8 @@ void hphp_thread_exit() {
 }
 
 void hphp_session_exit() {
+  CycleCollector::requestExit();
+
   // Server note has to live long enough for the access log to fire.
   // RequestLocal is too early.
   ServerNote::Reset();
@@ -66,6 +66,7 @@ struct RefData {
     m_count = 1;
     assert(static_cast<bool>(m_magic = Magic::kMagic)); // assign magic
     assert(m_cowAndZ == 0);
+    m_cycleRoot = false;
   }
 
   /*
@@ -93,7 +94,28 @@ struct RefData {
     MM().smartFreeSize(this, sizeof(RefData));
   }
 
-  IMPLEMENT_COUNTABLE_METHODS_NO_STATIC
+  RefCount getCount() const {
+    assert(is_refcount_realistic(m_count));
+    return m_count;
+  }
+  bool isRefCounted() const { return true; }
+  void incRefCount() const {
+    assert(!MemoryManager::sweeping());
+    assert(is_refcount_realistic(m_count));
+    ++m_count;
+  }
+  // A ref that loses a reference but survives (m_cow keeps it alive at
+  // a zero m_count) is a candidate CycleCollector root.
+  RefCount decRefCount() const {
+    assert(m_count > 0);
+    assert(is_refcount_realistic(m_count));
+    auto const count = --m_count;
+    if (UNLIKELY(CycleCollector::enabled()) && (count || m_cow) &&
+        !m_cycleRoot) {
+      CycleCollector::addRoot(const_cast<RefData*>(this));
+    }
+    return count;
+  }
 
   // Memory allocator methods
   void dump() const;
@@ -151,6 +173,7 @@ struct RefData {
     m_tv.m_type = KindOfNull;
     m_count = 0;
     m_cowAndZ = 0;
+    m_cycleRoot = false;
   }
 
   bool zIsRef() const {
@@ -243,6 +266,7 @@ private:
     // Initialize this value by laundering uninitNull -> Null.
     m_count = 1;
     m_cowAndZ = 0;
+    m_cycleRoot = false;
     if (!IS_NULL_TYPE(t)) {
       m_tv.m_type = t;
       m_tv.m_data.num = datum;
@@ -301,6 +325,9 @@ public:
     mutable uint32_t m_cowAndZ;
   };
 #endif
+private:
+  friend struct CycleCollector;
+  mutable bool m_cycleRoot; // in the CycleCollector's root buffer
 };
 
 ALWAYS_INLINE void decRefRef(RefData* ref) {
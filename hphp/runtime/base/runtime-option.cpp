@@ -302,6 +302,8 @@ std::vector<std::string> RuntimeOption::APCSizeSkipPrefix;
 bool RuntimeOption::EnableAPCSizeDetail = false;
 bool RuntimeOption::EnableAPCFetchStats = false;
 bool RuntimeOption::APCSizeCountPrime = false;
+bool RuntimeOption::EnableAPCHotKeys = false;
+int32_t RuntimeOption::APCHotKeysSampleRate = 100;
 
 int64_t RuntimeOption::MaxRSS = 0;
 int64_t RuntimeOption::MaxRSSPollingCycle = 0;
@@ -1068,6 +1070,12 @@ void RuntimeOption::Load(Hdf &config, StringVec *overwrites /* = NULL */,
       if (EnableAPCSizeDetail) EnableAPCSizeGroup = true;
       APCSizeCountPrime = apcSize["CountPrime"].getBool();
     }
+    {
+      Hdf apcHot = stats["APCHotKeys"];
+      EnableAPCHotKeys = apcHot["Enable"].getBool();
+      APCHotKeysSampleRate = apcHot["SampleRate"].getInt32(100);
+      if (APCHotKeysSampleRate < 1) APCHotKeysSampleRate = 1;
+    }
 
     EnableHotProfiler = stats["EnableHotProfiler"].getBool(true);
     ProfilerTraceBuffer = stats["ProfilerTraceBuffer"].getInt32(2000000);
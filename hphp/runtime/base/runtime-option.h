@@ -289,6 +289,8 @@ public:
   static bool EnableAPCSizeDetail;
   static bool EnableAPCFetchStats;
   static bool APCSizeCountPrime;
+  static bool EnableAPCHotKeys;
+  static int32_t APCHotKeysSampleRate;
   static bool EnableHotProfiler;
   static int32_t ProfilerTraceBuffer;
   static double ProfilerTraceExpansion;
@@ -433,6 +435,39 @@ public:
   F(uint32_t, InitialNamedEntityTableSize,  30000)                      \
   F(uint32_t, InitialStaticStringTableSize, 100000)                     \
   F(uint32_t, PCRETableSize, kPCREInitialTableSize)                     \
+  /*                                                                    \
+   * When set, small smart-allocated blocks are never put back on the   \
+   * free lists; the request heap is bump-allocated from slabs and      \
+   * thrown away in one piece at request end.                           \
+   */                                                                   \
+  F(bool, SmartHeapArena,              false)                           \
+  /* Free slabs pooled per numa node; see MemoryManager. */             \
+  F(uint32_t, SmartHeapSlabsPerNode,   16)                              \
+  /* Slab bytes a thread keeps between requests; see MemoryManager. */  \
+  F(uint64_t, SmartHeapRetainBytes,    0)                               \
+  /* Back smart heap slabs with 2MB huge pages; see MemoryManager. */   \
+  F(bool, SmartHeapHugePages,          false)                           \
+  /* Per-size-class smart allocator counters; see MemoryManager. */     \
+  F(bool, ProfileSmartHeap,            false)                           \
+  /* Mean bytes between sampled allocations; see HeapSampler. */        \
+  F(uint32_t, HeapSampleBytes,         0)                               \
+  F(uint32_t, HeapSampleMaxSites,      10000)                           \
+  /* Trial-deletion collection of heap cycles; see CycleCollector. */   \
+  F(bool, EnableCycleCollector,        false)                           \
+  F(uint64_t, CycleCollectorThreshold, 64 << 20)                        \
+  F(uint32_t, CycleCollectorMaxRoots,  10000)                           \
+  /* Let gc_enable()/gc_disable() turn the collector on and off. */     \
+  F(bool, CycleCollectorUserControl,   false)                           \
+  /* Shared-key-layout arrays for fetched rows; see StructArray. */     \
+  F(bool, EnableStructArrays,          false)                           \
+  /* Int/double-only packed arrays built by append; see kIntVecKind. */ \
+  F(bool, EnableTypedVecs,             false)                           \
+  /* Builtin-comparator sorts this large use radix passes. */           \
+  F(uint32_t, RadixSortThreshold,      256)                             \
+  /* CLI sorts this large are split across threads; 0 is off. */        \
+  F(uint32_t, ParallelSortThreshold,   0)                               \
+  /* array_slice runs this long share the parent; see SliceArray. */    \
+  F(uint32_t, SliceArrayThreshold,     0)                               \
   F(bool, EnableNuma, ServerExecutionMode())                            \
   F(bool, EnableNumaLocal, ServerExecutionMode())                       \
   F(bool, SimulateARM,                 false)                           \
@@ -40,7 +40,7 @@ CVarRef SharedArray::getValueRef(ssize_t pos) const {
     m_localCache = (TypedValue*) smart_calloc(cap, sizeof(TypedValue));
   }
   TypedValue* tv = &m_localCache[pos];
-  tvAsVariant(tv) = sv->toLocal();
+  tvAsVariant(tv) = sv->toLocal(m_borrowed);
   assert(tv->m_type != KindOfUninit);
   return tvAsCVarRef(tv);
 }
@@ -63,7 +63,7 @@ ALWAYS_INLINE SharedArray::~SharedArray() {
     }
     smart_free(m_localCache);
   }
-  m_arr->decRef();
+  if (!m_borrowed) m_arr->decRef();
 }
 
 HOT_FUNC
@@ -30,12 +30,13 @@ namespace HPHP {
  * Wrapper for a shared memory map.
  */
 class SharedArray : public ArrayData, Sweepable {
-  explicit SharedArray(SharedVariant* source)
+  explicit SharedArray(SharedVariant* source, bool borrowed = false)
     : ArrayData(kSharedKind)
     , m_arr(source)
-    , m_localCache(nullptr) {
+    , m_localCache(nullptr)
+    , m_borrowed(borrowed) {
     m_size = m_arr->arrSize();
-    source->incRef();
+    if (!borrowed) source->incRef();
   }
 
   ~SharedArray();
@@ -118,7 +119,7 @@ public:
   static ArrayData* EscalateForSort(ArrayData*);
 
   // implements Sweepable.sweep()
-  void sweep() FOLLY_OVERRIDE { m_arr->decRef(); }
+  void sweep() FOLLY_OVERRIDE { if (!m_borrowed) m_arr->decRef(); }
 
 private:
   ssize_t getIndex(int64_t k) const;
@@ -130,6 +131,9 @@ public:
   void getChildren(std::vector<TypedValue *> &out);
   SharedVariant *m_arr;
   mutable TypedValue* m_localCache;
+  // No reference is held on m_arr (see SharedVariant::toLocal); its
+  // elements are then borrowed too, since m_arr keeps them alive.
+  bool m_borrowed;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
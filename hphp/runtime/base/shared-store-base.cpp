@@ -55,6 +55,8 @@ void SharedStores::create() {
   for (int i = 0; i < MAX_SHARED_STORE; i++) {
     switch (apcExtension::TableType) {
       case apcExtension::TableTypes::ConcurrentTable:
+      // The segment is attached once the apc extension has its options.
+      case apcExtension::TableTypes::SharedMemory:
         m_stores[i] = new ConcurrentTableSharedStore(i);
         break;
       default:
@@ -244,12 +244,17 @@ std::atomic<int32_t> SharedStoreStats::s_fromFileCount(0);
 std::atomic<int32_t> SharedStoreStats::s_updateCount(0);
 std::atomic<int32_t> SharedStoreStats::s_deleteCount(0);
 std::atomic<int32_t> SharedStoreStats::s_expireCount(0);
+std::atomic<int32_t> SharedStoreStats::s_evictCount(0);
+std::atomic<int64_t> SharedStoreStats::s_evictSize(0);
 
 int32_t SharedStoreStats::s_expireQueueSize = 0;
 std::atomic<int64_t> SharedStoreStats::s_purgingTime(0);
 
 ReadWriteMutex SharedStoreStats::s_rwlock;
 
+HeavyHitters SharedStoreStats::s_hotKeys[NumHotMetrics];
+HeavyHitters SharedStoreStats::s_hotGroups[NumHotMetrics];
+
 SharedStoreStats::StatsMap SharedStoreStats::s_statsMap,
                            SharedStoreStats::s_detailMap;
 
@@ -269,6 +274,8 @@ string SharedStoreStats::report_basic() {
   writeEntryInt(out, "Update_Count", s_updateCount, false, 1, true);
   writeEntryInt(out, "Delete_Count", s_deleteCount, false, 1, true);
   writeEntryInt(out, "Expire_Count", s_expireCount, false, 1, true);
+  writeEntryInt(out, "Evict_Count", s_evictCount, false, 1, true);
+  writeEntryInt(out, "Evict_Size", s_evictSize, false, 1, true);
   writeEntryInt(out, "Expire_Queue_Size", s_expireQueueSize, false, 1, true);
   writeEntryInt(out, "Purging_Time", s_purgingTime, true, 1, true);
   out << "}\n";
@@ -287,6 +294,8 @@ string SharedStoreStats::report_basic_flat() {
       << ", " << "\"hphp.apc.update_count\":" << s_updateCount
       << ", " << "\"hphp.apc.delete_count\":" << s_deleteCount
       << ", " << "\"hphp.apc.expire_count\":" << s_expireCount
+      << ", " << "\"hphp.apc.evict_count\":" << s_evictCount
+      << ", " << "\"hphp.apc.evict_size\":" << s_evictSize
       << ", " << "\"hphp.apc.expire_queue_size\":" << s_expireQueueSize
       << ", " << "\"hphp.apc.purging_time\":" << s_purgingTime
       << "}\n";
@@ -415,6 +424,17 @@ void SharedStoreStats::updateDirect(int32_t dataTotalOld, int32_t dataTotalNew)
   s_updateCount.fetch_add(1, std::memory_order_relaxed);
 }
 
+void SharedStoreStats::evictDirect(int32_t keySize, int32_t dataTotal) {
+  s_keyCount.fetch_sub(1, std::memory_order_relaxed);
+  s_keySize.fetch_sub(keySize, std::memory_order_relaxed);
+  s_dataTotalSize.fetch_sub((int64_t)dataTotal, std::memory_order_relaxed);
+}
+
+void SharedStoreStats::addEviction(int32_t bytes) {
+  s_evictCount.fetch_add(1, std::memory_order_relaxed);
+  s_evictSize.fetch_add((int64_t)bytes, std::memory_order_relaxed);
+}
+
 void SharedStoreStats::addPurgingTime(int64_t purgingTime) {
   s_purgingTime.fetch_add(purgingTime, std::memory_order_relaxed);
 }
@@ -457,6 +477,62 @@ void SharedStoreStats::onDelete(const StringData *key, const SharedVariant *var,
   }
 }
 
+void SharedStoreStats::onHotKeySample(const StringData* key,
+                                      int64_t bytesFetched, bool contended) {
+  uint64_t weight = RuntimeOption::APCHotKeysSampleRate;
+  char normalizedKey[MAX_KEY_LEN + 1];
+  normalizeKey(key->data(), normalizedKey, MAX_KEY_LEN);
+  normalizedKey[MAX_KEY_LEN] = '\0';
+  size_t groupLen = strlen(normalizedKey);
+
+  auto add = [&] (HotMetric m, uint64_t w) {
+    s_hotKeys[m].add(key->data(), key->size(), w);
+    s_hotGroups[m].add(normalizedKey, groupLen, w);
+  };
+  if (bytesFetched >= 0) {
+    add(HotFetches, weight);
+    add(HotBytesFetched, weight * bytesFetched);
+  }
+  if (contended) {
+    add(HotContended, weight);
+  }
+}
+
+string SharedStoreStats::report_hot_keys(size_t n) {
+  static const char* names[NumHotMetrics] = {
+    "Fetches", "Bytes_Fetched", "Contended"
+  };
+  ostringstream out;
+  out << "{\n";
+  auto report = [&] (const char* what, HotMetric m, const HeavyHitters& hh,
+                     bool last) {
+    out << "  \"" << what << "_By_" << names[m] << "\": [";
+    auto const top = hh.top(n);
+    for (size_t i = 0; i < top.size(); ++i) {
+      out << (i ? ",\n    {" : "\n    {");
+      writeEntryStr(out, "Key", JSON::Escape(top[i].first.c_str()).c_str());
+      writeEntryInt(out, "Count", top[i].second, true);
+      out << "}";
+    }
+    out << (last ? "]\n" : "],\n");
+  };
+  for (int m = 0; m < NumHotMetrics; ++m) {
+    report("Keys", HotMetric(m), s_hotKeys[m], false);
+  }
+  for (int m = 0; m < NumHotMetrics; ++m) {
+    report("Groups", HotMetric(m), s_hotGroups[m], m == NumHotMetrics - 1);
+  }
+  out << "}\n";
+  return out.str();
+}
+
+void SharedStoreStats::resetHotKeys() {
+  for (int m = 0; m < NumHotMetrics; ++m) {
+    s_hotKeys[m].reset();
+    s_hotGroups[m].reset();
+  }
+}
+
 void SharedStoreStats::onGet(const StringData *key, const SharedVariant *var) {
   ReadLock l(s_rwlock);
   StatsMap::const_accessor cacc;
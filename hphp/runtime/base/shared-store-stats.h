@@ -21,6 +21,7 @@
 
 #include "hphp/runtime/base/shared-variant.h"
 #include "hphp/runtime/base/complex-types.h"
+#include "hphp/util/heavy-hitters.h"
 
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
@@ -104,12 +105,28 @@ public:
   static void addDirect(int32_t keySize, int32_t dataTotal, bool prime, bool file);
   static void removeDirect(int32_t keySize, int32_t dataTotal, bool exp);
   static void updateDirect(int32_t dataTotalOld, int32_t dataTotalNew);
+  static void evictDirect(int32_t keySize, int32_t dataTotal);
+
+  // Counted whether or not size stats are on.
+  static void addEviction(int32_t bytes);
 
   static void setExpireQueueSize(int32_t size) {
     s_expireQueueSize = size;
   }
   static void addPurgingTime(int64_t purgingTime);
 
+  /*
+   * Heavy hitters (Stats.APCHotKeys): the keys, and key groups as
+   * /apc-ss-keys forms them, with the most fetches, bytes fetched and
+   * contended bucket locks.  Callers sample; each call stands for
+   * APCHotKeysSampleRate accesses.  bytesFetched is negative if the
+   * access wasn't a successful fetch.
+   */
+  static void onHotKeySample(const StringData* key, int64_t bytesFetched,
+                             bool contended);
+  static std::string report_hot_keys(size_t n);
+  static void resetHotKeys();
+
 protected:
   static ReadWriteMutex s_rwlock;
 
@@ -128,6 +145,8 @@ protected:
   static std::atomic<int32_t> s_updateCount;
   static std::atomic<int32_t> s_deleteCount;
   static std::atomic<int32_t> s_expireCount;
+  static std::atomic<int32_t> s_evictCount;
+  static std::atomic<int64_t> s_evictSize;
 
   static int32_t s_expireQueueSize;
   static std::atomic<int64_t> s_purgingTime;
@@ -150,6 +169,10 @@ protected:
                                    charHashCompare> StatsMap;
 
   static StatsMap s_statsMap, s_detailMap;
+
+  enum HotMetric { HotFetches, HotBytesFetched, HotContended, NumHotMetrics };
+  static HeavyHitters s_hotKeys[NumHotMetrics];
+  static HeavyHitters s_hotGroups[NumHotMetrics];
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -164,7 +164,8 @@ ALWAYS_INLINE void StringData::enlist() {
 }
 
 HOT_FUNC NEVER_INLINE
-StringData* StringData::MakeSVSlowPath(SharedVariant* shared, uint32_t len) {
+StringData* StringData::MakeSVSlowPath(SharedVariant* shared, uint32_t len,
+                                       bool borrowed) {
   auto const data       = shared->stringData();
   auto const hash       = shared->rawStringData()->m_hash & STRHASH_MASK;
   auto const capAndHash = static_cast<uint64_t>(hash) << 32;
@@ -178,8 +179,12 @@ StringData* StringData::MakeSVSlowPath(SharedVariant* shared, uint32_t len) {
   sd->m_capAndHash  = capAndHash;
 
   sd->sharedPayload()->shared = shared;
-  sd->enlist();
-  shared->incRef();
+  if (borrowed) {
+    sd->sharedPayload()->node.next = nullptr;
+  } else {
+    sd->enlist();
+    shared->incRef();
+  }
 
   assert(sd->m_len == len);
   assert(sd->m_count == 0);
@@ -196,7 +201,7 @@ StringData* StringData::Make(SharedVariant* shared) {
 
   auto const len        = shared->stringLength();
   if (UNLIKELY(len > SmallStringReserve)) {
-    return MakeSVSlowPath(shared, len);
+    return MakeSVSlowPath(shared, len, false);
   }
 
   auto const psrc       = shared->stringData();
@@ -233,8 +238,16 @@ StringData* StringData::Make(SharedVariant* shared) {
   return ret;
 }
 
+StringData* StringData::MakeBorrowed(SharedVariant* shared) {
+  auto const len = shared->stringLength();
+  if (UNLIKELY(len > SmallStringReserve)) {
+    return MakeSVSlowPath(shared, len, true);
+  }
+  return Make(shared);
+}
+
 HOT_FUNC
-Variant SharedVariant::toLocal() {
+Variant SharedVariant::toLocal(bool borrowed /* = false */) {
   switch (m_type) {
   case KindOfBoolean:
     {
@@ -254,14 +267,15 @@ Variant SharedVariant::toLocal() {
     }
   case KindOfString:
     {
-      return StringData::Make(this);
+      return borrowed ? StringData::MakeBorrowed(this)
+                      : StringData::Make(this);
     }
   case KindOfArray:
     {
       if (getSerializedArray()) {
         return apc_unserialize(m_data.str->data(), m_data.str->size());
       }
-      return SharedArray::Make(this);
+      return SharedArray::Make(this, borrowed);
     }
   case KindOfUninit:
   case KindOfNull:
@@ -325,6 +339,77 @@ void SharedVariant::dump(std::string &out) {
   out += "\n";
 }
 
+static void serialize_string(std::string& out, const char* s, size_t len) {
+  out += "s:";
+  out += boost::lexical_cast<string>(len);
+  out += ":\"";
+  out.append(s, len);
+  out += "\";";
+}
+
+bool SharedVariant::serializeTo(std::string& out) const {
+  switch (m_type) {
+  case KindOfBoolean:
+    out += m_data.num ? "b:1;" : "b:0;";
+    return true;
+  case KindOfInt64:
+    out += "i:";
+    out += boost::lexical_cast<string>(m_data.num);
+    out += ';';
+    return true;
+  case KindOfDouble:
+    {
+      out += "d:";
+      auto const v = m_data.dbl;
+      if (std::isnan(v)) {
+        out += "NAN";
+      } else if (std::isinf(v)) {
+        out += v < 0 ? "-INF" : "INF";
+      } else {
+        // Unlike serialize(), keep every bit, including the sign of -0.
+        char buf[32];
+        snprintf(buf, sizeof buf, "%.17g", v);
+        out += buf;
+      }
+      out += ';';
+      return true;
+    }
+  case KindOfStaticString:
+  case KindOfString:
+    serialize_string(out, stringData(), stringLength());
+    return true;
+  case KindOfArray:
+    {
+      // Serialized arrays are in apc_serialize() format, which may point
+      // at static strings in this process.
+      if (getSerializedArray()) return false;
+      auto const n = arrSize();
+      out += "a:";
+      out += boost::lexical_cast<string>(n);
+      out += ":{";
+      for (size_t i = 0; i < n; ++i) {
+        if (isPacked()) {
+          out += "i:";
+          out += boost::lexical_cast<string>(i);
+          out += ';';
+        } else if (!m_data.array->getKeyIndex(i)->serializeTo(out)) {
+          return false;
+        }
+        if (!getValue(i)->serializeTo(out)) return false;
+      }
+      out += '}';
+      return true;
+    }
+  case KindOfUninit:
+  case KindOfNull:
+    out += "N;";
+    return true;
+  default:
+    // Objects are either live or in apc_serialize() format.
+    return false;
+  }
+}
+
 SharedVariant::~SharedVariant() {
   switch (m_type) {
   case KindOfObject:
@@ -477,9 +562,9 @@ int32_t SharedVariant::getSpaceUsage() const {
     if (getSerializedArray()) {
       size += sizeof(StringData) + m_data.str->size();
     } else if (isPacked()) {
-      auto size = m_data.packed->size();
-      size += sizeof(ImmutablePackedArray) + size * sizeof(SharedVariant*);
-      for (size_t i = 0, n = m_data.packed->size(); i < n; i++) {
+      auto const n = m_data.packed->size();
+      size += sizeof(ImmutablePackedArray) + n * sizeof(SharedVariant*);
+      for (size_t i = 0; i < n; i++) {
         size += m_data.packed->vals()[i]->getSpaceUsage();
       }
     } else {
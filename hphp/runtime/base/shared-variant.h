@@ -83,7 +83,13 @@ public:
     }
   }
 
-  Variant toLocal();
+  /*
+   * Make a request-local value from this one.  Strings and arrays made
+   * from it normally hold a reference on it; with `borrowed' they
+   * don't, and the caller must instead guarantee that this
+   * SharedVariant lives until the end of the request.
+   */
+  Variant toLocal(bool borrowed = false);
 
   int64_t intData() const {
     assert(is(KindOfInt64));
@@ -128,6 +134,14 @@ public:
 
   void dump(std::string &out);
 
+  /*
+   * Append this value to out in serialize() format, without making a
+   * request-local copy first, so it can be called outside a request.
+   * Returns false, leaving out partly written, for values that can't be
+   * written this way: objects, and arrays APC keeps serialized.
+   */
+  bool serializeTo(std::string& out) const;
+
   void getStats(SharedVariantStats *stats) const;
   int32_t getSpaceUsage() const;
 
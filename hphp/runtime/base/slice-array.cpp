@@ -0,0 +1,255 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+#include "hphp/runtime/base/slice-array.h"
+
+#include "hphp/runtime/base/array-init.h"
+#include "hphp/runtime/base/array-iterator.h"
+
+namespace HPHP {
+
+//////////////////////////////////////////////////////////////////////
+
+ArrayData* SliceArray::Make(ArrayData* parent, uint32_t start,
+                            uint32_t size) {
+  assert(size > 0 && start + size <= parent->size());
+  if (parent->isSliceArray()) {
+    auto const s = asSliceArray(parent);
+    return Make(s->m_parent, s->m_start + start, size);
+  }
+  if (!parent->isPacked() && !parent->isTypedVec()) return nullptr;
+
+  auto const a = static_cast<HphpArray*>(parent);
+  auto const elms = a->data();
+  for (uint32_t i = start, stop = start + size; i < stop; ++i) {
+    if (elms[i].data.m_type == KindOfRef) return nullptr;
+  }
+  return new (MM().smartMallocSize(sizeof(SliceArray)))
+    SliceArray(a, start, size);
+}
+
+inline SliceArray* SliceArray::asSliceArray(ArrayData* ad) {
+  assert(ad->kind() == kSliceKind);
+  return static_cast<SliceArray*>(ad);
+}
+
+inline const SliceArray* SliceArray::asSliceArray(const ArrayData* ad) {
+  assert(ad->kind() == kSliceKind);
+  return static_cast<const SliceArray*>(ad);
+}
+
+void SliceArray::Release(ArrayData* ad) {
+  auto const a = asSliceArray(ad);
+  decRefArr(a->m_parent);
+  MM().smartFreeSize(a, sizeof(SliceArray));
+}
+
+CVarRef SliceArray::GetValueRef(const ArrayData* ad, ssize_t pos) {
+  return tvAsCVarRef(asSliceArray(ad)->elm(pos));
+}
+
+bool SliceArray::IsVectorData(const ArrayData* ad) {
+  return true;
+}
+
+bool SliceArray::ExistsInt(const ArrayData* ad, int64_t k) {
+  return size_t(k) < asSliceArray(ad)->m_size;
+}
+
+bool SliceArray::ExistsStr(const ArrayData* ad, const StringData* k) {
+  return false;
+}
+
+TypedValue* SliceArray::NvGetInt(const ArrayData* ad, int64_t k) {
+  auto const a = asSliceArray(ad);
+  return LIKELY(size_t(k) < a->m_size) ? a->elm(k) : nullptr;
+}
+
+TypedValue* SliceArray::NvGetStr(const ArrayData* ad, const StringData* k) {
+  return nullptr;
+}
+
+void SliceArray::NvGetKey(const ArrayData* ad, TypedValue* out, ssize_t pos) {
+  assert(size_t(pos) < asSliceArray(ad)->m_size);
+  out->m_data.num = pos;
+  out->m_type = KindOfInt64;
+}
+
+/* if a2 is modified copy of a1 (i.e. != a1), then release a1 and return a2 */
+static inline ArrayData* releaseIfCopied(ArrayData* a1, ArrayData* a2) {
+  if (a1 != a2) a1->release();
+  return a2;
+}
+
+ArrayData* SliceArray::LvalInt(ArrayData* ad, int64_t k, Variant*& ret,
+                               bool copy) {
+  ArrayData *escalated = Escalate(ad);
+  return releaseIfCopied(escalated, escalated->lval(k, ret, false));
+}
+
+ArrayData* SliceArray::LvalStr(ArrayData* ad, StringData* k, Variant*& ret,
+                               bool copy) {
+  ArrayData *escalated = Escalate(ad);
+  return releaseIfCopied(escalated, escalated->lval(k, ret, false));
+}
+
+ArrayData* SliceArray::LvalNew(ArrayData* ad, Variant*& ret, bool copy) {
+  ArrayData *escalated = Escalate(ad);
+  return releaseIfCopied(escalated, escalated->lvalNew(ret, false));
+}
+
+ArrayData*
+SliceArray::SetInt(ArrayData* ad, int64_t k, CVarRef v, bool copy) {
+  ArrayData *escalated = Escalate(ad);
+  return releaseIfCopied(escalated, escalated->set(k, v, false));
+}
+
+ArrayData*
+SliceArray::SetStr(ArrayData* ad, StringData* k, CVarRef v, bool copy) {
+  ArrayData *escalated = Escalate(ad);
+  return releaseIfCopied(escalated, escalated->set(k, v, false));
+}
+
+ArrayData*
+SliceArray::SetRefInt(ArrayData* ad, int64_t k, CVarRef v, bool copy) {
+  ArrayData *escalated = Escalate(ad);
+  return releaseIfCopied(escalated, escalated->setRef(k, v, false));
+}
+
+ArrayData*
+SliceArray::SetRefStr(ArrayData* ad, StringData* k, CVarRef v, bool copy) {
+  ArrayData *escalated = Escalate(ad);
+  return releaseIfCopied(escalated, escalated->setRef(k, v, false));
+}
+
+ArrayData* SliceArray::RemoveInt(ArrayData* ad, int64_t k, bool copy) {
+  if (!ExistsInt(ad, k)) return ad;
+  ArrayData *escalated = Escalate(ad);
+  return releaseIfCopied(escalated, escalated->remove(k, false));
+}
+
+ArrayData*
+SliceArray::RemoveStr(ArrayData* ad, const StringData* k, bool copy) {
+  // There are no string keys, so there is nothing to remove.
+  return ad;
+}
+
+ArrayData* SliceArray::Copy(const ArrayData* ad) {
+  return Escalate(ad);
+}
+
+ArrayData* SliceArray::NonSmartCopy(const ArrayData* ad) {
+  Array escalated = Escalate(ad);
+  return escalated->nonSmartCopy();
+}
+
+ArrayData* SliceArray::Append(ArrayData* ad, CVarRef v, bool copy) {
+  ArrayData *escalated = Escalate(ad);
+  return releaseIfCopied(escalated, escalated->append(v, false));
+}
+
+ArrayData* SliceArray::AppendRef(ArrayData* ad, CVarRef v, bool copy) {
+  ArrayData *escalated = Escalate(ad);
+  return releaseIfCopied(escalated, escalated->appendRef(v, false));
+}
+
+ArrayData* SliceArray::AppendWithRef(ArrayData* ad, CVarRef v, bool copy) {
+  ArrayData *escalated = Escalate(ad);
+  return releaseIfCopied(escalated, escalated->appendWithRef(v, false));
+}
+
+ArrayData* SliceArray::Plus(ArrayData* ad, const ArrayData* elems) {
+  Array escalated = Escalate(ad);
+  return escalated->plus(elems);
+}
+
+ArrayData* SliceArray::Merge(ArrayData* ad, const ArrayData* elems) {
+  Array escalated = Escalate(ad);
+  return escalated->merge(elems);
+}
+
+ArrayData* SliceArray::Prepend(ArrayData* ad, CVarRef v, bool copy) {
+  ArrayData *escalated = Escalate(ad);
+  return releaseIfCopied(escalated, escalated->prepend(v, false));
+}
+
+/*
+ * Copy the run into a packed HphpArray with the same internal position.
+ * Make() turned away runs with references, so every value is copied
+ * plainly.
+ */
+ArrayData* SliceArray::Escalate(const ArrayData* ad) {
+  auto const a = asSliceArray(ad);
+  auto const n = a->m_size;
+  PackedArrayInit ai(n);
+  for (uint32_t i = 0; i < n; ++i) {
+    ai.append(tvAsCVarRef(a->elm(i)));
+  }
+  auto const ret = ai.create();
+  ret->setPosition(a->m_pos);
+  return ret;
+}
+
+ArrayData* SliceArray::EscalateForSort(ArrayData* ad) {
+  return Escalate(ad);
+}
+
+/*
+ * NonSmartCopy() escalates, so scalar arrays are never views.  A view
+ * that gets here anyway can't be swapped for its escalation, so it
+ * makes its run of the parent scalar instead; that changes no values.
+ */
+void SliceArray::OnSetEvalScalar(ArrayData* ad) {
+  auto const a = asSliceArray(ad);
+  if (a->m_parent->isTypedVec()) return; // ints and doubles already are
+  for (uint32_t i = 0, n = a->m_size; i < n; ++i) {
+    tvAsVariant(a->elm(i)).setEvalScalar();
+  }
+}
+
+ssize_t SliceArray::IterBegin(const ArrayData* ad) {
+  return asSliceArray(ad)->m_size > 0 ? 0 : invalid_index;
+}
+
+ssize_t SliceArray::IterEnd(const ArrayData* ad) {
+  auto const n = asSliceArray(ad)->m_size;
+  return n > 0 ? ssize_t(n - 1) : invalid_index;
+}
+
+ssize_t SliceArray::IterAdvance(const ArrayData* ad, ssize_t prev) {
+  auto const a = asSliceArray(ad);
+  assert(prev >= 0 && prev < a->m_size);
+  ssize_t next = prev + 1;
+  return next < a->m_size ? next : invalid_index;
+}
+
+ssize_t SliceArray::IterRewind(const ArrayData* ad, ssize_t prev) {
+  assert(prev >= 0 && prev < asSliceArray(ad)->m_size);
+  ssize_t next = prev - 1;
+  return next >= 0 ? next : invalid_index;
+}
+
+bool SliceArray::ValidFullPos(const ArrayData* ad, const FullPos& fp) {
+  // Strong iteration escalates to an HphpArray first.
+  assert(fp.getContainer() == ad);
+  return false;
+}
+
+bool SliceArray::AdvanceFullPos(ArrayData* ad, FullPos& fp) {
+  return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,132 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+
+#ifndef incl_HPHP_SLICE_ARRAY_H_
+#define incl_HPHP_SLICE_ARRAY_H_
+
+#include "hphp/runtime/base/array-data.h"
+#include "hphp/runtime/base/hphp-array.h"
+#include "hphp/runtime/base/complex-types.h"
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Read-only view of a run of elements in a packed HphpArray, with keys 0
+ * to size-1.  The view holds a reference to its parent, so the parent's
+ * elements can't change under it: any write to the parent copies it
+ * first.  Writes to the view itself, sorting and strong iteration
+ * materialize the run into a new packed HphpArray, the same way
+ * SharedArray escalates.
+ */
+class SliceArray : public ArrayData {
+  SliceArray(HphpArray* parent, uint32_t start, uint32_t size)
+    : ArrayData(kSliceKind, AllocationMode::smart, size)
+    , m_parent(parent)
+    , m_start(start) {
+    parent->incRefCount();
+  }
+
+public:
+  /*
+   * Return a view of `size' elements of `parent' starting at `start', or
+   * nullptr if a view can't stand in for a copy: the parent isn't packed,
+   * or the run holds references, which a copy would keep bound.  Slicing
+   * a view makes a view of the same parent.  The returned array has a
+   * refcount of zero.
+   */
+  static ArrayData* Make(ArrayData* parent, uint32_t start, uint32_t size);
+
+  // these using directives ensure the full set of overloaded functions
+  // are visible in this class, to avoid triggering implicit conversions
+  // from a CVarRef key to int64.
+  using ArrayData::exists;
+  using ArrayData::lval;
+  using ArrayData::lvalNew;
+  using ArrayData::set;
+  using ArrayData::setRef;
+  using ArrayData::add;
+  using ArrayData::remove;
+
+  static CVarRef GetValueRef(const ArrayData* ad, ssize_t pos);
+
+  static bool ExistsInt(const ArrayData* ad, int64_t k);
+  static bool ExistsStr(const ArrayData* ad, const StringData* k);
+
+  static ArrayData* LvalInt(ArrayData*, int64_t k, Variant *&ret,
+                            bool copy);
+  static ArrayData* LvalStr(ArrayData*, StringData* k, Variant *&ret,
+                            bool copy);
+  static ArrayData* LvalNew(ArrayData*, Variant *&ret, bool copy);
+
+  static ArrayData* SetInt(ArrayData*, int64_t k, CVarRef v, bool copy);
+  static ArrayData* SetStr(ArrayData*, StringData* k, CVarRef v, bool copy);
+  static ArrayData* SetRefInt(ArrayData*, int64_t k, CVarRef v, bool copy);
+  static ArrayData* SetRefStr(ArrayData*, StringData* k, CVarRef v, bool copy);
+
+  static ArrayData *RemoveInt(ArrayData* ad, int64_t k, bool copy);
+  static ArrayData *RemoveStr(ArrayData* ad, const StringData* k, bool copy);
+
+  static ArrayData* Copy(const ArrayData*);
+  static ArrayData* NonSmartCopy(const ArrayData*);
+  static ArrayData* Append(ArrayData* a, CVarRef v, bool copy);
+  static ArrayData* AppendRef(ArrayData*, CVarRef v, bool copy);
+  static ArrayData* AppendWithRef(ArrayData*, CVarRef v, bool copy);
+  static ArrayData* Plus(ArrayData*, const ArrayData *elems);
+  static ArrayData* Merge(ArrayData*, const ArrayData *elems);
+  static ArrayData* Prepend(ArrayData*, CVarRef v, bool copy);
+
+  /**
+   * Non-Variant methods that override ArrayData
+   */
+  static TypedValue* NvGetInt(const ArrayData*, int64_t k);
+  static TypedValue* NvGetStr(const ArrayData*, const StringData* k);
+  static void NvGetKey(const ArrayData*, TypedValue* out, ssize_t pos);
+
+  static bool IsVectorData(const ArrayData* ad);
+
+  static ssize_t IterBegin(const ArrayData*);
+  static ssize_t IterEnd(const ArrayData*);
+  static ssize_t IterAdvance(const ArrayData*, ssize_t prev);
+  static ssize_t IterRewind(const ArrayData*, ssize_t prev);
+
+  static bool ValidFullPos(const ArrayData*, const FullPos& fp);
+  static bool AdvanceFullPos(ArrayData*, FullPos& fp);
+
+  static void Release(ArrayData*);
+
+  static ArrayData* Escalate(const ArrayData*);
+  static ArrayData* EscalateForSort(ArrayData*);
+  static void OnSetEvalScalar(ArrayData*);
+
+private:
+  static SliceArray* asSliceArray(ArrayData* ad);
+  static const SliceArray* asSliceArray(const ArrayData* ad);
+
+  TypedValue* elm(uint32_t i) const {
+    assert(i < m_size);
+    return &m_parent->data()[m_start + i].data;
+  }
+
+  HphpArray* m_parent;
+  uint32_t m_start;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // incl_HPHP_SLICE_ARRAY_H_
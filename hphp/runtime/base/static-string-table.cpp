@@ -15,11 +15,17 @@
 */
 #include "hphp/runtime/base/static-string-table.h"
 
-#include "folly/AtomicHashMap.h"
+#include <atomic>
+#include <memory>
+#include <sched.h>
+#include <sstream>
+#include <unordered_set>
+#include <vector>
 
 #include "hphp/runtime/base/class-info.h"
 #include "hphp/runtime/base/runtime-option.h"
 #include "hphp/runtime/base/rds.h"
+#include "hphp/util/hash.h"
 
 namespace HPHP {
 
@@ -27,96 +33,296 @@ namespace HPHP {
 
 namespace {
 
-// Pointer to StringData, or pointer to StringSlice.
-typedef intptr_t StrInternKey;
+/*
+ * The table is split into kNumShards shards by the low bits of the string
+ * hash.  Each shard is an open-addressing, linear-probing table of entry
+ * pointers.  Lookups never lock; inserts claim an empty slot with a CAS.
+ *
+ * When a shard gets half full, the inserter that notices grows it: it
+ * hangs a table twice the size off the old one's `next', then walks the
+ * old table, copying each entry across and turning each empty slot into
+ * kMovedSlot.  Since entries are never removed, a string is always found
+ * before the first empty slot on its probe path; a probe that meets
+ * kMovedSlot instead carries on in `next'.  So readers and other
+ * inserters keep going while one shard grows, and nothing else stalls.
+ * Old tables are never freed (readers may still be walking them); they
+ * add up to less than the live one.
+ */
+struct StrEntry {
+  StrEntry(StringData* s, strhash_t h)
+    : str(s)
+    , hash(h)
+    , link(RDS::kInvalidHandle)
+  {}
+
+  StringData* str;
+  strhash_t hash;
+  // Holds RDS handles for constants with this name.
+  RDS::Link<TypedValue> link;
+};
 
-constexpr intptr_t kAhmMagicThreshold = -3;
+StrEntry* const kMovedSlot = reinterpret_cast<StrEntry*>(1);
 
-StrInternKey make_intern_key(const StringData* sd) {
-  auto const ret = reinterpret_cast<StrInternKey>(sd);
-  assert(ret > 0);
-  return ret;
+bool isEntry(const StrEntry* e) {
+  return uintptr_t(e) > uintptr_t(kMovedSlot);
 }
 
-StrInternKey make_intern_key(const StringSlice* sl) {
-  auto const ret = -reinterpret_cast<StrInternKey>(sl);
-  assert(ret < 0 && ret < kAhmMagicThreshold);
-  return ret;
+struct StrTable {
+  explicit StrTable(size_t capacity)
+    : mask(capacity - 1)
+    , next(nullptr)
+    , slots(new std::atomic<StrEntry*>[capacity]) {
+    assert((capacity & mask) == 0);
+    for (size_t i = 0; i < capacity; ++i) {
+      slots[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  size_t capacity() const { return mask + 1; }
+
+  const size_t mask;
+  std::atomic<StrTable*> next;
+  std::unique_ptr<std::atomic<StrEntry*>[]> slots;
+};
+
+constexpr int kShardBits = 6;
+constexpr size_t kNumShards = size_t(1) << kShardBits;
+
+struct Shard {
+  std::atomic<StrTable*> table;
+  std::atomic<size_t> count;
+  std::atomic<bool> resizing;
+
+  // Insert statistics; see getStaticStringTableStats().
+  std::atomic<size_t> insertRaces;
+  std::atomic<size_t> resizes;
+} __attribute__((aligned(64)));
+
+Shard* s_shards;
+
+/*
+ * Lookups are far too frequent to bump shared counters on every one, so
+ * each thread counts its own and adds them to the totals every
+ * kLookupStatsBatch lookups.  The totals lag by less than that per
+ * thread.
+ */
+struct LookupStats {
+  size_t lookups;
+  size_t probes;
+  size_t collisions;
+};
+
+constexpr size_t kLookupStatsBatch = 1024;
+
+__thread LookupStats tl_lookupStats;
+
+struct {
+  std::atomic<size_t> lookups;
+  std::atomic<size_t> probes;
+  std::atomic<size_t> collisions;
+} s_lookupStats __attribute__((aligned(64)));
+
+Shard& shardFor(strhash_t h) {
+  return s_shards[size_t(h) & (kNumShards - 1)];
 }
 
-const StringData* to_sdata(StrInternKey key) {
-  assert(key > 0);
-  return reinterpret_cast<const StringData*>(key);
+size_t homeSlot(const StrTable* t, strhash_t h) {
+  return (size_t(h) >> kShardBits) & t->mask;
 }
 
-const StringSlice* to_sslice(StrInternKey key) {
-  assert(key < 0 && key < kAhmMagicThreshold);
-  return reinterpret_cast<const StringSlice*>(-key);
+void bump(std::atomic<size_t>& counter, size_t n = 1) {
+  counter.fetch_add(n, std::memory_order_relaxed);
 }
 
-// To avoid extra instructions in strintern_eq, we currently are
-// making use of the fact that StringSlice and StringData have the
-// same initial layout.  See the static_asserts in checkSane.
-const StringSlice* to_sslice_punned(StrInternKey key) {
-  if (UNLIKELY(key < 0)) {
-    return reinterpret_cast<const StringSlice*>(-key);
+bool strEq(const StringData* sd, StringSlice sl) {
+  return sd->size() == sl.len && wordsame(sd->data(), sl.ptr, sl.len);
+}
+
+/*
+ * Find the entry for sl, whose hash is h, or return nullptr.
+ */
+StrEntry* findEntry(StringSlice sl, strhash_t h) {
+  auto& shard = shardFor(h);
+  auto t = shard.table.load(std::memory_order_acquire);
+  size_t probes = 0;
+  StrEntry* ret = nullptr;
+  while (t) {
+    auto i = homeSlot(t, h);
+    bool moved = false;
+    for (size_t n = 0; n <= t->mask; ++n, i = (i + 1) & t->mask) {
+      ++probes;
+      auto const e = t->slots[i].load(std::memory_order_acquire);
+      if (!e) goto done;
+      if (e == kMovedSlot) {
+        moved = true;
+        break;
+      }
+      if (e->hash == h && strEq(e->str, sl)) {
+        ret = e;
+        goto done;
+      }
+    }
+    if (!moved) break;
+    t = t->next.load(std::memory_order_acquire);
+  }
+done:
+  auto& stats = tl_lookupStats;
+  stats.probes += probes;
+  if (probes > 1) ++stats.collisions;
+  if (UNLIKELY(++stats.lookups == kLookupStatsBatch)) {
+    bump(s_lookupStats.lookups, stats.lookups);
+    bump(s_lookupStats.probes, stats.probes);
+    bump(s_lookupStats.collisions, stats.collisions);
+    stats = LookupStats();
   }
-  // Actually a StringData*, but same layout.
-  return reinterpret_cast<const StringSlice*>(key);
+  return ret;
 }
 
-struct strintern_eq {
-  bool operator()(StrInternKey k1, StrInternKey k2) const {
-    if (k1 < 0) {
-      // AHM only gives lookup keys on the rhs of the equal operator
-      assert(k1 >= kAhmMagicThreshold);
-      return false;
+/*
+ * Put e in t (or a table after it), unless an entry for the same string
+ * is already there.  Returns the entry that ends up representing the
+ * string.  Only returns nullptr when t is full; the caller must wait for
+ * a grow to publish a bigger table.
+ */
+StrEntry* placeEntry(Shard& shard, StrTable* t, StrEntry* e) {
+  auto const sl = e->str->slice();
+  while (t) {
+    auto i = homeSlot(t, e->hash);
+    bool moved = false;
+    for (size_t n = 0; n <= t->mask; ++n, i = (i + 1) & t->mask) {
+      auto& slot = t->slots[i];
+      auto cur = slot.load(std::memory_order_acquire);
+      if (!cur) {
+        if (slot.compare_exchange_strong(cur, e,
+                                         std::memory_order_acq_rel)) {
+          return e;
+        }
+        // Somebody else filled or retired this slot first; look at
+        // what's there now.
+        bump(shard.insertRaces);
+      }
+      if (cur == kMovedSlot) {
+        moved = true;
+        break;
+      }
+      if (cur == e) return e;
+      if (cur->hash == e->hash && strEq(cur->str, sl)) return cur;
     }
-    assert(k2 >= 0 || k2 < kAhmMagicThreshold);
-    auto const sd1 = to_sdata(k1);
-    auto const s2 = to_sslice_punned(k2);
-    return sd1->size() == s2->len &&
-           wordsame(sd1->data(), s2->ptr, s2->len);
+    if (!moved) return nullptr;
+    t = t->next.load(std::memory_order_acquire);
   }
-};
+  return nullptr;
+}
 
-struct strintern_hash {
-  size_t operator()(StrInternKey k) const {
-    assert(k > 0 || k < kAhmMagicThreshold);
-    if (LIKELY(k > 0)) {
-      return to_sdata(k)->hash();
+void growShard(Shard& shard) {
+  bool expected = false;
+  if (!shard.resizing.compare_exchange_strong(expected, true)) return;
+
+  auto const old = shard.table.load(std::memory_order_acquire);
+  if (shard.count.load(std::memory_order_relaxed) * 2 <= old->capacity()) {
+    shard.resizing.store(false, std::memory_order_release);
+    return;
+  }
+
+  auto const fresh = new StrTable(old->capacity() * 2);
+  old->next.store(fresh, std::memory_order_release);
+  for (size_t i = 0; i <= old->mask; ++i) {
+    auto& slot = old->slots[i];
+    StrEntry* cur = nullptr;
+    if (slot.compare_exchange_strong(cur, kMovedSlot,
+                                     std::memory_order_acq_rel)) {
+      continue;
     }
-    auto const slice = *to_sslice(k);
-    return hash_string_inline(slice.ptr, slice.len);
+    assert(isEntry(cur));
+    DEBUG_ONLY auto const placed = placeEntry(shard, fresh, cur);
+    assert(placed == cur);
   }
-};
+  shard.table.store(fresh, std::memory_order_release);
+  shard.resizing.store(false, std::memory_order_release);
+  bump(shard.resizes);
+}
+
+/*
+ * Return the entry for sd's string, adding one for sd if there is none.
+ * If the returned entry isn't for sd, the caller should free sd.
+ */
+StrEntry* insertEntry(StringData* sd, strhash_t h) {
+  auto& shard = shardFor(h);
+  auto const e = new StrEntry(sd, h);
+  for (;;) {
+    auto const t = shard.table.load(std::memory_order_acquire);
+    auto const ret = placeEntry(shard, t, e);
+    if (ret == e) {
+      auto const n = shard.count.fetch_add(1, std::memory_order_relaxed) + 1;
+      if (n * 2 > shard.table.load(std::memory_order_relaxed)->capacity()) {
+        growShard(shard);
+      }
+      return e;
+    }
+    if (ret) {
+      delete e;
+      return ret;
+    }
+    // Every table on the chain is full; let the grower finish.
+    growShard(shard);
+    sched_yield();
+  }
+}
 
-// The uint32_t is used to hold RDS offsets for constants
-typedef folly::AtomicHashMap<
-  StrInternKey,
-  RDS::Link<TypedValue>,
-  strintern_hash,
-  strintern_eq
-> StringDataMap;
-StringDataMap* s_stringDataMap;
+template<class F>
+void forEachEntry(F f) {
+  for (size_t s = 0; s < kNumShards; ++s) {
+    auto t = s_shards[s].table.load(std::memory_order_acquire);
+    // While a shard grows, moved entries are in both tables of the chain.
+    std::vector<StrEntry*> emitted;
+    std::unordered_set<StrEntry*> seen;
+    for (bool first = true; t; first = false) {
+      for (size_t i = 0; i <= t->mask; ++i) {
+        auto const e = t->slots[i].load(std::memory_order_acquire);
+        if (!isEntry(e)) continue;
+        if (first) {
+          emitted.push_back(e);
+        } else if (!seen.insert(e).second) {
+          continue;
+        }
+        f(e);
+      }
+      t = t->next.load(std::memory_order_acquire);
+      if (first && t) seen.insert(emitted.begin(), emitted.end());
+    }
+  }
+}
+
+void create_string_data_map() {
+  auto const perShard =
+    RuntimeOption::EvalInitialStaticStringTableSize * 2 / kNumShards;
+  size_t capacity = 16;
+  while (capacity < perShard) capacity *= 2;
+  auto const shards = new Shard[kNumShards];
+  for (size_t s = 0; s < kNumShards; ++s) {
+    auto& shard = shards[s];
+    shard.table.store(new StrTable(capacity), std::memory_order_relaxed);
+    shard.count.store(0, std::memory_order_relaxed);
+    shard.resizing.store(false, std::memory_order_relaxed);
+    shard.insertRaces.store(0, std::memory_order_relaxed);
+    shard.resizes.store(0, std::memory_order_relaxed);
+  }
+  s_shards = shards;
+}
+
+StrEntry* findEntry(const StringData* sd) {
+  return findEntry(sd->slice(), sd->hash());
+}
 
 // If a string is static it better be the one in the table.
 DEBUG_ONLY bool checkStaticStr(const StringData* s) {
   assert(s->isStatic());
-  auto DEBUG_ONLY const it = s_stringDataMap->find(make_intern_key(s));
-  assert(it != s_stringDataMap->end());
-  assert(to_sdata(it->first) == s);
+  auto DEBUG_ONLY const e = findEntry(s);
+  assert(e != nullptr);
+  assert(e->str == s);
   return true;
 }
 
-void create_string_data_map() {
-  StringDataMap::Config config;
-  config.growthFactor = 1;
-  s_stringDataMap =
-    new StringDataMap(RuntimeOption::EvalInitialStaticStringTableSize,
-                      config);
-}
-
 StringData** precompute_chars() ATTRIBUTE_COLD;
 StringData** precompute_chars() {
   StringData** raw = new StringData*[256];
@@ -129,17 +335,13 @@ StringData** precompute_chars() {
 
 StringData** precomputed_chars = precompute_chars();
 
-StringData* insertStaticString(StringSlice slice) {
+StringData* insertStaticString(StringSlice slice, strhash_t h) {
   auto const sd = StringData::MakeStatic(slice);
-  auto pair = s_stringDataMap->insert(
-    make_intern_key(sd),
-    RDS::Link<TypedValue>(RDS::kInvalidHandle)
-  );
-  if (!pair.second) {
+  auto const e = insertEntry(sd, h);
+  if (e->str != sd) {
     sd->destructStatic();
   }
-  assert(to_sdata(pair.first->first) != nullptr);
-  return const_cast<StringData*>(to_sdata(pair.first->first));
+  return e->str;
 }
 
 }
@@ -147,45 +349,85 @@ StringData* insertStaticString(StringSlice slice) {
 //////////////////////////////////////////////////////////////////////
 
 size_t makeStaticStringCount() {
-  if (!s_stringDataMap) return 0;
-  return s_stringDataMap->size();
+  if (!s_shards) return 0;
+  size_t count = 0;
+  for (size_t s = 0; s < kNumShards; ++s) {
+    count += s_shards[s].count.load(std::memory_order_relaxed);
+  }
+  return count;
+}
+
+StaticStringTableStats getStaticStringTableStats() {
+  StaticStringTableStats stats{};
+  if (!s_shards) return stats;
+  auto const load = [] (const std::atomic<size_t>& c) {
+    return c.load(std::memory_order_relaxed);
+  };
+  for (size_t s = 0; s < kNumShards; ++s) {
+    auto const& shard = s_shards[s];
+    stats.strings += load(shard.count);
+    stats.capacity +=
+      shard.table.load(std::memory_order_acquire)->capacity();
+    stats.insertRaces += load(shard.insertRaces);
+    stats.resizes += load(shard.resizes);
+  }
+  stats.shards = kNumShards;
+  stats.lookups = load(s_lookupStats.lookups);
+  stats.probes = load(s_lookupStats.probes);
+  stats.collisions = load(s_lookupStats.collisions);
+  return stats;
+}
+
+std::string getStaticStringTableStatsJson() {
+  auto const stats = getStaticStringTableStats();
+  std::ostringstream out;
+  out << "{ \"shards\":" << stats.shards
+      << ", \"strings\":" << stats.strings
+      << ", \"capacity\":" << stats.capacity
+      << ", \"lookups\":" << stats.lookups
+      << ", \"probes\":" << stats.probes
+      << ", \"collisions\":" << stats.collisions
+      << ", \"insert_races\":" << stats.insertRaces
+      << ", \"resizes\":" << stats.resizes
+      << ", \"hash\":\""
+      << stringHashFunctionName(stringHashFunction()) << "\"}\n";
+  return out.str();
 }
 
 StringData* makeStaticString(const StringData* str) {
-  if (UNLIKELY(!s_stringDataMap)) {
+  if (UNLIKELY(!s_shards)) {
     create_string_data_map();
   }
   if (str->isStatic()) {
     assert(checkStaticStr(str));
     return const_cast<StringData*>(str);
   }
-  auto const it = s_stringDataMap->find(make_intern_key(str));
-  if (it != s_stringDataMap->end()) {
-    return const_cast<StringData*>(to_sdata(it->first));
+  auto const h = str->hash();
+  if (auto const e = findEntry(str->slice(), h)) {
+    return e->str;
   }
-  return insertStaticString(str->slice());
+  return insertStaticString(str->slice(), h);
 }
 
 StringData* makeStaticString(StringSlice slice) {
-  if (UNLIKELY(!s_stringDataMap)) {
+  if (UNLIKELY(!s_shards)) {
     create_string_data_map();
   }
-  auto const it = s_stringDataMap->find(make_intern_key(&slice));
-  if (it != s_stringDataMap->end()) {
-    return const_cast<StringData*>(to_sdata(it->first));
+  auto const h = hash_string_inline(slice.ptr, slice.len);
+  if (auto const e = findEntry(slice, h)) {
+    return e->str;
   }
-  return insertStaticString(slice);
+  return insertStaticString(slice, h);
 }
 
 StringData* lookupStaticString(const StringData *str) {
-  if (UNLIKELY(!s_stringDataMap)) return nullptr;
+  if (UNLIKELY(!s_shards)) return nullptr;
   if (str->isStatic()) {
     assert(checkStaticStr(str));
     return const_cast<StringData*>(str);
   }
-  auto const it = s_stringDataMap->find(make_intern_key(str));
-  if (it != s_stringDataMap->end()) {
-    return const_cast<StringData*>(to_sdata(it->first));
+  if (auto const e = findEntry(str)) {
+    return e->str;
   }
   return nullptr;
 }
@@ -218,10 +460,9 @@ StringData* makeStaticString(char c) {
 }
 
 RDS::Handle lookupCnsHandle(const StringData* cnsName) {
-  assert(s_stringDataMap);
-  auto const it = s_stringDataMap->find(make_intern_key(cnsName));
-  if (it != s_stringDataMap->end()) {
-    return it->second.handle();
+  assert(s_shards);
+  if (auto const e = findEntry(cnsName)) {
+    return e->link.handle();
   }
   return 0;
 }
@@ -235,41 +476,39 @@ RDS::Handle makeCnsHandle(const StringData* cnsName, bool persistent) {
     // the request local RDS::s_constants instead.
     return 0;
   }
-  auto const it = s_stringDataMap->find(make_intern_key(cnsName));
-  assert(it != s_stringDataMap->end());
-  it->second.bind<kTVXmmAlign>(persistent ? RDS::Mode::Persistent
-                                          : RDS::Mode::Normal);
-  return it->second.handle();
+  auto const e = findEntry(cnsName);
+  assert(e);
+  e->link.bind<kTVXmmAlign>(persistent ? RDS::Mode::Persistent
+                                       : RDS::Mode::Normal);
+  return e->link.handle();
 }
 
 const StaticString s_user("user");
 const StaticString s_Core("Core");
 Array lookupDefinedConstants(bool categorize /*= false */) {
-  assert(s_stringDataMap);
+  assert(s_shards);
   Array usr(RDS::s_constants());
   Array sys;
 
-  for (StringDataMap::const_iterator it = s_stringDataMap->begin();
-       it != s_stringDataMap->end(); ++it) {
-    if (it->second.bound()) {
-      Array *tbl = (categorize &&
-                    RDS::isPersistentHandle(it->second.handle()))
-                 ? &sys : &usr;
-      auto& tv = *it->second;
-      if (tv.m_type != KindOfUninit) {
-        StrNR key(const_cast<StringData*>(to_sdata(it->first)));
-        tbl->set(key, tvAsVariant(&tv), true);
-      } else if (tv.m_data.pref) {
-        StrNR key(const_cast<StringData*>(to_sdata(it->first)));
-        ClassInfo::ConstantInfo* ci =
-          (ClassInfo::ConstantInfo*)(void*)tv.m_data.pref;
-        auto cns = ci->getDeferredValue();
-        if (cns.isInitialized()) {
-          tbl->set(key, cns, true);
-        }
+  forEachEntry([&] (StrEntry* e) {
+    if (!e->link.bound()) return;
+    Array *tbl = (categorize &&
+                  RDS::isPersistentHandle(e->link.handle()))
+               ? &sys : &usr;
+    auto& tv = *e->link;
+    if (tv.m_type != KindOfUninit) {
+      StrNR key(e->str);
+      tbl->set(key, tvAsVariant(&tv), true);
+    } else if (tv.m_data.pref) {
+      StrNR key(e->str);
+      ClassInfo::ConstantInfo* ci =
+        (ClassInfo::ConstantInfo*)(void*)tv.m_data.pref;
+      auto cns = ci->getDeferredValue();
+      if (cns.isInitialized()) {
+        tbl->set(key, cns, true);
       }
     }
-  }
+  });
 
   if (categorize) {
     Array ret;
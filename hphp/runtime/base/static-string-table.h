@@ -86,6 +86,31 @@ StringData* lookupStaticString(const StringData* str);
  */
 size_t makeStaticStringCount();
 
+/*
+ * Counters for the static string table, summed over its shards.  Probes
+ * counts slots examined by lookups; a collision is a lookup that looked
+ * past its home slot, and an insert race is an insert that lost a slot
+ * to another thread.  The lookup counters are batched per thread, so
+ * they trail the real numbers a little.
+ */
+struct StaticStringTableStats {
+  size_t shards;
+  size_t strings;
+  size_t capacity;
+  size_t lookups;
+  size_t probes;
+  size_t collisions;
+  size_t insertRaces;
+  size_t resizes;
+};
+StaticStringTableStats getStaticStringTableStats();
+
+/*
+ * The same counters, and the string hash in use, as the JSON object the
+ * /static-strings-stats admin command returns.
+ */
+std::string getStaticStringTableStatsJson();
+
 /*
  * Functions mapping constants to RDS handles to their values in a
  * given request.
@@ -45,7 +45,9 @@ StringBuffer::StringBuffer(int initialSize /* = SmallStringReserve */)
 }
 
 StringBuffer::~StringBuffer() {
-  if (m_str) {
+  if (UNLIKELY(isAdopted())) {
+    decRefStr(m_str);
+  } else if (m_str) {
     assert((m_str->setSize(0), true)); // appease StringData::checkSane()
     m_str->release();
   }
@@ -53,7 +55,9 @@ StringBuffer::~StringBuffer() {
 
 const char *StringBuffer::data() const {
   if (m_buffer && m_len) {
-    m_buffer[m_len] = '\0'; // fixup
+    // An adopted string is already terminated, and may be an APC
+    // string whose bytes aren't ours to write.
+    if (LIKELY(!isAdopted())) m_buffer[m_len] = '\0'; // fixup
     return m_buffer;
   }
   return nullptr;
@@ -61,6 +65,15 @@ const char *StringBuffer::data() const {
 
 String StringBuffer::detach() {
   if (m_buffer && m_len) {
+    if (UNLIKELY(isAdopted())) {
+      String ret(m_str);
+      m_str->decRefCount();
+      m_str = 0;
+      m_buffer = 0;
+      m_len = 0;
+      m_cap = 0;
+      return ret;
+    }
     assert(m_str && m_str->getCount() == 0);
     m_buffer[m_len] = '\0'; // fixup
     StringData* str = m_str;
@@ -75,6 +88,7 @@ String StringBuffer::detach() {
 }
 
 String StringBuffer::copy() const {
+  if (UNLIKELY(isAdopted())) return String(m_str);
   return String(data(), size(), CopyString);
 }
 
@@ -105,11 +119,19 @@ void StringBuffer::absorb(StringBuffer& buf) {
 }
 
 void StringBuffer::clear() {
+  if (UNLIKELY(isAdopted())) {
+    decRefStr(m_str);
+    m_str = 0;
+    m_buffer = 0;
+    m_cap = 0;
+  }
   m_len = 0;
 }
 
 void StringBuffer::release() {
-  if (m_str) {
+  if (UNLIKELY(isAdopted())) {
+    decRefStr(m_str);
+  } else if (m_str) {
     assert(m_str->getCount() == 0);
     m_buffer[m_len] = 0; // appease StringData::checkSane()
     m_str->release();
@@ -121,6 +143,7 @@ void StringBuffer::release() {
 
 void StringBuffer::resize(int size) {
   assert(size >= 0 && size <= m_cap);
+  if (UNLIKELY(isAdopted()) && size != m_len) unshare(m_len);
   if (size >= 0 && size <= m_cap) {
     m_len = size;
   }
@@ -129,6 +152,8 @@ void StringBuffer::resize(int size) {
 char* StringBuffer::appendCursor(int size) {
   if (!m_buffer) {
     makeValid(size);
+  } else if (UNLIKELY(isAdopted())) {
+    unshare(m_len + size);
   } else if (m_cap - m_len < size) {
     m_buffer[m_len] = 0;
     m_str->setSize(m_len);
@@ -220,6 +245,32 @@ void StringBuffer::appendHelper(const char *s, int len) {
   m_len += len;
 }
 
+void StringBuffer::appendHelper(const StringData* s) {
+  auto const len = s->size();
+  if (!m_len && len && len <= m_maxBytes && !s->isStatic()) {
+    release();
+    s->incRefCount();
+    m_str = const_cast<StringData*>(s);
+    // Never written through: unshare() copies before any write.
+    m_buffer = m_str->mutableData();
+    m_len = m_cap = len;
+    assert(isAdopted());
+    return;
+  }
+  appendHelper(s->data(), len);
+}
+
+void StringBuffer::unshare(int minCap) {
+  assert(isAdopted() && minCap >= m_len);
+  auto const sd = StringData::Make(minCap);
+  auto const s = sd->bufferSlice();
+  memcpy(s.ptr, m_buffer, m_len);
+  decRefStr(m_str);
+  m_str = sd;
+  m_buffer = s.ptr;
+  m_cap = s.len;
+}
+
 void StringBuffer::printf(const char *format, ...) {
   va_list ap;
   va_start(ap, format);
@@ -300,6 +351,11 @@ void StringBuffer::growBy(int spaceRequired) {
     }
   }
 
+  if (UNLIKELY(isAdopted())) {
+    unshare(new_size);
+    return;
+  }
+
   m_buffer[m_len] = 0;
   m_str->setSize(m_len);
   auto const tmp = m_str->reserve(new_size);
@@ -153,9 +153,17 @@ struct StringBuffer {
   }
   void append(unsigned char c) { append((char)c);}
   void append(const char* s) { assert(s); append(s, strlen(s)); }
-  void append(const String& s) { append(s.data(), s.size()); }
+  void append(const String& s) { if (s.get()) append(s.get()); }
   void append(const std::string& s) { append(s.data(), s.size()); }
-  void append(const StringData* s) { append(s->data(), s->size()); }
+  void append(const StringData* s) {
+    auto const len = s->size();
+    if (m_buffer && len <= m_cap - m_len) {
+      memcpy(m_buffer + m_len, s->data(), len);
+      m_len += len;
+      return;
+    }
+    appendHelper(s);
+  }
   void append(const char* s, int len) {
     assert(len >= 0);
     if (m_buffer && len <= m_cap - m_len) {
@@ -190,11 +198,29 @@ struct StringBuffer {
 
 private:
   void appendHelper(const char* s, int len);
+  void appendHelper(const StringData* s);
   void appendHelper(char c);
   void growBy(int spaceRequired);
   void makeValid(int minCap);
   bool valid() const { return m_buffer != nullptr; }
 
+  /*
+   * A string appended to an empty buffer that would have had to grow
+   * anyway is adopted: the buffer takes a reference to it instead of
+   * copying its bytes, and m_cap is set to m_len so the next write
+   * goes through a slow path.  The copy is only made (by unshare()) if
+   * the buffer is written to again; echoing a page that was built up
+   * elsewhere and then fetching it with ob_get_clean() copies nothing.
+   * That includes APC strings, whose bytes belong to the SharedVariant:
+   * the reference keeps it alive, and nothing writes through m_buffer
+   * while the string is adopted.
+   *
+   * The buffer's own string always has a refcount of zero, so a
+   * non-zero count is what marks an adopted one.
+   */
+  bool isAdopted() const { return m_str && m_str->getCount() != 0; }
+  void unshare(int minCap);
+
 private:
   StringData* m_str;
   char *m_buffer;
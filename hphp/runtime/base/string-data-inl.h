@@ -102,6 +102,10 @@ inline SharedVariant* StringData::getSharedVariant() const {
   return nullptr;
 }
 
+inline bool StringData::canMutateInPlace() const {
+  return getCount() == 1 && !isShared();
+}
+
 inline StringSlice StringData::slice() const {
   return StringSlice(m_data, m_len);
 }
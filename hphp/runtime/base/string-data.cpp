@@ -239,8 +239,10 @@ void StringData::releaseDataSlowPath() {
   assert(isShared());
   assert(checkSane());
 
-  sharedPayload()->shared->decRef();
-  delist();
+  if (LIKELY(sharedPayload()->node.next != nullptr)) {
+    sharedPayload()->shared->decRef();
+    delist();
+  }
   freeForSize(this, sizeof(StringData) + sizeof(SharedPayload));
 }
 
@@ -319,8 +321,10 @@ StringData* StringData::reserve(int cap) {
 
   if (cap + 1 <= capacity()) return this;
 
-  cap += cap >> 2;
-  if (cap > MaxCap) cap = MaxCap;
+  // Strings that outgrow their buffer are mostly being built up by a
+  // run of appends, so leave half again as much room for the next ones.
+  auto const grown = int64_t{cap} + (cap >> 1);
+  cap = grown > MaxCap ? MaxCap : grown;
 
   auto const sd = Make(cap);
   auto const src = slice();
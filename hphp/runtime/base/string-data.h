@@ -128,6 +128,13 @@ struct StringData {
    */
   static StringData* Make(SharedVariant* shared);
 
+  /*
+   * Like Make(SharedVariant*), but without taking a reference on the
+   * SharedVariant, for callers that hold one for the rest of the
+   * request themselves (see SharedVariant::toLocal).
+   */
+  static StringData* MakeBorrowed(SharedVariant* shared);
+
   /*
    * Create a StringData that is allocated by malloc, instead of the
    * smart allocator.
@@ -199,6 +206,13 @@ struct StringData {
    */
   SharedVariant* getSharedVariant() const;
 
+  /*
+   * Whether this string's buffer may be written in place: nothing else
+   * refers to it, and it is neither static nor backed by APC memory.
+   * Writers must still call setSize() or invalidateHash() (see below).
+   */
+  bool canMutateInPlace() const;
+
   /*
    * Append the supplied range to this string.  If there is not
    * sufficient capacity in this string to contain the range, a new
@@ -416,13 +430,16 @@ struct StringData {
   void dump() const;
 
 private:
+  // A borrowed string (MakeBorrowed) holds no reference on `shared',
+  // so it isn't on the sweep list either: its node.next is null.
   struct SharedPayload {
     SweepNode node;
     SharedVariant* shared;
   };
 
 private:
-  static StringData* MakeSVSlowPath(SharedVariant*, uint32_t len);
+  static StringData* MakeSVSlowPath(SharedVariant*, uint32_t len,
+                                    bool borrowed);
 
   StringData(const StringData&) = delete;
   StringData& operator=(const StringData&) = delete;
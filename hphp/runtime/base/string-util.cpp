@@ -207,6 +207,12 @@ String StringUtil::HtmlEncode(const String& input, QuoteStyle quoteStyle,
   }
 
   int len = input.size();
+  if (string_html_encode_span(input.data(), len,
+                              quoteStyle != QuoteStyle::No,
+                              quoteStyle == QuoteStyle::Both,
+                              utf8, nbsp) == len) {
+    return input;
+  }
   char *ret = string_html_encode(input.data(), len,
                                  quoteStyle != QuoteStyle::No,
                                  quoteStyle == QuoteStyle::Both,
@@ -294,6 +300,10 @@ String StringUtil::HtmlEncodeExtra(const String& input, QuoteStyle quoteStyle,
   }
 
   int len = input.size();
+  if (string_html_encode_extra_span(input.data(), len,
+                                    (StringHtmlEncoding)flags, am) == len) {
+    return input;
+  }
   char *ret = string_html_encode_extra(input.data(), len,
                                        (StringHtmlEncoding)flags, am);
   if (!ret) {
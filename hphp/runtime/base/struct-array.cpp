@@ -0,0 +1,374 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+#include "hphp/runtime/base/struct-array.h"
+
+#include <atomic>
+
+#include <tbb/concurrent_hash_map.h>
+
+#include "hphp/runtime/base/array-init.h"
+#include "hphp/runtime/base/array-iterator.h"
+#include "hphp/runtime/base/runtime-error.h"
+
+namespace HPHP {
+
+//////////////////////////////////////////////////////////////////////
+
+static_assert(sizeof(StructArray) == 32,
+              "StructArray values are assumed to start 32 bytes in.");
+
+namespace {
+
+typedef tbb::concurrent_hash_map<std::string, StructLayout*> LayoutMap;
+
+LayoutMap s_layoutMap;
+std::atomic<uint32_t> s_numLayouts(0);
+std::atomic<StructLayout*> s_layouts[StructLayout::kMaxLayouts];
+
+std::string layoutSignature(const StringData* const* keys, uint32_t n) {
+  std::string sig;
+  for (uint32_t i = 0; i < n; ++i) {
+    uint32_t len = keys[i]->size();
+    sig.append(reinterpret_cast<const char*>(&len), sizeof len);
+    sig.append(keys[i]->data(), len);
+  }
+  return sig;
+}
+
+}
+
+const StructLayout* StructLayout::Intern(const StringData* const* keys,
+                                         uint32_t n) {
+  if (n == 0 || n > kMaxKeys) return nullptr;
+
+  auto const sig = layoutSignature(keys, n);
+  {
+    LayoutMap::const_accessor acc;
+    if (s_layoutMap.find(acc, sig)) return acc->second;
+  }
+  if (s_numLayouts.load(std::memory_order_relaxed) >= kMaxLayouts) {
+    return nullptr;
+  }
+
+  LayoutMap::accessor acc;
+  if (!s_layoutMap.insert(acc, sig)) return acc->second;
+  acc->second = nullptr;
+
+  std::vector<StringData*> staticKeys;
+  staticKeys.reserve(n);
+  for (uint32_t i = 0; i < n; ++i) {
+    int64_t ignore;
+    if (keys[i]->isStrictlyInteger(ignore)) return nullptr;
+    for (uint32_t j = 0; j < i; ++j) {
+      if (keys[j]->same(keys[i])) return nullptr;
+    }
+    staticKeys.push_back(makeStaticString(keys[i]));
+  }
+
+  auto const id = s_numLayouts.fetch_add(1, std::memory_order_relaxed);
+  if (id >= kMaxLayouts) return nullptr;
+  auto const layout = new StructLayout(id, std::move(staticKeys));
+  s_layouts[id].store(layout, std::memory_order_release);
+  acc->second = layout;
+  return layout;
+}
+
+const StructLayout* StructLayout::FromId(uint32_t id) {
+  assert(id < kMaxLayouts);
+  return s_layouts[id].load(std::memory_order_acquire);
+}
+
+int32_t StructLayout::find(const StringData* k) const {
+  auto const n = size();
+  for (uint32_t i = 0; i < n; ++i) {
+    if (m_keys[i] == k) return i;
+  }
+  auto const h = k->hash();
+  for (uint32_t i = 0; i < n; ++i) {
+    if (m_keys[i]->hash() == h && m_keys[i]->same(k)) return i;
+  }
+  return -1;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+StructArray* StructArray::Make(const StructLayout* layout) {
+  auto const n = layout->size();
+  auto const mem = MM().objMalloc(allocBytes(n));
+  auto const a = new (mem) StructArray(layout);
+  auto const vals = a->data();
+  for (uint32_t i = 0; i < n; ++i) tvWriteNull(&vals[i]);
+  return a;
+}
+
+inline StructArray* StructArray::asStructArray(ArrayData* ad) {
+  assert(ad->kind() == kStructKind);
+  return static_cast<StructArray*>(ad);
+}
+
+inline const StructArray* StructArray::asStructArray(const ArrayData* ad) {
+  assert(ad->kind() == kStructKind);
+  return static_cast<const StructArray*>(ad);
+}
+
+void StructArray::Release(ArrayData* ad) {
+  auto const a = asStructArray(ad);
+  if (UNLIKELY(a->m_cycleRoot)) CycleCollector::forgetRoot(a);
+  auto const n = a->m_size;
+  auto const vals = a->data();
+  for (uint32_t i = 0; i < n; ++i) tvRefcountedDecRef(&vals[i]);
+  MM().objFree(a, allocBytes(n));
+}
+
+CVarRef StructArray::GetValueRef(const ArrayData* ad, ssize_t pos) {
+  auto const a = asStructArray(ad);
+  assert(size_t(pos) < a->m_size);
+  return tvAsCVarRef(&a->data()[pos]);
+}
+
+bool StructArray::IsVectorData(const ArrayData* ad) {
+  // Every key is a non-integer string and a layout has at least one.
+  return false;
+}
+
+bool StructArray::ExistsInt(const ArrayData* ad, int64_t k) {
+  return false;
+}
+
+bool StructArray::ExistsStr(const ArrayData* ad, const StringData* k) {
+  return asStructArray(ad)->m_layout->find(k) >= 0;
+}
+
+TypedValue* StructArray::NvGetInt(const ArrayData* ad, int64_t k) {
+  return nullptr;
+}
+
+TypedValue* StructArray::NvGetStr(const ArrayData* ad, const StringData* k) {
+  auto const a = asStructArray(ad);
+  auto const i = a->m_layout->find(k);
+  if (i < 0) return nullptr;
+  return const_cast<TypedValue*>(&a->data()[i]);
+}
+
+void StructArray::NvGetKey(const ArrayData* ad, TypedValue* out, ssize_t pos) {
+  auto const a = asStructArray(ad);
+  assert(size_t(pos) < a->m_size);
+  auto const key = a->m_layout->key(pos);
+  out->m_data.pstr = key;
+  out->m_type = KindOfString;
+  key->incRefCount();
+}
+
+TypedValue StructArray::GetCellStr(ArrayData* ad, const StringData* k) {
+  auto const a = asStructArray(ad);
+  auto const i = a->m_layout->find(k);
+  TypedValue ret;
+  if (UNLIKELY(i < 0)) {
+    getNotFound(k);
+    tvWriteNull(&ret);
+    return ret;
+  }
+  cellDup(*tvToCell(&a->data()[i]), ret);
+  return ret;
+}
+
+/* if a2 is modified copy of a1 (i.e. != a1), then release a1 and return a2 */
+static inline ArrayData* releaseIfCopied(ArrayData* a1, ArrayData* a2) {
+  if (a1 != a2) a1->release();
+  return a2;
+}
+
+ArrayData* StructArray::LvalInt(ArrayData* ad, int64_t k, Variant*& ret,
+                                bool copy) {
+  ArrayData *escalated = Escalate(ad);
+  return releaseIfCopied(escalated, escalated->lval(k, ret, false));
+}
+
+ArrayData* StructArray::LvalStr(ArrayData* ad, StringData* k, Variant*& ret,
+                                bool copy) {
+  auto a = asStructArray(ad);
+  auto const i = a->m_layout->find(k);
+  if (i < 0) {
+    ArrayData *escalated = Escalate(ad);
+    return releaseIfCopied(escalated, escalated->lval(k, ret, false));
+  }
+  if (copy) a = asStructArray(Copy(a));
+  ret = &a->valAt(i);
+  return a;
+}
+
+ArrayData* StructArray::LvalNew(ArrayData* ad, Variant*& ret, bool copy) {
+  ArrayData *escalated = Escalate(ad);
+  return releaseIfCopied(escalated, escalated->lvalNew(ret, false));
+}
+
+ArrayData*
+StructArray::SetInt(ArrayData* ad, int64_t k, CVarRef v, bool copy) {
+  ArrayData *escalated = Escalate(ad);
+  return releaseIfCopied(escalated, escalated->set(k, v, false));
+}
+
+ArrayData*
+StructArray::SetStr(ArrayData* ad, StringData* k, CVarRef v, bool copy) {
+  auto a = asStructArray(ad);
+  auto const i = a->m_layout->find(k);
+  if (i < 0) {
+    ArrayData *escalated = Escalate(ad);
+    return releaseIfCopied(escalated, escalated->set(k, v, false));
+  }
+  if (copy) a = asStructArray(Copy(a));
+  a->valAt(i).assignVal(v);
+  return a;
+}
+
+ArrayData*
+StructArray::SetRefInt(ArrayData* ad, int64_t k, CVarRef v, bool copy) {
+  ArrayData *escalated = Escalate(ad);
+  return releaseIfCopied(escalated, escalated->setRef(k, v, false));
+}
+
+ArrayData*
+StructArray::SetRefStr(ArrayData* ad, StringData* k, CVarRef v, bool copy) {
+  auto a = asStructArray(ad);
+  auto const i = a->m_layout->find(k);
+  if (i < 0) {
+    ArrayData *escalated = Escalate(ad);
+    return releaseIfCopied(escalated, escalated->setRef(k, v, false));
+  }
+  if (copy) a = asStructArray(Copy(a));
+  a->valAt(i).assignRef(v);
+  return a;
+}
+
+ArrayData* StructArray::RemoveInt(ArrayData* ad, int64_t k, bool copy) {
+  // There are no int keys, so there is nothing to remove.
+  return ad;
+}
+
+ArrayData*
+StructArray::RemoveStr(ArrayData* ad, const StringData* k, bool copy) {
+  if (asStructArray(ad)->m_layout->find(k) < 0) return ad;
+  ArrayData *escalated = Escalate(ad);
+  return releaseIfCopied(escalated, escalated->remove(k, false));
+}
+
+ArrayData* StructArray::Copy(const ArrayData* ad) {
+  auto const a = asStructArray(ad);
+  auto const ret = Make(a->m_layout);
+  auto const src = a->data();
+  auto const dst = ret->data();
+  for (uint32_t i = 0, n = a->m_size; i < n; ++i) {
+    tvDupFlattenVars(&src[i], &dst[i], a);
+  }
+  ret->m_pos = a->m_pos;
+  return ret;
+}
+
+ArrayData* StructArray::NonSmartCopy(const ArrayData* ad) {
+  Array escalated = Escalate(ad);
+  return escalated->nonSmartCopy();
+}
+
+ArrayData* StructArray::Append(ArrayData* ad, CVarRef v, bool copy) {
+  ArrayData *escalated = Escalate(ad);
+  return releaseIfCopied(escalated, escalated->append(v, false));
+}
+
+ArrayData* StructArray::AppendRef(ArrayData* ad, CVarRef v, bool copy) {
+  ArrayData *escalated = Escalate(ad);
+  return releaseIfCopied(escalated, escalated->appendRef(v, false));
+}
+
+ArrayData* StructArray::AppendWithRef(ArrayData* ad, CVarRef v, bool copy) {
+  ArrayData *escalated = Escalate(ad);
+  return releaseIfCopied(escalated, escalated->appendWithRef(v, false));
+}
+
+ArrayData* StructArray::Plus(ArrayData* ad, const ArrayData* elems) {
+  Array escalated = Escalate(ad);
+  return escalated->plus(elems);
+}
+
+ArrayData* StructArray::Merge(ArrayData* ad, const ArrayData* elems) {
+  Array escalated = Escalate(ad);
+  return escalated->merge(elems);
+}
+
+ArrayData* StructArray::Prepend(ArrayData* ad, CVarRef v, bool copy) {
+  ArrayData *escalated = Escalate(ad);
+  return releaseIfCopied(escalated, escalated->prepend(v, false));
+}
+
+/*
+ * Rebuild as a mixed HphpArray with the same keys, values and internal
+ * position.  References stay references, since the caller replaces this
+ * array with the result rather than copying it.
+ */
+ArrayData* StructArray::Escalate(const ArrayData* ad) {
+  auto const a = asStructArray(ad);
+  auto const n = a->m_size;
+  ArrayInit ai(n, ArrayInit::mapInit);
+  auto const vals = a->data();
+  for (uint32_t i = 0; i < n; ++i) {
+    String key(a->m_layout->key(i));
+    if (vals[i].m_type == KindOfRef) {
+      ai.setRef(key, tvAsCVarRef(&vals[i]), true);
+    } else {
+      ai.add(key, tvAsCVarRef(&vals[i]), true);
+    }
+  }
+  auto const ret = ai.create();
+  ret->setPosition(a->m_pos);
+  return ret;
+}
+
+ArrayData* StructArray::EscalateForSort(ArrayData* ad) {
+  return Escalate(ad);
+}
+
+ssize_t StructArray::IterBegin(const ArrayData* ad) {
+  return 0;
+}
+
+ssize_t StructArray::IterEnd(const ArrayData* ad) {
+  return asStructArray(ad)->m_size - 1;
+}
+
+ssize_t StructArray::IterAdvance(const ArrayData* ad, ssize_t prev) {
+  auto const a = asStructArray(ad);
+  assert(prev >= 0 && prev < a->m_size);
+  ssize_t next = prev + 1;
+  return next < a->m_size ? next : invalid_index;
+}
+
+ssize_t StructArray::IterRewind(const ArrayData* ad, ssize_t prev) {
+  assert(prev >= 0 && prev < asStructArray(ad)->m_size);
+  ssize_t next = prev - 1;
+  return next >= 0 ? next : invalid_index;
+}
+
+bool StructArray::ValidFullPos(const ArrayData* ad, const FullPos& fp) {
+  // Strong iteration escalates to an HphpArray first.
+  assert(fp.getContainer() == ad);
+  return false;
+}
+
+bool StructArray::AdvanceFullPos(ArrayData* ad, FullPos& fp) {
+  return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,176 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+
+#ifndef incl_HPHP_STRUCT_ARRAY_H_
+#define incl_HPHP_STRUCT_ARRAY_H_
+
+#include <vector>
+
+#include "hphp/runtime/base/array-data.h"
+#include "hphp/runtime/base/complex-types.h"
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/*
+ * An interned, immutable list of string keys shared by every StructArray
+ * built with that key set, in the spirit of a hidden class.  Layouts live
+ * forever and are numbered densely from 0, so a layout id is a stable
+ * handle that generated code and profiling can hold on to.
+ */
+struct StructLayout {
+  static constexpr uint32_t kMaxKeys = 64;
+  static constexpr uint32_t kMaxLayouts = 4096;
+
+  /*
+   * Return the layout with exactly these keys in this order, creating it
+   * on first use.  Returns nullptr when the keys can't be a layout: no
+   * keys or more than kMaxKeys, a duplicate, a key that an array would
+   * store as an integer, or a full layout table.
+   */
+  static const StructLayout* Intern(const StringData* const* keys,
+                                    uint32_t n);
+  static const StructLayout* FromId(uint32_t id);
+
+  uint32_t id() const { return m_id; }
+  uint32_t size() const { return m_keys.size(); }
+  StringData* key(uint32_t i) const { return m_keys[i]; }
+
+  /*
+   * Slot of k in this layout, or -1.  Keys are static strings, so
+   * literal keys usually match on pointer equality alone.
+   */
+  int32_t find(const StringData* k) const;
+
+private:
+  StructLayout(uint32_t id, std::vector<StringData*>&& keys)
+    : m_id(id), m_keys(std::move(keys)) {}
+
+  uint32_t m_id;
+  std::vector<StringData*> m_keys;
+};
+
+/*
+ * Array of string keys laid out by a shared StructLayout.  Only the
+ * values live in the array; reads and writes to existing keys index
+ * straight into them.  Any change of shape (new or removed keys, int
+ * keys, appends, sorting, strong iteration) escalates to an HphpArray.
+ */
+class StructArray : public ArrayData {
+  explicit StructArray(const StructLayout* layout)
+    : ArrayData(kStructKind, AllocationMode::smart, layout->size())
+    , m_layout(layout) {}
+
+public:
+  /*
+   * Make an array with the given layout and every value null.  The
+   * returned array has a refcount of zero.
+   */
+  static StructArray* Make(const StructLayout* layout);
+
+  const StructLayout* layout() const { return m_layout; }
+  TypedValue* data() { return reinterpret_cast<TypedValue*>(this + 1); }
+  const TypedValue* data() const {
+    return reinterpret_cast<const TypedValue*>(this + 1);
+  }
+  Variant& valAt(uint32_t i) {
+    assert(i < m_size);
+    return tvAsVariant(&data()[i]);
+  }
+
+  // these using directives ensure the full set of overloaded functions
+  // are visible in this class, to avoid triggering implicit conversions
+  // from a CVarRef key to int64.
+  using ArrayData::exists;
+  using ArrayData::lval;
+  using ArrayData::lvalNew;
+  using ArrayData::set;
+  using ArrayData::setRef;
+  using ArrayData::add;
+  using ArrayData::remove;
+
+  static CVarRef GetValueRef(const ArrayData* ad, ssize_t pos);
+
+  static bool ExistsInt(const ArrayData* ad, int64_t k);
+  static bool ExistsStr(const ArrayData* ad, const StringData* k);
+
+  static ArrayData* LvalInt(ArrayData*, int64_t k, Variant *&ret,
+                            bool copy);
+  static ArrayData* LvalStr(ArrayData*, StringData* k, Variant *&ret,
+                            bool copy);
+  static ArrayData* LvalNew(ArrayData*, Variant *&ret, bool copy);
+
+  static ArrayData* SetInt(ArrayData*, int64_t k, CVarRef v, bool copy);
+  static ArrayData* SetStr(ArrayData*, StringData* k, CVarRef v, bool copy);
+  static ArrayData* SetRefInt(ArrayData*, int64_t k, CVarRef v, bool copy);
+  static ArrayData* SetRefStr(ArrayData*, StringData* k, CVarRef v, bool copy);
+
+  static ArrayData *RemoveInt(ArrayData* ad, int64_t k, bool copy);
+  static ArrayData *RemoveStr(ArrayData* ad, const StringData* k, bool copy);
+
+  static ArrayData* Copy(const ArrayData*);
+  static ArrayData* NonSmartCopy(const ArrayData*);
+  static ArrayData* Append(ArrayData* a, CVarRef v, bool copy);
+  static ArrayData* AppendRef(ArrayData*, CVarRef v, bool copy);
+  static ArrayData* AppendWithRef(ArrayData*, CVarRef v, bool copy);
+  static ArrayData* Plus(ArrayData*, const ArrayData *elems);
+  static ArrayData* Merge(ArrayData*, const ArrayData *elems);
+  static ArrayData* Prepend(ArrayData*, CVarRef v, bool copy);
+
+  /**
+   * Non-Variant methods that override ArrayData
+   */
+  static TypedValue* NvGetInt(const ArrayData*, int64_t k);
+  static TypedValue* NvGetStr(const ArrayData*, const StringData* k);
+  static void NvGetKey(const ArrayData*, TypedValue* out, ssize_t pos);
+
+  static bool IsVectorData(const ArrayData* ad);
+
+  static ssize_t IterBegin(const ArrayData*);
+  static ssize_t IterEnd(const ArrayData*);
+  static ssize_t IterAdvance(const ArrayData*, ssize_t prev);
+  static ssize_t IterRewind(const ArrayData*, ssize_t prev);
+
+  static bool ValidFullPos(const ArrayData*, const FullPos& fp);
+  static bool AdvanceFullPos(ArrayData*, FullPos& fp);
+
+  static void Release(ArrayData*);
+
+  static ArrayData* Escalate(const ArrayData*);
+  static ArrayData* EscalateForSort(ArrayData*);
+
+  /*
+   * Read helper for translated code that already knows `ad' is a
+   * StructArray: returns the element as a cell with a reference added,
+   * or raises the usual undefined index notice and returns null.
+   */
+  static TypedValue GetCellStr(ArrayData* ad, const StringData* k);
+
+private:
+  static StructArray* asStructArray(ArrayData* ad);
+  static const StructArray* asStructArray(const ArrayData* ad);
+  static size_t allocBytes(uint32_t size) {
+    return sizeof(StructArray) + size * sizeof(TypedValue);
+  }
+
+  const StructLayout* m_layout;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // incl_HPHP_STRUCT_ARRAY_H_
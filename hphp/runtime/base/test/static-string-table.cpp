@@ -0,0 +1,102 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+#include "hphp/runtime/base/static-string-table.h"
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hphp/runtime/base/string-data.h"
+
+namespace HPHP {
+
+//////////////////////////////////////////////////////////////////////
+
+namespace {
+
+std::string name(size_t i) {
+  return "static-string-table-test-" + std::to_string(i);
+}
+
+}
+
+TEST(StaticStringTable, ConcurrentInsertAndLookup) {
+  // Enough strings that the shards have to grow.
+  constexpr size_t kStrings = 200000;
+  constexpr size_t kThreads = 8;
+
+  auto const before = getStaticStringTableStats();
+  std::vector<std::vector<StringData*>> seen(kThreads);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] {
+      auto& mine = seen[t];
+      mine.resize(kStrings);
+      // Each thread starts somewhere else, so inserts of the same string
+      // race, and lookups run against shards that are growing.
+      for (size_t n = 0; n < kStrings; ++n) {
+        auto const i = (n + t * kStrings / kThreads) % kStrings;
+        auto const s = name(i);
+        auto const sd = makeStaticString(s);
+        mine[i] = sd;
+        if (makeStaticString(s) != sd) mine[i] = nullptr;
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+
+  for (size_t i = 0; i < kStrings; ++i) {
+    auto const sd = seen[0][i];
+    ASSERT_NE(nullptr, sd);
+    EXPECT_TRUE(sd->isStatic());
+    EXPECT_EQ(name(i), sd->data());
+    for (size_t t = 1; t < kThreads; ++t) EXPECT_EQ(sd, seen[t][i]);
+    EXPECT_EQ(sd, makeStaticString(name(i)));
+  }
+
+  auto const after = getStaticStringTableStats();
+  EXPECT_EQ(kStrings, after.strings - before.strings);
+  EXPECT_EQ(after.strings, makeStaticStringCount());
+  EXPECT_GT(after.resizes, before.resizes);
+  EXPECT_GT(after.capacity, after.strings);
+  EXPECT_GT(after.lookups, before.lookups);
+  EXPECT_GE(after.probes - before.probes, after.lookups - before.lookups);
+}
+
+TEST(StaticStringTable, StatsJson) {
+  makeStaticString("static-string-table-test-json");
+  auto const stats = getStaticStringTableStats();
+  auto const json = getStaticStringTableStatsJson();
+  auto const field = [&] (const char* key, size_t value) {
+    return "\"" + std::string(key) + "\":" + std::to_string(value);
+  };
+  EXPECT_EQ('{', json.front());
+  EXPECT_EQ("}\n", json.substr(json.size() - 2));
+  EXPECT_NE(std::string::npos, json.find(field("shards", stats.shards)));
+  EXPECT_NE(std::string::npos, json.find(field("strings", stats.strings)));
+  EXPECT_NE(std::string::npos, json.find(field("capacity", stats.capacity)));
+  EXPECT_NE(std::string::npos, json.find(field("resizes", stats.resizes)));
+  for (auto key : { "lookups", "probes", "collisions", "insert_races" }) {
+    EXPECT_NE(std::string::npos, json.find("\"" + std::string(key) + "\":"))
+      << key;
+  }
+  EXPECT_NE(std::string::npos, json.find("\"hash\":\""));
+}
+
+//////////////////////////////////////////////////////////////////////
+
+}
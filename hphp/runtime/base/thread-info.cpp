@@ -286,6 +286,11 @@ void RequestInjectionData::setDebuggerSignalFlag() {
                       RequestInjectionData::DebuggerSignalFlag);
 }
 
+void RequestInjectionData::setCycleCollectFlag() {
+  __sync_fetch_and_or(getConditionFlags(),
+                      RequestInjectionData::CycleCollectFlag);
+}
+
 ssize_t RequestInjectionData::fetchAndClearFlags() {
   return __sync_fetch_and_and(getConditionFlags(),
                               (RequestInjectionData::EventHookFlag |
@@ -134,11 +134,11 @@ String::String(int64_t n) {
 }
 
 StringData* buildStringData(double n) {
-  char *buf;
+  char buf[FormatDoubleBufSize];
 
   if (n == 0.0) n = 0.0; // so to avoid "-0" output
-  vspprintf(&buf, 0, "%.*G", 14, n);
-  return StringData::Make(buf, AttachString);
+  auto const len = format_double_G(buf, n, 14);
+  return StringData::Make(buf, len, CopyString);
 }
 
 String::String(double n) {
@@ -1403,6 +1403,7 @@ inline Variant &concat_assign(Variant &v1, const String& s2) {
 // Defined here for include order reasons.
 inline RefData::~RefData() {
   assert(m_magic == Magic::kMagic);
+  if (UNLIKELY(m_cycleRoot)) CycleCollector::forgetRoot(this);
   tvAsVariant(&m_tv).~Variant();
 }
 
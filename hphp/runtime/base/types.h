@@ -234,7 +234,9 @@ public:
   static const ssize_t InterceptFlag        = 1 << 5;
   // Set by the debugger to break out of loops in translated code.
   static const ssize_t DebuggerSignalFlag   = 1 << 6;
-  static const ssize_t LastFlag             = DebuggerSignalFlag;
+  // Set by the MemoryManager when it wants a CycleCollector run.
+  static const ssize_t CycleCollectFlag     = 1 << 7;
+  static const ssize_t LastFlag             = CycleCollectFlag;
 
   RequestInjectionData()
     : cflagsPtr(nullptr),
@@ -308,6 +310,7 @@ public:
   void setInterceptFlag();
   void clearInterceptFlag();
   void setDebuggerSignalFlag();
+  void setCycleCollectFlag();
   ssize_t fetchAndClearFlags();
 
   void onSessionInit();
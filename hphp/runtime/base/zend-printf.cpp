@@ -1625,5 +1625,24 @@ int spprintf(char **pbuf, size_t max_len, const char *format, ...)
   return (cc);
 }
 
+int format_double_G(char *buf, double num, int precision) {
+  if (isnan(num)) {
+    memcpy(buf, "NAN", 4);
+    return 3;
+  }
+  if (isinf(num)) {
+    if (num > 0) {
+      memcpy(buf, "INF", 4);
+      return 3;
+    }
+    memcpy(buf, "-INF", 5);
+    return 4;
+  }
+  assert(precision > 0 && precision <= 17);
+  struct lconv *lconv = localeconv();
+  php_gcvt(num, precision, LCONV_DECIMAL_POINT, 'E', buf);
+  return strlen(buf);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
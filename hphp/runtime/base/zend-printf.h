@@ -35,6 +35,15 @@ int vspprintf(char **pbuf, size_t max_len, const char *format, ...);
 int vspprintf_ap(char **pbuf, size_t max_len, const char *format, va_list ap);
 int spprintf(char **pbuf, size_t max_len, const char *format, ...);
 
+/**
+ * Writes num to buf the way vspprintf's "%.*G" does at the given
+ * precision (at most 17), and returns its length.  Unlike vspprintf it
+ * doesn't malloc the result, so callers can format into a stack buffer
+ * of FormatDoubleBufSize bytes.
+ */
+constexpr size_t FormatDoubleBufSize = 32;
+int format_double_G(char *buf, double num, int precision);
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 
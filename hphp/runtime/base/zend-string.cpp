@@ -20,6 +20,8 @@
 #include "hphp/runtime/base/zend-math.h"
 
 #include "hphp/util/lock.h"
+#include "hphp/util/string-simd.h"
+#include <algorithm>
 #include <math.h>
 #include <monetary.h>
 
@@ -135,6 +137,64 @@ void string_charmask(const char *sinput, int len, char *mask) {
   }
 }
 
+namespace {
+
+/*
+ * Collect the characters set in a string_charmask() mask into `set', if
+ * there are few enough for the SIMD set scans.  Returns how many there
+ * are, or -1 if there are too many.
+ */
+int charmask_to_set(const char *mask, char *set) {
+  int n = 0;
+  for (int c = 0; c < 256; c += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, mask + c, sizeof word);
+    if (!word) continue;
+    for (int i = c; i < c + (int)sizeof(uint64_t); i++) {
+      if (!mask[i]) continue;
+      if (n == (int)kSimdMaxSetLen) return -1;
+      set[n++] = i;
+    }
+  }
+  return n;
+}
+
+/*
+ * Most trims only remove a character or two, so the first few bytes are
+ * checked directly; only a longer run pays for building the set.
+ */
+const int kCharmaskDirectRun = 16;
+
+}
+
+int string_charmask_span(const char *s, int len, const char *mask) {
+  int i = 0;
+  for (int stop = std::min(len, kCharmaskDirectRun); i < stop; i++) {
+    if (!mask[(unsigned char)s[i]]) return i;
+  }
+  if (i == len) return len;
+
+  char set[kSimdMaxSetLen];
+  int n = charmask_to_set(mask, set);
+  if (n >= 0) return i + simd_span(s + i, len - i, set, n);
+  while (i < len && mask[(unsigned char)s[i]]) i++;
+  return i;
+}
+
+int string_charmask_rspan(const char *s, int len, const char *mask) {
+  int i = len;
+  for (int stop = std::max(0, len - kCharmaskDirectRun); i > stop; i--) {
+    if (!mask[(unsigned char)s[i - 1]]) return len - i;
+  }
+  if (i == 0) return len;
+
+  char set[kSimdMaxSetLen];
+  int n = charmask_to_set(mask, set);
+  if (n >= 0) return len - i + simd_rspan(s, i, set, n);
+  while (i > 0 && mask[(unsigned char)s[i - 1]]) i--;
+  return len - i;
+}
+
 int string_copy(char *dst, const char *src, int siz) {
   register char *d = dst;
   register const char *s = src;
@@ -302,13 +362,41 @@ int string_natural_cmp(char const *a, size_t a_len,
 
 ///////////////////////////////////////////////////////////////////////////////
 
+namespace {
+
+bool ascii_case_map() {
+  for (int c = 0; c < 256; c++) {
+    int lower = c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+    int upper = c >= 'a' && c <= 'z' ? c - ('a' - 'A') : c;
+    if (tolower(c) != lower || toupper(c) != upper) return false;
+  }
+  return true;
+}
+
+bool s_ascii_case_map = ascii_case_map();
+
+}
+
+void string_locale_changed() {
+  s_ascii_case_map = ascii_case_map();
+}
+
+void string_to_case_copy(char *dst, const char *s, int len,
+                         int (*tocase)(int)) {
+  if (s_ascii_case_map) {
+    if (tocase == ::tolower) return simd_ascii_tolower(dst, s, len);
+    if (tocase == ::toupper) return simd_ascii_toupper(dst, s, len);
+  }
+  for (int i = 0; i < len; i++) {
+    dst[i] = tocase(s[i]);
+  }
+}
+
 char *string_to_case(const char *s, int len, int (*tocase)(int)) {
   assert(s);
   assert(tocase);
   char *ret = (char *)malloc(len + 1);
-  for (int i = 0; i < len; i++) {
-    ret[i] = tocase(s[i]);
-  }
+  string_to_case_copy(ret, s, len, tocase);
   ret[len] = '\0';
   return ret;
 }
@@ -348,25 +436,14 @@ char *string_trim(const char *s, int &len,
 
   int trimmed = 0;
   if (mode & 1) {
-    for (int i = 0; i < len; i++) {
-      if (mask[(unsigned char)s[i]]) {
-        trimmed++;
-      } else {
-        break;
-      }
-    }
+    trimmed = string_charmask_span(s, len, mask);
     len -= trimmed;
     s += trimmed;
   }
   if (mode & 2) {
-    for (int i = len - 1; i >= 0; i--) {
-      if (mask[(unsigned char)s[i]]) {
-        len--;
-        trimmed++;
-      } else {
-        break;
-      }
-    }
+    int right = string_charmask_rspan(s, len, mask);
+    len -= right;
+    trimmed += right;
   }
 
   if (trimmed == 0) {
@@ -547,22 +624,11 @@ int string_rfind(const char *input, int len, const char *s, int s_len,
 
 const char *string_memnstr(const char *haystack, const char *needle,
                            int needle_len, const char *end) {
-  const char *p = haystack;
-  char ne = needle[needle_len-1];
-
-  end -= needle_len;
-  while (p <= end) {
-    if ((p = (char *)memchr(p, *needle, (end-p+1))) && ne == p[needle_len-1]) {
-      if (!memcmp(needle, p, needle_len-1)) {
-        return p;
-      }
-    }
-    if (p == nullptr) {
-      return nullptr;
-    }
-    p++;
+  assert(needle_len > 0);
+  if (end <= haystack) {
+    return nullptr;
   }
-  return nullptr;
+  return simd_memmem(haystack, end - haystack, needle, needle_len);
 }
 
 char *string_replace(const char *s, int &len, int start, int length,
@@ -1326,6 +1392,11 @@ char *string_stripcslashes(const char *input, int &nlen) {
   return str;
 }
 
+int string_addslashes_span(const char *s, int len) {
+  static const char slashed[] = { '\0', '\'', '"', '\\' };
+  return simd_cspan(s, len, slashed, sizeof slashed);
+}
+
 char *string_addslashes(const char *str, int &length) {
   assert(str);
   if (length == 0) {
@@ -1337,22 +1408,15 @@ char *string_addslashes(const char *str, int &length) {
   const char *end = source + length;
   char *target = new_str;
 
-  while (source < end) {
-    switch (*source) {
-    case '\0':
-      *target++ = '\\';
-      *target++ = '0';
-      break;
-    case '\'':
-    case '\"':
-    case '\\':
-      *target++ = '\\';
-      /* break is missing *intentionally* */
-    default:
-      *target++ = *source;
-      break;
-    }
+  for (;;) {
+    int run = string_addslashes_span(source, end - source);
+    memcpy(target, source, run);
+    target += run;
+    source += run;
+    if (source == end) break;
 
+    *target++ = '\\';
+    *target++ = *source ? *source : '0';
     source++;
   }
 
@@ -115,6 +115,16 @@ int string_natural_cmp(char const *a, size_t a_len,
  * Changing string's cases. Return's length is always the same as "len".
  */
 char *string_to_case(const char *s, int len, int (*tocase)(int));
+
+/**
+ * Write s with tocase applied to every byte into dst, which may be s.
+ * tolower and toupper are vectorized while the current locale maps only
+ * ASCII letters (the "C" and UTF-8 locales do); string_locale_changed()
+ * must be called after setlocale() so this gets rechecked.
+ */
+void string_to_case_copy(char *dst, const char *s, int len,
+                         int (*tocase)(int));
+void string_locale_changed();
 char *string_to_case_first(const char *s, int len, int (*tocase)(int));
 char *string_to_case_words(const char *s, int len, int (*tocase)(int));
 
@@ -205,6 +215,10 @@ char *string_addcslashes(const char *str, int &length, const char *what,
                          int wlength);
 char *string_stripcslashes(const char *input, int &nlen);
 char *string_addslashes(const char *str, int &length);
+/**
+ * Length of the longest prefix of s that addslashes() leaves unchanged.
+ */
+int string_addslashes_span(const char *s, int len);
 char *string_stripslashes(const char *input, int &l);
 char *string_quotemeta(const char *input, int &len);
 char *string_quoted_printable_encode(const char *input, int &len);
@@ -285,6 +299,13 @@ bool string_substr_check(int len, int &f, int &l, bool strict = true);
  */
 void string_charmask(const char *input, int len, char *mask);
 
+/**
+ * Lengths of the longest prefix and suffix of s made only of characters
+ * set in a string_charmask() mask.
+ */
+int string_charmask_span(const char *s, int len, const char *mask);
+int string_charmask_rspan(const char *s, int len, const char *mask);
+
 ///////////////////////////////////////////////////////////////////////////////
 // mac doesn't have memrchr
 
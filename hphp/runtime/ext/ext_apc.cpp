@@ -20,6 +20,7 @@
 #include "hphp/runtime/ext/ext_fb.h"
 #include "hphp/runtime/base/runtime-option.h"
 #include "hphp/util/async-job.h"
+#include "hphp/util/logger.h"
 #include "hphp/util/timer.h"
 #include <dlfcn.h>
 #include "hphp/runtime/base/program-functions.h"
@@ -50,6 +51,8 @@ void apcExtension::moduleLoad(Hdf config) {
   string tblType = apc["TableType"].getString("concurrent");
   if (strcasecmp(tblType.c_str(), "concurrent") == 0) {
     TableType = TableTypes::ConcurrentTable;
+  } else if (strcasecmp(tblType.c_str(), "sharedmemory") == 0) {
+    TableType = TableTypes::SharedMemory;
   } else {
     throw InvalidArgumentException("apc table type", "Invalid table type");
   }
@@ -60,6 +63,17 @@ void apcExtension::moduleLoad(Hdf config) {
 
   AllowObj = apc["AllowObject"].getBool();
   TTLLimit = apc["TTLLimit"].getInt32(-1);
+  MaxMemory = apc["MaxMemory"].getInt64(0);
+  HotCache = apc["HotCache"].getBool();
+
+  Hdf snapshot = apc["Snapshot"];
+  SnapshotFile = snapshot["File"].getString();
+  SnapshotInterval = snapshot["Interval"].getInt32(0);
+
+  Hdf sharedMemory = apc["SharedMemory"];
+  SharedMemoryName = sharedMemory["Name"].getString("/hhvm-apc");
+  SharedMemorySize = sharedMemory["Size"].getInt64(1LL << 30);
+  SharedMemoryMaxKeys = sharedMemory["MaxKeys"].getInt64(1 << 20);
 
   Hdf fileStorage = apc["FileStorage"];
   UseFileStorage = fileStorage["Enable"].getBool();
@@ -89,6 +103,10 @@ void apcExtension::moduleInit() {
                               FileStorageChunkSize,
                               FileStorageMaxSize);
   }
+  if (Enable && TableType == TableTypes::SharedMemory) {
+    s_apc_store[SHARED_STORE_APPLICATION_CACHE].attachSharedMemory(
+      SharedMemoryName, SharedMemorySize, SharedMemoryMaxKeys);
+  }
 }
 
 void apcExtension::moduleShutdown() {
@@ -115,6 +133,13 @@ int apcExtension::PurgeFrequency = 4096;
 int apcExtension::PurgeRate = -1;
 bool apcExtension::AllowObj = false;
 int apcExtension::TTLLimit = -1;
+int64_t apcExtension::MaxMemory = 0;
+bool apcExtension::HotCache = false;
+std::string apcExtension::SnapshotFile;
+int apcExtension::SnapshotInterval = 0;
+std::string apcExtension::SharedMemoryName;
+int64_t apcExtension::SharedMemorySize = 1LL << 30;
+int64_t apcExtension::SharedMemoryMaxKeys = 1 << 20;
 bool apcExtension::UseFileStorage = false;
 int64_t apcExtension::FileStorageChunkSize = int64_t(1LL << 29);
 int64_t apcExtension::FileStorageMaxSize = int64_t(1LL << 32);
@@ -482,6 +507,30 @@ size_t get_const_map_size() {
   return s_const_map_size;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// warm restarts
+
+// The shared memory segment outlives the process by itself.
+static bool snapshot_enabled() {
+  return !apcExtension::SnapshotFile.empty() && apcExtension::Enable &&
+    apcExtension::TableType != apcExtension::TableTypes::SharedMemory;
+}
+
+void apc_restore_snapshot() {
+  if (!snapshot_enabled()) return;
+  Timer timer(Timer::WallTime, "restoring APC snapshot");
+  int64_t count = s_apc_store[0].restore(apcExtension::SnapshotFile);
+  if (count >= 0) {
+    Logger::Info("restored %" PRId64 " APC keys from %s", count,
+                 apcExtension::SnapshotFile.c_str());
+  }
+}
+
+void apc_save_snapshot() {
+  if (!snapshot_enabled()) return;
+  s_apc_store[0].snapshot(apcExtension::SnapshotFile);
+}
+
 //define in ext_fb.cpp
 extern void const_load_set(const String& key, CVarRef value);
 
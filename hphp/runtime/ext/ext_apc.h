@@ -36,7 +36,8 @@ class apcExtension : public Extension {
   static int LoadThread;
   static std::set<std::string> CompletionKeys;
   enum class TableTypes {
-    ConcurrentTable
+    ConcurrentTable,
+    SharedMemory
   };
   static TableTypes TableType;
   static bool EnableApcSerialize;
@@ -48,6 +49,13 @@ class apcExtension : public Extension {
   static int PurgeRate;
   static bool AllowObj;
   static int TTLLimit;
+  static int64_t MaxMemory;
+  static bool HotCache;
+  static std::string SnapshotFile;
+  static int SnapshotInterval;
+  static std::string SharedMemoryName;
+  static int64_t SharedMemorySize;
+  static int64_t SharedMemoryMaxKeys;
   static bool UseFileStorage;
   static int64_t FileStorageChunkSize;
   static int64_t FileStorageMaxSize;
@@ -109,6 +117,10 @@ bool f_apc_bin_loadfile(const String& filename,
 
 void apc_load(int thread);
 
+// warm restarts from Server.APC.Snapshot.File
+void apc_restore_snapshot();
+void apc_save_snapshot();
+
 // needed by generated apc archive .cpp files
 void apc_load_impl(struct cache_info *info,
                    const char **int_keys, long long *int_values,
@@ -649,6 +649,12 @@ Variant f_array_values(CVarRef input) {
                   "or collection");
     return uninit_null();
   }
+  if (cell_input.m_type == KindOfArray &&
+      cell_input.m_data.parr->isPacked() &&
+      cell_input.m_data.parr->isHead()) {
+    // A packed array is already its own list of values.
+    return tvAsCVarRef(&cell_input);
+  }
   PackedArrayInit ai(getContainerSize(cell_input));
   for (ArrayIter iter(cell_input); iter; ++iter) {
     ai.appendWithRef(iter.secondRefPlus());
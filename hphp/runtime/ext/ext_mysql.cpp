@@ -26,6 +26,7 @@
 #include "hphp/runtime/server/server-stats.h"
 #include "hphp/runtime/base/request-local.h"
 #include "hphp/runtime/base/extended-logger.h"
+#include "hphp/runtime/base/struct-array.h"
 #include "hphp/util/timer.h"
 #include "hphp/util/db-mysql.h"
 #include "folly/String.h"
@@ -62,6 +63,8 @@ MySQLResult::MySQLResult(MYSQL_RES *res, bool localized /* = false */)
   , m_current_field(-1)
   , m_field_count(0)
   , m_conn(nullptr)
+  , m_struct_layout(nullptr)
+  , m_struct_layout_ready(false)
 {
   if (localized) {
     m_res = nullptr; // ensure that localized results don't have another result
@@ -1230,11 +1233,24 @@ static Variant php_mysql_fetch_hash(CVarRef result, int result_type) {
   MySQLResult *res = get_result(result);
   if (res == NULL) return false;
 
-  Array ret;
+  // Rows of one result share their keys, so plain associative rows can
+  // point at one interned layout instead of each carrying a hash table.
+  StructArray* row = nullptr;
+  if (result_type == MYSQL_ASSOC) {
+    if (auto const layout = res->getStructLayout()) {
+      row = StructArray::Make(layout);
+    }
+  }
+  Array ret(row);
+
   if (res->isLocalized()) {
     if (!res->fetchRow()) return false;
 
     for (int i = 0; i < res->getFieldCount(); i++) {
+      if (row) {
+        row->valAt(i) = res->getField(i);
+        continue;
+      }
       if (result_type & MYSQL_NUM) {
         ret.set(i, res->getField(i));
       }
@@ -1267,6 +1283,10 @@ static Variant php_mysql_fetch_hash(CVarRef result, int result_type) {
       data = mysql_makevalue(String(mysql_row[i], mysql_row_lengths[i],
                                     CopyString), mysql_field);
     }
+    if (row) {
+      row->valAt(i) = data;
+      continue;
+    }
     if (result_type & MYSQL_NUM) {
       ret.set(i, data);
     }
@@ -1890,6 +1910,23 @@ Variant MySQLResult::getField(int64_t field) const {
   return (*m_current_row)[field];
 }
 
+const StructLayout *MySQLResult::getStructLayout() {
+  if (m_struct_layout_ready) return m_struct_layout;
+  m_struct_layout_ready = true;
+  if (!RuntimeOption::EvalEnableStructArrays) return nullptr;
+
+  int64_t count = getFieldCount();
+  if (count <= 0 || count > StructLayout::kMaxKeys) return nullptr;
+  const StringData *keys[StructLayout::kMaxKeys];
+  for (int64_t i = 0; i < count; i++) {
+    MySQLFieldInfo *info = getFieldInfo(i);
+    if (!info || info->name.isNull()) return nullptr;
+    keys[i] = info->name.get();
+  }
+  m_struct_layout = StructLayout::Intern(keys, count);
+  return m_struct_layout;
+}
+
 int64_t MySQLResult::getFieldCount() const {
   if (!m_localized) {
     return (int64_t)mysql_num_fields(m_res);
@@ -34,6 +34,8 @@
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
 
+struct StructLayout;
+
 class mysqlExtension : public Extension {
 public:
   mysqlExtension() : Extension("mysql") {}
@@ -263,6 +265,12 @@ public:
 
   MySQLFieldInfo *fetchFieldInfo();
 
+  /**
+   * Shared key layout for associative rows of this result, or null if
+   * rows should be built as plain arrays.
+   */
+  const StructLayout *getStructLayout();
+
   void setAsyncConnection(MySQL* conn) {
     m_conn = conn;
     m_conn->incRefCount();
@@ -280,6 +288,8 @@ protected:
   int64_t m_field_count;
   int64_t m_row_count;
   MySQL* m_conn;  // only set for async for refcounting underlying buffers
+  const StructLayout *m_struct_layout;
+  bool m_struct_layout_ready; // set once m_struct_layout has been computed
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -25,6 +25,7 @@
 #include "hphp/runtime/base/runtime-option.h"
 #include "hphp/runtime/base/ini-setting.h"
 #include "hphp/runtime/base/memory-manager.h"
+#include "hphp/runtime/base/cycle-collector.h"
 #include "hphp/runtime/base/request-local.h"
 #include "hphp/runtime/base/runtime-error.h"
 #include "hphp/runtime/base/zend-functions.h"
@@ -1068,23 +1069,29 @@ Variant f_version_compare(const String& version1, const String& version2,
 }
 
 bool f_gc_enabled() {
-  return false;
+  return CycleCollector::enabled();
 }
 
 void f_gc_enable() {
-  raise_warning("HipHop currently does not support circular reference "
-                "collection");
+  if (!RuntimeOption::EvalCycleCollectorUserControl) {
+    raise_warning("HipHop currently does not support circular reference "
+                  "collection");
+    return;
+  }
+  CycleCollector::setEnabled(true);
 }
 
 void f_gc_disable() {
-  raise_warning("HipHop currently does not support circular reference "
-                "collection");
+  if (!RuntimeOption::EvalCycleCollectorUserControl) {
+    raise_warning("HipHop currently does not support circular reference "
+                  "collection");
+    return;
+  }
+  CycleCollector::setEnabled(false);
 }
 
 int64_t f_gc_collect_cycles() {
-  raise_warning("HipHop currently does not support circular reference "
-                "collection");
-  return 0;
+  return CycleCollector::collect();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
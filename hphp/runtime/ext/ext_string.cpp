@@ -51,6 +51,7 @@ String stringForEachBuffered(uint32_t bufLen, const String& str, Op action) {
 
 template <bool mutate, class Op> ALWAYS_INLINE
 String stringForEach(uint32_t len, const String& str, Op action) {
+  if (mutate) str->invalidateHash();
   String ret = mutate ? str : String(len, ReserveString);
 
   StringSlice srcSlice = str.slice();
@@ -75,7 +76,7 @@ String stringForEachFast(const String& str, Op action) {
     return str;
   }
 
-  if (str->getCount() == 1) {
+  if (str->canMutateInPlace()) {
     return stringForEach<true>(str.size(), str, action);
   }
 
@@ -182,24 +183,24 @@ String f_stripcslashes(const String& str) {
 }
 
 String f_addslashes(const String& str) {
-  if (str.empty()) {
+  auto const src = str.data();
+  int const len = str.size();
+  int pos = string_addslashes_span(src, len);
+  if (pos == len) {
     return str;
   }
 
-  return stringForEachBuffered(str.size(), str,
-    [&] (StringBuffer& ret, const char* src, const char* end) {
-      switch (*src) {
-        case '\0':
-          ret.append('\\');
-          ret.append('0');
-          break;
-        case '\\': case '\"': case '\'':
-          ret.append('\\');
-          /* fall through */
-        default:
-          ret.append(*src);
-      }
-    });
+  StringBuffer ret(len + 1);
+  ret.append(src, pos);
+  do {
+    ret.append('\\');
+    ret.append(src[pos] ? src[pos] : '0');
+    pos++;
+    int run = string_addslashes_span(src + pos, len - pos);
+    ret.append(src + pos, run);
+    pos += run;
+  } while (pos < len);
+  return ret.detach();
 }
 
 String f_stripslashes(const String& str) {
@@ -297,7 +298,9 @@ String f_str_shuffle(const String& str) {
     return str;
   }
 
-  String ret = str->getCount() == 1 ? str : String(str, CopyString);
+  auto const inPlace = str->canMutateInPlace();
+  if (inPlace) str->invalidateHash();
+  String ret = inPlace ? str : String(str, CopyString);
   char* buf  = ret->mutableData();
   int left   = ret->size();
 
@@ -315,7 +318,8 @@ String f_str_shuffle(const String& str) {
 String f_strrev(const String& str) {
   auto len = str.size();
 
-  if (str->getCount() == 1) {
+  if (str->canMutateInPlace()) {
+    str->invalidateHash();
     char* sdata = str->mutableData();
     for (int i = 0; i < len / 2; ++i) {
       char temp = sdata[i];
@@ -338,12 +342,32 @@ String f_strrev(const String& str) {
   return ret;
 }
 
+static ALWAYS_INLINE
+String stringToCase(const String& str, int (*tocase)(int)) {
+  if (str.empty()) {
+    return str;
+  }
+
+  auto const len = str.size();
+  if (str->canMutateInPlace()) {
+    str->invalidateHash();
+    auto const buf = str->bufferSlice().ptr;
+    string_to_case_copy(buf, buf, len, tocase);
+    return str;
+  }
+
+  String ret(len, ReserveString);
+  string_to_case_copy(ret.bufferSlice().ptr, str.data(), len, tocase);
+  ret.setSize(len);
+  return ret;
+}
+
 String f_strtolower(const String& str) {
-  return stringForEachFast(str, tolower);
+  return stringToCase(str, tolower);
 }
 
 String f_strtoupper(const String& str) {
-  return stringForEachFast(str, toupper);
+  return stringToCase(str, toupper);
 }
 
 template <class OpTo, class OpIs> ALWAYS_INLINE
@@ -352,7 +376,8 @@ String stringToCaseFirst(const String& str, OpTo tocase, OpIs iscase) {
     return str;
   }
 
-  if (str->getCount() == 1) {
+  if (str->canMutateInPlace()) {
+    str->invalidateHash();
     char* sdata = str->mutableData();
     sdata[0] = tocase(sdata[0]);
     return str;
@@ -392,18 +417,18 @@ String stringTrim(const String& str, const String& charlist) {
   string_charmask(charlist.c_str(), charlist.size(), flags);
 
   auto len = str.size();
+  auto const data = str.data();
   int start = 0, end = len - 1;
 
   if (left) {
-    for (; start < len && flags[(unsigned char)str[start]]; ++start)
-      /* do nothing */;
+    start = string_charmask_span(data, len, flags);
   }
 
   if (right) {
-    for (; end >= start && flags[(unsigned char)str[end]]; --end) {}
+    end -= string_charmask_rspan(data + start, len - start, flags);
   }
 
-  if (str->getCount() == 1) {
+  if (str->canMutateInPlace()) {
     int slen = end - start + 1;
     if (start) {
       char* sdata = str->mutableData();
@@ -1515,6 +1540,7 @@ Variant f_setlocale(int _argc, int category, CVarRef locale, CArrRef _argv /* =
       Lock lock(s_mutex);
       const char *retval = setlocale(category, loc);
       if (retval) {
+        string_locale_changed();
         return String(retval, CopyString);
       }
     }
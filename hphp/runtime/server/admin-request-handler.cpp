@@ -182,8 +182,15 @@ void AdminRequestHandler::handleRequest(Transport *transport) {
         "                  only valid when EnableAPCSizeDetail is true\n"
         "    keysample     optional, only dump keys that belongs to the same\n"
         "                  group as <keysample>\n"
+        "/apc-ss-hot:      get the most fetched keys and key groups, by\n"
+        "                  count and bytes, and those with the most contended\n"
+        "                  locks; only valid when Stats.APCHotKeys is on\n"
+        "    n             optional, how many of each to show, default 20\n"
+        "/apc-ss-hot-reset: start counting hot keys afresh\n"
         "/const-ss:        get const_map_size\n"
         "/static-strings:  get number of static strings\n"
+        "/static-strings-stats: get static string table probe, collision\n"
+        "                  and resize counters, and the string hash in use\n"
         "/dump-apc:        dump all current value in APC to /tmp/apc_dump\n"
         "/dump-const:      dump all constant value in constant map to\n"
         "                  /tmp/const_map_dump\n"
@@ -203,6 +210,10 @@ void AdminRequestHandler::handleRequest(Transport *transport) {
         "                  /tmp/tc_dump_astub\n"
         "/vm-tcreset:      throw away translations and start over\n"
         "/vm-namedentities:show size of the NamedEntityTable\n"
+        "/mm-stats:        show per-node slab pools, and smart allocator\n"
+        "                  size class and slab usage (needs\n"
+        "                  Eval.ProfileSmartHeap)\n"
+        "/mm-stats-clear:  clear smart allocator statistics\n"
         ;
 #ifdef USE_TCMALLOC
         if (MallocExtensionInstance) {
@@ -320,7 +331,7 @@ void AdminRequestHandler::handleRequest(Transport *transport) {
         handleConstSizeRequest(cmd, transport)) {
       break;
     }
-    if (strcmp(cmd.c_str(), "static-strings") == 0 &&
+    if (strncmp(cmd.c_str(), "static-strings", 14) == 0 &&
         handleStaticStringsRequest(cmd, transport)) {
       break;
     }
@@ -328,6 +339,10 @@ void AdminRequestHandler::handleRequest(Transport *transport) {
         handleVMRequest(cmd, transport)) {
       break;
     }
+    if (strncmp(cmd.c_str(), "mm-", 3) == 0 &&
+        handleMemoryManagerRequest(cmd, transport)) {
+      break;
+    }
 
     if (cmd == "pcre-cache-size") {
       std::ostringstream size;
@@ -830,6 +845,21 @@ bool AdminRequestHandler::handleAPCSizeRequest (const std::string &cmd,
     }
     return true;
   }
+  if (cmd == "apc-ss-hot" || cmd == "apc-ss-hot-reset") {
+    if (!RuntimeOption::EnableAPCHotKeys) {
+      transport->sendString("Not Enabled\n");
+      return true;
+    }
+    if (cmd == "apc-ss-hot-reset") {
+      SharedStoreStats::resetHotKeys();
+      transport->sendString("Done\n");
+      return true;
+    }
+    int n = transport->getIntParam("n");
+    if (n <= 0) n = 20;
+    transport->sendString(SharedStoreStats::report_hot_keys(n));
+    return true;
+  }
   return false;
 }
 
@@ -852,7 +882,13 @@ bool AdminRequestHandler::handleConstSizeRequest (const std::string &cmd,
 bool AdminRequestHandler::handleStaticStringsRequest(const std::string& cmd,
                                                      Transport* transport) {
   std::ostringstream result;
-  result << makeStaticStringCount();
+  if (cmd == "static-strings") {
+    result << makeStaticStringCount();
+  } else if (cmd == "static-strings-stats") {
+    result << getStaticStringTableStatsJson();
+  } else {
+    return false;
+  }
   transport->sendString(result.str());
   return true;
 }
@@ -901,6 +937,71 @@ bool AdminRequestHandler::handleVMRequest(const std::string &cmd,
   return false;
 }
 
+bool AdminRequestHandler::handleMemoryManagerRequest(const std::string &cmd,
+                                                     Transport *transport) {
+  if (cmd == "mm-stats-clear") {
+    MemoryManager::resetSmartHeapStats();
+    transport->sendString("OK\n");
+    return true;
+  }
+  if (cmd == "mm-stats") {
+    std::ostringstream out;
+    out << std::setw(6) << "node"
+        << std::setw(12) << "fresh"
+        << std::setw(12) << "hugetlb"
+        << std::setw(12) << "thp"
+        << std::setw(12) << "reused"
+        << std::setw(12) << "released"
+        << std::setw(12) << "pooled" << endl;
+    auto const nodes = MemoryManager::getNodeSlabStats();
+    for (int i = 0; i < MemoryManager::kMaxNumaNodes; ++i) {
+      auto const& ns = nodes[i];
+      if (!ns.fresh) continue;
+      out << std::setw(6) << i
+          << std::setw(12) << ns.fresh
+          << std::setw(12) << ns.hugetlb
+          << std::setw(12) << ns.thp
+          << std::setw(12) << ns.reused
+          << std::setw(12) << ns.released
+          << std::setw(12) << ns.pooled << endl;
+    }
+    out << endl;
+    if (!RuntimeOption::EvalProfileSmartHeap) {
+      out << "Smart heap profiling is off\n";
+      transport->sendString(out.str());
+      return true;
+    }
+    auto const stats = MemoryManager::getSmartHeapStats();
+    auto const reqs = std::max<uint64_t>(stats.requests, 1);
+    out << "requests: " << stats.requests << endl
+        << "slabs/request: " << stats.slabs / reqs << endl
+        << "slab bytes/request: " << stats.slabBytes / reqs << endl
+        << "slab utilization: " << std::fixed << std::setprecision(1)
+        << (stats.slabBytes ? 100.0 *
+            (stats.slabBytes - stats.slabWastedBytes) / stats.slabBytes : 0.0)
+        << "%" << endl << endl;
+    out << std::setw(6) << "size"
+        << std::setw(14) << "allocs"
+        << std::setw(14) << "frees"
+        << std::setw(12) << "live/req"
+        << std::setw(12) << "peak"
+        << std::setw(12) << "free/req" << endl;
+    for (unsigned i = 0; i < MemoryManager::kNumSizes; ++i) {
+      auto const& sz = stats.sizes[i];
+      if (!sz.allocs) continue;
+      out << std::setw(6) << ((i + 1) << MemoryManager::kLgSizeQuantum)
+          << std::setw(14) << sz.allocs
+          << std::setw(14) << sz.frees
+          << std::setw(12) << sz.liveBytes / int64_t(reqs)
+          << std::setw(12) << sz.peakBytes
+          << std::setw(12) << sz.freeListBytes / int64_t(reqs) << endl;
+    }
+    transport->sendString(out.str());
+    return true;
+  }
+  return false;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Dump cache content
 
@@ -43,6 +43,8 @@ private:
   bool handleStaticStringsRequest(const std::string &cmd,
                                   Transport *transport);
   bool handleVMRequest      (const std::string &cnd, Transport *transport);
+  bool handleMemoryManagerRequest(const std::string &cmd,
+                                  Transport *transport);
 
 #ifdef GOOGLE_CPU_PROFILER
   bool handleCPUProfilerRequest (const std::string &cmd, Transport *transport);
@@ -223,6 +223,7 @@ HttpServer::~HttpServer() {
 void HttpServer::run() {
   StartTime = time(0);
 
+  apc_restore_snapshot();
   m_watchDog.start();
 
   for (unsigned int i = 0; i < m_serviceThreads.size(); i++) {
@@ -315,6 +316,8 @@ void HttpServer::run() {
     m_serviceThreads[i]->waitForEnd();
   }
 
+  // No more requests can change APC at this point.
+  apc_save_snapshot();
   hphp_process_exit();
   m_watchDog.waitForEnd();
   Logger::Info("all servers stopped");
@@ -412,6 +415,14 @@ void HttpServer::watchDog() {
         checkMemory();
       }
     }
+
+    if (apcExtension::SnapshotInterval > 0 &&
+        !apcExtension::SnapshotFile.empty()) {
+      noneed = false;
+      if ((count % apcExtension::SnapshotInterval) == 0) {
+        apc_save_snapshot();
+      }
+    }
   }
 }
 
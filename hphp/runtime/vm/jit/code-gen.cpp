@@ -3140,6 +3140,17 @@ Address CodeGenerator::cgCheckRefCountedType(PhysReg baseReg, int64_t offset) {
   return addrToPatch;
 }
 
+//
+// Whether DecRefs of a value of this type go through
+// tv_decref_cycle_root, so the CycleCollector sees objects, arrays and
+// refs that lose a reference but survive.
+//
+static bool decRefBuffersCycleRoots(Type type) {
+  return (RuntimeOption::EvalEnableCycleCollector ||
+          RuntimeOption::EvalCycleCollectorUserControl) &&
+    type.maybe(Type::Obj | Type::CountedArr | Type::BoxedCell);
+}
+
 //
 // Generates dec-ref of a typed value with statically known type.
 //
@@ -3307,6 +3318,17 @@ void CodeGenerator::cgDecRefMem(Type type,
   auto scratchReg = m_rScratch;
   assert(baseReg != scratchReg);
 
+  if (exit == nullptr && decRefBuffersCycleRoots(type)) {
+    m_as.lea(baseReg[offset], scratchReg);
+    cgCallHelper(m_as,
+                 CppCall(tv_decref_mem_cycle_root),
+                 kVoidDest,
+                 SyncOptions::kSyncPoint,
+                 ArgGroup(m_regs)
+                   .reg(scratchReg));
+    return;
+  }
+
   if (type.needsReg()) {
     // The type is dynamic, but we don't have two registers available
     // to load the type and the data.
@@ -3330,6 +3352,15 @@ void CodeGenerator::cgDecRefWork(IRInstruction* inst, bool genZeroCheck) {
   if (!isRefCounted(src)) return;
   Block* exit = inst->taken();
   Type type = src->type();
+  if (exit == nullptr && decRefBuffersCycleRoots(type)) {
+    cgCallHelper(m_as,
+                 CppCall(tv_decref_cycle_root),
+                 kVoidDest,
+                 SyncOptions::kSyncPoint,
+                 ArgGroup(m_regs)
+                   .typedValue(src));
+    return;
+  }
   if (type.isKnownDataType()) {
     cgDecRefStaticType(type, m_regs[src].reg(), exit, genZeroCheck);
   } else {
@@ -17,6 +17,7 @@
 
 #include "hphp/runtime/base/hphp-array-defs.h"
 #include "hphp/runtime/base/strings.h"
+#include "hphp/runtime/base/struct-array.h"
 #include "hphp/runtime/vm/member-operations.h"
 #include "hphp/runtime/vm/jit/hhbc-translator.h"
 #include "hphp/runtime/vm/jit/ir.h"
@@ -1604,6 +1605,16 @@ TypedValue packedArrayGetI(ArrayData* a, TypedValue* key) {
   int64_t ki = keyAsRaw<KeyType::Int>(key);
   return HphpArray::GetCellIntPacked(a, ki);
 }
+
+TypedValue typedVecGetI(ArrayData* a, TypedValue* key) {
+  int64_t ki = keyAsRaw<KeyType::Int>(key);
+  return HphpArray::GetCellIntTypedVec(a, ki);
+}
+
+TypedValue structArrayGetS(ArrayData* a, TypedValue* key) {
+  StringData* sd = keyAsRaw<KeyType::Str>(key);
+  return StructArray::GetCellStr(a, sd);
+}
 }
 
 template<KeyType keyType, bool checkForInt>
@@ -1651,6 +1662,27 @@ void HhbcTranslator::MInstrTranslator::emitArrayGet(SSATmp* key) {
     // DataTypeSpecialized because we care about the array kind
     m_tb.constrainValue(m_base, DataTypeSpecialized);
     opFunc = VectorHelpers::packedArrayGetI;
+  } else if (baseType.hasArrayKind() &&
+             baseType.getArrayKind() == ArrayData::kStructKind &&
+             keyType == KeyType::Str && !checkForInt) {
+    // Struct arrays only hold non-integer string keys, so a string key
+    // goes straight to the layout lookup.
+    m_tb.constrainValue(m_base, DataTypeSpecialized);
+    opFunc = VectorHelpers::structArrayGetS;
+  } else if (baseType.hasArrayKind() &&
+             (baseType.getArrayKind() == ArrayData::kIntVecKind ||
+              baseType.getArrayKind() == ArrayData::kDblVecKind) &&
+             key->isA(Type::Int)) {
+    // Typed vectors only hold ints (or doubles), so the loaded value
+    // needs no type guard downstream: it is either that or a null miss.
+    m_tb.constrainValue(m_base, DataTypeSpecialized);
+    auto const valType =
+      baseType.getArrayKind() == ArrayData::kIntVecKind ? Type::Int
+                                                        : Type::Dbl;
+    auto const result = gen(ArrayGet, cns((TCA)VectorHelpers::typedVecGetI),
+                            m_base, key);
+    m_result = gen(AssertType, valType | Type::InitNull, result);
+    return;
   }
   m_result = gen(ArrayGet, cns((TCA)opFunc), m_base, key);
 }
@@ -440,6 +440,20 @@ void tv_release_typed(RefData* pv, DataType dt) {
   g_destructors[typeToDestrIndex(dt)](pv);
 }
 
+/*
+ * Out-of-line DecRefs for values that may be objects, used instead of
+ * the inline sequence when a CycleCollector might be running: the
+ * collector buffers an object as a root when its count is decremented
+ * to something other than zero, which ObjectData::decRefCount() does.
+ */
+void tv_decref_cycle_root(TypedValue tv) {
+  tvRefcountedDecRef(&tv);
+}
+
+void tv_decref_mem_cycle_root(TypedValue* tv) {
+  tvRefcountedDecRef(tv);
+}
+
 Cell lookupCnsHelper(const TypedValue* tv,
                      StringData* nm,
                      bool error) {
@@ -116,6 +116,8 @@ TCA sswitchHelperFast(const StringData* val,
 
 void tv_release_generic(TypedValue* tv);
 void tv_release_typed(RefData* pv, DataType dt);
+void tv_decref_cycle_root(TypedValue tv);
+void tv_decref_mem_cycle_root(TypedValue* tv);
 
 Cell lookupCnsHelper(const TypedValue* tv,
                      StringData* nm,
@@ -2696,6 +2696,17 @@ Translator::getOperandConstraintCategory(NormalizedInstruction* instr,
               instr->inputs[1]->isInt()) {
             return DataTypeSpecialized;
           }
+          if (specType.hasArrayKind() &&
+              specType.getArrayKind() == ArrayData::ArrayKind::kStructKind &&
+              instr->inputs[1]->isString()) {
+            return DataTypeSpecialized;
+          }
+          if (specType.hasArrayKind() &&
+              (specType.getArrayKind() == ArrayData::ArrayKind::kIntVecKind ||
+               specType.getArrayKind() == ArrayData::ArrayKind::kDblVecKind) &&
+              instr->inputs[1]->isInt()) {
+            return DataTypeSpecialized;
+          }
         }
       } else if (specType.getOuterType() == KindOfObject) {
         if (instr->inputs.size() == 2 && opndIdx == 0) {
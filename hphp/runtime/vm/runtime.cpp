@@ -42,7 +42,7 @@ BuildNativeClassUnitFn g_hphp_build_native_class_unit;
  * print_string will decRef the string
  */
 void print_string(StringData* s) {
-  g_context->write(s->data(), s->size());
+  g_context->write(StrNR(s));
   TRACE(1, "t-x64 output(str): (%p) %43s\n", s->data(),
         Util::escapeStringForCPP(s->data(), s->size()).data());
   decRefStr(s);
@@ -169,12 +169,24 @@ concat_si(StringData* v1, int64_t v2) {
     int is_negative;
     intstart = conv_10(v2, &is_negative, intbuf + sizeof(intbuf), &len2);
   }
-  StringSlice s1 = v1->slice();
   StringSlice s2(intstart, len2);
-  StringData* ret = StringData::Make(s1, s2);
-  ret->incRefCount();
-  decRefStr(v1);
-  return ret;
+  if (v1->getCount() > 1) {
+    StringData* ret = StringData::Make(v1->slice(), s2);
+    ret->setRefCount(1);
+    v1->decRefCount();
+    return ret;
+  }
+
+  // Same as concat_ss: a string nobody else holds can usually take the
+  // digits in its spare capacity, without a new allocation.
+  auto const newV1 = v1->append(s2);
+  if (UNLIKELY(newV1 != v1)) {
+    assert(v1->getCount() == 1);
+    v1->release();
+    newV1->incRefCount();
+    return newV1;
+  }
+  return v1;
 }
 
 int64_t eq_null_str(StringData* v1) {
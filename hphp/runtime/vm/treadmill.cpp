@@ -72,6 +72,7 @@ static GenCount* idToCount(int threadID) {
 
 typedef std::list<WorkItem*> PendingTriggers;
 static PendingTriggers s_tq;
+static __thread bool tl_inRequest;
 
 // Inherently racy. We get a lower bound on the generation; presumably
 // clients are aware of this, and are creating the trigger for an object
@@ -90,6 +91,7 @@ void startRequest(int threadId) {
   assert(*idToCount(threadId) == kIdleGenCount);
   TRACE(1, "tid %d start @gen %d\n", threadId, int(s_gen));
   *idToCount(threadId) = s_gen;
+  tl_inRequest = true;
 }
 
 void finishRequest(int threadId) {
@@ -99,6 +101,7 @@ void finishRequest(int threadId) {
     GenCountGuard g;
     assert(*idToCount(threadId) != kIdleGenCount);
     *idToCount(threadId) = kIdleGenCount;
+    tl_inRequest = false;
 
     // After finishing a request, check to see if we've allowed any triggers
     // to fire.
@@ -140,6 +143,10 @@ void FreeMemoryTrigger::operator()() {
   free(m_ptr);
 }
 
+bool inRequest() {
+  return tl_inRequest;
+}
+
 void deferredFree(void* p) {
   WorkItem::enqueue(new FreeMemoryTrigger(p));
 }
@@ -36,6 +36,13 @@ namespace Treadmill {
 void startRequest(int threadId);
 void finishRequest(int threadId);
 
+/*
+ * Whether the calling thread is between startRequest and finishRequest.
+ * If so, anything it can reach now that is only freed through the
+ * treadmill stays valid until it finishes the request.
+ */
+bool inRequest();
+
 /*
  * Ask for memory to be freed (as in free, not delete) by the next
  * appropriate treadmill round.
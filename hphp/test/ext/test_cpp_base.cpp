@@ -24,12 +24,20 @@
 #include "hphp/runtime/ext/ext_mysql.h"
 #include "hphp/runtime/ext/ext_curl.h"
 #include "hphp/runtime/base/shared-store-base.h"
+#include "hphp/runtime/base/concurrent-shared-store.h"
+#include "hphp/runtime/base/shared-variant.h"
 #include "hphp/runtime/base/runtime-option.h"
+#include "hphp/runtime/base/struct-array.h"
+#include "hphp/runtime/base/array-util.h"
+#include "hphp/runtime/base/sort-flags.h"
 #include "hphp/runtime/server/ip-block-map.h"
 #include "hphp/test/ext/test_mysql_info.h"
 #include "hphp/system/systemlib.h"
 #include "hphp/runtime/ext/ext_string.h"
 
+#include <cmath>
+#include <limits>
+
 ///////////////////////////////////////////////////////////////////////////////
 
 TestCppBase::TestCppBase() {
@@ -41,6 +49,9 @@ bool TestCppBase::RunTests(const std::string &which) {
   bool ret = true;
   RUN_TEST(TestString);
   RUN_TEST(TestArray);
+  RUN_TEST(TestStructArray);
+  RUN_TEST(TestTypedVec);
+  RUN_TEST(TestApcSnapshot);
   RUN_TEST(TestObject);
   RUN_TEST(TestVariant);
   RUN_TEST(TestIpBlockMap);
@@ -533,6 +544,283 @@ bool TestCppBase::TestArray() {
   return Count(true);
 }
 
+bool TestCppBase::TestStructArray() {
+  const StringData* keys[] = {
+    makeStaticString("id"), makeStaticString("name")
+  };
+  auto layout = StructLayout::Intern(keys, 2);
+  VERIFY(layout != nullptr);
+  VERIFY(StructLayout::Intern(keys, 2) == layout);
+  VERIFY(StructLayout::FromId(layout->id()) == layout);
+  {
+    const StringData* dups[] = {
+      makeStaticString("id"), makeStaticString("id")
+    };
+    VERIFY(StructLayout::Intern(dups, 2) == nullptr);
+    const StringData* ints[] = { makeStaticString("12") };
+    VERIFY(StructLayout::Intern(ints, 1) == nullptr);
+  }
+  {
+    auto row = StructArray::Make(layout);
+    Array arr(row);
+    row->valAt(0) = 7;
+    row->valAt(1) = "apple";
+    VERIFY(arr->isStructArray());
+    VS(arr, make_map_array("id", 7, "name", "apple"));
+
+    Array copy = arr;
+    copy.set(String("name"), "pear");
+    VERIFY(copy->isStructArray());
+    VS(arr[String("name")], "apple");
+    VS(copy[String("name")], "pear");
+
+    copy.set(String("extra"), 1);
+    VERIFY(copy->isHphpArray());
+    VS(copy, make_map_array("id", 7, "name", "pear", "extra", 1));
+  }
+  {
+    // Scalar arrays are non-smart copies, which escalate to mixed.
+    auto row = StructArray::Make(layout);
+    Array arr(row);
+    row->valAt(0) = 8;
+    row->valAt(1) = "plum";
+    Array scalar = arr;
+    scalar.setEvalScalar();
+    VERIFY(scalar->isStatic());
+    VERIFY(scalar->isHphpArray());
+    VS(scalar, make_map_array("id", 8, "name", "plum"));
+    VERIFY(arr->isStructArray());
+  }
+  return Count(true);
+}
+
+bool TestCppBase::TestTypedVec() {
+  auto const saved = RuntimeOption::EvalEnableTypedVecs;
+  RuntimeOption::EvalEnableTypedVecs = true;
+  {
+    Array arr = Array::Create();
+    arr.append(1);
+    arr.append(2);
+    VERIFY(arr->kind() == ArrayData::kIntVecKind);
+    arr.set(0, 5);
+    VERIFY(arr->kind() == ArrayData::kIntVecKind);
+    VS(arr, make_packed_array(5, 2));
+
+    Array copy = arr;
+    copy.append("three");
+    VERIFY(arr->kind() == ArrayData::kIntVecKind);
+    VERIFY(copy->isPacked());
+    VS(copy, make_packed_array(5, 2, "three"));
+
+    arr.append(1.5);
+    VERIFY(arr->isPacked());
+    VS(arr, make_packed_array(5, 2, 1.5));
+  }
+  {
+    Array arr = Array::Create();
+    arr.append(2.5);
+    arr.append(0.5);
+    VERIFY(arr->kind() == ArrayData::kDblVecKind);
+    Array sorted(arr->escalateForSort());
+    sorted->sort(SORT_REGULAR, true);
+    VERIFY(sorted->kind() == ArrayData::kDblVecKind);
+    VS(sorted, make_packed_array(0.5, 2.5));
+    arr = sorted;
+    arr.remove(1);
+    VERIFY(arr->kind() == ArrayData::kDblVecKind);
+    arr.set(String("k"), 1.0);
+    VERIFY(arr->isHphpArray() && !arr->isPacked());
+  }
+  {
+    // Writes to a shared typed vector leave the other holder's kind alone.
+    Array arr = Array::Create();
+    arr.append(1);
+    arr.append(2);
+    arr.append(3);
+    Array other = arr;
+    VS(arr.pop(), 3);
+    VERIFY(other->kind() == ArrayData::kIntVecKind);
+    VS(other, make_packed_array(1, 2, 3));
+    VS(arr, make_packed_array(1, 2));
+
+    Array merged = other;
+    merged.merge(make_packed_array(4));
+    VERIFY(other->kind() == ArrayData::kIntVecKind);
+    VS(merged, make_packed_array(1, 2, 3, 4));
+
+    Array mixed = other;
+    mixed += make_map_array(7, "x");
+    VERIFY(other->kind() == ArrayData::kIntVecKind);
+    VS(other, make_packed_array(1, 2, 3));
+  }
+  {
+    // Slices of a typed vector are views, like those of any packed array.
+    auto const threshold = RuntimeOption::EvalSliceArrayThreshold;
+    RuntimeOption::EvalSliceArrayThreshold = 2;
+    Array arr = Array::Create();
+    for (int i = 0; i < 6; ++i) arr.append(i);
+    VERIFY(arr->kind() == ArrayData::kIntVecKind);
+    Array slice = ArrayUtil::Slice(arr, 1, 3, false).toArray();
+    VERIFY(slice->isSliceArray());
+    VS(slice, make_packed_array(1, 2, 3));
+    slice.setEvalScalar();
+    VERIFY(slice->isStatic());
+    VS(slice, make_packed_array(1, 2, 3));
+    RuntimeOption::EvalSliceArrayThreshold = threshold;
+  }
+  RuntimeOption::EvalEnableTypedVecs = saved;
+  return Count(true);
+}
+
+// What a snapshot holds for v, read back with unserialize().
+static Variant apc_snapshot_value(CVarRef v, bool& written) {
+  auto const svar = SharedVariant::Create(v, false);
+  std::string out;
+  written = svar->serializeTo(out);
+  svar->decRef();
+  if (!written) return uninit_null();
+  return unserialize_from_buffer(out.data(), out.size());
+}
+
+// Snapshot files by hand, in the layout ConcurrentTableSharedStore uses.
+static std::string apc_snapshot_header(uint64_t count) {
+  std::string out("HHAPCSNP", 8);
+  uint32_t const version = 1, reserved = 0;
+  out.append((const char*)&version, sizeof version);
+  out.append((const char*)&reserved, sizeof reserved);
+  out.append((const char*)&count, sizeof count);
+  return out;
+}
+
+static std::string apc_snapshot_entry(int64_t expiry, const std::string& key,
+                                      const std::string& val) {
+  std::string out((const char*)&expiry, sizeof expiry);
+  uint32_t const keyLen = key.size(), valLen = val.size();
+  out.append((const char*)&keyLen, sizeof keyLen);
+  out.append((const char*)&valLen, sizeof valLen);
+  out += key;
+  out += '\0';
+  out += val;
+  out += '\0';
+  out.append(-(keyLen + valLen + 2) & 7, '\0');
+  return out;
+}
+
+static void write_file(const std::string& path, const std::string& data) {
+  FILE* f = fopen(path.c_str(), "w");
+  fwrite(data.data(), data.size(), 1, f);
+  fclose(f);
+}
+
+bool TestCppBase::TestApcSnapshot() {
+  Array mixed = make_map_array(
+    "a", 1,
+    7, "seven",
+    "nested", make_map_array(0, make_packed_array(1.5, false, null_variant),
+                             "s", "x")
+  );
+
+  // serializeTo writes what unserialize() reads back, bit for bit.
+  {
+    bool written;
+    Variant v = apc_snapshot_value(std::numeric_limits<double>::quiet_NaN(),
+                                   written);
+    VERIFY(written);
+    VERIFY(v.isDouble() && std::isnan(v.toDouble()));
+    v = apc_snapshot_value(std::numeric_limits<double>::infinity(), written);
+    VS(v, std::numeric_limits<double>::infinity());
+    v = apc_snapshot_value(-std::numeric_limits<double>::infinity(), written);
+    VS(v, -std::numeric_limits<double>::infinity());
+    v = apc_snapshot_value(-0.0, written);
+    VERIFY(v.isDouble() && v.toDouble() == 0 && std::signbit(v.toDouble()));
+    v = apc_snapshot_value(0.1, written);
+    VERIFY(v.isDouble() && v.toDouble() == 0.1);
+    v = apc_snapshot_value(mixed, written);
+    VERIFY(written);
+    VS(v, mixed);
+    v = apc_snapshot_value(Array::Create(), written);
+    VERIFY(written);
+    VS(v, Array::Create());
+  }
+
+  std::string const path = "/tmp/test_apc_snapshot." +
+    std::to_string(getpid());
+
+  // Values written by one store come back in another.
+  {
+    ConcurrentTableSharedStore from(0);
+    VERIFY(from.store("int", 42, 0));
+    VERIFY(from.store("dbl", -0.0, 0));
+    VERIFY(from.store("str", String("a\0b", 3, CopyString), 0));
+    VERIFY(from.store("arr", mixed, 3600));
+    VERIFY(from.snapshot(path));
+    from.clear();
+
+    ConcurrentTableSharedStore to(0);
+    VERIFY(to.store("int", 1, 0));
+    VS(to.restore(path), 3); // "int" was already there, and stays
+    Variant v;
+    VERIFY(to.get("int", v));
+    VS(v, 1);
+    VERIFY(to.get("dbl", v));
+    VERIFY(v.isDouble() && std::signbit(v.toDouble()));
+    VERIFY(to.get("str", v));
+    VS(v, String("a\0b", 3, CopyString));
+    VERIFY(to.get("arr", v));
+    VS(v, mixed);
+    to.clear();
+  }
+
+  // Keys that expired since the snapshot was taken are dropped.
+  {
+    auto const now = time(nullptr);
+    write_file(path, apc_snapshot_header(3) +
+                     apc_snapshot_entry(0, "live", "i:1;") +
+                     apc_snapshot_entry(now - 10, "old", "i:2;") +
+                     apc_snapshot_entry(now + 3600, "later", "s:1:\"x\";"));
+    ConcurrentTableSharedStore s(0);
+    VS(s.restore(path), 2);
+    Variant v;
+    VERIFY(s.get("live", v));
+    VS(v, 1);
+    VERIFY(!s.get("old", v));
+    VERIFY(s.get("later", v));
+    VS(v, "x");
+    s.clear();
+  }
+
+  // A truncated or corrupt file gives up at the first bad entry.
+  {
+    auto const good = apc_snapshot_header(2) +
+                      apc_snapshot_entry(0, "first", "i:1;") +
+                      apc_snapshot_entry(0, "second", "i:2;");
+    write_file(path, good.substr(0, good.size() - 5));
+    ConcurrentTableSharedStore s(0);
+    VS(s.restore(path), 1);
+    Variant v;
+    VERIFY(s.get("first", v));
+    VERIFY(!s.get("second", v));
+    s.clear();
+
+    auto bad = good;
+    bad[sizeof(int64_t) + 24] = 0x7f; // first key's length
+    write_file(path, bad);
+    VS(s.restore(path), 0);
+    VERIFY(!s.get("first", v));
+
+    bad = good;
+    bad[0] = 'X';
+    write_file(path, bad);
+    VS(s.restore(path), -1);
+    write_file(path, good.substr(0, 10));
+    VS(s.restore(path), -1);
+    unlink(path.c_str());
+    VS(s.restore(path), -1);
+    VS(s.size(), 0);
+  }
+  return Count(true);
+}
+
 bool TestCppBase::TestObject() {
   {
     String s = "O:1:\"B\":1:{s:3:\"obj\";O:1:\"A\":1:{s:1:\"a\";i:10;}}";
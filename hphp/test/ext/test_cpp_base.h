@@ -54,6 +54,9 @@ class TestCppBase : public TestBase {
    */
   bool TestString();
   bool TestArray();
+  bool TestStructArray();
+  bool TestTypedVec();
+  bool TestApcSnapshot();
   bool TestObject();
   bool TestVariant();
   bool TestListAssignment();
@@ -0,0 +1,35 @@
+<?php
+
+// Keys sharing their low bits pile into one probe run; removals leave
+// tombstones that later inserts and lookups must step over.
+$a = array();
+for ($i = 0; $i < 200; ++$i) {
+  $a[$i * 1024] = $i;
+  $a["s$i"] = -$i;
+}
+for ($i = 0; $i < 200; $i += 2) {
+  unset($a[$i * 1024]);
+  unset($a["s$i"]);
+}
+var_dump(count($a));
+
+$ok = true;
+for ($i = 0; $i < 200; ++$i) {
+  $odd = ($i & 1) == 1;
+  if (isset($a[$i * 1024]) != $odd) $ok = false;
+  if (isset($a["s$i"]) != $odd) $ok = false;
+}
+var_dump($ok);
+
+for ($i = 0; $i < 200; $i += 2) {
+  $a["s$i"] = $i;
+  $a[-$i - 1] = $i;
+}
+var_dump(count($a));
+var_dump($a["s10"], $a["s11"], $a[-11]);
+
+$b = array('x' => 1, 'y' => 2);
+unset($b['x']);
+$b['z'] = 3;
+$b['x'] = 4;
+var_dump($b);
@@ -0,0 +1,39 @@
+<?php
+
+function show($a) {
+  echo json_encode($a), "\n";
+}
+
+$a = array(1, 2, 3);
+
+show($a + $a);
+show($a + array(9, 9, 9, 4));
+show($a + array(5 => 'x'));
+show($a + array('k' => 'v'));
+
+show(array_merge($a, array(4, 5)));
+show(array_merge($a, array(7 => 4, 'k' => 5, 6)));
+
+$b = array(3, 1, 2);
+sort($b);
+show($b);
+$b = array(3, 1, 2);
+usort($b, function($x, $y) { return $y - $x; });
+show($b);
+$b = array(3, 1, 2);
+asort($b);
+show($b);
+
+show(array_slice($a, 1));
+show(array_slice($a, 1, 1, true));
+show(array_slice($a, 0, 2, true));
+show(array_slice($a, -2, 5));
+show(array_slice($a, 3));
+
+show(array_reverse($a));
+show(array_reverse($a, true));
+
+show(array_map(function($x) { return $x * 2; }, $a));
+
+next($a);
+show(array_values($a));
@@ -0,0 +1,50 @@
+<?php
+
+// With radix sorting off and a ParallelSortThreshold of 500, sorts of at
+// least 500 elements are split into runs that are sorted on their own
+// threads and merged.  Each result is checked against usort(), which
+// always sorts serially, on either side of the threshold.
+function check($a, $flags, $cmp) {
+  $want = $a;
+  usort($want, $cmp);
+  $got = $a;
+  sort($got, $flags);
+  $rwant = array_reverse($want);
+  $rgot = $a;
+  rsort($rgot, $flags);
+  $assoc = $a;
+  asort($assoc, $flags);
+  $kept = true;
+  foreach ($assoc as $k => $v) {
+    if ($a[$k] !== $v) $kept = false;
+  }
+  var_dump($got === $want, $rgot === $rwant,
+           $kept && array_values($assoc) === $want);
+}
+
+function int_cmp($x, $y) { return $x < $y ? -1 : ($x > $y ? 1 : 0); }
+
+function nat_case_cmp($x, $y) { return strnatcasecmp($x, $y); }
+
+foreach (array(499, 500, 501, 3001) as $n) {
+  echo "$n\n";
+  $ints = array();
+  $strs = array();
+  $files = array();
+  for ($i = 0; $i < $n; ++$i) {
+    $v = ($i * 7919) % 3001 - 1500;
+    $ints[] = $v * 1000003;
+    $strs[] = str_repeat('ab', $i % 5) . dechex($v + 1500);
+    $files[] = ($i % 2 ? 'File' : 'file') . ($v + 1500) . '.txt';
+  }
+  check($ints, SORT_REGULAR, 'int_cmp');
+  check($strs, SORT_STRING, 'strcmp');
+  check($files, SORT_NATURAL | SORT_FLAG_CASE, 'nat_case_cmp');
+
+  $keyed = array_flip($ints);
+  ksort($keyed);
+  $keys = array_keys($keyed);
+  $want = $ints;
+  usort($want, 'int_cmp');
+  var_dump($keys === $want);
+}
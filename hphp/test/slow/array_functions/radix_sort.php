@@ -0,0 +1,71 @@
+<?php
+
+// With a low RadixSortThreshold and no parallel sorting, all-int sorts
+// take the LSD path and SORT_STRING sorts the MSD one.  Each result is
+// checked against usort(), which always calls the comparator.
+function check($a, $flags, $cmp) {
+  $want = $a;
+  usort($want, $cmp);
+  $got = $a;
+  sort($got, $flags);
+  $rwant = array_reverse($want);
+  $rgot = $a;
+  rsort($rgot, $flags);
+  $assoc = $a;
+  asort($assoc, $flags);
+  $kept = true;
+  foreach ($assoc as $k => $v) {
+    if ($a[$k] !== $v) $kept = false;
+  }
+  var_dump($got === $want, $rgot === $rwant,
+           $kept && array_values($assoc) === $want);
+}
+
+function int_cmp($x, $y) { return $x < $y ? -1 : ($x > $y ? 1 : 0); }
+
+// Both sides of zero, where the sign bit flip has to put negatives first,
+// including the extremes.
+$ints = array();
+for ($i = 0; $i < 601; ++$i) {
+  $ints[] = ($i * 337) % 601 - 300;
+}
+$ints[] = PHP_INT_MAX;
+$ints[] = PHP_INT_MAX - 1;
+$ints[] = -PHP_INT_MAX - 1;
+$ints[] = -PHP_INT_MAX;
+check($ints, SORT_REGULAR, 'int_cmp');
+check($ints, SORT_NUMERIC, 'int_cmp');
+
+// Keys differing only in the top byte, so every other pass is skipped.
+$ints = array();
+for ($i = 0; $i < 100; ++$i) {
+  $ints[] = (($i * 7) % 16 - 8) << 56 | 0x1234;
+}
+check($ints, SORT_REGULAR, 'int_cmp');
+
+// No pass at all.
+check(array_fill(0, 100, 42), SORT_REGULAR, 'int_cmp');
+
+// Strings that end inside a bucket, NUL and 0xff bytes, and buckets large
+// enough to be split again.
+$strs = array();
+for ($i = 0; $i < 400; ++$i) {
+  $s = substr('abcdefgh', 0, $i % 9) . chr(($i * 37) % 256);
+  if ($i % 3 == 0) $s .= dechex($i);
+  if ($i % 11 == 0) $s = substr($s, 0, $i % 9);
+  $strs[] = $s;
+}
+$strs[] = '';
+$strs[] = "\x00";
+$strs[] = "\xff\xff";
+check($strs, SORT_STRING, 'strcmp');
+
+// A common prefix longer than the radix depth limit.
+$strs = array();
+for ($i = 0; $i < 200; ++$i) {
+  $strs[] = str_repeat('x', 100) . dechex(($i * 7919) % 1009);
+}
+check($strs, SORT_STRING, 'strcmp');
+
+// Every string the same.
+check(array_fill(0, 100, 'same'), SORT_STRING, 'strcmp');
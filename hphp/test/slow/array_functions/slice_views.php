@@ -0,0 +1,54 @@
+<?php
+
+// With a low SliceArrayThreshold, slices of packed arrays share their
+// parent's elements until either side is written.
+$a = range(0, 19);
+$s = array_slice($a, 5, 6);
+var_dump(count($s), $s[0], $s[5], isset($s[6]), array_key_exists(2, $s));
+echo implode(',', $s), "\n";
+
+$a[6] = 'changed';
+echo implode(',', $s), "\n";
+
+$s[] = 'new';
+$s[0] = 'first';
+echo implode(',', $s), "\n";
+echo $a[5], ',', $a[6], "\n";
+
+$t = array_slice(array_slice($a, 2), 3, 5);
+echo implode(',', $t), "\n";
+var_dump(array_keys($t) === range(0, 4));
+
+$u = array_slice($a, 10, 4);
+sort($u);
+rsort($u);
+echo implode(',', $u), "\n";
+
+$v = array_slice($a, 0, 5);
+foreach ($v as &$x) { $x *= 10; }
+unset($x);
+echo implode(',', $v), "\n";
+echo implode(',', array_slice($a, 0, 5)), "\n";
+
+$w = array_slice($a, 12, 5);
+var_dump(array_pop($w), array_shift($w), $w);
+
+foreach (array_chunk(range(1, 10), 4) as $chunk) {
+  echo implode(',', $chunk), "\n";
+}
+
+$b = range(1, 10);
+$removed = array_splice($b, 2, 5);
+echo implode(',', $removed), '|', implode(',', $b), "\n";
+$removed[] = 99;
+echo implode(',', $removed), "\n";
+
+// A run holding a reference is copied so the reference stays bound.
+$c = range(1, 10);
+$r = &$c[3];
+$d = array_slice($c, 2, 5);
+$r = 'ref';
+echo implode(',', $d), "\n";
+
+var_dump(array_slice(range(1, 12), 8));
+var_dump(serialize(array_slice($a, 1, 4)));
@@ -0,0 +1,19 @@
+<?php
+
+// Lists built by appending ints or doubles are typed vectors; their
+// slices are views just like those of any packed array.
+$a = array();
+for ($i = 0; $i < 12; ++$i) $a[] = $i;
+$s = array_slice($a, 3, 5);
+echo implode(',', $s), "\n";
+
+$a[4] = 'changed';
+echo implode(',', $s), "\n";
+$s[] = 1.5;
+echo implode(',', $s), "\n";
+
+$d = array();
+for ($i = 0; $i < 8; ++$i) $d[] = $i * 0.5;
+$t = array_slice(array_slice($d, 1), 2, 4);
+echo implode(',', $t), "\n";
+var_dump(array_slice($d, -4, 4));
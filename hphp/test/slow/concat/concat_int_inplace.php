@@ -0,0 +1,22 @@
+<?php
+
+function build($prefix, $n) {
+  $keys = array();
+  for ($i = 0; $i < $n; $i++) {
+    $k = $prefix . '_';
+    $keys[] = $k . $i;
+    $keys[] = ($k . $i) . $i;
+  }
+  return $keys;
+}
+
+$p = 'item';
+$keys = build($p, 3);
+var_dump($p);
+var_dump($keys);
+
+$s = str_repeat('a', 3);
+$t = $s;
+$t = $t . 42;
+var_dump($s, $t);
+var_dump((string)1.5, (string)-0.0, (string)1e100, (string)0.1, 'x' . 2.5);
@@ -0,0 +1,30 @@
+<?php
+
+apc_store('s', str_repeat('x', 100));
+apc_store('a', array(1, 'two', array(3)));
+apc_store('n', 1);
+
+// The first fetch publishes, the rest are served lock-free.
+for ($i = 0; $i < 3; $i++) {
+  var_dump(strlen(apc_fetch('s')));
+  $a = apc_fetch('a');
+  var_dump($a[1], $a[2][0]);
+  var_dump(apc_fetch('n'));
+}
+
+// Writes must not leave stale values behind.
+apc_store('s', 'short');
+var_dump(apc_fetch('s'));
+apc_inc('n', 5);
+var_dump(apc_fetch('n'));
+var_dump(apc_cas('n', 6, 10));
+var_dump(apc_fetch('n'));
+apc_delete('a');
+var_dump(apc_fetch('a'));
+
+// Modifying a fetched copy doesn't touch the stored value.
+apc_store('l', str_repeat('y', 50));
+apc_fetch('l');
+$a = apc_fetch('l');
+$a .= '!';
+var_dump(strlen($a), strlen(apc_fetch('l')));
@@ -0,0 +1,24 @@
+<?php
+
+// With Server.APC.MaxMemory at 64KB, about 16 of these 4KB values fit.
+// Keys that keep being fetched survive; the oldest unfetched ones go.
+$v = str_repeat('x', 4000);
+apc_store('hot', $v);
+for ($i = 0; $i < 100; $i++) {
+  apc_store("k$i", $v);
+  apc_fetch('hot');
+}
+
+$n = 0;
+for ($i = 0; $i < 100; $i++) {
+  if (apc_exists("k$i")) $n++;
+}
+var_dump($n >= 10 && $n <= 16);
+var_dump(apc_fetch('hot') === $v);
+var_dump(apc_exists('k0'));
+var_dump(apc_fetch('k99') === $v);
+
+apc_delete('k99');
+var_dump(apc_exists('k99'));
+apc_store('k99', 1);
+var_dump(apc_inc('k99'));
@@ -0,0 +1,35 @@
+<?php
+
+// Large APC strings echoed into an empty output buffer are held by
+// reference, not copied; writes to the buffer must not reach APC.
+function VS($x, $y) {
+  if ($x !== $y) {
+    throw new Exception("test failed: got ".strlen($x)." bytes");
+  }
+}
+
+$blob = str_repeat("<p>template</p>\n", 4096);
+apc_store('blob', $blob);
+
+ob_start();
+echo apc_fetch('blob');
+VS(ob_get_clean(), $blob);
+
+ob_start();
+echo apc_fetch('blob');
+echo "tail";
+VS(ob_get_clean(), $blob."tail");
+
+ob_start();
+echo apc_fetch('blob');
+$out = ob_get_contents();
+ob_clean();
+echo "x";
+VS(ob_get_clean(), "x");
+VS($out, $blob);
+
+apc_store('blob', 'replaced');
+VS($out, $blob);
+VS(apc_fetch('blob'), 'replaced');
+
+echo "ok\n";
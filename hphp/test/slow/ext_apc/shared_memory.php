@@ -0,0 +1,30 @@
+<?php
+
+// Values in the shared memory segment must be readable by a process
+// that isn't this one, including literal strings and array keys, which
+// APC's own serialization writes as pointers.
+$opts = '-vServer.APC.TableType=sharedmemory'.
+        ' -vServer.APC.SharedMemory.Name=/hhvm-apc-slow-test'.
+        ' -vServer.APC.SharedMemory.Size=8388608'.
+        ' -vServer.APC.SharedMemory.MaxKeys=1024';
+
+apc_clear_cache();
+apc_store('literal', 'a literal string');
+apc_store('array', array('key' => 'value', 3 => array('nested' => 1.5)));
+apc_store('counter', 10);
+apc_inc('counter', 5);
+var_dump(apc_add('literal', 'other'));
+
+$reader = tempnam(sys_get_temp_dir(), 'apc');
+file_put_contents($reader, '<?php
+var_dump(apc_fetch("literal"));
+var_dump(apc_fetch("array"));
+var_dump(apc_fetch("counter"));
+apc_store("from_child", "child value");
+');
+echo shell_exec(PHP_BINARY.' '.$opts.' '.escapeshellarg($reader));
+unlink($reader);
+
+var_dump(apc_fetch('from_child'));
+apc_clear_cache();
+@unlink('/dev/shm/hhvm-apc-slow-test');
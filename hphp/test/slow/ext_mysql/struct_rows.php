@@ -0,0 +1,44 @@
+<?php
+
+// With struct arrays on, mysql_fetch_assoc rows share one key layout per
+// result.  Every way of changing a row's shape has to leave it behaving
+// like the plain array it stands in for.
+
+$conn = mysql_connect(getenv('MYSQL_TEST_HOST'),
+                      getenv('MYSQL_TEST_USER'),
+                      getenv('MYSQL_TEST_PASSWD'));
+mysql_select_db(getenv('MYSQL_TEST_DB') ?: 'test', $conn);
+mysql_query('create temporary table struct_rows (id int not null, '.
+            'name varchar(32) not null)', $conn);
+mysql_query("insert into struct_rows values (1, 'apple'), (2, 'pear'), ".
+            "(3, 'plum')", $conn);
+
+$res = mysql_query('select id, name from struct_rows order by id', $conn);
+$first = mysql_fetch_assoc($res);
+$second = mysql_fetch_assoc($res);
+var_dump($first, $second);
+
+$copy = $first;
+$copy['name'] = 'quince';
+var_dump($first['name'], $copy['name']);
+
+$second['extra'] = true;
+unset($first['id']);
+var_dump($first, $second);
+
+$third = mysql_fetch_assoc($res);
+foreach ($third as $k => &$v) {
+  $v = $k.'='.$v;
+}
+unset($v);
+krsort($third);
+var_dump($third, serialize($third));
+var_dump(mysql_fetch_assoc($res));
+
+$res = mysql_unbuffered_query('select name from struct_rows order by id',
+                              $conn);
+$names = array();
+while ($row = mysql_fetch_assoc($res)) {
+  $names[] = $row['name'];
+}
+var_dump(implode(',', $names));
@@ -0,0 +1,55 @@
+<?php
+
+// Large strings echoed into an empty output buffer are held by
+// reference; make sure later writes to either side don't leak through.
+function VS($x, $y) {
+  if ($x !== $y) {
+    throw new Exception("test failed: got ".strlen($x)." bytes");
+  }
+}
+
+function page($n) {
+  $s = '';
+  for ($i = 0; $i < $n; $i++) {
+    $s .= "<li>item $i</li>";
+  }
+  return $s;
+}
+
+$page = page(2000);
+
+ob_start();
+echo $page;
+VS(ob_get_clean(), $page);
+
+ob_start();
+echo $page;
+echo "tail";
+VS(ob_get_clean(), $page."tail");
+
+ob_start();
+echo $page;
+$page .= "more";
+VS(ob_get_clean(), substr($page, 0, -4));
+
+ob_start();
+echo $page;
+VS(ob_get_contents(), $page);
+ob_clean();
+echo "x";
+VS(ob_get_clean(), "x");
+VS(strlen($page), 34894);
+
+ob_start();
+ob_start();
+echo $page;
+ob_end_flush();
+echo "!";
+VS(ob_get_clean(), $page."!");
+
+ob_start();
+print $page;
+printf("%d", 42);
+VS(ob_get_clean(), $page."42");
+
+echo "ok\n";
@@ -0,0 +1,42 @@
+<?php
+
+// Long inputs go through the vector scans; check every position of a
+// special character against a straightforward reference.
+
+$quotes = array('&' => '&amp;', '<' => '&lt;', '>' => '&gt;',
+                '"' => '&quot;', "'" => '&#039;');
+$compat = array('&' => '&amp;', '<' => '&lt;', '>' => '&gt;',
+                '"' => '&quot;');
+
+$bad = 0;
+foreach (array(1, 15, 16, 17, 31, 32, 33, 64, 100) as $len) {
+  $clean = str_repeat("ab\xc3\xa9 ", $len);
+  if (htmlspecialchars($clean, ENT_QUOTES, 'UTF-8') !== $clean) $bad++;
+  if (fb_htmlspecialchars($clean, ENT_QUOTES, 'UTF-8') !== $clean) $bad++;
+
+  // Every character boundary except the middle of the UTF-8 pair.
+  for ($i = 0; $i <= strlen($clean); $i++) {
+    if ($i % 5 == 3) continue;
+    foreach (array('&', '<', '>', '"', "'") as $c) {
+      $s = substr($clean, 0, $i) . $c . substr($clean, $i);
+      if (htmlspecialchars($s, ENT_QUOTES) !== strtr($s, $quotes)) $bad++;
+      if (htmlspecialchars($s) !== strtr($s, $compat)) $bad++;
+      if (fb_htmlspecialchars($s, ENT_QUOTES, 'UTF-8') !==
+          strtr($s, $quotes)) {
+        $bad++;
+      }
+    }
+  }
+}
+var_dump($bad);
+
+// More extra characters than fit in one vector compare.
+$extra = str_split('bcdfghjklmnpqrstvwxz');
+$s = str_repeat('the quick brown fox ', 4);
+$expected = '';
+foreach (str_split($s) as $c) {
+  $expected .= in_array($c, $extra) ? '&#' . sprintf('%03d', ord($c)) . ';'
+                                    : $c;
+}
+var_dump(fb_htmlspecialchars($s, ENT_QUOTES, 'UTF-8', $extra) === $expected);
+var_dump(fb_htmlspecialchars('aeiou aeiou', ENT_QUOTES, 'UTF-8', $extra));
@@ -0,0 +1,20 @@
+<?php
+
+// Returns a fresh string that has already been hashed by an array lookup,
+// so the string functions below get it with a cached hash and are free to
+// modify it in place.
+function hashed_key($arr, $s) {
+  $k = $s . 'B';
+  var_dump(isset($arr[$k]));
+  return $k;
+}
+
+function main() {
+  $arr = array('aaab' => 1, 'BAAA' => 2, 'Aaab' => 3, 'aaa' => 4);
+  var_dump($arr[strtolower(hashed_key($arr, 'AAA'))]);
+  var_dump($arr[strrev(hashed_key($arr, 'AAA'))]);
+  var_dump($arr[ucfirst(strtolower(hashed_key($arr, 'AAA')))]);
+  var_dump($arr[trim(hashed_key($arr, 'aaa'), 'B')]);
+}
+
+main();
@@ -0,0 +1,50 @@
+<?php
+
+class Node {
+  public $val;
+  public $next;
+  function __construct($val, $next) {
+    $this->val = $val;
+    $this->next = $next;
+  }
+}
+
+function churn($n) {
+  $total = 0;
+  for ($i = 0; $i < $n; $i++) {
+    $s = str_repeat('x', $i % 100) . $i;
+    $a = array($i, $s, array('k' => $s));
+    $total += strlen($a[2]['k']);
+    unset($a);
+  }
+  return $total;
+}
+
+function build_list($n) {
+  $head = null;
+  for ($i = 0; $i < $n; $i++) {
+    $head = new Node("v$i", $head);
+  }
+  return $head;
+}
+
+function main() {
+  var_dump(churn(20000));
+  $list = build_list(1000);
+  $count = 0;
+  for ($n = $list; $n; $n = $n->next) $count++;
+  var_dump($count, $list->val);
+  unset($list);
+
+  // Small blocks freed during the request are never handed out again,
+  // so churning claims fresh slabs even though nothing stays live.
+  // memory_get_usage() counts slabs; memory_get_usage(true) counts the
+  // bytes in use.
+  $slabs = memory_get_usage();
+  $live = memory_get_usage(true);
+  churn(50000);
+  var_dump(memory_get_usage() - $slabs >= (8 << 20));
+  var_dump(memory_get_usage(true) - $live < 4096);
+}
+
+main();
@@ -0,0 +1,26 @@
+<?php
+
+function churn($n) {
+  $total = 0;
+  for ($i = 0; $i < $n; $i++) {
+    $s = str_repeat('x', $i % 100) . $i;
+    $a = array($i, $s, array('k' => $s));
+    $total += strlen($a[2]['k']);
+    unset($a);
+  }
+  return $total;
+}
+
+function main() {
+  // The same churn as arena.php, but without the arena the free lists
+  // hand the blocks straight back out, so it needs at most one more
+  // slab.
+  churn(1000);
+  $slabs = memory_get_usage();
+  $live = memory_get_usage(true);
+  churn(50000);
+  var_dump(memory_get_usage() - $slabs <= (2 << 20));
+  var_dump(memory_get_usage(true) - $live < 4096);
+}
+
+main();
@@ -0,0 +1,38 @@
+<?php
+
+class Node {
+  public $next;
+  public $payload;
+}
+
+function make_cycles($n) {
+  for ($i = 0; $i < $n; $i++) {
+    $a = new Node;
+    $b = new Node;
+    $a->next = $b;
+    $b->next = $a;
+    $a->payload = str_repeat('x', 100);
+  }
+}
+
+function main() {
+  var_dump(gc_enabled());
+
+  $live = new Node;
+  $live->next = $live;
+
+  make_cycles(1000);
+  $before = memory_get_usage(true);
+  var_dump(gc_collect_cycles() >= 2000);
+  var_dump(memory_get_usage(true) < $before);
+
+  // Reachable cycles are left alone.
+  var_dump($live->next === $live);
+
+  gc_disable();
+  var_dump(gc_enabled());
+  make_cycles(10);
+  var_dump(gc_collect_cycles());
+}
+
+main();
@@ -0,0 +1,38 @@
+<?php
+
+// Cycles made only of arrays and references, with no objects to act
+// as roots.
+function make_cycles($n) {
+  for ($i = 0; $i < $n; $i++) {
+    $a = array('payload' => str_repeat('x', 100));
+    $a['self'] = &$a;
+
+    $x = array(str_repeat('y', 100));
+    $y = array(&$x);
+    $x[] = &$y;
+
+    // Assigning to $a next time round would write through the ref.
+    unset($a, $x, $y);
+  }
+}
+
+function main() {
+  $live = array();
+  $live['self'] = &$live;
+
+  $before = memory_get_usage(true);
+  make_cycles(1000);
+  $grown = memory_get_usage(true);
+  var_dump($grown - $before > 100000);
+
+  // Each iteration leaves an array and a ref behind from the first
+  // cycle, and two of each from the second.
+  var_dump(gc_collect_cycles() >= 6000);
+  var_dump(memory_get_usage(true) - $before < ($grown - $before) / 4);
+
+  // Reachable cycles are left alone.
+  var_dump(isset($live['self']['self']));
+  var_dump(gc_collect_cycles());
+}
+
+main();
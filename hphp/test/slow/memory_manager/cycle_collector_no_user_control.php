@@ -0,0 +1,28 @@
+<?php
+
+class Node {
+  public $next;
+}
+
+function make_cycles($n) {
+  for ($i = 0; $i < $n; $i++) {
+    $a = new Node;
+    $b = new Node;
+    $a->next = $b;
+    $b->next = $a;
+  }
+}
+
+function main() {
+  var_dump(gc_enabled());
+
+  // Without Eval.CycleCollectorUserControl the script can't switch it off.
+  gc_disable();
+  var_dump(gc_enabled());
+
+  make_cycles(10);
+  var_dump(gc_collect_cycles());
+  var_dump(gc_collect_cycles());
+}
+
+main();
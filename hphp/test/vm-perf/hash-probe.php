@@ -0,0 +1,40 @@
+<?php
+
+/**
+ * String-keyed insert and lookup throughput at a few table sizes.  Time
+ * this against a build with the previous hash layout to compare probing.
+ */
+
+function build($n) {
+  $a = array();
+  for ($i = 0; $i < $n; ++$i) {
+    $a['key_' . $i] = $i;
+  }
+  return $a;
+}
+
+function probe($a, $n, $rounds) {
+  $hits = 0;
+  $misses = 0;
+  for ($r = 0; $r < $rounds; ++$r) {
+    for ($i = 0; $i < $n; ++$i) {
+      if (isset($a['key_' . $i])) ++$hits;
+      if (isset($a['nokey_' . $i])) ++$misses;
+    }
+  }
+  return array($hits, $misses);
+}
+
+function run($n, $rounds) {
+  $sum = 0;
+  for ($r = 0; $r < $rounds; ++$r) {
+    $a = build($n);
+    $sum += count($a);
+  }
+  list($hits, $misses) = probe($a, $n, $rounds);
+  echo "$n: built $sum, hits $hits, misses $misses\n";
+}
+
+run(10, 100000);
+run(1000, 1000);
+run(1000000, 1);
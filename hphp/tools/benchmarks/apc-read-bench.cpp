@@ -0,0 +1,141 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+/*
+ * Models the two ways ConcurrentTableSharedStore::get() can find a value
+ * when many threads fetch the same few keys.
+ *
+ *   apc-read-bench [max-threads [keys]]
+ *
+ *   locked: find() with a Map::const_accessor, which takes the bucket's
+ *           reader lock, then an atomic increment and decrement of the
+ *           value's refcount, as toLocal() and the later release do.
+ *   hot:    one acquire load of a published entry and a key compare, as
+ *           with Server.APC.HotCache; the refcount is touched once per
+ *           request rather than per fetch, so not at all here.
+ *
+ * Prints total fetches per microsecond for each thread count.  The
+ * runtime itself can't be linked into a standalone program, so this
+ * only measures the mechanisms.
+ */
+
+#include <tbb/concurrent_hash_map.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Value {
+  std::atomic<int> count;
+  int64_t payload;
+};
+
+typedef tbb::concurrent_hash_map<std::string, Value*> Map;
+
+struct HotEntry {
+  Value* var;
+  size_t hash;
+  std::string key;
+};
+
+constexpr size_t kHotSize = 4096;
+constexpr size_t kFetches = 1 << 21;
+
+std::atomic<int64_t> g_sink;
+
+template <class F>
+double fetchesPerUs(int threads, F fetch) {
+  std::atomic<int> ready(0);
+  std::atomic<bool> go(false);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      ++ready;
+      while (!go.load()) {}
+      int64_t sum = 0;
+      for (size_t i = 0; i < kFetches; ++i) sum += fetch(t + i);
+      g_sink += sum;
+    });
+  }
+  while (ready.load() < threads) {}
+  auto const start = std::chrono::steady_clock::now();
+  go = true;
+  for (auto& w : workers) w.join();
+  auto const us = std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - start).count();
+  return double(kFetches) * threads / us;
+}
+
+}
+
+int main(int argc, char** argv) {
+  int const maxThreads = argc > 1 ? atoi(argv[1])
+                                  : std::thread::hardware_concurrency();
+  size_t const nkeys = argc > 2 ? strtoul(argv[2], nullptr, 10) : 8;
+
+  Map map;
+  std::vector<std::string> keys;
+  std::vector<std::atomic<HotEntry*>> hot(kHotSize);
+  for (auto& slot : hot) slot = nullptr;
+  std::hash<std::string> hasher;
+  for (size_t i = 0; i < nkeys; ++i) {
+    keys.push_back("config:site:" + std::to_string(i));
+    auto const v = new Value;
+    v->count = 1;
+    v->payload = i;
+    Map::accessor acc;
+    map.insert(acc, keys.back());
+    acc->second = v;
+    auto const h = hasher(keys.back());
+    hot[h & (kHotSize - 1)] = new HotEntry{v, h, keys.back()};
+  }
+
+  auto locked = [&](size_t i) -> int64_t {
+    auto const& key = keys[i % nkeys];
+    Map::const_accessor acc;
+    if (!map.find(acc, key)) return 0;
+    auto const v = acc->second;
+    v->count.fetch_add(1, std::memory_order_relaxed);
+    auto const ret = v->payload;
+    v->count.fetch_sub(1, std::memory_order_acq_rel);
+    return ret;
+  };
+
+  auto lockFree = [&](size_t i) -> int64_t {
+    auto const& key = keys[i % nkeys];
+    auto const h = hasher(key);
+    auto const e = hot[h & (kHotSize - 1)].load(std::memory_order_acquire);
+    if (!e || e->hash != h || e->key.size() != key.size() ||
+        memcmp(e->key.data(), key.data(), key.size()) != 0) {
+      return 0;
+    }
+    return e->var->payload;
+  };
+
+  printf("%8s %14s %14s\n", "threads", "locked /us", "hot /us");
+  for (int t = 1; t <= maxThreads; t *= 2) {
+    printf("%8d %14.1f %14.1f\n", t,
+           fetchesPerUs(t, locked), fetchesPerUs(t, lockFree));
+  }
+  return 0;
+}
@@ -0,0 +1,120 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+/*
+ * Compares the two case-insensitive string hashes StringData::hash() can
+ * use: MurmurHash3 (the default) and hash_string_i_crc (selected with
+ * HHVM_STRING_HASH=crc32).
+ *
+ *   string-hash-bench [iterations-scale]
+ *
+ * For each key length it prints nanoseconds per hash, then how evenly
+ * each function spreads a set of identifier-like keys over a
+ * power-of-two table, the way HphpArray and the static string table use
+ * the low bits.
+ */
+
+#include "hphp/util/hash.h"
+#include "hphp/util/string-simd.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace HPHP;
+
+namespace {
+
+volatile strhash_t g_sink;
+
+strhash_t murmur(const char* s, int len) {
+  uint64_t h[2];
+  MurmurHash3::hash128<false>(s, len, 0, h);
+  return strhash_t(h[0] & STRHASH_MASK);
+}
+
+std::vector<std::string> makeKeys(size_t count, size_t len) {
+  static const char alphabet[] =
+    "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_";
+  std::mt19937 rng(len);
+  std::vector<std::string> keys(count);
+  for (auto& k : keys) {
+    k.resize(len);
+    for (auto& c : k) c = alphabet[rng() % (sizeof(alphabet) - 1)];
+  }
+  return keys;
+}
+
+template <class H>
+double nsPerHash(const std::vector<std::string>& keys, size_t reps, H h) {
+  auto const start = std::chrono::steady_clock::now();
+  for (size_t r = 0; r < reps; r++) {
+    for (auto const& k : keys) g_sink = g_sink + h(k.data(), k.size());
+  }
+  auto const ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - start).count();
+  return double(ns) / (double(reps) * keys.size());
+}
+
+/*
+ * Keys that are the same but for a counter, like generated array keys
+ * ("item_1", "item_2", ...), put the most stress on the low bits.  The
+ * result is the longest chain as a multiple of the expected load.
+ */
+template <class H>
+double worstChain(size_t len, H h) {
+  size_t const buckets = 1 << 14;
+  std::vector<uint32_t> load(buckets);
+  char buf[64];
+  for (size_t i = 0; i < buckets * 4; i++) {
+    int n = snprintf(buf, sizeof buf, "%0*zu", int(len), i);
+    load[h(buf, n) & (buckets - 1)]++;
+  }
+  uint32_t worst = 0;
+  for (auto l : load) worst = std::max(worst, l);
+  return worst / 4.0;
+}
+
+}
+
+int main(int argc, char** argv) {
+  size_t const scale = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1;
+  bool const crc = simdSupportedLevel() >= SimdLevel::SSE42;
+  if (!crc) {
+    printf("no SSE4.2 on this machine; hash_string_i_crc is unavailable\n");
+    return 1;
+  }
+
+  printf("%6s %12s %12s\n", "bytes", "murmur ns", "crc32 ns");
+  for (size_t len : { 1, 4, 7, 8, 12, 16, 24, 32, 64, 128, 256, 1024 }) {
+    auto const keys = makeKeys(4096, len);
+    size_t const reps = scale * 16 * 1024 / (len / 16 + 1) / 64;
+    printf("%6zu %12.2f %12.2f\n", len,
+           nsPerHash(keys, reps, murmur),
+           nsPerHash(keys, reps, hash_string_i_crc));
+  }
+
+  printf("\nlongest chain / expected, counter keys\n");
+  printf("%6s %12s %12s\n", "bytes", "murmur", "crc32");
+  for (size_t len : { 2, 4, 6, 8, 12, 16, 24, 32 }) {
+    printf("%6zu %12.2f %12.2f\n", len,
+           worstChain(len, murmur), worstChain(len, hash_string_i_crc));
+  }
+  return 0;
+}
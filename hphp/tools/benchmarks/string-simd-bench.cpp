@@ -0,0 +1,146 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+/*
+ * Times the string-simd kernels at each level this machine supports.
+ *
+ *   string-simd-bench [iterations-scale]
+ *
+ * Inputs are HTML-ish text, so matches are about as frequent as they are
+ * in strtolower/trim/addslashes/strpos calls on page fragments.  Results
+ * are nanoseconds per input byte; lower is better.
+ */
+
+#include "hphp/util/string-simd.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace HPHP;
+
+namespace {
+
+volatile size_t g_sink;
+
+std::string makeText(size_t len) {
+  static const char sample[] =
+    "<div class=\"item\">Hello, World! It's the \"Quick\" Brown Fox "
+    "jumping over 12 lazy dogs &amp; cats.</div>\n";
+  std::string s;
+  s.reserve(len);
+  while (s.size() < len) s += sample;
+  s.resize(len);
+  return s;
+}
+
+template <class F>
+double nsPerByte(const std::string& s, size_t reps, F f) {
+  auto const start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < reps; i++) {
+    g_sink = g_sink + f(s.data(), s.size());
+  }
+  auto const ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - start).count();
+  return double(ns) / (double(reps) * s.size());
+}
+
+const char kSpaces[] = " \t\n\r\v";
+const char kSlashes[] = { '\0', '\'', '"', '\\' };
+const char kHtml[] = { '\0', '<', '>', '&', '"', '\'', '{', '}', '@' };
+
+}
+
+int main(int argc, char** argv) {
+  size_t const scale = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1;
+  size_t const sizes[] = { 16, 256, 4096, 65536 };
+  std::vector<char> buf(65536);
+
+  struct Kernel {
+    const char* name;
+    size_t (*fn)(const char*, size_t, char*);
+  };
+  Kernel const kernels[] = {
+    { "memmem", [] (const char* s, size_t n, char*) -> size_t {
+        auto const p = simd_memmem(s, n, "lazy cats", 9);
+        return p ? p - s : n;
+      } },
+    { "memcasechr", [] (const char* s, size_t n, char*) -> size_t {
+        auto const p = simd_memcasechr(s, n, 'Z');
+        return p ? p - s : n;
+      } },
+    { "tolower", [] (const char* s, size_t n, char* out) -> size_t {
+        simd_ascii_tolower(out, s, n);
+        return out[n - 1];
+      } },
+    { "toupper", [] (const char* s, size_t n, char* out) -> size_t {
+        simd_ascii_toupper(out, s, n);
+        return out[n - 1];
+      } },
+    { "span(trim)", [] (const char* s, size_t n, char*) -> size_t {
+        return simd_span(s, n, kSpaces, sizeof(kSpaces) - 1) +
+               simd_rspan(s, n, kSpaces, sizeof(kSpaces) - 1);
+      } },
+    { "cspan(addslashes)", [] (const char* s, size_t n, char*) -> size_t {
+        size_t total = 0;
+        for (size_t pos = 0; pos < n; ++pos) {
+          pos += simd_cspan(s + pos, n - pos, kSlashes, sizeof(kSlashes));
+          ++total;
+        }
+        return total;
+      } },
+    { "ascii_cspan(html)", [] (const char* s, size_t n, char*) -> size_t {
+        size_t total = 0;
+        for (size_t pos = 0; pos < n; ++pos) {
+          pos += simd_ascii_cspan(s + pos, n - pos, kHtml, sizeof(kHtml));
+          ++total;
+        }
+        return total;
+      } },
+  };
+
+  printf("supported level: %s\n\n", simdLevelName(simdSupportedLevel()));
+  printf("%-20s %8s", "kernel", "bytes");
+  int const top = int(simdSupportedLevel());
+  for (int l = 0; l <= top; l++) {
+    printf(" %10s", simdLevelName(SimdLevel(l)));
+  }
+  printf("\n");
+
+  for (auto const& k : kernels) {
+    for (auto const size : sizes) {
+      auto text = makeText(size);
+      if (k.fn == kernels[0].fn || k.fn == kernels[1].fn) {
+        // Search kernels: make the target absent so the whole input is
+        // scanned, as in the common "not found" strpos/stristr case.
+        for (auto& c : text) if (c == 'z' || c == 'Z') c = 'y';
+      }
+      size_t const reps = scale * (size_t(1) << 26) / (size + 64);
+      printf("%-20s %8zu", k.name, size);
+      for (int l = 0; l <= top; l++) {
+        setSimdLevel(SimdLevel(l));
+        auto const out = buf.data();
+        auto const fn = k.fn;
+        printf(" %10.3f", nsPerByte(text, reps,
+          [&] (const char* s, size_t n) { return fn(s, n, out); }));
+      }
+      printf("\n");
+    }
+  }
+  return 0;
+}
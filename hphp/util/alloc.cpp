@@ -104,6 +104,7 @@ void enable_numa(bool local) {}
 int next_numa_node() { return 0; }
 void set_numa_binding(int node) {}
 int num_numa_nodes() { return 1; }
+int numa_node_arena(int node) { return -1; }
 void numa_interleave(void* start, size_t size) {}
 void numa_local(void* start, size_t size) {}
 void numa_bind_to(void* start, size_t size, int node) {}
@@ -262,6 +263,11 @@ int num_numa_nodes() {
   return numa_num_nodes;
 }
 
+int numa_node_arena(int node) {
+  if (!use_numa || !threads_bind_local) return -1;
+  return base_arena + node;
+}
+
 void numa_interleave(void* start, size_t size) {
   if (!use_numa) return;
   numa_interleave_memory(start, size, numa_all_nodes_ptr);
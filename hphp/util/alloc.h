@@ -213,6 +213,11 @@ void set_numa_binding(int node);
  * The number of numa nodes in the system
  */
 int num_numa_nodes();
+/*
+ * The jemalloc arena dedicated to the given node, or -1 if threads
+ * aren't using node-local arenas.
+ */
+int numa_node_arena(int node);
 /*
  * Enable numa interleaving for the specified address range
  */
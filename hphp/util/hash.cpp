@@ -14,11 +14,94 @@
    +----------------------------------------------------------------------+
 */
 #include <string.h>
+#include <strings.h>
 #include "hphp/util/hash.h"
+#include "hphp/util/string-simd.h"
 #include "hphp/util/util.h"
 
+#ifdef __x86_64__
+#include <nmmintrin.h>
+#endif
+
 namespace HPHP {
 
+std::atomic<StringHashFunction> g_stringHashFunction(
+  StringHashFunction::Unset);
+
+StringHashFunction initStringHashFunction() {
+  auto f = StringHashFunction::Murmur3;
+  auto const env = getenv("HHVM_STRING_HASH");
+  if (env && !strcasecmp(env, "crc32") &&
+      simdSupportedLevel() >= SimdLevel::SSE42) {
+    f = StringHashFunction::CRC32;
+  }
+  // Every thread that gets here computes the same answer.
+  g_stringHashFunction.store(f, std::memory_order_relaxed);
+  return f;
+}
+
+const char* stringHashFunctionName(StringHashFunction f) {
+  switch (f) {
+    case StringHashFunction::Unset:   break;
+    case StringHashFunction::Murmur3: return "murmur3";
+    case StringHashFunction::CRC32:   return "crc32";
+  }
+  return "unset";
+}
+
+#ifdef __x86_64__
+__attribute__((__target__("sse4.2")))
+strhash_t hash_string_i_crc(const char *arKey, int nKeyLength) {
+  const uint64_t fold = 0xdfdfdfdfdfdfdfdfLLU; // a-z => A-Z
+  auto p = arKey;
+  size_t len = nKeyLength;
+  // Two streams, so consecutive crc32s don't wait on each other.  The
+  // length goes in the seed, as the tail is padded with zeros.
+  uint64_t h1 = len;
+  uint64_t h2 = ~uint64_t(0);
+  uint64_t a, b;
+  for (; len >= 16; p += 16, len -= 16) {
+    memcpy(&a, p, 8);
+    memcpy(&b, p + 8, 8);
+    h1 = _mm_crc32_u64(h1, a & fold);
+    h2 = _mm_crc32_u64(h2, b & fold);
+  }
+  if (len >= 8) {
+    memcpy(&a, p, 8);
+    h1 = _mm_crc32_u64(h1, a & fold);
+    p += 8;
+    len -= 8;
+  }
+  if (len) {
+    // Assemble the tail from loads that may overlap; with the length in
+    // the seed, that still tells different tails apart.
+    if (nKeyLength >= 8) {
+      memcpy(&b, p + len - 8, 8);
+    } else if (len >= 4) {
+      uint32_t lo, hi;
+      memcpy(&lo, p, 4);
+      memcpy(&hi, p + len - 4, 4);
+      b = lo | uint64_t(hi) << 32;
+    } else {
+      b = uint8_t(p[0]) | uint8_t(p[len >> 1]) << 8 |
+          uint8_t(p[len - 1]) << 16;
+    }
+    h2 = _mm_crc32_u64(h2, b & fold);
+  }
+  // crc32 is linear in its input; a multiply spreads it over the high
+  // bits, which are the ones kept.
+  auto const h = ((h1 << 32) | (h2 & 0xffffffff)) * 0x9e3779b97f4a7c15LLU;
+  return strhash_t(h >> 33);
+}
+#else
+strhash_t hash_string_i_crc(const char *arKey, int nKeyLength) {
+  // Never selected without SSE4.2; keep the symbol for the benchmark.
+  uint64_t h[2];
+  MurmurHash3::hash128<false>(arKey, nKeyLength, 0, h);
+  return strhash_t(h[0] & STRHASH_MASK);
+}
+#endif
+
 HOT_FUNC
 strhash_t hash_string_i(const char *arKey, int nKeyLength) {
   return hash_string_i_inline(arKey, nKeyLength);
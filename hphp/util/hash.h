@@ -18,6 +18,7 @@
 #define incl_HPHP_HASH_H_
 
 #include <stdint.h>
+#include <atomic>
 #include <cstring>
 
 #include "hphp/util/util.h"
@@ -236,6 +237,40 @@ ALWAYS_INLINE void hash128(const void *key, size_t len, uint64_t seed,
 ///////////////////////////////////////////////////////////////////////////////
 } // namespace MurmurHash3
 
+/*
+ * The case-insensitive string hash (hash_string_i and friends, so
+ * StringData::hash() too) is MurmurHash3 by default.  Starting the
+ * process with HHVM_STRING_HASH=crc32 switches it to hash_string_i_crc
+ * on CPUs that have SSE4.2, and leaves it on MurmurHash3 elsewhere.
+ *
+ * Hashes are cached in static strings and shared memory, so the choice
+ * is made the first time anything is hashed, and never changes after
+ * that.  Processes sharing hashed data must make the same choice.
+ */
+enum class StringHashFunction : uint8_t {
+  Unset,
+  Murmur3,
+  CRC32,
+};
+
+extern std::atomic<StringHashFunction> g_stringHashFunction;
+StringHashFunction initStringHashFunction();
+const char* stringHashFunctionName(StringHashFunction f);
+
+inline StringHashFunction stringHashFunction() {
+  auto const f = g_stringHashFunction.load(std::memory_order_relaxed);
+  return LIKELY(f != StringHashFunction::Unset) ? f
+                                                : initStringHashFunction();
+}
+
+/*
+ * Case-insensitive hash built on the SSE4.2 crc32 instruction, with
+ * the same a-z => A-Z folding as MurmurHash3 above.  It does 8 bytes in
+ * a few cycles, and is meant for hash tables, not for anything that
+ * needs to resist chosen inputs.  Pre: the CPU supports SSE4.2.
+ */
+strhash_t hash_string_i_crc(const char *arKey, int nKeyLength);
+
 inline strhash_t hash_string_cs(const char *arKey, int nKeyLength) {
   if (MurmurHash3::useHash128) {
     uint64_t h[2];
@@ -251,6 +286,9 @@ strhash_t hash_string_i(const char *arKey, int nKeyLength);
 strhash_t hash_string(const char *arKey, int nKeyLength);
 
 inline strhash_t hash_string_i_inline(const char *arKey, int nKeyLength) {
+  if (stringHashFunction() == StringHashFunction::CRC32) {
+    return hash_string_i_crc(arKey, nKeyLength);
+  }
   if (MurmurHash3::useHash128) {
     uint64_t h[2];
     MurmurHash3::hash128<false>(arKey, nKeyLength, 0, h);
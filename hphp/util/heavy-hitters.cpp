@@ -0,0 +1,124 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+#include "hphp/util/heavy-hitters.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "hphp/util/hash.h"
+
+namespace HPHP {
+
+//////////////////////////////////////////////////////////////////////
+
+HeavyHitters::HeavyHitters() {
+  reset();
+}
+
+void HeavyHitters::reset() {
+  for (auto& row : m_sketch) {
+    for (auto& c : row) c.store(0, std::memory_order_relaxed);
+  }
+  for (auto& s : m_slots) {
+    s.seq.store(0, std::memory_order_relaxed);
+    s.hash.store(0, std::memory_order_relaxed);
+    s.count.store(0, std::memory_order_relaxed);
+    s.len = 0;
+    s.truncated = false;
+  }
+}
+
+void HeavyHitters::add(const char* key, size_t len, uint64_t weight) {
+  uint64_t h[2];
+  MurmurHash3::hash128<true>(key, len, 0, h);
+  // Zero marks an empty slot.
+  auto const hash = h[0] | 1;
+
+  // Row i uses h0 + i * h1 (Kirsch-Mitzenmacher), so one hash is enough.
+  uint64_t est = UINT64_MAX;
+  for (size_t i = 0; i < kDepth; ++i) {
+    auto& c = m_sketch[i][(h[0] + i * h[1]) % kWidth];
+    est = std::min(est, c.fetch_add(weight, std::memory_order_relaxed) +
+                        weight);
+  }
+
+  auto const set = (hash >> 32) % (kSlots / kWays) * kWays;
+  Slot* victim = nullptr;
+  uint64_t victimCount = UINT64_MAX;
+  for (size_t i = set; i < set + kWays; ++i) {
+    auto& s = m_slots[i];
+    if (s.hash.load(std::memory_order_relaxed) == hash) {
+      auto cur = s.count.load(std::memory_order_relaxed);
+      while (cur < est &&
+             !s.count.compare_exchange_weak(cur, est,
+                                            std::memory_order_relaxed)) {}
+      return;
+    }
+    auto const count = s.count.load(std::memory_order_relaxed);
+    if (count < victimCount) {
+      victim = &s;
+      victimCount = count;
+    }
+  }
+  if (est <= victimCount) return;
+
+  auto seq = victim->seq.load(std::memory_order_relaxed);
+  if ((seq & 1) ||
+      !victim->seq.compare_exchange_strong(seq, seq + 1,
+                                           std::memory_order_acquire)) {
+    return;
+  }
+  victim->hash.store(hash, std::memory_order_relaxed);
+  victim->count.store(est, std::memory_order_relaxed);
+  victim->len = std::min(len, kMaxKeyLen);
+  victim->truncated = len > kMaxKeyLen;
+  memcpy(victim->key, key, victim->len);
+  victim->seq.store(seq + 2, std::memory_order_release);
+}
+
+std::vector<std::pair<std::string, uint64_t>>
+HeavyHitters::top(size_t n) const {
+  std::vector<std::pair<std::string, uint64_t>> ret;
+  for (auto& s : m_slots) {
+    for (int tries = 0; tries < 16; ++tries) {
+      auto const before = s.seq.load(std::memory_order_acquire);
+      if (before & 1) continue;
+      if (!s.hash.load(std::memory_order_relaxed)) break;
+      auto const count = s.count.load(std::memory_order_relaxed);
+      std::string key(s.key, s.len);
+      if (s.truncated) key += "...";
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (s.seq.load(std::memory_order_relaxed) != before) continue;
+      ret.emplace_back(std::move(key), count);
+      break;
+    }
+  }
+  auto const cmp = [] (const std::pair<std::string, uint64_t>& a,
+                       const std::pair<std::string, uint64_t>& b) {
+    return a.second > b.second;
+  };
+  if (ret.size() > n) {
+    std::partial_sort(ret.begin(), ret.begin() + n, ret.end(), cmp);
+    ret.resize(n);
+  } else {
+    std::sort(ret.begin(), ret.end(), cmp);
+  }
+  return ret;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+}
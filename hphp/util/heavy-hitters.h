@@ -0,0 +1,88 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+#ifndef incl_HPHP_HEAVY_HITTERS_H_
+#define incl_HPHP_HEAVY_HITTERS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+namespace HPHP {
+
+//////////////////////////////////////////////////////////////////////
+
+/*
+ * Finds the keys with the largest total weight in a stream, in fixed
+ * memory, without locks.
+ *
+ * A count-min sketch of atomic counters estimates each key's total; the
+ * estimate never undercounts, and overcounts by at most about
+ * 2 * total / kWidth with high probability.  Keys whose estimate is
+ * large enough are kept in a small set-associative table of candidates,
+ * which is what top() reports.  Each candidate slot is guarded by a
+ * sequence lock: a writer that finds one busy just doesn't update it,
+ * and readers retry.  Keys longer than kMaxKeyLen are kept truncated
+ * (but told apart by their full hash).
+ *
+ * add() costs a hash, kDepth relaxed atomic adds and a look at kWays
+ * slots.  Callers on hot paths are expected to sample, and scale the
+ * weight to match.
+ */
+struct HeavyHitters : private boost::noncopyable {
+  static constexpr size_t kDepth = 4;
+  static constexpr size_t kWidth = 4096;
+  static constexpr size_t kSlots = 256;
+  static constexpr size_t kWays = 4;
+  static constexpr size_t kMaxKeyLen = 96;
+
+  HeavyHitters();
+
+  void add(const char* key, size_t len, uint64_t weight);
+
+  /*
+   * The n candidates with the largest estimates, largest first.
+   * Truncated keys end in "...".
+   */
+  std::vector<std::pair<std::string, uint64_t>> top(size_t n) const;
+
+  /*
+   * Forget everything.  Adds that race with a reset may survive it.
+   */
+  void reset();
+
+private:
+  struct Slot {
+    std::atomic<uint32_t> seq;
+    std::atomic<uint64_t> hash;
+    std::atomic<uint64_t> count;
+    uint32_t len;
+    bool truncated;
+    char key[kMaxKeyLen];
+  };
+
+  std::atomic<uint64_t> m_sketch[kDepth][kWidth];
+  Slot m_slots[kSlots];
+};
+
+//////////////////////////////////////////////////////////////////////
+
+}
+
+#endif
@@ -213,11 +213,13 @@ public:
         // since we timed out, maybe we can turn idle without holding memory
         if (m_jobCount == 0) {
           ScopedUnlock unlock(this);
+          // The policy may free memory, so let it go first and the
+          // arena purge below can return those pages too.
+          DropCachePolicy::dropCache();
           Util::flush_thread_caches();
           if (m_dropStack && Util::s_stackLimit) {
             Util::flush_thread_stack();
           }
-          DropCachePolicy::dropCache();
           flushed = true;
         }
       }
@@ -0,0 +1,475 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+#include "hphp/util/shared-memory-table.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hphp/util/assertions.h"
+#include "hphp/util/exception.h"
+#include "hphp/util/hash.h"
+
+namespace HPHP {
+
+//////////////////////////////////////////////////////////////////////
+
+namespace {
+
+const char kMagic[8] = { 'H', 'H', 'S', 'H', 'M', 'T', 'B', 'L' };
+// Bump whenever the layout, or how keys are hashed, changes.
+const uint32_t kVersion = 1;
+
+const uint64_t kEmpty = 0;
+const uint64_t kTombstone = 1;
+
+size_t roundUp(size_t n, size_t to) {
+  return (n + to - 1) / to * to;
+}
+
+size_t recordSize(size_t klen, size_t vlen) {
+  return roundUp(klen + vlen, 8);
+}
+
+}
+
+struct SharedMemoryTable::Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t stripes;
+  uint64_t bytes;
+  uint64_t slotsPerStripe;
+  uint64_t heapPerStripe;
+  uint64_t stripeOffset;
+  uint64_t stripeStride;
+  std::atomic<uint64_t> recoveries;
+  // Set last, once everything else is in place.
+  std::atomic<uint32_t> formatted;
+};
+
+struct SharedMemoryTable::Stripe {
+  pthread_mutex_t mutex;
+  uint64_t count;     // live keys
+  uint64_t used;      // slots that aren't empty, tombstones included
+  uint64_t heapUsed;
+  uint64_t liveBytes; // heap bytes belonging to live keys
+  uint64_t hand;      // next slot to look at for eviction
+};
+
+struct SharedMemoryTable::Slot {
+  uint64_t hash;      // kEmpty, kTombstone or a key's hash
+  uint64_t off;       // of the key in the heap; the value follows it
+  uint32_t klen;
+  uint32_t vlen;
+  int64_t expiry;
+};
+
+struct SharedMemoryTable::StripeLock {
+  StripeLock(const SharedMemoryTable* table, Stripe* s) : m_stripe(s) {
+    int rc = pthread_mutex_lock(&s->mutex);
+    if (rc == EOWNERDEAD) {
+      // Whoever held it died part way through a change; nothing in the
+      // stripe can be trusted.
+      table->wipe(s);
+      table->m_header->recoveries.fetch_add(1);
+      rc = pthread_mutex_consistent(&s->mutex);
+    }
+    always_assert(rc == 0);
+  }
+  ~StripeLock() {
+    pthread_mutex_unlock(&m_stripe->mutex);
+  }
+
+  Stripe* m_stripe;
+};
+
+//////////////////////////////////////////////////////////////////////
+
+SharedMemoryTable::SharedMemoryTable(const std::string& name, size_t bytes,
+                                     size_t maxKeys)
+  : m_name(name), m_base(nullptr), m_bytes(bytes), m_header(nullptr) {
+  // A mismatched segment is unlinked and we go round again; give up if
+  // other processes keep replacing it under us.
+  for (int tries = 0; tries < 8; ++tries) {
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+      throw Exception("shm_open %s failed: %s", name.c_str(),
+                      strerror(errno));
+    }
+    bool formatted = false;
+    try {
+      while (flock(fd, LOCK_EX) < 0) {
+        if (errno != EINTR) {
+          throw Exception("flock %s failed: %s", name.c_str(),
+                          strerror(errno));
+        }
+      }
+      attach(fd, bytes, maxKeys, formatted);
+    } catch (...) {
+      close(fd);
+      throw;
+    }
+    // The mapping keeps the open file, and with it the flock, alive.
+    flock(fd, LOCK_UN);
+    close(fd);
+    if (formatted) return;
+  }
+  throw Exception("could not attach to shared memory %s", name.c_str());
+}
+
+SharedMemoryTable::~SharedMemoryTable() {
+  if (m_base) munmap(m_base, m_bytes);
+}
+
+bool SharedMemoryTable::Remove(const std::string& name) {
+  return shm_unlink(name.c_str()) == 0;
+}
+
+/*
+ * Called holding the flock on fd.  Maps the segment and leaves
+ * formatted set if it is usable, formatting it first if nobody has;
+ * unlinks it if it was made for a different layout.
+ */
+void SharedMemoryTable::attach(int fd, size_t bytes, size_t maxKeys,
+                               bool& formatted) {
+  size_t slotsPerStripe = 8;
+  while (slotsPerStripe < maxKeys * 2 / kStripes) slotsPerStripe *= 2;
+  auto const headerSize = roundUp(sizeof(Header), 64);
+  auto const metaSize = roundUp(sizeof(Stripe), 64) +
+                        slotsPerStripe * sizeof(Slot);
+  if (bytes < headerSize + kStripes * (metaSize + 4096)) {
+    throw Exception("shared memory %s: %zu bytes is too small for %zu keys",
+                    m_name.c_str(), bytes, maxKeys);
+  }
+  auto const heapPerStripe =
+    ((bytes - headerSize) / kStripes - metaSize) & ~size_t(7);
+
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    throw Exception("fstat %s failed: %s", m_name.c_str(), strerror(errno));
+  }
+  if (st.st_size != 0 && size_t(st.st_size) != bytes) {
+    shm_unlink(m_name.c_str());
+    return;
+  }
+  if (st.st_size == 0 && ftruncate(fd, bytes) < 0) {
+    throw Exception("ftruncate %s failed: %s", m_name.c_str(),
+                    strerror(errno));
+  }
+  auto const base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         fd, 0);
+  if (base == MAP_FAILED) {
+    throw Exception("mmap %s failed: %s", m_name.c_str(), strerror(errno));
+  }
+  m_base = static_cast<char*>(base);
+  m_header = reinterpret_cast<Header*>(m_base);
+
+  auto& h = *m_header;
+  if (h.formatted.load(std::memory_order_acquire)) {
+    if (memcmp(h.magic, kMagic, sizeof kMagic) == 0 &&
+        h.version == kVersion && h.stripes == kStripes &&
+        h.bytes == bytes && h.slotsPerStripe == slotsPerStripe &&
+        h.heapPerStripe == heapPerStripe) {
+      formatted = true;
+      return;
+    }
+    munmap(m_base, bytes);
+    m_base = nullptr;
+    m_header = nullptr;
+    shm_unlink(m_name.c_str());
+    return;
+  }
+
+  // Either new, or whoever was formatting it died.
+  memcpy(h.magic, kMagic, sizeof kMagic);
+  h.version = kVersion;
+  h.stripes = kStripes;
+  h.bytes = bytes;
+  h.slotsPerStripe = slotsPerStripe;
+  h.heapPerStripe = heapPerStripe;
+  h.stripeOffset = headerSize;
+  h.stripeStride = metaSize + heapPerStripe;
+  h.recoveries.store(0, std::memory_order_relaxed);
+
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+  pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+  for (uint32_t i = 0; i < kStripes; ++i) {
+    auto const s = stripeAt(i);
+    pthread_mutex_init(&s->mutex, &attr);
+    wipe(s);
+  }
+  pthread_mutexattr_destroy(&attr);
+
+  h.formatted.store(1, std::memory_order_release);
+  formatted = true;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+SharedMemoryTable::Stripe* SharedMemoryTable::stripeAt(uint32_t i) const {
+  return reinterpret_cast<Stripe*>(
+    m_base + m_header->stripeOffset + i * m_header->stripeStride);
+}
+
+SharedMemoryTable::Stripe* SharedMemoryTable::stripeFor(uint64_t hash) const {
+  return stripeAt((hash >> 32) % kStripes);
+}
+
+SharedMemoryTable::Slot* SharedMemoryTable::slots(const Stripe* s) const {
+  return reinterpret_cast<Slot*>(
+    const_cast<char*>(reinterpret_cast<const char*>(s)) +
+    roundUp(sizeof(Stripe), 64));
+}
+
+char* SharedMemoryTable::heap(const Stripe* s) const {
+  return reinterpret_cast<char*>(slots(s) + m_header->slotsPerStripe);
+}
+
+uint64_t SharedMemoryTable::hashKey(const char* key, size_t klen) {
+  uint64_t h[2];
+  MurmurHash3::hash128<true>(key, klen, 0, h);
+  return h[0] > kTombstone ? h[0] : h[0] + 2;
+}
+
+SharedMemoryTable::Slot* SharedMemoryTable::find(Stripe* s, const char* key,
+                                                 size_t klen,
+                                                 uint64_t hash) const {
+  auto const mask = m_header->slotsPerStripe - 1;
+  auto const table = slots(s);
+  auto const base = heap(s);
+  for (uint64_t n = 0, i = hash & mask; n <= mask; ++n, i = (i + 1) & mask) {
+    auto& slot = table[i];
+    if (slot.hash == kEmpty) return nullptr;
+    if (slot.hash == hash && slot.klen == klen &&
+        memcmp(base + slot.off, key, klen) == 0) {
+      return &slot;
+    }
+  }
+  return nullptr;
+}
+
+// Removes slot if it has expired.
+bool SharedMemoryTable::live(Stripe* s, Slot* slot) {
+  if (slot->expiry && time(nullptr) >= slot->expiry) {
+    remove(s, slot);
+    return false;
+  }
+  return true;
+}
+
+void SharedMemoryTable::remove(Stripe* s, Slot* slot) {
+  slot->hash = kTombstone;
+  s->count--;
+  s->liveBytes -= recordSize(slot->klen, slot->vlen);
+}
+
+/*
+ * Make room for one more key needing need bytes of heap, compacting and
+ * evicting as necessary.  Slots and offsets all change if it does.
+ */
+bool SharedMemoryTable::reserve(Stripe* s, size_t need) {
+  auto const maxUsed = m_header->slotsPerStripe * 3 / 4;
+  auto const heapSize = m_header->heapPerStripe;
+  if (need > heapSize) return false;
+  if (s->used < maxUsed && s->heapUsed + need <= heapSize) return true;
+
+  if (s->count >= maxUsed || s->liveBytes + need > heapSize) {
+    // Leave some slack, so the next few stores don't compact again.
+    auto const keys = maxUsed - maxUsed / 8;
+    auto const bytes = heapSize - std::min(heapSize / 8, heapSize - need);
+    auto const table = slots(s);
+    auto const mask = m_header->slotsPerStripe - 1;
+    while (s->count >= keys || s->liveBytes + need > bytes) {
+      auto& slot = table[s->hand];
+      s->hand = (s->hand + 1) & mask;
+      if (slot.hash > kTombstone) remove(s, &slot);
+    }
+  }
+  compact(s);
+  return true;
+}
+
+void SharedMemoryTable::compact(Stripe* s) {
+  auto const now = time(nullptr);
+  auto const table = slots(s);
+  auto const base = heap(s);
+  std::vector<Slot> keep;
+  keep.reserve(s->count);
+  std::string data;
+  data.reserve(s->liveBytes);
+  for (uint64_t i = 0; i < m_header->slotsPerStripe; ++i) {
+    auto slot = table[i];
+    if (slot.hash <= kTombstone) continue;
+    if (slot.expiry && now >= slot.expiry) continue;
+    auto const off = data.size();
+    data.append(base + slot.off, slot.klen + slot.vlen);
+    data.resize(off + recordSize(slot.klen, slot.vlen));
+    slot.off = off;
+    keep.push_back(slot);
+  }
+
+  auto const hand = s->hand;
+  wipe(s);
+  s->hand = hand;
+  for (auto& slot : keep) {
+    auto const p = data.data() + slot.off;
+    insert(s, slot.hash, p, slot.klen, p + slot.klen, slot.vlen,
+           slot.expiry);
+  }
+}
+
+// The caller has reserve()d room.
+void SharedMemoryTable::insert(Stripe* s, uint64_t hash, const char* key,
+                               size_t klen, const char* val, size_t vlen,
+                               int64_t expiry) {
+  auto const mask = m_header->slotsPerStripe - 1;
+  auto const table = slots(s);
+  auto i = hash & mask;
+  while (table[i].hash > kTombstone) i = (i + 1) & mask;
+  auto& slot = table[i];
+  if (slot.hash == kEmpty) s->used++;
+
+  auto const rec = recordSize(klen, vlen);
+  auto const p = heap(s) + s->heapUsed;
+  memcpy(p, key, klen);
+  memcpy(p + klen, val, vlen);
+  slot.off = s->heapUsed;
+  slot.klen = klen;
+  slot.vlen = vlen;
+  slot.expiry = expiry;
+  slot.hash = hash;
+  s->heapUsed += rec;
+  s->liveBytes += rec;
+  s->count++;
+}
+
+void SharedMemoryTable::wipe(Stripe* s) const {
+  memset(slots(s), 0, m_header->slotsPerStripe * sizeof(Slot));
+  s->count = 0;
+  s->used = 0;
+  s->heapUsed = 0;
+  s->liveBytes = 0;
+  s->hand = 0;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+bool SharedMemoryTable::store(const char* key, size_t klen, const char* val,
+                              size_t vlen, int64_t expiry,
+                              bool overwrite /* = true */) {
+  auto const hash = hashKey(key, klen);
+  auto const s = stripeFor(hash);
+  StripeLock lock(this, s);
+  auto slot = find(s, key, klen, hash);
+  if (slot && live(s, slot) && !overwrite) return false;
+  // A store that doesn't fit leaves the old value alone.
+  if (!reserve(s, recordSize(klen, vlen))) return false;
+  // reserve() may have moved or evicted the old value.
+  if ((slot = find(s, key, klen, hash))) remove(s, slot);
+  insert(s, hash, key, klen, val, vlen, expiry);
+  return true;
+}
+
+bool SharedMemoryTable::get(const char* key, size_t klen, std::string& val) {
+  auto const hash = hashKey(key, klen);
+  auto const s = stripeFor(hash);
+  StripeLock lock(this, s);
+  auto const slot = find(s, key, klen, hash);
+  if (!slot || !live(s, slot)) return false;
+  val.assign(heap(s) + slot->off + klen, slot->vlen);
+  return true;
+}
+
+bool SharedMemoryTable::exists(const char* key, size_t klen) {
+  auto const hash = hashKey(key, klen);
+  auto const s = stripeFor(hash);
+  StripeLock lock(this, s);
+  auto const slot = find(s, key, klen, hash);
+  return slot && live(s, slot);
+}
+
+bool SharedMemoryTable::erase(const char* key, size_t klen) {
+  auto const hash = hashKey(key, klen);
+  auto const s = stripeFor(hash);
+  StripeLock lock(this, s);
+  auto const slot = find(s, key, klen, hash);
+  if (!slot || !live(s, slot)) return false;
+  remove(s, slot);
+  return true;
+}
+
+bool SharedMemoryTable::update(const char* key, size_t klen,
+                               const std::function<bool(std::string&)>& f) {
+  auto const hash = hashKey(key, klen);
+  auto const s = stripeFor(hash);
+  StripeLock lock(this, s);
+  auto const slot = find(s, key, klen, hash);
+  if (!slot || !live(s, slot)) return false;
+  std::string val(heap(s) + slot->off + klen, slot->vlen);
+  if (!f(val)) return false;
+
+  auto const oldRec = recordSize(klen, slot->vlen);
+  auto const rec = recordSize(klen, val.size());
+  if (rec <= oldRec) {
+    memcpy(heap(s) + slot->off + klen, val.data(), val.size());
+    slot->vlen = val.size();
+    s->liveBytes -= oldRec - rec;
+    return true;
+  }
+  auto const expiry = slot->expiry;
+  if (!reserve(s, rec)) return false;
+  if (auto const old = find(s, key, klen, hash)) remove(s, old);
+  insert(s, hash, key, klen, val.data(), val.size(), expiry);
+  return true;
+}
+
+void SharedMemoryTable::clear() {
+  for (uint32_t i = 0; i < kStripes; ++i) {
+    auto const s = stripeAt(i);
+    StripeLock lock(this, s);
+    wipe(s);
+  }
+}
+
+size_t SharedMemoryTable::size() const {
+  size_t n = 0;
+  for (uint32_t i = 0; i < kStripes; ++i) {
+    auto const s = stripeAt(i);
+    StripeLock lock(this, s);
+    n += s->count;
+  }
+  return n;
+}
+
+uint64_t SharedMemoryTable::recoveries() const {
+  return m_header->recoveries.load();
+}
+
+//////////////////////////////////////////////////////////////////////
+
+}
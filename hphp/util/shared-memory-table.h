@@ -0,0 +1,126 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+#ifndef incl_HPHP_SHARED_MEMORY_TABLE_H_
+#define incl_HPHP_SHARED_MEMORY_TABLE_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+namespace HPHP {
+
+//////////////////////////////////////////////////////////////////////
+
+/*
+ * A hash table from byte strings to byte strings in a named POSIX
+ * shared-memory segment, usable by any number of processes on the host
+ * at once, and surviving all of them.
+ *
+ * The segment is split into kStripes stripes by key hash.  Each stripe
+ * has its own process-shared robust mutex, an open-addressed array of
+ * slots and a heap the keys and values are appended to.  When the heap
+ * fills up it is compacted, and if that isn't enough, keys are evicted
+ * round-robin.  Keys with an expiry time are dropped when found expired.
+ *
+ * Crash safety: every change to a stripe happens under its mutex.  If a
+ * process dies holding one, the next process to take it sees EOWNERDEAD
+ * and empties the stripe before using it, so a crash can lose a
+ * stripe's contents but never leaves it corrupt or locked.  Creating
+ * and formatting the segment happens under an flock() on it, which dies
+ * with its holder too; a segment whose header doesn't match this build
+ * and configuration is unlinked and replaced, leaving processes still
+ * attached to it with their own copy.
+ *
+ * Lookups copy the value out under the lock, so values should be small
+ * enough for that to be cheap.
+ */
+struct SharedMemoryTable : private boost::noncopyable {
+  static constexpr uint32_t kStripes = 64;
+
+  /*
+   * Attach to the segment called name (as in shm_open(3)), creating it
+   * if necessary.  bytes is the size of the whole segment, and maxKeys
+   * the number of keys it has slots for.  Throws Exception on failure.
+   */
+  SharedMemoryTable(const std::string& name, size_t bytes, size_t maxKeys);
+  ~SharedMemoryTable();
+
+  static bool Remove(const std::string& name);
+
+  /*
+   * expiry is an absolute time() in seconds, or zero for never.  With
+   * overwrite false, a key that is present and unexpired is left alone
+   * and store() returns false.  It also returns false, leaving any old
+   * value in place, when the key and value are too big for a stripe.
+   */
+  bool store(const char* key, size_t klen, const char* val, size_t vlen,
+             int64_t expiry, bool overwrite = true);
+  bool get(const char* key, size_t klen, std::string& val);
+  bool exists(const char* key, size_t klen);
+  bool erase(const char* key, size_t klen);
+
+  /*
+   * Read-modify-write.  f gets the key's value and returns whether to
+   * store what it left there, keeping the old expiry.  f runs holding
+   * the stripe's lock, and must not use the table.  Returns false if
+   * the key is missing or f did.
+   */
+  bool update(const char* key, size_t klen,
+              const std::function<bool(std::string&)>& f);
+
+  void clear();
+
+  // Approximate: the stripes are counted one at a time.
+  size_t size() const;
+  // Stripes emptied because their lock's owner died.
+  uint64_t recoveries() const;
+
+private:
+  struct Header;
+  struct Stripe;
+  struct Slot;
+  struct StripeLock;
+
+  Stripe* stripeAt(uint32_t i) const;
+  Stripe* stripeFor(uint64_t hash) const;
+  Slot* slots(const Stripe* s) const;
+  char* heap(const Stripe* s) const;
+
+  static uint64_t hashKey(const char* key, size_t klen);
+  Slot* find(Stripe* s, const char* key, size_t klen, uint64_t hash) const;
+  bool live(Stripe* s, Slot* slot);
+  void remove(Stripe* s, Slot* slot);
+  bool reserve(Stripe* s, size_t need);
+  void compact(Stripe* s);
+  void insert(Stripe* s, uint64_t hash, const char* key, size_t klen,
+              const char* val, size_t vlen, int64_t expiry);
+  void wipe(Stripe* s) const;
+
+  void attach(int fd, size_t bytes, size_t maxKeys, bool& formatted);
+
+  std::string m_name;
+  char* m_base;
+  size_t m_bytes;
+  Header* m_header;
+};
+
+//////////////////////////////////////////////////////////////////////
+
+}
+
+#endif
@@ -0,0 +1,602 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+#include "hphp/util/string-simd.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+namespace HPHP {
+
+//////////////////////////////////////////////////////////////////////
+
+namespace {
+
+//////////////////////////////////////////////////////////////////////
+// Portable versions.  The vector versions finish their tails with these.
+
+const char* memmemScalar(const char* h, size_t hlen,
+                         const char* n, size_t nlen) {
+  assert(nlen > 0);
+  if (nlen > hlen) return nullptr;
+  auto const last = h + (hlen - nlen);
+  for (auto p = h; p <= last; ++p) {
+    p = static_cast<const char*>(memchr(p, n[0], last - p + 1));
+    if (!p) return nullptr;
+    if (!memcmp(p + 1, n + 1, nlen - 1)) return p;
+  }
+  return nullptr;
+}
+
+bool isAsciiLetter(unsigned char lc) {
+  return unsigned(lc - 'a') < 26;
+}
+
+const char* memcasechrScalar(const char* s, size_t len, char c) {
+  unsigned char const lc = c | 0x20;
+  if (!isAsciiLetter(lc)) {
+    return static_cast<const char*>(memchr(s, c, len));
+  }
+  for (size_t i = 0; i < len; ++i) {
+    if ((s[i] | 0x20) == lc) return s + i;
+  }
+  return nullptr;
+}
+
+// Flip the case bit of every byte in [lo, hi].
+template<char lo, char hi>
+void toCaseScalar(char* dst, const char* src, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    auto const c = src[i];
+    dst[i] = unsigned(c - lo) <= unsigned(hi - lo) ? c ^ 0x20 : c;
+  }
+}
+
+struct ByteSet {
+  ByteSet(const char* set, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      unsigned char const c = set[i];
+      bits[c >> 6] |= uint64_t(1) << (c & 63);
+    }
+  }
+  bool has(char c) const {
+    unsigned char const u = c;
+    return (bits[u >> 6] >> (u & 63)) & 1;
+  }
+  uint64_t bits[4] = {};
+};
+
+size_t spanScalar(const char* s, size_t len, const char* set, size_t n) {
+  ByteSet const bs(set, n);
+  size_t i = 0;
+  while (i < len && bs.has(s[i])) ++i;
+  return i;
+}
+
+size_t cspanScalar(const char* s, size_t len, const char* set, size_t n) {
+  ByteSet const bs(set, n);
+  size_t i = 0;
+  while (i < len && !bs.has(s[i])) ++i;
+  return i;
+}
+
+size_t asciiCspanScalar(const char* s, size_t len,
+                        const char* set, size_t n) {
+  ByteSet const bs(set, n);
+  size_t i = 0;
+  while (i < len && (unsigned char)s[i] < 0x80 && !bs.has(s[i])) ++i;
+  return i;
+}
+
+size_t rspanScalar(const char* s, size_t len, const char* set, size_t n) {
+  ByteSet const bs(set, n);
+  size_t i = len;
+  while (i > 0 && bs.has(s[i - 1])) --i;
+  return len - i;
+}
+
+#ifdef __x86_64__
+
+#define SSE42_FN __attribute__((__target__("sse4.2")))
+#define AVX2_FN __attribute__((__target__("avx2")))
+
+//////////////////////////////////////////////////////////////////////
+// SSE4.2: 16 bytes at a time.
+
+/*
+ * Compare 16 candidate starts at once on the needle's first and last
+ * bytes; only starts where both match get a full memcmp.
+ */
+SSE42_FN
+const char* memmemSSE42(const char* h, size_t hlen,
+                        const char* n, size_t nlen) {
+  assert(nlen > 0);
+  if (nlen == 1) return static_cast<const char*>(memchr(h, n[0], hlen));
+  if (nlen > hlen) return nullptr;
+  auto const first = _mm_set1_epi8(n[0]);
+  auto const last = _mm_set1_epi8(n[nlen - 1]);
+  size_t i = 0;
+  for (; i + nlen + 15 <= hlen; i += 16) {
+    auto const a = _mm_loadu_si128((const __m128i*)(h + i));
+    auto const b = _mm_loadu_si128((const __m128i*)(h + i + nlen - 1));
+    uint32_t mask = _mm_movemask_epi8(
+      _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+    while (mask) {
+      auto const off = i + __builtin_ctz(mask);
+      if (!memcmp(h + off + 1, n + 1, nlen - 2)) return h + off;
+      mask &= mask - 1;
+    }
+  }
+  return memmemScalar(h + i, hlen - i, n, nlen);
+}
+
+SSE42_FN
+const char* memcasechrSSE42(const char* s, size_t len, char c) {
+  unsigned char const lc = c | 0x20;
+  if (!isAsciiLetter(lc)) {
+    return static_cast<const char*>(memchr(s, c, len));
+  }
+  auto const fold = _mm_set1_epi8(0x20);
+  auto const want = _mm_set1_epi8(lc);
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    auto const v = _mm_or_si128(_mm_loadu_si128((const __m128i*)(s + i)),
+                                fold);
+    auto const mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, want));
+    if (mask) return s + i + __builtin_ctz(mask);
+  }
+  return memcasechrScalar(s + i, len - i, c);
+}
+
+// Bytes >= 0x80 compare as negative, so they are never in [lo, hi].
+template<char lo, char hi> SSE42_FN
+void toCaseSSE42(char* dst, const char* src, size_t len) {
+  auto const below = _mm_set1_epi8(lo - 1);
+  auto const above = _mm_set1_epi8(hi + 1);
+  auto const flip = _mm_set1_epi8(0x20);
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    auto const v = _mm_loadu_si128((const __m128i*)(src + i));
+    auto const in = _mm_and_si128(_mm_cmpgt_epi8(v, below),
+                                  _mm_cmpgt_epi8(above, v));
+    _mm_storeu_si128((__m128i*)(dst + i),
+                     _mm_xor_si128(v, _mm_and_si128(in, flip)));
+  }
+  toCaseScalar<lo, hi>(dst + i, src + i, len - i);
+}
+
+SSE42_FN __m128i loadSet(const char* set, size_t n) {
+  assert(n <= kSimdMaxSetLen);
+  char buf[16] = {};
+  memcpy(buf, set, n);
+  return _mm_loadu_si128((const __m128i*)buf);
+}
+
+constexpr int kAnyOf = _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY;
+
+SSE42_FN
+size_t spanSSE42(const char* s, size_t len, const char* set, size_t n) {
+  auto const sv = loadSet(set, n);
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    auto const v = _mm_loadu_si128((const __m128i*)(s + i));
+    auto const idx = _mm_cmpestri(sv, n, v, 16,
+                                  kAnyOf | _SIDD_NEGATIVE_POLARITY);
+    if (idx < 16) return i + idx;
+  }
+  return i + spanScalar(s + i, len - i, set, n);
+}
+
+SSE42_FN
+size_t cspanSSE42(const char* s, size_t len, const char* set, size_t n) {
+  auto const sv = loadSet(set, n);
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    auto const v = _mm_loadu_si128((const __m128i*)(s + i));
+    auto const idx = _mm_cmpestri(sv, n, v, 16, kAnyOf);
+    if (idx < 16) return i + idx;
+  }
+  return i + cspanScalar(s + i, len - i, set, n);
+}
+
+/*
+ * ASCII sets are looked up with two pshufbs instead of pcmpestri, which
+ * is slow when the scan stops every few bytes, as it does on markup.
+ * Entry (c & 15) of `lo' has bit (c >> 4) set for each member c; `bits'
+ * maps a high nibble to that bit.  A byte >= 0x80 has a high nibble of
+ * 8 or more, which `bits' maps to 0, so it always reports a match.
+ */
+struct NibbleTable {
+  NibbleTable(const char* set, size_t n) {
+    for (size_t k = 0; k < n; ++k) {
+      unsigned char const c = set[k];
+      if (c < 0x80) lo[c & 15] |= 1 << (c >> 4);
+    }
+  }
+  uint8_t lo[16] = {};
+};
+
+const uint8_t kNibbleBits[16] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+
+SSE42_FN
+uint32_t asciiStops(__m128i v, __m128i lo, __m128i bits) {
+  auto const mask = _mm_set1_epi8(0x0f);
+  auto const bit =
+    _mm_shuffle_epi8(bits, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+  auto const row = _mm_shuffle_epi8(lo, _mm_and_si128(v, mask));
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(row, bit), bit));
+}
+
+SSE42_FN
+size_t asciiCspanSSE42(const char* s, size_t len,
+                       const char* set, size_t n) {
+  NibbleTable const table(set, n);
+  auto const lo = _mm_loadu_si128((const __m128i*)table.lo);
+  auto const bits = _mm_loadu_si128((const __m128i*)kNibbleBits);
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    auto const stops =
+      asciiStops(_mm_loadu_si128((const __m128i*)(s + i)), lo, bits);
+    if (stops) return i + __builtin_ctz(stops);
+  }
+  return i + asciiCspanScalar(s + i, len - i, set, n);
+}
+
+SSE42_FN
+size_t rspanSSE42(const char* s, size_t len, const char* set, size_t n) {
+  auto const sv = loadSet(set, n);
+  size_t i = len;
+  for (; i >= 16; i -= 16) {
+    auto const v = _mm_loadu_si128((const __m128i*)(s + i - 16));
+    auto const idx = _mm_cmpestri(
+      sv, n, v, 16,
+      kAnyOf | _SIDD_NEGATIVE_POLARITY | _SIDD_MOST_SIGNIFICANT);
+    if (idx < 16) return len - (i - 16 + idx + 1);
+  }
+  return len - i + rspanScalar(s, i, set, n);
+}
+
+//////////////////////////////////////////////////////////////////////
+// AVX2: 32 bytes at a time.  Inputs or tails shorter than a ymm register
+// go to the SSE4.2 versions, which CPUs with AVX2 always have.
+
+AVX2_FN
+const char* memmemAVX2(const char* h, size_t hlen,
+                       const char* n, size_t nlen) {
+  assert(nlen > 0);
+  if (nlen == 1) return static_cast<const char*>(memchr(h, n[0], hlen));
+  if (nlen > hlen) return nullptr;
+  auto const first = _mm256_set1_epi8(n[0]);
+  auto const last = _mm256_set1_epi8(n[nlen - 1]);
+  size_t i = 0;
+  for (; i + nlen + 31 <= hlen; i += 32) {
+    auto const a = _mm256_loadu_si256((const __m256i*)(h + i));
+    auto const b = _mm256_loadu_si256((const __m256i*)(h + i + nlen - 1));
+    uint32_t mask = _mm256_movemask_epi8(
+      _mm256_and_si256(_mm256_cmpeq_epi8(a, first),
+                       _mm256_cmpeq_epi8(b, last)));
+    while (mask) {
+      auto const off = i + __builtin_ctz(mask);
+      if (!memcmp(h + off + 1, n + 1, nlen - 2)) return h + off;
+      mask &= mask - 1;
+    }
+  }
+  return memmemSSE42(h + i, hlen - i, n, nlen);
+}
+
+AVX2_FN
+const char* memcasechrAVX2(const char* s, size_t len, char c) {
+  unsigned char const lc = c | 0x20;
+  if (!isAsciiLetter(lc)) {
+    return static_cast<const char*>(memchr(s, c, len));
+  }
+  auto const fold = _mm256_set1_epi8(0x20);
+  auto const want = _mm256_set1_epi8(lc);
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    auto const v = _mm256_or_si256(
+      _mm256_loadu_si256((const __m256i*)(s + i)), fold);
+    uint32_t const mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, want));
+    if (mask) return s + i + __builtin_ctz(mask);
+  }
+  return memcasechrSSE42(s + i, len - i, c);
+}
+
+template<char lo, char hi> AVX2_FN
+void toCaseAVX2(char* dst, const char* src, size_t len) {
+  auto const below = _mm256_set1_epi8(lo - 1);
+  auto const above = _mm256_set1_epi8(hi + 1);
+  auto const flip = _mm256_set1_epi8(0x20);
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    auto const v = _mm256_loadu_si256((const __m256i*)(src + i));
+    auto const in = _mm256_and_si256(_mm256_cmpgt_epi8(v, below),
+                                     _mm256_cmpgt_epi8(above, v));
+    _mm256_storeu_si256((__m256i*)(dst + i),
+                        _mm256_xor_si256(v, _mm256_and_si256(in, flip)));
+  }
+  toCaseSSE42<lo, hi>(dst + i, src + i, len - i);
+}
+
+/*
+ * AVX2 has no counterpart to pcmpestri on ymm registers, so set scans
+ * compare against each member of the set in turn; with at most 16
+ * members that still beats pcmpestri's latency.
+ */
+struct SetAVX2 {
+  AVX2_FN SetAVX2(const char* set, size_t n) : n(n) {
+    assert(n <= kSimdMaxSetLen);
+    for (size_t k = 0; k < n; ++k) members[k] = _mm256_set1_epi8(set[k]);
+  }
+
+  // Bit i is set iff byte i of v is in the set.
+  AVX2_FN uint32_t match(__m256i v) const {
+    auto acc = _mm256_setzero_si256();
+    for (size_t k = 0; k < n; ++k) {
+      acc = _mm256_or_si256(acc, _mm256_cmpeq_epi8(v, members[k]));
+    }
+    return _mm256_movemask_epi8(acc);
+  }
+
+  __m256i members[kSimdMaxSetLen];
+  size_t n;
+};
+
+AVX2_FN
+size_t spanAVX2(const char* s, size_t len, const char* set, size_t n) {
+  if (len < 32) return spanSSE42(s, len, set, n);
+  SetAVX2 const sv(set, n);
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    auto const miss =
+      ~sv.match(_mm256_loadu_si256((const __m256i*)(s + i)));
+    if (miss) return i + __builtin_ctz(miss);
+  }
+  return i + spanSSE42(s + i, len - i, set, n);
+}
+
+AVX2_FN
+size_t cspanAVX2(const char* s, size_t len, const char* set, size_t n) {
+  if (len < 32) return cspanSSE42(s, len, set, n);
+  SetAVX2 const sv(set, n);
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    auto const hit = sv.match(_mm256_loadu_si256((const __m256i*)(s + i)));
+    if (hit) return i + __builtin_ctz(hit);
+  }
+  return i + cspanSSE42(s + i, len - i, set, n);
+}
+
+AVX2_FN
+size_t asciiCspanAVX2(const char* s, size_t len,
+                      const char* set, size_t n) {
+  if (len < 32) return asciiCspanSSE42(s, len, set, n);
+  NibbleTable const table(set, n);
+  // vpshufb looks up within each 128-bit lane, so both lanes get a copy.
+  auto const lo = _mm256_broadcastsi128_si256(
+    _mm_loadu_si128((const __m128i*)table.lo));
+  auto const bits = _mm256_broadcastsi128_si256(
+    _mm_loadu_si128((const __m128i*)kNibbleBits));
+  auto const mask = _mm256_set1_epi8(0x0f);
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    auto const v = _mm256_loadu_si256((const __m256i*)(s + i));
+    auto const bit = _mm256_shuffle_epi8(
+      bits, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+    auto const row = _mm256_shuffle_epi8(lo, _mm256_and_si256(v, mask));
+    uint32_t const stops = _mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(_mm256_and_si256(row, bit), bit));
+    if (stops) return i + __builtin_ctz(stops);
+  }
+  return i + asciiCspanSSE42(s + i, len - i, set, n);
+}
+
+AVX2_FN
+size_t rspanAVX2(const char* s, size_t len, const char* set, size_t n) {
+  if (len < 32) return rspanSSE42(s, len, set, n);
+  SetAVX2 const sv(set, n);
+  size_t i = len;
+  for (; i >= 32; i -= 32) {
+    auto const miss =
+      ~sv.match(_mm256_loadu_si256((const __m256i*)(s + i - 32)));
+    if (miss) return len - (i - 32 + (31 - __builtin_clz(miss)) + 1);
+  }
+  return len - i + rspanSSE42(s, i, set, n);
+}
+
+#endif // __x86_64__
+
+//////////////////////////////////////////////////////////////////////
+
+struct Kernels {
+  SimdLevel level;
+  const char* (*memmem)(const char*, size_t, const char*, size_t);
+  const char* (*memcasechr)(const char*, size_t, char);
+  void (*tolower)(char*, const char*, size_t);
+  void (*toupper)(char*, const char*, size_t);
+  size_t (*span)(const char*, size_t, const char*, size_t);
+  size_t (*cspan)(const char*, size_t, const char*, size_t);
+  size_t (*rspan)(const char*, size_t, const char*, size_t);
+  size_t (*asciiCspan)(const char*, size_t, const char*, size_t);
+};
+
+const Kernels kScalarKernels = {
+  SimdLevel::None,
+  memmemScalar,
+  memcasechrScalar,
+  toCaseScalar<'A', 'Z'>,
+  toCaseScalar<'a', 'z'>,
+  spanScalar,
+  cspanScalar,
+  rspanScalar,
+  asciiCspanScalar,
+};
+
+#ifdef __x86_64__
+const Kernels kSSE42Kernels = {
+  SimdLevel::SSE42,
+  memmemSSE42,
+  memcasechrSSE42,
+  toCaseSSE42<'A', 'Z'>,
+  toCaseSSE42<'a', 'z'>,
+  spanSSE42,
+  cspanSSE42,
+  rspanSSE42,
+  asciiCspanSSE42,
+};
+
+const Kernels kAVX2Kernels = {
+  SimdLevel::AVX2,
+  memmemAVX2,
+  memcasechrAVX2,
+  toCaseAVX2<'A', 'Z'>,
+  toCaseAVX2<'a', 'z'>,
+  spanAVX2,
+  cspanAVX2,
+  rspanAVX2,
+  asciiCspanAVX2,
+};
+
+void cpuid(uint32_t leaf, uint32_t regs[4]) {
+  asm volatile ("cpuid"
+                : "=a" (regs[0]), "=b" (regs[1]), "=c" (regs[2]),
+                  "=d" (regs[3])
+                : "0" (leaf), "2" (0));
+}
+#endif
+
+SimdLevel detectLevel() {
+#ifdef __x86_64__
+  uint32_t regs[4];
+  cpuid(0, regs);
+  auto const maxLeaf = regs[0];
+  cpuid(1, regs);
+  auto const sse42   = regs[2] & (1u << 20);
+  auto const osxsave = regs[2] & (1u << 27);
+  auto const avx     = regs[2] & (1u << 28);
+  if (!sse42) return SimdLevel::None;
+  if (maxLeaf >= 7 && osxsave && avx) {
+    // The OS has to save the ymm registers across context switches.
+    uint32_t xcr0, edx;
+    asm volatile ("xgetbv" : "=a" (xcr0), "=d" (edx) : "c" (0));
+    if ((xcr0 & 6) == 6) {
+      cpuid(7, regs);
+      if (regs[1] & (1u << 5)) return SimdLevel::AVX2;
+    }
+  }
+  return SimdLevel::SSE42;
+#else
+  return SimdLevel::None;
+#endif
+}
+
+const Kernels& kernelsFor(SimdLevel level) {
+  switch (level) {
+    case SimdLevel::None:  break;
+#ifdef __x86_64__
+    case SimdLevel::SSE42: return kSSE42Kernels;
+    case SimdLevel::AVX2:  return kAVX2Kernels;
+#else
+    default: break;
+#endif
+  }
+  return kScalarKernels;
+}
+
+std::atomic<const Kernels*> s_kernels(nullptr);
+
+const Kernels& kernels() {
+  auto k = s_kernels.load(std::memory_order_relaxed);
+  if (__builtin_expect(k == nullptr, 0)) {
+    k = &kernelsFor(simdSupportedLevel());
+    s_kernels.store(k, std::memory_order_relaxed);
+  }
+  return *k;
+}
+
+}
+
+//////////////////////////////////////////////////////////////////////
+
+const char* simdLevelName(SimdLevel level) {
+  switch (level) {
+    case SimdLevel::None:  return "none";
+    case SimdLevel::SSE42: return "sse4.2";
+    case SimdLevel::AVX2:  return "avx2";
+  }
+  return "unknown";
+}
+
+SimdLevel simdSupportedLevel() {
+  static SimdLevel const level = detectLevel();
+  return level;
+}
+
+SimdLevel simdLevel() {
+  return kernels().level;
+}
+
+void setSimdLevel(SimdLevel level) {
+  if (level > simdSupportedLevel()) level = simdSupportedLevel();
+  s_kernels.store(&kernelsFor(level), std::memory_order_relaxed);
+}
+
+const char* simd_memmem(const char* haystack, size_t haystackLen,
+                        const char* needle, size_t needleLen) {
+  return kernels().memmem(haystack, haystackLen, needle, needleLen);
+}
+
+const char* simd_memcasechr(const char* s, size_t len, char c) {
+  return kernels().memcasechr(s, len, c);
+}
+
+void simd_ascii_tolower(char* dst, const char* src, size_t len) {
+  kernels().tolower(dst, src, len);
+}
+
+void simd_ascii_toupper(char* dst, const char* src, size_t len) {
+  kernels().toupper(dst, src, len);
+}
+
+size_t simd_span(const char* s, size_t len, const char* set, size_t setLen) {
+  assert(setLen <= kSimdMaxSetLen);
+  return kernels().span(s, len, set, setLen);
+}
+
+size_t simd_cspan(const char* s, size_t len, const char* set, size_t setLen) {
+  assert(setLen <= kSimdMaxSetLen);
+  return kernels().cspan(s, len, set, setLen);
+}
+
+size_t simd_rspan(const char* s, size_t len, const char* set, size_t setLen) {
+  assert(setLen <= kSimdMaxSetLen);
+  return kernels().rspan(s, len, set, setLen);
+}
+
+size_t simd_ascii_cspan(const char* s, size_t len,
+                        const char* set, size_t setLen) {
+  assert(setLen <= kSimdMaxSetLen);
+  return kernels().asciiCspan(s, len, set, setLen);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+}
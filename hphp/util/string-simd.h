@@ -0,0 +1,104 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+#ifndef incl_HPHP_STRING_SIMD_H_
+#define incl_HPHP_STRING_SIMD_H_
+
+#include <cstddef>
+
+namespace HPHP {
+
+//////////////////////////////////////////////////////////////////////
+
+/*
+ * Byte-string kernels behind the zend-string primitives.
+ *
+ * Each kernel has a portable version and, on x86-64, SSE4.2 and AVX2
+ * versions.  The widest one the CPU (and OS, for the ymm registers)
+ * supports is picked from CPUID the first time any kernel is called.
+ * All versions give identical results; the vector ones only load whole
+ * vectors that lie inside the input, and finish short tails with the
+ * portable code.
+ *
+ * This file deliberately depends on nothing but libc, so that the
+ * benchmark in hphp/tools/benchmarks can build it on its own.
+ */
+
+enum class SimdLevel {
+  None,
+  SSE42,
+  AVX2,
+};
+
+const char* simdLevelName(SimdLevel level);
+
+/*
+ * The level the kernels currently run at, and the best one this
+ * machine supports.
+ */
+SimdLevel simdLevel();
+SimdLevel simdSupportedLevel();
+
+/*
+ * Run the kernels at `level', or at simdSupportedLevel() if that is
+ * lower.  Meant for benchmarks and tests, which compare the versions
+ * against each other; it is not safe to call while other threads are
+ * using the kernels.
+ */
+void setSimdLevel(SimdLevel level);
+
+/*
+ * Returns a pointer to the first occurrence of the needle in the
+ * haystack, or nullptr.
+ *
+ * Pre: needleLen > 0
+ */
+const char* simd_memmem(const char* haystack, size_t haystackLen,
+                        const char* needle, size_t needleLen);
+
+/*
+ * memchr, except that ASCII letters match regardless of case.
+ */
+const char* simd_memcasechr(const char* s, size_t len, char c);
+
+/*
+ * Copy `len' bytes from src to dst, mapping 'A'-'Z' to 'a'-'z' (or the
+ * reverse).  Every other byte is copied unchanged.  dst may be src.
+ */
+void simd_ascii_tolower(char* dst, const char* src, size_t len);
+void simd_ascii_toupper(char* dst, const char* src, size_t len);
+
+/*
+ * Scans against a small byte set, given as `setLen' bytes at `set'.
+ *
+ *   simd_span:  length of the longest prefix made only of bytes in set
+ *   simd_cspan: length of the longest prefix with no bytes in set
+ *   simd_rspan: length of the longest suffix made only of bytes in set
+ *   simd_ascii_cspan: like simd_cspan, but also stops at any byte >= 0x80
+ *
+ * Pre: setLen <= kSimdMaxSetLen
+ */
+constexpr size_t kSimdMaxSetLen = 16;
+size_t simd_span(const char* s, size_t len, const char* set, size_t setLen);
+size_t simd_cspan(const char* s, size_t len, const char* set, size_t setLen);
+size_t simd_rspan(const char* s, size_t len, const char* set, size_t setLen);
+size_t simd_ascii_cspan(const char* s, size_t len,
+                        const char* set, size_t setLen);
+
+//////////////////////////////////////////////////////////////////////
+
+}
+
+#endif
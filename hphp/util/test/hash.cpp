@@ -0,0 +1,62 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include "hphp/util/hash.h"
+#include "hphp/util/string-simd.h"
+
+#include <set>
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace HPHP {
+
+TEST(HashTest, CrcIsCaseInsensitive) {
+  if (simdSupportedLevel() < SimdLevel::SSE42) return;
+  std::string lower = "abcdefghijklmnopqrstuvwxyz_0123456789";
+  for (size_t len = 0; len <= lower.size(); len++) {
+    std::string upper = lower.substr(0, len);
+    for (auto& c : upper) c = toupper(c);
+    EXPECT_EQ(hash_string_i_crc(lower.data(), len),
+              hash_string_i_crc(upper.data(), len));
+    EXPECT_GE(hash_string_i_crc(lower.data(), len), 0);
+  }
+}
+
+TEST(HashTest, CrcSeesEveryByte) {
+  if (simdSupportedLevel() < SimdLevel::SSE42) return;
+  // Changing any single byte, or padding with NULs, changes the hash.
+  for (size_t len = 1; len <= 40; len++) {
+    std::string base(len, 'x');
+    auto const h = hash_string_i_crc(base.data(), len);
+    for (size_t i = 0; i < len; i++) {
+      auto s = base;
+      s[i] = 'y';
+      EXPECT_NE(h, hash_string_i_crc(s.data(), len));
+    }
+    std::string padded = base + '\0';
+    EXPECT_NE(h, hash_string_i_crc(padded.data(), len + 1));
+  }
+}
+
+TEST(HashTest, SelectedFunctionIsStable) {
+  auto const f = stringHashFunction();
+  EXPECT_NE(StringHashFunction::Unset, f);
+  EXPECT_EQ(f, stringHashFunction());
+  EXPECT_EQ(hash_string_i("Foo", 3), hash_string_i("fOO", 3));
+}
+
+}
@@ -0,0 +1,95 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+#include "hphp/util/heavy-hitters.h"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace HPHP {
+
+namespace {
+
+// The sketch is too big for the stack.
+std::unique_ptr<HeavyHitters> make() {
+  return std::unique_ptr<HeavyHitters>(new HeavyHitters);
+}
+
+}
+
+TEST(HeavyHitters, FindsHotKeysAmongCold) {
+  auto hh = make();
+  for (int round = 0; round < 100; ++round) {
+    for (int i = 0; i < 5; ++i) {
+      auto key = "hot:" + std::to_string(i);
+      hh->add(key.data(), key.size(), 10 * (i + 1));
+    }
+    for (int i = 0; i < 1000; ++i) {
+      auto key = "cold:" + std::to_string(round * 1000 + i);
+      hh->add(key.data(), key.size(), 1);
+    }
+  }
+
+  auto top = hh->top(5);
+  ASSERT_EQ(5u, top.size());
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ("hot:" + std::to_string(4 - i), top[i].first);
+    // Never an undercount, and close for keys this heavy.
+    EXPECT_GE(top[i].second, 1000u * (5 - i));
+    EXPECT_LE(top[i].second, 1000u * (5 - i) + 200);
+  }
+}
+
+TEST(HeavyHitters, TruncatesLongKeys) {
+  auto hh = make();
+  std::string key(HeavyHitters::kMaxKeyLen + 10, 'k');
+  hh->add(key.data(), key.size(), 3);
+  auto top = hh->top(10);
+  ASSERT_EQ(1u, top.size());
+  EXPECT_EQ(key.substr(0, HeavyHitters::kMaxKeyLen) + "...", top[0].first);
+  EXPECT_EQ(3u, top[0].second);
+}
+
+TEST(HeavyHitters, Reset) {
+  auto hh = make();
+  hh->add("a", 1, 1);
+  hh->reset();
+  EXPECT_TRUE(hh->top(10).empty());
+}
+
+TEST(HeavyHitters, Threads) {
+  auto hh = make();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < 20000; ++i) {
+        hh->add("shared", 6, 1);
+        auto key = std::to_string(t) + ":" + std::to_string(i);
+        hh->add(key.data(), key.size(), 1);
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  auto top = hh->top(1);
+  ASSERT_EQ(1u, top.size());
+  EXPECT_EQ("shared", top[0].first);
+  EXPECT_GE(top[0].second, 80000u);
+}
+
+}
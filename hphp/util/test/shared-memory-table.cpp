@@ -0,0 +1,182 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+#include "hphp/util/shared-memory-table.h"
+#include <gtest/gtest.h>
+
+#include <ctime>
+#include <string>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace HPHP {
+
+//////////////////////////////////////////////////////////////////////
+
+namespace {
+
+std::string segmentName() {
+  return "/hphp-shm-table-test-" + std::to_string(getpid());
+}
+
+struct SegmentRemover {
+  explicit SegmentRemover(const std::string& name) : m_name(name) {
+    SharedMemoryTable::Remove(name);
+  }
+  ~SegmentRemover() { SharedMemoryTable::Remove(m_name); }
+  std::string m_name;
+};
+
+bool store(SharedMemoryTable& t, const std::string& k, const std::string& v,
+           int64_t expiry = 0, bool overwrite = true) {
+  return t.store(k.data(), k.size(), v.data(), v.size(), expiry, overwrite);
+}
+
+bool get(SharedMemoryTable& t, const std::string& k, std::string& v) {
+  return t.get(k.data(), k.size(), v);
+}
+
+}
+
+TEST(SharedMemoryTable, Basic) {
+  auto const name = segmentName();
+  SegmentRemover remover(name);
+  SharedMemoryTable t(name, 8 << 20, 1024);
+
+  std::string v;
+  EXPECT_FALSE(get(t, "a", v));
+  EXPECT_TRUE(store(t, "a", "one"));
+  EXPECT_TRUE(get(t, "a", v));
+  EXPECT_EQ("one", v);
+  EXPECT_FALSE(store(t, "a", "two", 0, false));
+  EXPECT_TRUE(store(t, "a", "three"));
+  EXPECT_TRUE(get(t, "a", v));
+  EXPECT_EQ("three", v);
+  EXPECT_TRUE(t.exists("a", 1));
+  EXPECT_EQ(1u, t.size());
+
+  EXPECT_TRUE(store(t, "gone", "x", time(nullptr) - 1));
+  EXPECT_FALSE(t.exists("gone", 4));
+  EXPECT_TRUE(store(t, "gone", "y", 0, false));
+
+  EXPECT_TRUE(t.update("a", 1, [] (std::string& s) {
+    s += " and more";
+    return true;
+  }));
+  EXPECT_TRUE(get(t, "a", v));
+  EXPECT_EQ("three and more", v);
+  EXPECT_FALSE(t.update("a", 1, [] (std::string& s) { return false; }));
+  EXPECT_FALSE(t.update("nope", 4, [] (std::string& s) { return true; }));
+
+  EXPECT_TRUE(t.erase("a", 1));
+  EXPECT_FALSE(t.erase("a", 1));
+  t.clear();
+  EXPECT_EQ(0u, t.size());
+}
+
+TEST(SharedMemoryTable, SharedBetweenMappings) {
+  auto const name = segmentName();
+  SegmentRemover remover(name);
+  SharedMemoryTable t1(name, 8 << 20, 1024);
+  SharedMemoryTable t2(name, 8 << 20, 1024);
+
+  std::string v;
+  EXPECT_TRUE(store(t1, "k", "v"));
+  EXPECT_TRUE(get(t2, "k", v));
+  EXPECT_EQ("v", v);
+
+  // A different configuration gets a segment of its own.
+  SharedMemoryTable t3(name, 16 << 20, 1024);
+  EXPECT_FALSE(get(t3, "k", v));
+  EXPECT_TRUE(get(t1, "k", v));
+}
+
+TEST(SharedMemoryTable, OutlivesWriter) {
+  auto const name = segmentName();
+  SegmentRemover remover(name);
+
+  auto const pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    SharedMemoryTable child(name, 8 << 20, 1024);
+    _exit(store(child, "written", "by another process") ? 0 : 1);
+  }
+  int status;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(0, WEXITSTATUS(status));
+
+  SharedMemoryTable t(name, 8 << 20, 1024);
+  std::string v;
+  EXPECT_TRUE(get(t, "written", v));
+  EXPECT_EQ("by another process", v);
+}
+
+TEST(SharedMemoryTable, FillsUp) {
+  auto const name = segmentName();
+  SegmentRemover remover(name);
+  SharedMemoryTable t(name, 4 << 20, 4096);
+
+  std::string const big(1000, 'x');
+  for (int i = 0; i < 20000; ++i) {
+    EXPECT_TRUE(store(t, "key" + std::to_string(i), big));
+  }
+  EXPECT_LT(t.size(), 20000u);
+  std::string v;
+  EXPECT_TRUE(get(t, "key19999", v));
+  EXPECT_EQ(big, v);
+  EXPECT_FALSE(store(t, "huge", std::string(1 << 20, 'y')));
+
+  // Neither a store nor an update that can't fit loses the old value.
+  EXPECT_TRUE(store(t, "kept", "small"));
+  EXPECT_FALSE(store(t, "kept", std::string(1 << 20, 'y')));
+  EXPECT_FALSE(t.update("kept", 4, [] (std::string& s) -> bool {
+    s.assign(1 << 20, 'y');
+    return true;
+  }));
+  EXPECT_TRUE(get(t, "kept", v));
+  EXPECT_EQ("small", v);
+}
+
+TEST(SharedMemoryTable, RecoversFromCrash) {
+  auto const name = segmentName();
+  SegmentRemover remover(name);
+  SharedMemoryTable t(name, 8 << 20, 1024);
+  EXPECT_TRUE(store(t, "k", "v"));
+
+  auto const pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    SharedMemoryTable child(name, 8 << 20, 1024);
+    child.update("k", 1, [] (std::string&) -> bool { _exit(0); });
+    _exit(1);
+  }
+  int status;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(0, WEXITSTATUS(status));
+
+  std::string v;
+  EXPECT_FALSE(get(t, "k", v));
+  EXPECT_EQ(1u, t.recoveries());
+  EXPECT_TRUE(store(t, "k", "again"));
+  EXPECT_TRUE(get(t, "k", v));
+  EXPECT_EQ("again", v);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+}
@@ -0,0 +1,142 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include "hphp/util/string-simd.h"
+
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace HPHP {
+
+namespace {
+
+const SimdLevel kLevels[] = { SimdLevel::None, SimdLevel::SSE42,
+                              SimdLevel::AVX2 };
+
+/*
+ * Short alphabets make matches, near-misses and runs likely, which is
+ * where the vector versions have their edge cases.
+ */
+std::string randomString(std::mt19937& rng, size_t len) {
+  static const char alphabet[] = "aAbB \t\n\\'\"\0\xff";
+  std::string s(len, '\0');
+  for (auto& c : s) {
+    c = alphabet[rng() % (sizeof(alphabet) - 1)];
+  }
+  return s;
+}
+
+size_t refSpan(const std::string& s, const std::string& set, bool in) {
+  size_t i = 0;
+  while (i < s.size() && (set.find(s[i]) != std::string::npos) == in) ++i;
+  return i;
+}
+
+size_t refAsciiCspan(const std::string& s, const std::string& set) {
+  size_t i = 0;
+  while (i < s.size() && (unsigned char)s[i] < 0x80 &&
+         set.find(s[i]) == std::string::npos) {
+    ++i;
+  }
+  return i;
+}
+
+size_t refRspan(const std::string& s, const std::string& set) {
+  size_t i = s.size();
+  while (i > 0 && set.find(s[i - 1]) != std::string::npos) --i;
+  return s.size() - i;
+}
+
+char refLower(char c) { return c >= 'A' && c <= 'Z' ? c + 32 : c; }
+char refUpper(char c) { return c >= 'a' && c <= 'z' ? c - 32 : c; }
+
+struct LevelScope {
+  explicit LevelScope(SimdLevel level) : m_saved(simdLevel()) {
+    setSimdLevel(level);
+  }
+  ~LevelScope() { setSimdLevel(m_saved); }
+  SimdLevel m_saved;
+};
+
+}
+
+TEST(StringSimdTest, MemmemMatchesReference) {
+  std::mt19937 rng(1);
+  for (auto level : kLevels) {
+    LevelScope scope(level);
+    for (int i = 0; i < 5000; i++) {
+      auto const h = randomString(rng, rng() % 200);
+      auto const n = randomString(rng, 1 + rng() % 6);
+      auto const expected = h.find(n);
+      auto const got = simd_memmem(h.data(), h.size(), n.data(), n.size());
+      if (expected == std::string::npos) {
+        EXPECT_EQ(nullptr, got);
+      } else {
+        EXPECT_EQ(h.data() + expected, got);
+      }
+    }
+  }
+}
+
+TEST(StringSimdTest, CaseMatchesReference) {
+  std::mt19937 rng(2);
+  for (auto level : kLevels) {
+    LevelScope scope(level);
+    for (int i = 0; i < 2000; i++) {
+      auto const s = randomString(rng, rng() % 300);
+      std::string lower(s.size(), '\0'), upper(s.size(), '\0');
+      simd_ascii_tolower(&lower[0], s.data(), s.size());
+      simd_ascii_toupper(&upper[0], s.data(), s.size());
+      for (size_t j = 0; j < s.size(); j++) {
+        EXPECT_EQ(refLower(s[j]), lower[j]);
+        EXPECT_EQ(refUpper(s[j]), upper[j]);
+      }
+
+      auto const c = "aBz\\"[rng() % 4];
+      auto const got = simd_memcasechr(s.data(), s.size(), c);
+      size_t k = 0;
+      while (k < s.size() && refLower(s[k]) != refLower(c)) ++k;
+      EXPECT_EQ(k < s.size() ? s.data() + k : nullptr, got);
+    }
+  }
+}
+
+TEST(StringSimdTest, SpansMatchReference) {
+  std::mt19937 rng(3);
+  for (auto level : kLevels) {
+    LevelScope scope(level);
+    for (int i = 0; i < 5000; i++) {
+      auto const s = randomString(rng, rng() % 300);
+      auto const set = randomString(rng, rng() % (kSimdMaxSetLen + 1));
+      auto const p = s.data();
+      auto const n = s.size();
+      EXPECT_EQ(refSpan(s, set, true),
+                simd_span(p, n, set.data(), set.size()));
+      EXPECT_EQ(refSpan(s, set, false),
+                simd_cspan(p, n, set.data(), set.size()));
+      EXPECT_EQ(refRspan(s, set),
+                simd_rspan(p, n, set.data(), set.size()));
+      EXPECT_EQ(refAsciiCspan(s, set),
+                simd_ascii_cspan(p, n, set.data(), set.size()));
+    }
+  }
+}
+
+}
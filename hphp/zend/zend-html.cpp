@@ -17,6 +17,7 @@
 
 #include "hphp/zend/zend-html.h"
 #include "hphp/util/lock.h"
+#include "hphp/util/string-simd.h"
 #include <unicode/uchar.h>
 #include <unicode/utf8.h>
 
@@ -453,6 +454,133 @@ static void init_entity_table() {
 
 ///////////////////////////////////////////////////////////////////////////////
 
+namespace {
+
+/*
+ * The bytes an encoder may rewrite.  The encoders find runs of other
+ * bytes with a vector scan and copy them in bulk.
+ */
+struct HtmlEncodeSet {
+  char bytes[kSimdMaxSetLen];
+  int size; // -1 if the bytes don't fit; scan a byte at a time
+};
+
+HtmlEncodeSet html_encode_set(bool encode_double_quote,
+                              bool encode_single_quote, bool utf8,
+                              bool nbsp) {
+  HtmlEncodeSet set;
+  int n = 0;
+  set.bytes[n++] = '<';
+  set.bytes[n++] = '>';
+  set.bytes[n++] = '&';
+  if (encode_double_quote) set.bytes[n++] = '"';
+  if (encode_single_quote) set.bytes[n++] = '\'';
+  if (nbsp) set.bytes[n++] = utf8 ? '\xc2' : '\xa0';
+  set.size = n;
+  return set;
+}
+
+/*
+ * Length of the prefix of [p, end) that string_html_encode copies
+ * unchanged.  A '\xc2' only matters when it starts a UTF-8 nbsp.
+ */
+int html_encode_span(const char *p, const char *end,
+                     const HtmlEncodeSet &set) {
+  const char *q = p;
+  for (;;) {
+    q += simd_cspan(q, end - q, set.bytes, set.size);
+    if (q == end || *q != '\xc2' || (q + 1 < end && q[1] == '\xa0')) {
+      return q - p;
+    }
+    q++;
+  }
+}
+
+HtmlEncodeSet html_encode_extra_set(StringHtmlEncoding flags,
+                                    const AsciiMap *asciiMap) {
+  HtmlEncodeSet set;
+  int n = 0;
+  // NUL isn't on the ASCII fast path: it is only copied as is when the
+  // input is Latin-1 and high bytes aren't encoded.
+  bool const nulIsPlain =
+    !(flags & (STRING_HTML_ENCODE_UTF8 | STRING_HTML_ENCODE_HIGH));
+  if (!nulIsPlain) set.bytes[n++] = '\0';
+  for (int c = 1; c < 128; c++) {
+    if ((asciiMap->map[c & 64 ? 1 : 0] >> (c & 63)) & 1) {
+      if (n == (int)kSimdMaxSetLen) {
+        set.size = -1;
+        return set;
+      }
+      set.bytes[n++] = c;
+    }
+  }
+  set.size = n;
+  return set;
+}
+
+/*
+ * Length of the prefix of input that string_html_encode_extra copies
+ * unchanged: ASCII outside the map, plus whatever non-ASCII input it
+ * passes through (well-formed UTF-8, or Latin-1 other than nbsp, unless
+ * STRING_HTML_ENCODE_HIGH asks for those to be encoded too).
+ */
+int html_encode_extra_span(const char *input, int pos, int len,
+                           StringHtmlEncoding flags,
+                           const AsciiMap *asciiMap,
+                           const HtmlEncodeSet &set) {
+  int const start = pos;
+  while (pos < len) {
+    if (set.size >= 0) {
+      pos += simd_ascii_cspan(input + pos, len - pos, set.bytes, set.size);
+    } else {
+      for (; pos < len; pos++) {
+        unsigned char c = input[pos];
+        if ((!c && (flags & (STRING_HTML_ENCODE_UTF8 |
+                             STRING_HTML_ENCODE_HIGH))) ||
+            c >= 128 ||
+            ((asciiMap->map[c & 64 ? 1 : 0] >> (c & 63)) & 1)) {
+          break;
+        }
+      }
+    }
+    if (pos == len) break;
+
+    unsigned char c = input[pos];
+    if ((c && c < 128) || (flags & STRING_HTML_ENCODE_HIGH)) break;
+    if (flags & STRING_HTML_ENCODE_UTF8) {
+      int32_t next = pos;
+      UChar32 curCodePoint;
+      U8_NEXT(input, next, len, curCodePoint);
+      if (curCodePoint <= 0) break;
+      if ((flags & STRING_HTML_ENCODE_NBSP) && curCodePoint == 0xC2A0) break;
+      pos = next;
+    } else {
+      if (c == 0xa0) break;
+      pos++;
+    }
+  }
+  return pos - start;
+}
+
+}
+
+int string_html_encode_span(const char *input, int len,
+                            bool encode_double_quote,
+                            bool encode_single_quote, bool utf8, bool nbsp) {
+  assert(input);
+  auto const set = html_encode_set(encode_double_quote, encode_single_quote,
+                                   utf8, nbsp);
+  return html_encode_span(input, input + len, set);
+}
+
+int string_html_encode_extra_span(const char *input, int len,
+                                  StringHtmlEncoding flags,
+                                  const AsciiMap *asciiMap) {
+  assert(input);
+  auto const set = html_encode_extra_set(flags, asciiMap);
+  return html_encode_extra_span(input, 0, len, flags, asciiMap, set);
+}
+
 char *string_html_encode(const char *input, int &len, bool encode_double_quote,
                          bool encode_single_quote, bool utf8, bool nbsp) {
   assert(input);
@@ -474,8 +602,16 @@ char *string_html_encode(const char *input, int &len, bool encode_double_quote,
   if (!ret) {
     return nullptr;
   }
+  auto const set = html_encode_set(encode_double_quote, encode_single_quote,
+                                   utf8, nbsp);
   char *q = ret;
   for (const char *p = input, *end = input + len; p < end; p++) {
+    int run = html_encode_span(p, end, set);
+    memcpy(q, p, run);
+    q += run;
+    p += run;
+    if (p == end) break;
+
     char c = *p;
     switch (c) {
     case '"':
@@ -502,7 +638,7 @@ char *string_html_encode(const char *input, int &len, bool encode_double_quote,
       *q++ = '&'; *q++ = 'a'; *q++ = 'm'; *q++ = 'p'; *q++ = ';';
       break;
     case '\xc2':
-      if (nbsp && utf8 && *(p+1) == '\xa0') {
+      if (nbsp && utf8 && p + 1 < end && *(p+1) == '\xa0') {
         *q++ = '&'; *q++ = 'n'; *q++ = 'b'; *q++ = 's'; *q++ = 'p'; *q++ = ';';
         p++;
       } else {
@@ -552,10 +688,18 @@ char *string_html_encode_extra(const char *input, int &len,
   if (!ret) {
     return nullptr;
   }
+  auto const set = html_encode_extra_set(flags, asciiMap);
   char *q = ret;
   const char *rep = "\ufffd";
   int32_t srcPosBytes;
   for (srcPosBytes = 0; srcPosBytes < len; /* incremented in-loop */) {
+    int run = html_encode_extra_span(input, srcPosBytes, len, flags,
+                                     asciiMap, set);
+    memcpy(q, input + srcPosBytes, run);
+    q += run;
+    srcPosBytes += run;
+    if (srcPosBytes == len) break;
+
     unsigned char c = input[srcPosBytes];
     if (c && c < 128) {
       srcPosBytes++; // Optimize US-ASCII case
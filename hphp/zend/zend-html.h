@@ -98,6 +98,17 @@ char *string_html_encode_extra(const char *input, int &len,
                                StringHtmlEncoding flags,
                                const AsciiMap *asciiMap);
 
+/*
+ * Length of the longest prefix of input that the matching encoder above
+ * would copy unchanged.  If it is len, the input needs no encoding.
+ */
+int string_html_encode_span(const char *input, int len,
+                            bool encode_double_quote,
+                            bool encode_single_quote, bool utf8, bool nbsp);
+int string_html_encode_extra_span(const char *input, int len,
+                                  StringHtmlEncoding flags,
+                                  const AsciiMap *asciiMap);
+
 /**
  * returns decoded string;
  * note, can return nullptr if the charset could not be detected